@@ -24,10 +24,13 @@
 
 #include <ais/ais_decode.h>
 
+#include <msgfmt/msg_json.h>
+
 #include <filter/filter.h>
 #include <filter/sample_buf.h>
 #include <filter/complex.h>
 #include <filter/dc_blocker.h>
+#include <filter/shm_ring.h>
 
 #include <app/app.h>
 
@@ -42,12 +45,15 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
-#include <ctype.h>
-#include <time.h>
 #include <inttypes.h>
 
 #define DEC_MSG(sev, sys, msg, ...) MESSAGE("DECODER", sev, sys, msg, ##__VA_ARGS__)
 
+/**
+ * How long to wait for a block from the input ring before checking if we should stop
+ */
+#define RING_WAIT_NS                100000000ull
+
 enum decoder_decoder_type {
     DECODER_PAGER_TYPE_FLEX = 0,
     DECODER_PAGER_TYPE_POCSAG = 1,
@@ -69,6 +75,9 @@ unsigned input_sample_rate = 0;
 static
 int in_fifo = -1;
 
+static
+struct shm_ring_consumer *in_ring = NULL;
+
 static
 int16_t *filter_coeffs = NULL;
 
@@ -105,11 +114,12 @@ bool _invert = false;
 static
 void _usage(const char *appname)
 {
-    DEC_MSG(SEV_INFO, "USAGE", "%s -I [interpolate] -D [decimate] -F [filter file] -d [sample_debug_file] -S [input sample rate] -f [center freq] [-c] [-o output JSON file] [-b] [-i] [in_fifo]",
+    DEC_MSG(SEV_INFO, "USAGE", "%s -I [interpolate] -D [decimate] -F [filter file] -d [sample_debug_file] -S [input sample rate] -f [center freq] [-c] [-o output JSON file] [-b] [-i] [-r in_ring | in_fifo]",
             appname);
     DEC_MSG(SEV_INFO, "USAGE", "        -b        Enable DC blocking filter          ");
     DEC_MSG(SEV_INFO, "USAGE", "        -c        Create JSON output file            ");
     DEC_MSG(SEV_INFO, "USAGE", "        -i        Invert input sample stream         ");
+    DEC_MSG(SEV_INFO, "USAGE", "        -r [ring] Read from a multifm output ring    ");
     DEC_MSG(SEV_INFO, "USAGE", "        -m [type] Specify protocol to decode         ");
     DEC_MSG(SEV_INFO, "USAGE", "           POCSAG - the POCSAG pager protocol        ");
     DEC_MSG(SEV_INFO, "USAGE", "           FLEX   - Motorola FLEX pager protocol     ");
@@ -117,59 +127,9 @@ void _usage(const char *appname)
     exit(EXIT_SUCCESS);
 }
 
-static const
-char phase_id[] = {
-    [0] = 'A',
-    [1] = 'B',
-    [2] = 'C',
-    [3] = 'D',
-};
-
 static
 FILE *out_file = NULL;
 
-static inline
-void _decoder_put_alnum_char(FILE *fp, char ch)
-{
-    switch (ch) {
-    case '\n':
-        fprintf(fp, "\\n");
-        break;
-    case '\r':
-        fprintf(fp, "\\n");
-        break;
-    case '\"':
-        fprintf(fp, "\\\"");
-        break;
-    case '\\':
-        fprintf(fp, "\\\\");
-        break;
-    case '/':
-        fprintf(fp, "\\/");
-        break;
-    case '\b':
-        fprintf(fp, "<BKSP>");
-        break;
-    case '\f':
-        fprintf(fp, "<FF>");
-        break;
-    case '\t':
-        fprintf(fp, "\\t");
-        break;
-    case 0x03:
-    case 0x04:
-    case 0x17:
-        fprintf(fp, " ");
-        break;
-    default:
-        if (isprint(ch)) {
-            fprintf(fp, "%c", ch);
-        } else {
-            fprintf(fp, "\\u%04x", (unsigned)ch);
-        }
-    }
-}
-
 static
 aresult_t _on_flex_alnum_msg(
         struct pager_flex *f,
@@ -184,24 +144,8 @@ aresult_t _on_flex_alnum_msg(
         const char *message_bytes,
         size_t message_len)
 {
-    /* TODO: this sucks, should move it closer to the capture clock */
-    time_t now = time(NULL);
-    struct tm *gmt = gmtime(&now);
-
-    fprintf(out_file, "{\"proto\":\"flex\",\"type\":\"alphanumeric\",\"timestamp\":\"%04i-%02i-%02i %02i:%02i:%02i UTC\","
-            "\"baud\":%i,\"syncLevel\":%i,\"frameNo\":%u,\"cycleNo\":%u,\"phaseNo\":\"%c\",\"capCode\":%"PRIu64",\"fragment\":%s,"
-            "\"maildrop\":%s,\"fragSeq\":%u,\"message\":\"",
-            gmt->tm_year + 1900, gmt->tm_mon + 1, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec,
-            baud, 0, frame_no, cycle_no, phase_id[phase], cap_code,
-            fragmented ? "true" : "false", maildrop ? "true" : "false", seq_num);
-
-    for (size_t i = 0; i < message_len; i++) {
-        _decoder_put_alnum_char(out_file, message_bytes[i]);
-    }
-
-    fprintf(out_file, "\"}\n");
-    fflush(out_file);
-
+    msg_json_flex_alnum(out_file, 0, baud, phase, cycle_no, frame_no, cap_code, fragmented, maildrop, seq_num,
+            message_bytes, message_len);
     return A_OK;
 }
 
@@ -216,22 +160,7 @@ aresult_t _on_flex_num_msg(
         const char *message_bytes,
         size_t message_len)
 {
-    /* TODO: this sucks, should move it closer to the capture clock */
-    time_t now = time(NULL);
-    struct tm *gmt = gmtime(&now);
-
-    fprintf(out_file, "{\"proto\":\"flex\",\"type\":\"numeric\",\"timestamp\":\"%04i-%02i-%02i %02i:%02i:%02i UTC\","
-            "\"baud\":%i,\"syncLevel\":%i,\"frameNo\":%u,\"cycleNo\":%u,\"phaseNo\":\"%c\",\"capCode\":%"PRIu64",\"message\":\"",
-            gmt->tm_year + 1900, gmt->tm_mon + 1, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec,
-            baud, 0, frame_no, cycle_no, phase_id[phase], cap_code);
-
-    for (size_t i = 0; i < message_len; i++) {
-        _decoder_put_alnum_char(out_file, message_bytes[i]);
-    }
-
-    fprintf(out_file, "\"}\n");
-    fflush(out_file);
-
+    msg_json_flex_num(out_file, 0, baud, phase, cycle_no, frame_no, cap_code, message_bytes, message_len);
     return A_OK;
 }
 
@@ -246,18 +175,7 @@ aresult_t _on_flex_siv_msg(
         uint8_t siv_msg_type,
         uint32_t data)
 {
-    /* TODO: this sucks, should move it closer to the capture clock */
-    time_t now = time(NULL);
-    struct tm *gmt = gmtime(&now);
-
-    switch (siv_msg_type) {
-    case PAGER_FLEX_SIV_TEMP_ADDRESS_ACTIVATION:
-        fprintf(out_file, "{\"proto\":\"flex\",\"type\":\"tempAddrActivation\",\"timestamp\":\"%04i-%02i-%02i %02i:%02i:%02i UTC\","
-                "\"baud\":%i,\"syncLevel\":%i,\"frameNo\":%u,\"cycleNo\":%u,\"phaseNo\":\"%c\",\"capCode\":%"PRIu64",\"startFrameNo\":%u,\"tempAddressId\":%u}\n",
-                gmt->tm_year + 1900, gmt->tm_mon + 1, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec,
-                baud, 0, frame_no, cycle_no, phase_id[phase], cap_code, data & 0x7f, (data >> 7) & 0xf);
-        break;
-    }
+    msg_json_flex_siv(out_file, 0, baud, phase, cycle_no, frame_no, cap_code, siv_msg_type, data);
     return A_OK;
 }
 
@@ -270,22 +188,7 @@ aresult_t _on_pocsag_alnum_msg(
         size_t data_len,
         uint8_t function)
 {
-    /* TODO: this sucks, should move it closer to the capture clock */
-    time_t now = time(NULL);
-    struct tm *gmt = gmtime(&now);
-
-    fprintf(out_file, "{\"proto\":\"pocsag\",\"type\":\"alphanumeric\",\"timestamp\":\"%04i-%02i-%02i %02i:%02i:%02i UTC\","
-            "\"baud\":%i,\"capCode\":%u,\"function\":%u,\"message\":\"",
-            gmt->tm_year + 1900, gmt->tm_mon + 1, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec,
-            baud_rate, capcode, (unsigned)function);
-
-    for (size_t i = 0; i < data_len; i++) {
-        _decoder_put_alnum_char(out_file, data[i]);
-    }
-
-    fprintf(out_file, "\"}\n");
-    fflush(out_file);
-
+    msg_json_pocsag(out_file, 0, true, baud_rate, capcode, data, data_len, function);
     return A_OK;
 }
 
@@ -298,45 +201,14 @@ aresult_t _on_pocsag_num_msg(
         size_t data_len,
         uint8_t function)
 {
-    /* TODO: this sucks, should move it closer to the capture clock */
-    time_t now = time(NULL);
-    struct tm *gmt = gmtime(&now);
-
-    fprintf(out_file, "{\"proto\":\"pocsag\",\"type\":\"numeric\",\"timestamp\":\"%04i-%02i-%02i %02i:%02i:%02i UTC\","
-            "\"baud\":%i,\"capCode\":%u,\"function\":%u,\"message\":\"",
-            gmt->tm_year + 1900, gmt->tm_mon + 1, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec,
-            baud_rate, capcode, (unsigned)function);
-
-    for (size_t i = 0; i < data_len; i++) {
-        _decoder_put_alnum_char(out_file, data[i]);
-    }
-
-    fprintf(out_file, "\"}\n");
-    fflush(out_file);
-
+    msg_json_pocsag(out_file, 0, false, baud_rate, capcode, data, data_len, function);
     return A_OK;
 }
 
 static
 aresult_t _on_ais_position_report(struct ais_decode *decode, void *state, struct ais_position_report *pr, const char *raw_msg)
 {
-    time_t now = time(NULL);
-    struct tm *gmt = gmtime(&now);
-
-    fprintf(out_file,
-            "{\"proto\":\"ais\",\"type\":\"positionReport\",\"timestamp\":\"%04i-%02i-%02i %02i:%02i:%02i UTC\","
-            "\"mmsi\":%u,\"navStat\":%u,\"rateOfTurn\":%d,\"speedOverGround\":%f,\"positionAcc\":%u,"
-            "\"geoPosition\":{\"lon\":%f,\"lat\":%f},\"course\":%u,\"heading\":%u,\"seconds\":%u,\"rawAscii\":\"",
-            gmt->tm_year + 1900, gmt->tm_mon + 1, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec,
-            pr->mmsi, pr->nav_stat, pr->rate_of_turn, (double)pr->speed_over_ground, pr->position_acc,
-            (double)pr->longitude, (double)pr->latitude, pr->course, pr->heading, pr->timestamp);
-
-    for (size_t i = 0; i < strlen(raw_msg); i++) {
-        _decoder_put_alnum_char(out_file, raw_msg[i]);
-    }
-
-    fprintf(out_file, "\"}\n");
-
+    msg_json_ais_position_report(out_file, 0, pr, raw_msg);
     return A_OK;
 }
 
@@ -344,23 +216,7 @@ static
 aresult_t _on_ais_base_station_report(struct ais_decode *decode, void *state, struct ais_base_station_report *br,
         const char *raw_msg)
 {
-    time_t now = time(NULL);
-    struct tm *gmt = gmtime(&now);
-
-    fprintf(out_file,
-            "{\"proto\":\"ais\",\"type\":\"baseStationReport\",\"timestamp\":\"%04i-%02i-%02i %02i:%02i:%02i UTC\","
-            "\"mmsi\":%u,\"baseStationDate\":\"%04u-%02u-%02u %02u:%02u:%02u UTC\","
-            "\"geoPosition\":{\"lon\":%f,\"lat\":%f},\"fixType\":\"%s\",\"rawAscii\":\"",
-            gmt->tm_year + 1900, gmt->tm_mon + 1, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec,
-            br->mmsi, br->year, br->month, br->day, br->hour, br->minute, br->second,
-            (double)br->longitude, (double)br->latitude, br->epfd_name);
-
-    for (size_t i = 0; i < strlen(raw_msg); i++) {
-        _decoder_put_alnum_char(out_file, raw_msg[i]);
-    }
-
-    fprintf(out_file, "\"}\n");
-
+    msg_json_ais_base_station_report(out_file, 0, br, raw_msg);
     return A_OK;
 }
 
@@ -368,28 +224,7 @@ static
 aresult_t _on_ais_static_voyage_data(struct ais_decode *decode, void *state, struct ais_static_voyage_data *svd,
         const char *raw_msg)
 {
-    time_t now = time(NULL);
-    struct tm *gmt = gmtime(&now);
-
-    /* TODO: Ensure we escape the callsign, ship name and destination */
-
-    fprintf(out_file,
-            "{\"proto\":\"ais\",\"type\":\"staticAndVoyageData\",\"timestamp\":\"%04i-%02i-%02i %02i:%02i:%02i UTC\","
-            "\"mmsi\":%u,\"version\":%u,\"imoNumber\":%u,\"callsign\":\"%s\",\"shipName\":\"%s\","
-            "\"shipType\":%u,\"dimensions\":{\"toBow\":%u,\"toStern\":%u,\"toPort\":%u,\"toStarboard\":%u},"
-            "\"fixType\":\"%s\",\"eta\":\"%02u-%02u %02u:%02u\",\"draught\":%f,\"destination\":\"%s\","
-            "\"rawAscii\":\"",
-            gmt->tm_year + 1900, gmt->tm_mon + 1, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec,
-            svd->mmsi, svd->version, svd->imo_number, svd->callsign, svd->ship_name,
-            svd->ship_type, svd->dim_to_bow, svd->dim_to_stern, svd->dim_to_port, svd->dim_to_starboard,
-            svd->epfd_name, svd->eta_month, svd->eta_day, svd->eta_hour, svd->eta_minute, svd->draught, svd->destination);
-
-    for (size_t i = 0; i < strlen(raw_msg); i++) {
-        _decoder_put_alnum_char(out_file, raw_msg[i]);
-    }
-
-    fprintf(out_file, "\"}\n");
-
+    msg_json_ais_static_voyage_data(out_file, 0, svd, raw_msg);
     return A_OK;
 }
 
@@ -398,12 +233,13 @@ void _set_options(int argc, char * const argv[])
 {
     int arg = -1;
     const char *filter_file = NULL,
-               *out_file_name = NULL;
+               *out_file_name = NULL,
+               *in_ring_name = NULL;
     struct config *cfg CAL_CLEANUP(config_delete) = NULL;
     double *filter_coeffs_f = NULL;
     bool create_out = false;
 
-    while ((arg = getopt(argc, argv, "co:I:D:S:F:f:d:p:m:bih")) != -1) {
+    while ((arg = getopt(argc, argv, "co:I:D:S:F:f:d:p:m:r:bih")) != -1) {
         switch (arg) {
         case 'o':
             out_file_name = optarg;
@@ -458,6 +294,10 @@ void _set_options(int argc, char * const argv[])
             DEC_MSG(SEV_INFO, "DC-BLOCK-POLE", "Setting DC Blocker pole to %f", dc_block_pole);
             break;
 
+        case 'r':
+            in_ring_name = optarg;
+            break;
+
         case 'i':
             _invert = true;
             DEC_MSG(SEV_INFO, "INVERTING", "Inverting input sample stream, due to a non-phase correcting input source.");
@@ -469,7 +309,7 @@ void _set_options(int argc, char * const argv[])
         }
     }
 
-    if (optind > argc) {
+    if (NULL == in_ring_name && optind >= argc) {
         DEC_MSG(SEV_FATAL, "MISSING-SRC-DEST", "Missing source/destination file");
         exit(EXIT_FAILURE);
     }
@@ -532,7 +372,26 @@ void _set_options(int argc, char * const argv[])
         filter_coeffs[i] = (int16_t)(filter_coeffs_f[i] * q15);
     }
 
-    if (0 > (in_fifo = open(argv[optind], O_RDONLY))) {
+    if (NULL != in_ring_name) {
+        if (FAILED(shm_ring_consumer_new(&in_ring, in_ring_name))) {
+            DEC_MSG(SEV_FATAL, "BAD-INPUT-RING", "Bad input - cannot attach to ring '%s', is multifm running?",
+                    in_ring_name);
+            exit(EXIT_FAILURE);
+        }
+
+        if (SHM_RING_SAMPLE_REAL_INT_16 != shm_ring_consumer_sample_type(in_ring)) {
+            DEC_MSG(SEV_FATAL, "BAD-INPUT-RING", "Ring '%s' doesn't carry PCM samples.", in_ring_name);
+            exit(EXIT_FAILURE);
+        }
+
+        if (0 != input_sample_rate && input_sample_rate != shm_ring_consumer_sample_rate(in_ring)) {
+            DEC_MSG(SEV_WARNING, "RING-RATE-MISMATCH", "Ring '%s' carries samples at %u Hz, not %u Hz.",
+                    in_ring_name, shm_ring_consumer_sample_rate(in_ring), input_sample_rate);
+        }
+
+        DEC_MSG(SEV_INFO, "INPUT-RING", "Reading %u Hz PCM from ring '%s'", shm_ring_consumer_sample_rate(in_ring),
+                in_ring_name);
+    } else if (0 > (in_fifo = open(argv[optind], O_RDONLY))) {
         DEC_MSG(SEV_INFO, "BAD-INPUT", "Bad input - cannot open %s", argv[optind]);
         exit(EXIT_FAILURE);
     }
@@ -577,6 +436,39 @@ done:
 static
 int16_t output_buf[NR_SAMPLES];
 
+/**
+ * Run filtered samples through the DC blocker, if asked, and the protocol decoder, and write
+ * them to the sample debug file, if there is one.
+ */
+static
+void _decode_samples(struct dc_blocker *blck, int16_t *samples, size_t nr_samples)
+{
+    /* Apply DC blocker, if asked */
+    if (true == dc_blocker) {
+        TSL_BUG_IF_FAILED(dc_blocker_apply(blck, samples, nr_samples));
+    }
+
+    /* Process with the protocol object */
+    if (_decoder_type == DECODER_PAGER_TYPE_FLEX) {
+        TSL_BUG_IF_FAILED(pager_flex_on_pcm(flex, samples, nr_samples));
+    } else if (_decoder_type == DECODER_PAGER_TYPE_POCSAG) {
+        TSL_BUG_IF_FAILED(pager_pocsag_on_pcm(pocsag, samples, nr_samples));
+    } else if (_decoder_type == DECODER_PROTO_TYPE_AIS) {
+        TSL_BUG_IF_FAILED(ais_decode_on_pcm(ais_decode, samples, nr_samples));
+    } else {
+        PANIC("Unknown decoder type, aborting");
+    }
+
+    /* If a sample debug file was specified, write to the sample debug file */
+    if (-1 != sample_debug_fd) {
+        if (0 > write(sample_debug_fd, samples, nr_samples * sizeof(int16_t))) {
+            int errnum = errno;
+            DEC_MSG(SEV_FATAL, "WRITE-DEBUG-FAIL", "Failed to write to output debug file: %s (%d)",
+                    strerror(errnum), errnum);
+        }
+    }
+}
+
 static
 aresult_t process_samples(void)
 {
@@ -639,36 +531,87 @@ aresult_t process_samples(void)
             continue;
         }
 
-        /* Apply DC blocker, if asked */
-        if (true == dc_blocker) {
-            TSL_BUG_IF_FAILED(dc_blocker_apply(&blck, output_buf, new_samples));
+        _decode_samples(&blck, output_buf, new_samples);
+
+        /* Release the sample buffer */
+    } while (app_running());
+
+done:
+    DEC_MSG(SEV_INFO, "TERMINATING", "Terminating processing loop, processed %zu samples", sample_count);
+    return ret;
+}
+
+/**
+ * Read blocks of samples from the input ring, in place, and decode them. There's no system call
+ * per block, unless we've caught up with multifm and have to wait for it.
+ */
+static
+aresult_t process_ring_samples(void)
+{
+    int ret = A_OK;
+
+    struct dc_blocker blck;
+    size_t sample_count = 0;
+
+    TSL_BUG_IF_FAILED(dc_blocker_init(&blck, dc_block_pole));
+
+    do {
+        const int16_t *samples = NULL;
+        size_t nr_bytes = 0,
+               new_samples = 0;
+        uint64_t nr_dropped = 0;
+
+        if (FAILED(ret = shm_ring_consumer_next(in_ring, (const void **)&samples, &nr_bytes, &nr_dropped,
+                        RING_WAIT_NS)))
+        {
+            if (A_E_DONE == ret) {
+                DEC_MSG(SEV_INFO, "RING-CLOSED", "The input ring was closed by multifm.");
+                ret = A_OK;
+            }
+            goto done;
         }
 
-        /* Process with the protocol object */
-        if (_decoder_type == DECODER_PAGER_TYPE_FLEX) {
-            TSL_BUG_IF_FAILED(pager_flex_on_pcm(flex, output_buf, new_samples));
-        } else if (_decoder_type == DECODER_PAGER_TYPE_POCSAG) {
-            TSL_BUG_IF_FAILED(pager_pocsag_on_pcm(pocsag, output_buf, new_samples));
-        } else if (_decoder_type == DECODER_PROTO_TYPE_AIS) {
-            TSL_BUG_IF_FAILED(ais_decode_on_pcm(ais_decode, output_buf, new_samples));
-        } else {
-            PANIC("Unknown decoder type, aborting");
+        if (NULL == samples) {
+            continue;
         }
 
-        /* If a sample debug file was specified, write to the sample debug file */
-        if (-1 != sample_debug_fd) {
-            if (0 > write(sample_debug_fd, output_buf, new_samples * sizeof(int16_t))) {
-                int errnum = errno;
-                DEC_MSG(SEV_FATAL, "WRITE-DEBUG-FAIL", "Failed to write to output debug file: %s (%d)",
-                        strerror(errnum), errnum);
-            }
+        if (0 != nr_dropped) {
+            DEC_MSG(SEV_WARNING, "RING-OVERRUN", "Fell behind the input ring, lost %"PRIu64" blocks of samples.",
+                    nr_dropped);
         }
 
-        /* Release the sample buffer */
+        /* The filter copies the samples into its history, so the block can be handed back right away */
+        TSL_BUG_IF_FAILED(polyphase_fir_push_samples(pfir, samples, nr_bytes / sizeof(int16_t)));
+
+        if (FAILED(shm_ring_consumer_release(in_ring))) {
+            DEC_MSG(SEV_WARNING, "RING-OVERRUN", "Input ring block was written over while it was being read.");
+        }
+
+        sample_count += nr_bytes / sizeof(int16_t);
+
+        /* Filter the samples, decimating as appropriate, until the filter runs dry */
+        do {
+            TSL_BUG_IF_FAILED(polyphase_fir_process(pfir, output_buf, NR_SAMPLES, &new_samples));
+
+            /*
+             * The ring's samples can't be written to, so invert the filter's output instead of its
+             * input. -32768 has no positive counterpart, so it saturates to 32767.
+             */
+            if (true == _invert) {
+                for (size_t i = 0; i < new_samples; i++) {
+                    output_buf[i] = INT16_MIN == output_buf[i] ? INT16_MAX : -output_buf[i];
+                }
+            }
+
+            if (0 != new_samples) {
+                _decode_samples(&blck, output_buf, new_samples);
+            }
+        } while (0 != new_samples);
     } while (app_running());
 
 done:
-    DEC_MSG(SEV_INFO, "TERMINATING", "Terminating processing loop, processed %zu samples", sample_count);
+    DEC_MSG(SEV_INFO, "TERMINATING", "Terminating processing loop, processed %zu samples, lost %"PRIu64" blocks",
+            sample_count, shm_ring_consumer_nr_dropped(in_ring));
     return ret;
 }
 
@@ -698,7 +641,7 @@ int main(int argc, char * const argv[])
 
     DEC_MSG(SEV_INFO, "STARTING", "Starting message decoder on frequency %u Hz.", center_freq);
 
-    if (FAILED(process_samples())) {
+    if (FAILED(NULL != in_ring ? process_ring_samples() : process_samples())) {
         DEC_MSG(SEV_FATAL, "FIR-FAILED", "Failed during message processing, aborting.");
         goto done;
     }
@@ -726,6 +669,10 @@ done:
         polyphase_fir_delete(&pfir);
     }
 
+    if (NULL != in_ring) {
+        shm_ring_consumer_delete(&in_ring);
+    }
+
     return ret;
 }
 
@@ -0,0 +1,293 @@
+/*
+ *  convert.c - Convert receiver sample formats to Q.15
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/convert.h>
+#include <filter/filter.h>
+#include <filter/kernels.h>
+#include <filter/kernels_priv.h>
+
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+/**
+ * Full scale, once converted. The same for every format, so a receiver can be swapped without
+ * retuning anything downstream.
+ */
+#define CONVERT_FULL_SCALE              (1 << Q_15_SHIFT)
+
+_Static_assert(CONVERT_FULL_SCALE == 128 << SAMPLE_8BIT_Q15_SHIFT, "8-bit full scale doesn't match");
+_Static_assert(CONVERT_FULL_SCALE == 2048 << 3, "12-bit full scale doesn't match");
+
+static const
+struct {
+    const char *name;
+    size_t bytes;
+} _convert_formats[CONVERT_FORMAT_MAX] = {
+    [CONVERT_FORMAT_CU8] = { "cu8", 2 * sizeof(uint8_t) },
+    [CONVERT_FORMAT_CS8] = { "cs8", 2 * sizeof(int8_t) },
+    [CONVERT_FORMAT_CS12] = { "cs12", 3 },
+    [CONVERT_FORMAT_CS16] = { "cs16", 2 * sizeof(int16_t) },
+    [CONVERT_FORMAT_CF32] = { "cf32", 2 * sizeof(float) },
+};
+
+aresult_t convert_format_parse(const char *name, enum convert_format *pformat)
+{
+    aresult_t ret = A_E_INVAL;
+
+    TSL_ASSERT_ARG(NULL != name);
+    TSL_ASSERT_ARG(NULL != pformat);
+
+    for (size_t i = 0; i < CONVERT_FORMAT_MAX; i++) {
+        if (!strcmp(_convert_formats[i].name, name)) {
+            *pformat = (enum convert_format)i;
+            ret = A_OK;
+            break;
+        }
+    }
+
+    return ret;
+}
+
+size_t convert_format_bytes(enum convert_format format)
+{
+    return format < CONVERT_FORMAT_MAX ? _convert_formats[format].bytes : 0;
+}
+
+/**
+ * Read one complex sample, scaled to Q.15, and count how many of its halves are at the input's
+ * full scale. format is always a constant, so only one case is ever compiled in.
+ */
+FILTER_ALWAYS_INLINE
+void _convert_sample(enum convert_format format, const void *restrict in, size_t k, int32_t *pi, int32_t *pq,
+        int32_t *pclipped)
+{
+    switch (format) {
+    case CONVERT_FORMAT_CU8: {
+        const uint8_t *s = (const uint8_t *)in + 2 * k;
+        *pi = ((int32_t)s[0] - SAMPLE_UINT_8_ZERO) * (1 << SAMPLE_8BIT_Q15_SHIFT);
+        *pq = ((int32_t)s[1] - SAMPLE_UINT_8_ZERO) * (1 << SAMPLE_8BIT_Q15_SHIFT);
+        *pclipped = (0 == s[0] || UINT8_MAX == s[0]) + (0 == s[1] || UINT8_MAX == s[1]);
+        break;
+    }
+    case CONVERT_FORMAT_CS8: {
+        const int8_t *s = (const int8_t *)in + 2 * k;
+        *pi = (int32_t)s[0] * (1 << SAMPLE_8BIT_Q15_SHIFT);
+        *pq = (int32_t)s[1] * (1 << SAMPLE_8BIT_Q15_SHIFT);
+        *pclipped = (INT8_MIN == s[0] || INT8_MAX == s[0]) + (INT8_MIN == s[1] || INT8_MAX == s[1]);
+        break;
+    }
+    case CONVERT_FORMAT_CS12: {
+        const uint8_t *s = (const uint8_t *)in + 3 * k;
+        uint32_t w = (uint32_t)s[0] | (uint32_t)s[1] << 8 | (uint32_t)s[2] << 16;
+        /* Sign extend each 12-bit half by shifting it to the top of the word and back */
+        int32_t i = (int32_t)(w << 20) >> 20,
+                q = (int32_t)(w << 8) >> 20;
+        *pi = i * (1 << 3);
+        *pq = q * (1 << 3);
+        *pclipped = (-2048 == i || 2047 == i) + (-2048 == q || 2047 == q);
+        break;
+    }
+    case CONVERT_FORMAT_CS16: {
+        const int16_t *s = (const int16_t *)in + 2 * k;
+        *pi = s[0];
+        *pq = s[1];
+        *pclipped = (INT16_MIN == s[0] || INT16_MAX == s[0]) + (INT16_MIN == s[1] || INT16_MAX == s[1]);
+        break;
+    }
+    case CONVERT_FORMAT_CF32: {
+        const float *s = (const float *)in + 2 * k;
+        float i = s[0] * (float)CONVERT_FULL_SCALE,
+              q = s[1] * (float)CONVERT_FULL_SCALE;
+        /* Saturate before truncating, so out of range samples don't wrap around */
+        i = i < (float)INT16_MIN ? (float)INT16_MIN : (i > (float)INT16_MAX ? (float)INT16_MAX : i);
+        q = q < (float)INT16_MIN ? (float)INT16_MIN : (q > (float)INT16_MAX ? (float)INT16_MAX : q);
+        *pi = (int32_t)i;
+        *pq = (int32_t)q;
+        *pclipped = (fabsf(s[0]) >= 1.0f) + (fabsf(s[1]) >= 1.0f);
+        break;
+    }
+    default:
+        *pi = *pq = *pclipped = 0;
+        break;
+    }
+}
+
+/**
+ * Convert a run of samples. write and gather are always constants: a kernel either writes the
+ * Q.15 samples, gathers statistics, or both, with nothing left in the loop that isn't needed.
+ */
+FILTER_ALWAYS_INLINE
+void _convert_loop(enum convert_format format, const void *restrict in, size_t nr_samples,
+        int16_t *restrict out, struct convert_stats *stats, bool write, bool gather)
+{
+    int64_t sum_i = 0,
+            sum_q = 0;
+    uint64_t sum_power = 0,
+             nr_clipped = 0;
+
+    for (size_t k = 0; k < nr_samples; k++) {
+        int32_t i = 0,
+                q = 0,
+                clipped = 0;
+
+        _convert_sample(format, in, k, &i, &q, &clipped);
+
+        if (write) {
+            out[2 * k    ] = i;
+            out[2 * k + 1] = q;
+        }
+
+        if (gather) {
+            sum_i += i;
+            sum_q += q;
+            /* Each square fits in 31 bits; their sum only fits unsigned */
+            sum_power += (uint32_t)(i * i) + (uint32_t)(q * q);
+            nr_clipped += clipped;
+        }
+    }
+
+    if (gather) {
+        stats->nr_samples += nr_samples;
+        stats->sum_i += sum_i;
+        stats->sum_q += sum_q;
+        stats->sum_power += sum_power;
+        stats->nr_clipped += nr_clipped;
+    }
+}
+
+FILTER_ALWAYS_INLINE
+void _convert_body(enum convert_format format, const void *in, size_t nr_samples, int16_t *out,
+        struct convert_stats *stats)
+{
+    if (NULL == stats) {
+        _convert_loop(format, in, nr_samples, out, NULL, true, false);
+    } else if (NULL == out) {
+        _convert_loop(format, in, nr_samples, NULL, stats, false, true);
+    } else {
+        _convert_loop(format, in, nr_samples, out, stats, true, true);
+    }
+}
+
+#define _CONVERT_KERNEL(target, isa, fmt, FMT) \
+    static target \
+    void _convert_##fmt##_##isa(const void *in, size_t nr_samples, int16_t *out, struct convert_stats *stats) \
+    { \
+        _convert_body(CONVERT_FORMAT_##FMT, in, nr_samples, out, stats); \
+    }
+
+#define _CONVERT_KERNELS_FOR_ISA(target, isa) \
+    _CONVERT_KERNEL(target, isa, cu8, CU8) \
+    _CONVERT_KERNEL(target, isa, cs8, CS8) \
+    _CONVERT_KERNEL(target, isa, cs12, CS12) \
+    _CONVERT_KERNEL(target, isa, cs16, CS16) \
+    _CONVERT_KERNEL(target, isa, cf32, CF32)
+
+#define _CONVERT_ENTRY(isa) \
+    { \
+        [CONVERT_FORMAT_CU8] = _convert_cu8_##isa, \
+        [CONVERT_FORMAT_CS8] = _convert_cs8_##isa, \
+        [CONVERT_FORMAT_CS12] = _convert_cs12_##isa, \
+        [CONVERT_FORMAT_CS16] = _convert_cs16_##isa, \
+        [CONVERT_FORMAT_CF32] = _convert_cf32_##isa, \
+    }
+
+_CONVERT_KERNELS_FOR_ISA(, scalar)
+
+#ifdef _FILTER_HAVE_X86_KERNELS
+_CONVERT_KERNELS_FOR_ISA(FILTER_TARGET_SSE41, sse41)
+_CONVERT_KERNELS_FOR_ISA(FILTER_TARGET_AVX2, avx2)
+_CONVERT_KERNELS_FOR_ISA(FILTER_TARGET_AVX512, avx512)
+#endif /* defined(_FILTER_HAVE_X86_KERNELS) */
+
+/*
+ * The kernels for each instruction set. There are no hand-written NEON kernels; the scalar
+ * kernels, built for ARM, are vectorized by the compiler.
+ */
+static const
+convert_fn _convert_kernels[FILTER_ISA_MAX][CONVERT_FORMAT_MAX] = {
+    [FILTER_ISA_SCALAR] = _CONVERT_ENTRY(scalar),
+#ifdef _FILTER_HAVE_X86_KERNELS
+    [FILTER_ISA_SSE41] = _CONVERT_ENTRY(sse41),
+    [FILTER_ISA_AVX2] = _CONVERT_ENTRY(avx2),
+    [FILTER_ISA_AVX512] = _CONVERT_ENTRY(avx512),
+#else
+    [FILTER_ISA_NEON] = _CONVERT_ENTRY(scalar),
+#endif /* defined(_FILTER_HAVE_X86_KERNELS) */
+};
+
+convert_fn convert_kernel(const struct filter_kernels *kernels, enum convert_format format)
+{
+    return format < CONVERT_FORMAT_MAX ? _convert_kernels[kernels->isa][format] : NULL;
+}
+
+aresult_t convert_to_q15(enum convert_format format, const void *in, size_t nr_samples, int16_t *out,
+        struct convert_stats *stats)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(format < CONVERT_FORMAT_MAX);
+    TSL_ASSERT_ARG(NULL != in || 0 == nr_samples);
+    TSL_ASSERT_ARG(NULL != out || 0 == nr_samples);
+
+    if (FAILED(ret = filter_kernels_init())) {
+        goto done;
+    }
+
+    _convert_kernels[filter_kernels->isa][format](in, nr_samples, out, stats);
+
+done:
+    return ret;
+}
+
+aresult_t convert_stats_update(enum convert_format format, const void *in, size_t nr_samples,
+        struct convert_stats *stats)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(format < CONVERT_FORMAT_MAX);
+    TSL_ASSERT_ARG(NULL != in || 0 == nr_samples);
+    TSL_ASSERT_ARG(NULL != stats);
+
+    if (FAILED(ret = filter_kernels_init())) {
+        goto done;
+    }
+
+    _convert_kernels[filter_kernels->isa][format](in, nr_samples, NULL, stats);
+
+done:
+    return ret;
+}
+
+void convert_stats_summary(const struct convert_stats *stats, double *pdc_i, double *pdc_q,
+        double *ppower_dbfs)
+{
+    double nr_samples = 0 == stats->nr_samples ? 1.0 : (double)stats->nr_samples,
+           full_scale = (double)CONVERT_FULL_SCALE;
+
+    *pdc_i = (double)stats->sum_i / nr_samples / full_scale;
+    *pdc_q = (double)stats->sum_q / nr_samples / full_scale;
+    *ppower_dbfs = 10.0 * log10((double)stats->sum_power / nr_samples / (full_scale * full_scale));
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <tsl/result.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct filter_kernels;
+
+/**
+ * The sample formats a receiver can deliver. All of them are interleaved I/Q.
+ */
+enum convert_format {
+    /**
+     * Unsigned 8-bit, centered on 127 (RTL-SDR)
+     */
+    CONVERT_FORMAT_CU8 = 0,
+
+    /**
+     * Signed 8-bit
+     */
+    CONVERT_FORMAT_CS8,
+
+    /**
+     * Signed 12-bit, packed into 3 bytes per complex sample: I is the low 12 bits and Q the
+     * high 12 bits of a little-endian 24-bit word
+     */
+    CONVERT_FORMAT_CS12,
+
+    /**
+     * Signed 16-bit, already Q.15
+     */
+    CONVERT_FORMAT_CS16,
+
+    /**
+     * 32-bit float, with full scale at +/-1.0 (Airspy)
+     */
+    CONVERT_FORMAT_CF32,
+
+    CONVERT_FORMAT_MAX,
+};
+
+/**
+ * Running statistics on the raw samples coming out of a receiver, gathered while they are
+ * converted. All sums are of the Q.15 samples.
+ */
+struct convert_stats {
+    /**
+     * The number of complex samples seen
+     */
+    uint64_t nr_samples;
+
+    /**
+     * The sum of the I and of the Q samples, for the DC offset
+     */
+    int64_t sum_i;
+    int64_t sum_q;
+
+    /**
+     * The sum of I^2 + Q^2, for the average power
+     */
+    uint64_t sum_power;
+
+    /**
+     * The number of I or Q samples at the input format's full scale, i.e. that probably clipped
+     */
+    uint64_t nr_clipped;
+};
+
+/**
+ * A conversion kernel for one format. Writes the Q.15 samples to out, unless it is NULL, and
+ * updates stats, unless it is NULL.
+ */
+typedef void (*convert_fn)(const void *in, size_t nr_samples, int16_t *out, struct convert_stats *stats);
+
+/**
+ * Look up a sample format by the name used in configuration files: cu8, cs8, cs12, cs16 or cf32.
+ *
+ * \param name The name of the format
+ * \param pformat The format, returned by reference
+ *
+ * \return A_OK on success, A_E_INVAL if the name isn't known
+ */
+aresult_t convert_format_parse(const char *name, enum convert_format *pformat);
+
+/**
+ * The size of a complex sample in the given format, in bytes. CONVERT_FORMAT_CS12 packs a
+ * complex sample into 3 bytes.
+ */
+size_t convert_format_bytes(enum convert_format format);
+
+/**
+ * Convert samples to interleaved Q.15 I/Q. The 8-bit and 12-bit formats are shifted up to the
+ * same scale as `sample_get_q15`; floats are scaled so +/-1.0 gives the same full scale, and
+ * saturated.
+ *
+ * \param format The format of the input samples
+ * \param in The input samples
+ * \param nr_samples The number of complex samples to convert
+ * \param out Where to write 2 * nr_samples Q.15 values. Can't overlap the input.
+ * \param stats If not NULL, the statistics to update with the converted samples, in the same
+ *              pass.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t convert_to_q15(enum convert_format format, const void *in, size_t nr_samples, int16_t *out,
+        struct convert_stats *stats);
+
+/**
+ * Update the statistics with samples that are not being converted, such as 8-bit samples handed
+ * to the filters as they are. The statistics are the same as `convert_to_q15` would gather.
+ *
+ * \param format The format of the samples
+ * \param in The samples
+ * \param nr_samples The number of complex samples
+ * \param stats The statistics to update
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t convert_stats_update(enum convert_format format, const void *in, size_t nr_samples,
+        struct convert_stats *stats);
+
+/**
+ * Summarize the statistics gathered so far.
+ *
+ * \param stats The statistics
+ * \param pdc_i The average I sample, as a fraction of full scale
+ * \param pdc_q The average Q sample, as a fraction of full scale
+ * \param ppower_dbfs The average power, in dB relative to a full scale complex tone
+ */
+void convert_stats_summary(const struct convert_stats *stats, double *pdc_i, double *pdc_q,
+        double *ppower_dbfs);
+
+/**
+ * Get the conversion kernel for a format, built for the given kernels' instruction set. Used
+ * for testing the variants against each other.
+ *
+ * \return The kernel, or NULL if the format isn't known
+ */
+convert_fn convert_kernel(const struct filter_kernels *kernels, enum convert_format format);
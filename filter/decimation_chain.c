@@ -0,0 +1,421 @@
+/*
+ *  decimation_chain.c - Cheap multi-stage decimation front ends (halfband cascades and CIC
+ *      decimators) for complex baseband signals.
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/decimation_chain.h>
+#include <filter/filter.h>
+#include <filter/filter_priv.h>
+#include <filter/complex.h>
+
+#include <tsl/safe_alloc.h>
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+
+#include <math.h>
+#include <string.h>
+
+/**
+ * Length of each halfband filter. Must be of the form 4*m + 3, so that the outermost taps are
+ * non-zero.
+ */
+#define DECIMATION_HALFBAND_NR_TAPS         19
+
+/**
+ * The number of non-zero taps on one side of the halfband center tap
+ */
+#define DECIMATION_HALFBAND_NR_ODD_TAPS     ((DECIMATION_HALFBAND_NR_TAPS + 1)/4)
+
+/**
+ * Order of the CIC decimator
+ */
+#define DECIMATION_CIC_ORDER                3
+
+/**
+ * Fixed point shift used to remove the CIC gain
+ */
+#define DECIMATION_CIC_SCALE_SHIFT          30
+
+/**
+ * A single decimate-by-2 halfband stage
+ */
+struct decimation_halfband {
+    /**
+     * Input history, interleaved I/Q. The oldest sample still needed is at index 0.
+     */
+    int16_t *hist;
+
+    /**
+     * Capacity of the history, in complex samples
+     */
+    size_t hist_cap;
+
+    /**
+     * Number of valid complex samples in the history
+     */
+    size_t hist_len;
+};
+
+/**
+ * A third-order CIC decimator
+ */
+struct decimation_cic {
+    /**
+     * Integrator state. These are allowed to wrap; the combs undo the wrapping.
+     */
+    uint64_t integ_re[DECIMATION_CIC_ORDER];
+    uint64_t integ_im[DECIMATION_CIC_ORDER];
+
+    /**
+     * Comb delay lines
+     */
+    uint64_t comb_re[DECIMATION_CIC_ORDER];
+    uint64_t comb_im[DECIMATION_CIC_ORDER];
+
+    /**
+     * Number of input samples since the last output sample
+     */
+    unsigned phase;
+
+    /**
+     * Fixed point (DECIMATION_CIC_SCALE_SHIFT) factor that removes the R^N CIC gain
+     */
+    int64_t scale;
+};
+
+struct decimation_chain {
+    /**
+     * Type of the chain
+     */
+    enum decimation_chain_type type;
+
+    /**
+     * Overall decimation factor
+     */
+    unsigned factor;
+
+    /**
+     * Halfband stages, if this is a halfband cascade
+     */
+    struct decimation_halfband halfband[DECIMATION_CHAIN_MAX_STAGES];
+
+    /**
+     * Number of halfband stages
+     */
+    size_t nr_halfband;
+
+    /**
+     * The non-zero halfband taps either side of the center, Q.15, nearest the center first
+     */
+    int16_t halfband_coeffs[DECIMATION_HALFBAND_NR_ODD_TAPS];
+
+    /**
+     * The halfband center tap, Q.15
+     */
+    int16_t halfband_center;
+
+    /**
+     * The CIC, if this is a CIC chain
+     */
+    struct decimation_cic cic;
+};
+
+static inline
+int16_t _decimation_saturate(int64_t v)
+{
+    return v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : (int16_t)v);
+}
+
+static
+void _decimation_halfband_design(struct decimation_chain *chain)
+{
+    const double q15 = (double)(1 << Q_15_SHIFT),
+                 center = (double)(DECIMATION_HALFBAND_NR_TAPS - 1)/2.0;
+
+    chain->halfband_center = (int16_t)lrint(0.5 * q15);
+
+    /* Blackman windowed sinc, cut off at a quarter of the sample rate */
+    for (size_t j = 0; j < DECIMATION_HALFBAND_NR_ODD_TAPS; j++) {
+        double k = (double)(2 * j + 1),
+               n = center + k,
+               sinc = sin(M_PI * k/2.0)/(M_PI * k),
+               win = 0.42 - 0.5 * cos(2.0 * M_PI * n/(DECIMATION_HALFBAND_NR_TAPS - 1)) +
+                     0.08 * cos(4.0 * M_PI * n/(DECIMATION_HALFBAND_NR_TAPS - 1));
+        chain->halfband_coeffs[j] = (int16_t)lrint(sinc * win * q15);
+    }
+}
+
+static
+aresult_t _decimation_halfband_process(struct decimation_chain *chain, struct decimation_halfband *hb,
+        const int16_t *in, size_t nr_in, int16_t *out, size_t *pnr_out)
+{
+    aresult_t ret = A_OK;
+
+    const size_t c = (DECIMATION_HALFBAND_NR_TAPS - 1)/2;
+    size_t nr_out = 0,
+           pos = 0;
+
+    /* Grow the history to hold the new samples */
+    if (hb->hist_len + nr_in > hb->hist_cap) {
+        int16_t *new_hist = NULL;
+        size_t new_cap = hb->hist_len + nr_in;
+
+        if (FAILED(ret = TACALLOC((void **)&new_hist, new_cap, 2 * sizeof(int16_t), SYS_CACHE_LINE_LENGTH))) {
+            goto done;
+        }
+
+        if (NULL != hb->hist) {
+            memcpy(new_hist, hb->hist, hb->hist_len * 2 * sizeof(int16_t));
+            TFREE(hb->hist);
+        }
+
+        hb->hist = new_hist;
+        hb->hist_cap = new_cap;
+    }
+
+    /* Copy the input first, so the output can overwrite it */
+    memcpy(&hb->hist[2 * hb->hist_len], in, nr_in * 2 * sizeof(int16_t));
+    hb->hist_len += nr_in;
+
+    while (pos + DECIMATION_HALFBAND_NR_TAPS <= hb->hist_len) {
+        const int16_t *x = &hb->hist[2 * (pos + c)];
+        int32_t acc_re = (int32_t)chain->halfband_center * x[0],
+                acc_im = (int32_t)chain->halfband_center * x[1];
+
+        for (size_t j = 0; j < DECIMATION_HALFBAND_NR_ODD_TAPS; j++) {
+            ptrdiff_t k = 2 * j + 1;
+            int32_t h = chain->halfband_coeffs[j];
+            acc_re += h * ((int32_t)x[ 2 * k    ] + x[-2 * k    ]);
+            acc_im += h * ((int32_t)x[ 2 * k + 1] + x[-2 * k + 1]);
+        }
+
+        out[2 * nr_out    ] = round_q30_q15(acc_re);
+        out[2 * nr_out + 1] = round_q30_q15(acc_im);
+
+        nr_out++;
+        pos += 2;
+    }
+
+    /* Slide the history down, keeping everything from the next window on */
+    if (0 != pos) {
+        memmove(hb->hist, &hb->hist[2 * pos], (hb->hist_len - pos) * 2 * sizeof(int16_t));
+        hb->hist_len -= pos;
+    }
+
+    *pnr_out = nr_out;
+
+done:
+    return ret;
+}
+
+static
+size_t _decimation_cic_process(struct decimation_chain *chain, const int16_t *in, size_t nr_in, int16_t *out)
+{
+    struct decimation_cic *cic = &chain->cic;
+    size_t nr_out = 0;
+
+    for (size_t i = 0; i < nr_in; i++) {
+        uint64_t v_re = (uint64_t)(int64_t)in[2 * i],
+                 v_im = (uint64_t)(int64_t)in[2 * i + 1];
+
+        for (size_t s = 0; s < DECIMATION_CIC_ORDER; s++) {
+            cic->integ_re[s] += v_re;
+            cic->integ_im[s] += v_im;
+            v_re = cic->integ_re[s];
+            v_im = cic->integ_im[s];
+        }
+
+        if (++cic->phase < chain->factor) {
+            continue;
+        }
+
+        cic->phase = 0;
+
+        for (size_t s = 0; s < DECIMATION_CIC_ORDER; s++) {
+            uint64_t d_re = v_re - cic->comb_re[s],
+                     d_im = v_im - cic->comb_im[s];
+            cic->comb_re[s] = v_re;
+            cic->comb_im[s] = v_im;
+            v_re = d_re;
+            v_im = d_im;
+        }
+
+        /* The output of the combs fits in the 16 + N*log2(R) bits of growth, so it's a valid signed value */
+        out[2 * nr_out    ] = _decimation_saturate(((int64_t)v_re * cic->scale) >> DECIMATION_CIC_SCALE_SHIFT);
+        out[2 * nr_out + 1] = _decimation_saturate(((int64_t)v_im * cic->scale) >> DECIMATION_CIC_SCALE_SHIFT);
+        nr_out++;
+    }
+
+    return nr_out;
+}
+
+aresult_t decimation_chain_new(struct decimation_chain **pchain, enum decimation_chain_type type,
+        const unsigned *factors, size_t nr_factors)
+{
+    aresult_t ret = A_OK;
+
+    struct decimation_chain *chain = NULL;
+    unsigned factor = 1;
+
+    TSL_ASSERT_ARG(NULL != pchain);
+    TSL_ASSERT_ARG(NULL != factors);
+    TSL_ASSERT_ARG(0 != nr_factors && nr_factors <= DECIMATION_CHAIN_MAX_STAGES);
+
+    *pchain = NULL;
+
+    for (size_t i = 0; i < nr_factors; i++) {
+        if (0 == factors[i] || (DECIMATION_CHAIN_HALFBAND == type && 2 != factors[i])) {
+            FIL_MSG(SEV_ERROR, "BAD-DECIMATION-STAGE", "Decimation stage %zu has invalid factor %u", i, factors[i]);
+            ret = A_E_INVAL;
+            goto done;
+        }
+        factor *= factors[i];
+    }
+
+    if (FAILED(ret = TZAALLOC(chain, SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    chain->type = type;
+    chain->factor = factor;
+
+    switch (type) {
+    case DECIMATION_CHAIN_HALFBAND:
+        chain->nr_halfband = nr_factors;
+        _decimation_halfband_design(chain);
+        break;
+    case DECIMATION_CHAIN_CIC:
+        /* The combs can't tell wrapped values apart past 64 bits of growth */
+        if (16.0 + DECIMATION_CIC_ORDER * log2((double)factor) > 62.0) {
+            FIL_MSG(SEV_ERROR, "CIC-TOO-LARGE", "CIC decimation factor %u is too large", factor);
+            ret = A_E_INVAL;
+            goto done;
+        }
+        chain->cic.scale = llrint(ldexp(1.0, DECIMATION_CIC_SCALE_SHIFT) / pow((double)factor, DECIMATION_CIC_ORDER));
+        break;
+    default:
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    DIAG("Decimation chain: %s, %zu stages, decimating by %u", DECIMATION_CHAIN_CIC == type ? "CIC" : "halfband",
+            nr_factors, factor);
+
+    *pchain = chain;
+
+done:
+    if (FAILED(ret)) {
+        if (NULL != chain) {
+            TFREE(chain);
+        }
+    }
+
+    return ret;
+}
+
+aresult_t decimation_chain_delete(struct decimation_chain **pchain)
+{
+    aresult_t ret = A_OK;
+
+    struct decimation_chain *chain = NULL;
+
+    TSL_ASSERT_PTR_BY_REF(pchain);
+
+    chain = *pchain;
+
+    for (size_t i = 0; i < chain->nr_halfband; i++) {
+        if (NULL != chain->halfband[i].hist) {
+            TFREE(chain->halfband[i].hist);
+        }
+    }
+
+    TFREE(chain);
+    *pchain = NULL;
+
+    return ret;
+}
+
+aresult_t decimation_chain_process(struct decimation_chain *chain, const int16_t *in, size_t nr_in,
+        int16_t *out, size_t *pnr_out)
+{
+    aresult_t ret = A_OK;
+
+    size_t nr_out = nr_in;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != chain);
+    TSL_ASSERT_ARG_DEBUG(NULL != in);
+    TSL_ASSERT_ARG_DEBUG(NULL != out);
+    TSL_ASSERT_ARG_DEBUG(NULL != pnr_out);
+
+    *pnr_out = 0;
+
+    if (DECIMATION_CHAIN_CIC == chain->type) {
+        nr_out = _decimation_cic_process(chain, in, nr_in, out);
+    } else {
+        /* Each stage reads the previous stage's output back out of the output buffer */
+        for (size_t i = 0; i < chain->nr_halfband; i++) {
+            if (FAILED(ret = _decimation_halfband_process(chain, &chain->halfband[i], 0 == i ? in : out, nr_out,
+                            out, &nr_out)))
+            {
+                goto done;
+            }
+        }
+    }
+
+    *pnr_out = nr_out;
+
+done:
+    return ret;
+}
+
+unsigned decimation_chain_factor(const struct decimation_chain *chain)
+{
+    TSL_BUG_ON(NULL == chain);
+
+    return chain->factor;
+}
+
+size_t decimation_chain_cost(const struct decimation_chain *chain)
+{
+    size_t cost = 0;
+
+    TSL_BUG_ON(NULL == chain);
+
+    if (DECIMATION_CHAIN_CIC == chain->type) {
+        /* Just the two scaling multiplies per output sample */
+        cost = 1;
+    } else {
+        /* Each stage costs 2 * (odd taps + 1) multiplies per output, i.e. (odd taps + 1) per
+         * input; every stage sees half the samples of the one before it.
+         */
+        double per_input = 0.0;
+
+        for (size_t i = 0; i < chain->nr_halfband; i++) {
+            per_input += (double)(DECIMATION_HALFBAND_NR_ODD_TAPS + 1) / (double)(1ul << i);
+        }
+
+        cost = (size_t)ceil(per_input);
+    }
+
+    return cost;
+}
+
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <tsl/result.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct decimation_chain;
+
+/**
+ * The maximum number of stages in a decimation chain
+ */
+#define DECIMATION_CHAIN_MAX_STAGES         8
+
+/**
+ * The type of filter used for the stages of a decimation chain
+ */
+enum decimation_chain_type {
+    /**
+     * A cascade of decimate-by-2 halfband FIRs. Every stage must decimate by 2.
+     */
+    DECIMATION_CHAIN_HALFBAND = 0,
+
+    /**
+     * A single third-order CIC decimator, decimating by the product of all the stage factors.
+     * The CIC's passband droop should be compensated for by the filter that follows the chain.
+     */
+    DECIMATION_CHAIN_CIC = 1,
+};
+
+/**
+ * Create a decimation chain, a cheap front end that brings a baseband complex signal down to a
+ * lower rate, before the final (sharper) channel filter is applied.
+ *
+ * \param pchain The new decimation chain, returned by reference.
+ * \param type The type of filter to use for the chain
+ * \param factors The decimation factor of each stage
+ * \param nr_factors The number of stages
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t decimation_chain_new(struct decimation_chain **pchain, enum decimation_chain_type type,
+        const unsigned *factors, size_t nr_factors);
+
+/**
+ * Release the resources held by a decimation chain.
+ *
+ * \param pchain The decimation chain, passed by reference. Set to NULL on success.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t decimation_chain_delete(struct decimation_chain **pchain);
+
+/**
+ * Decimate a block of complex Q.15 samples. All input samples are consumed; state is carried
+ * over to the next call. The output may be the same buffer as the input.
+ *
+ * \param chain The decimation chain
+ * \param in Interleaved I/Q input samples
+ * \param nr_in The number of complex input samples
+ * \param out Interleaved I/Q output samples. Must hold at least nr_in/factor + 1 samples.
+ * \param pnr_out The number of complex samples written to out, returned by reference.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t decimation_chain_process(struct decimation_chain *chain, const int16_t *in, size_t nr_in,
+        int16_t *out, size_t *pnr_out);
+
+/**
+ * Get the overall decimation factor of the chain.
+ */
+unsigned decimation_chain_factor(const struct decimation_chain *chain);
+
+/**
+ * Get the number of multiplies the chain costs for each input sample, rounded up.
+ */
+size_t decimation_chain_cost(const struct decimation_chain *chain);
+
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <filter/filter.h>
+
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+
+#include <math.h>
+#include <string.h>
+
+/**
+ * State for a single-pole de-emphasis filter, the RC low-pass an FM transmitter's pre-emphasis
+ * is undone with.
+ */
+struct deemphasis {
+    /**
+     * The filter coefficient, 1 - exp(-1/(tau * fs)). In Q.15 representation.
+     */
+    int32_t a;
+
+    /**
+     * Prior output sample, y[n-1]. In Q.30 representation.
+     */
+    int32_t y_n_1;
+};
+
+/**
+ * Initialize a de-emphasis filter to its starting state.
+ *
+ * \param deemph Enough memory to store a de-emphasis filter's state
+ * \param tau The time constant of the filter, in seconds (i.e. 75e-6 or 50e-6 for broadcast FM)
+ * \param sample_rate The sample rate of the samples to be filtered, in Hz
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+static inline
+aresult_t deemphasis_init(struct deemphasis *deemph, double tau, double sample_rate)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != deemph);
+    TSL_ASSERT_ARG(0.0 < tau);
+    TSL_ASSERT_ARG(0.0 < sample_rate);
+
+    memset(deemph, 0, sizeof(*deemph));
+
+    /* Convert the coefficient to a fixed point integer */
+    deemph->a = (int32_t)lrint((1.0 - exp(-1.0 / (tau * sample_rate))) * (double)(1 << Q_15_SHIFT));
+
+    return ret;
+}
+
+/**
+ * Apply a de-emphasis filter, in place: y[n] = y[n-1] + a * (x[n] - y[n-1]). The output is
+ * always between the input and the previous output, so it can't overflow.
+ *
+ * \param deemph The de-emphasis filter state
+ * \param samples Samples to filter
+ * \param nr_samples The number of samples in the input buffer
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+static inline
+aresult_t deemphasis_apply(struct deemphasis *deemph, int16_t *samples, size_t nr_samples)
+{
+    aresult_t ret = A_OK;
+
+    int32_t y = 0;
+
+    TSL_ASSERT_ARG(NULL != deemph);
+    TSL_ASSERT_ARG(NULL != samples);
+
+    y = deemph->y_n_1;
+
+    for (size_t i = 0; i < nr_samples; i++) {
+        int32_t x = (int32_t)samples[i] << Q_15_SHIFT;
+
+        /* The difference can take up 31 bits, so the product needs 64 */
+        y += (int32_t)(((int64_t)deemph->a * (x - y)) >> Q_15_SHIFT);
+        samples[i] = (int16_t)((y + (1 << (Q_15_SHIFT - 1))) >> Q_15_SHIFT);
+    }
+
+    deemph->y_n_1 = y;
+
+    return ret;
+}
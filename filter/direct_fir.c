@@ -22,6 +22,11 @@
 
 #include <filter/filter.h>
 #include <filter/direct_fir.h>
+#include <filter/kernels.h>
+#include <filter/kernels_priv.h>
+#include <filter/kernels_fixed.h>
+#include <filter/decimation_chain.h>
+#include <filter/fast_conv.h>
 #include <filter/sample_buf.h>
 #include <filter/complex.h>
 
@@ -30,16 +35,9 @@
 #include <tsl/diag.h>
 #include <tsl/safe_alloc.h>
 
+#include <stdint.h>
 #include <string.h>
 #include <math.h>
-#include <complex.h>
-
-#if defined(_USE_ARM_NEON)
-/* Use ARM NEON because configuration told us to */
-#define _NEON_FIR_IMPLEMENTATION
-#else
-#define _DIRECT_FIR_IMPLEMENTATION
-#endif /* determine which FIR implementation to use */
 
 aresult_t direct_fir_init(struct direct_fir *fir, size_t nr_coeffs, const int16_t *fir_real_coeff,
         const int16_t *fir_imag_coeff, unsigned decimation_factor,
@@ -58,395 +56,836 @@ aresult_t direct_fir_init(struct direct_fir *fir, size_t nr_coeffs, const int16_
 
     memset(fir, 0, sizeof(struct direct_fir));
 
+    TSL_BUG_IF_FAILED(filter_kernels_init());
+    TSL_BUG_IF_FAILED(sample_history_init(&fir->hist, 2 * sizeof(int16_t)));
+
     TSL_BUG_IF_FAILED(TACALLOC((void **)&fir->fir_real_coeff, nr_coeffs, sizeof(int16_t), 16));
     memcpy(fir->fir_real_coeff, fir_real_coeff, nr_coeffs * sizeof(int16_t));
     TSL_BUG_IF_FAILED(TACALLOC((void **)&fir->fir_imag_coeff, nr_coeffs, sizeof(int16_t), 16));
     memcpy(fir->fir_imag_coeff, fir_imag_coeff, nr_coeffs * sizeof(int16_t));
 
+    /* Pad the interleaved coefficients so a vector load never runs off the end, for any of the kernels */
+    TSL_BUG_IF_FAILED(TACALLOC((void **)&fir->mac_coeff_re, (nr_coeffs + 15) & ~(size_t)15, 2 * sizeof(int16_t), 64));
+    TSL_BUG_IF_FAILED(TACALLOC((void **)&fir->mac_coeff_im, (nr_coeffs + 15) & ~(size_t)15, 2 * sizeof(int16_t), 64));
+
+    for (size_t i = 0; i < nr_coeffs; i++) {
+        if (INT16_MIN == fir_imag_coeff[i]) {
+            /* -c_im doesn't fit; the SIMD kernels fall back to the scalar one */
+            DIAG("FIR: coefficient %zu can't be negated, not using the multiply-accumulate kernels", i);
+            TFREE(fir->mac_coeff_re);
+            TFREE(fir->mac_coeff_im);
+            break;
+        }
+
+        fir->mac_coeff_re[2 * i    ] = fir_real_coeff[i];
+        fir->mac_coeff_re[2 * i + 1] = -fir_imag_coeff[i];
+        fir->mac_coeff_im[2 * i    ] = fir_imag_coeff[i];
+        fir->mac_coeff_im[2 * i + 1] = fir_real_coeff[i];
+    }
+
     fir->decimate_factor = decimation_factor;
     fir->nr_coeffs = nr_coeffs;
 
-    fir->rot_phase_re = 0;
-    fir->rot_phase_im = 0;
+    /* Use a kernel built for this exact filter shape, if there is one */
+    fir->dot_block = filter_kernels->direct_fir_dot_block;
+    fir->dot_block_u8 = filter_kernels->direct_fir_dot_block_u8;
+
+    if (NULL != fir->mac_coeff_re) {
+        filter_direct_fir_dot_block_fn fixed = filter_kernels_fixed_direct_fir(filter_kernels, nr_coeffs,
+                decimation_factor);
+        filter_direct_fir_dot_block_u8_fn fixed_u8 = filter_kernels_fixed_direct_fir_u8(filter_kernels,
+                nr_coeffs, decimation_factor);
+
+        if (NULL != fixed) {
+            DIAG("FIR: using the fixed-size kernel for %zu coefficients, decimation by %u", nr_coeffs,
+                    decimation_factor);
+            fir->dot_block = fixed;
+        }
 
-    if (true == derotate) {
-        double fwt0 = 2.0 * M_PI * (double)freq_shift / (double)sampling_rate,
-               q15 = 1ll << Q_15_SHIFT;
-        complex double derotate_incr = cexp(CMPLX(0, -fwt0 * (double)decimation_factor));
-        fir->rot_phase_incr_re = (int32_t)(creal(derotate_incr) * q15);
-        fir->rot_phase_incr_im = (int32_t)(cimag(derotate_incr) * q15);
-        fir->rot_phase_re = 1ul << Q_15_SHIFT;
-        fir->rot_phase_im = 0;
-        DIAG("Derotation factor: %f, %f (%08x, %08x -> %f, %f)", creal(derotate_incr), cimag(derotate_incr),
-                fir->rot_phase_incr_re, fir->rot_phase_incr_im,
-                (double)fir->rot_phase_incr_re/q15, (double)fir->rot_phase_incr_im/q15);
+        if (NULL != fixed_u8) {
+            fir->dot_block_u8 = fixed_u8;
+        }
     }
 
+    /* Derotate by the shift over a whole decimation's worth of input samples, exactly */
+    TSL_BUG_IF_FAILED(nco_init(&fir->rot_nco, true == derotate ?
+                nco_phase_incr(-(double)freq_shift, (double)sampling_rate) * decimation_factor : 0));
 
     return ret;
 }
 
-aresult_t direct_fir_cleanup(struct direct_fir *fir)
+aresult_t direct_fir_init_mix(struct direct_fir *fir, size_t nr_coeffs, const int16_t *fir_coeff,
+        unsigned decimation_factor, uint32_t sampling_rate, int32_t freq_shift)
 {
     aresult_t ret = A_OK;
 
     TSL_ASSERT_ARG(NULL != fir);
+    TSL_ASSERT_ARG(0 != nr_coeffs);
+    TSL_ASSERT_ARG(NULL != fir_coeff);
+    TSL_ASSERT_ARG(0 != decimation_factor);
+    TSL_ASSERT_ARG(0 != sampling_rate);
 
-    if (NULL != fir->fir_real_coeff) {
-        TFREE(fir->fir_real_coeff);
+    DIAG("FIR: Preparing %zu real coefficients, decimation by %u, mixing sampling rate = %u frequency_shift = %d",
+            nr_coeffs, decimation_factor, sampling_rate, freq_shift);
+
+    memset(fir, 0, sizeof(struct direct_fir));
+
+    fir->strategy = DIRECT_FIR_STRATEGY_MIX;
+
+    if (FAILED(ret = filter_kernels_init())) {
+        goto done;
     }
 
-    if (NULL != fir->fir_imag_coeff) {
-        TFREE(fir->fir_imag_coeff);
+    if (FAILED(ret = sample_history_init(&fir->hist, 2 * sizeof(int16_t)))) {
+        goto done;
     }
 
-    if (NULL != fir->sb_active) {
-        sample_buf_decref(fir->sb_active);
-        fir->sb_active = NULL;
+    if (FAILED(ret = TACALLOC((void **)&fir->fir_real_coeff, nr_coeffs, sizeof(int16_t), 16))) {
+        goto done;
     }
 
-    if (NULL != fir->sb_next) {
-        sample_buf_decref(fir->sb_next);
-        fir->sb_next = NULL;
+    memcpy(fir->fir_real_coeff, fir_coeff, nr_coeffs * sizeof(int16_t));
+
+    if (FAILED(ret = fir_fold_init(&fir->fold, fir_coeff, nr_coeffs))) {
+        goto done;
     }
 
-    fir->decimate_factor = 0;
+    /* The mixer shifts the input down by freq_shift */
+    if (FAILED(ret = nco_init(&fir->mix_nco, nco_phase_incr(-(double)freq_shift, (double)sampling_rate)))) {
+        goto done;
+    }
+
+    fir->decimate_factor = decimation_factor;
+    fir->nr_coeffs = nr_coeffs;
+
+done:
+    if (FAILED(ret)) {
+        direct_fir_cleanup(fir);
+    }
 
     return ret;
 }
 
-aresult_t direct_fir_push_sample_buf(struct direct_fir *fir, struct sample_buf *buf)
+aresult_t direct_fir_init_fft(struct direct_fir *fir, size_t nr_coeffs, const int16_t *fir_real_coeff,
+        const int16_t *fir_imag_coeff, unsigned decimation_factor, uint32_t sampling_rate, int32_t freq_shift)
 {
     aresult_t ret = A_OK;
 
     TSL_ASSERT_ARG(NULL != fir);
-    TSL_ASSERT_ARG(NULL != buf);
+    TSL_ASSERT_ARG(0 != nr_coeffs);
+    TSL_ASSERT_ARG(NULL != fir_real_coeff);
+    TSL_ASSERT_ARG(NULL != fir_imag_coeff);
+    TSL_ASSERT_ARG(0 != decimation_factor);
+    TSL_ASSERT_ARG(0 != sampling_rate);
 
-    TSL_BUG_ON(fir->sb_active == buf);
-    TSL_BUG_ON(fir->sb_next == buf);
+    memset(fir, 0, sizeof(struct direct_fir));
 
-    if (NULL == fir->sb_active) {
-        fir->sb_active = buf;
-        TSL_BUG_ON(NULL != fir->sb_next);
-    } else {
-        if (NULL == fir->sb_next) {
-            fir->sb_next = buf;
-        } else {
-            ret = A_E_BUSY;
-            goto done;
-        }
+    fir->strategy = DIRECT_FIR_STRATEGY_FFT;
+
+    /* The history is unused, but keeps cleanup uniform */
+    if (FAILED(ret = sample_history_init(&fir->hist, 2 * sizeof(int16_t)))) {
+        goto done;
     }
 
-    DIAG("PUSH(active = %p next = %p)", fir->sb_active, fir->sb_next);
+    if (FAILED(ret = fast_conv_new(&fir->fast_conv, nr_coeffs, fir_real_coeff, fir_imag_coeff, decimation_factor,
+                    sampling_rate, freq_shift)))
+    {
+        goto done;
+    }
 
-    fir->nr_samples += buf->nr_samples;
+    fir->decimate_factor = decimation_factor;
+    fir->nr_coeffs = nr_coeffs;
 
 done:
+    if (FAILED(ret)) {
+        direct_fir_cleanup(fir);
+    }
+
     return ret;
 }
 
-/**
- * Perform a phase derotation for the current sample.
- */
-static
-aresult_t _direct_fir_apply_derotation(struct direct_fir *fir, int32_t acc_re_in, int32_t acc_im_in,
-        int32_t *acc_re_out, int32_t *acc_im_out)
+size_t direct_fir_cost(enum direct_fir_strategy strategy, size_t nr_coeffs, unsigned decimation_factor)
+{
+    size_t cost = 0;
+
+    switch (strategy) {
+    case DIRECT_FIR_STRATEGY_COMPLEX:
+        /* Complex multiply per tap, plus the derotation of the output sample */
+        cost = 4 * nr_coeffs + 4;
+        break;
+    case DIRECT_FIR_STRATEGY_MIX:
+        /* Real by complex multiply per tap, plus mixing every input sample exactly once */
+        cost = 2 * nr_coeffs + 4 * decimation_factor;
+        break;
+    case DIRECT_FIR_STRATEGY_FFT:
+        cost = fast_conv_cost(nr_coeffs, decimation_factor);
+        break;
+    default:
+        PANIC("Unknown FIR strategy %d", strategy);
+    }
+
+    return cost;
+}
+
+enum direct_fir_strategy direct_fir_choose_strategy(size_t nr_coeffs, unsigned decimation_factor)
+{
+    return direct_fir_cost(DIRECT_FIR_STRATEGY_MIX, nr_coeffs, decimation_factor) <
+        direct_fir_cost(DIRECT_FIR_STRATEGY_COMPLEX, nr_coeffs, decimation_factor) ?
+            DIRECT_FIR_STRATEGY_MIX : DIRECT_FIR_STRATEGY_COMPLEX;
+}
+
+aresult_t direct_fir_set_front_end(struct direct_fir *fir, struct decimation_chain *chain)
 {
     aresult_t ret = A_OK;
 
-    TSL_ASSERT_ARG_DEBUG(NULL != fir);
-    TSL_ASSERT_ARG_DEBUG(NULL != acc_re_out);
-    TSL_ASSERT_ARG_DEBUG(NULL != acc_im_out);
+    TSL_ASSERT_ARG(NULL != fir);
+    TSL_ASSERT_ARG(NULL != chain);
+    TSL_ASSERT_ARG(DIRECT_FIR_STRATEGY_MIX == fir->strategy);
+    TSL_ASSERT_ARG(NULL == fir->front_end);
+    TSL_ASSERT_ARG(0 == fir->hist.nr);
+
+    fir->front_end = chain;
+
+    return ret;
+}
+
+aresult_t direct_fir_cleanup(struct direct_fir *fir)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != fir);
+
+    if (NULL != fir->fir_real_coeff) {
+        TFREE(fir->fir_real_coeff);
+    }
+
+    if (NULL != fir->fir_imag_coeff) {
+        TFREE(fir->fir_imag_coeff);
+    }
+
+    if (NULL != fir->mac_coeff_re) {
+        TFREE(fir->mac_coeff_re);
+    }
+
+    if (NULL != fir->mac_coeff_im) {
+        TFREE(fir->mac_coeff_im);
+    }
+
+    TSL_BUG_IF_FAILED(fir_fold_cleanup(&fir->fold));
 
-    /* Apply the phase derotation to the sample */
-    cmul_q15_q30(acc_re_in, acc_im_in, fir->rot_phase_re, fir->rot_phase_im,
-            acc_re_out, acc_im_out);
+    TSL_BUG_IF_FAILED(sample_history_cleanup(&fir->hist));
 
-    /* Now add the phase rotation increment to the phase rotation for the next sample */
-    cmul_q15_q15(fir->rot_phase_re, fir->rot_phase_im, fir->rot_phase_incr_re, fir->rot_phase_incr_im,
-            &fir->rot_phase_re, &fir->rot_phase_im);
+    if (NULL != fir->front_end) {
+        TSL_BUG_IF_FAILED(decimation_chain_delete(&fir->front_end));
+    }
+
+    if (NULL != fir->fast_conv) {
+        TSL_BUG_IF_FAILED(fast_conv_delete(&fir->fast_conv));
+    }
 
-    fir->rot_counter++;
+    fir->decimate_factor = 0;
 
     return ret;
 }
 
-#if defined(_NEON_FIR_IMPLEMENTATION)
-#include <arm_neon.h>
 
+/**
+ * Mix a sample buffer down to baseband, appending the result to the history. The sample buffer
+ * is released once it has been mixed.
+ */
 static
-aresult_t _direct_fir_process_sample(struct direct_fir *fir, int16_t *psample_real, int16_t *psample_imag)
+aresult_t _direct_fir_mix_push(struct direct_fir *fir, struct sample_buf *buf)
 {
     aresult_t ret = A_OK;
 
-    size_t coeffs_remain = 0,
-           buf_offset = 0;
-    struct sample_buf *cur_buf = NULL;
+    int16_t *out = NULL;
 
+    if (FAILED(ret = sample_history_reserve(&fir->hist, buf->nr_samples, (void **)&out))) {
+        goto done;
+    }
+
+    /* Mix in place, once the samples are in the history */
+    if (FAILED(ret = sample_buf_copy_q15(buf, out))) {
+        goto done;
+    }
+
+    nco_rotate(&fir->mix_nco, out, buf->nr_samples);
+
+    if (NULL != fir->front_end) {
+        size_t nr_decimated = 0;
+
+        /* Decimate the freshly mixed samples in place */
+        if (FAILED(ret = decimation_chain_process(fir->front_end, out, buf->nr_samples, out, &nr_decimated))) {
+            goto done;
+        }
+
+        sample_history_commit(&fir->hist, nr_decimated);
+        fir->max_push = BL_MAX2(fir->max_push, nr_decimated);
+    } else {
+        sample_history_commit(&fir->hist, buf->nr_samples);
+        fir->max_push = BL_MAX2(fir->max_push, buf->nr_samples);
+    }
+
+    TSL_BUG_IF_FAILED(sample_buf_decref(buf));
+
+done:
+    return ret;
+}
+
+FILTER_ALWAYS_INLINE
+void _direct_fir_dot_real_body(const int16_t *restrict coeffs, const int16_t *restrict samples,
+        size_t nr_coeffs, int32_t *pacc_re, int32_t *pacc_im)
+{
     int32_t acc_re = 0,
             acc_im = 0;
 
-    TSL_ASSERT_ARG_DEBUG(NULL != fir);
-    TSL_ASSERT_ARG_DEBUG(NULL != psample_real);
-    TSL_ASSERT_ARG_DEBUG(NULL != psample_imag);
-    TSL_BUG_ON(NULL == fir->sb_active);
+    for (size_t i = 0; i < nr_coeffs; i++) {
+        acc_re += (int32_t)coeffs[i] * samples[2 * i    ];
+        acc_im += (int32_t)coeffs[i] * samples[2 * i + 1];
+    }
 
-    coeffs_remain = fir->nr_coeffs;
-    cur_buf = fir->sb_active;
-    buf_offset = fir->sample_offset;
+    *pacc_re = acc_re;
+    *pacc_im = acc_im;
+}
 
-    /* Check if we have enough samples available */
-    if (fir->sample_offset + fir->nr_coeffs > fir->sb_active->nr_samples && fir->sb_next == NULL) {
-        ret = A_E_DONE;
-        goto done;
+void direct_fir_dot_real_scalar(const int16_t *coeffs, const int16_t *samples, size_t nr_coeffs,
+        int32_t *pacc_re, int32_t *pacc_im)
+{
+    _direct_fir_dot_real_body(coeffs, samples, nr_coeffs, pacc_re, pacc_im);
+}
+
+FILTER_ALWAYS_INLINE
+void _direct_fir_dot_real_block_body(const int16_t *restrict coeffs, const int16_t *restrict samples,
+        size_t nr_coeffs, size_t stride, int32_t *pacc_re, int32_t *pacc_im)
+{
+    const int16_t *restrict s0 = samples,
+                  *restrict s1 = samples + 2 * stride,
+                  *restrict s2 = samples + 4 * stride,
+                  *restrict s3 = samples + 6 * stride;
+    int32_t re0 = 0, im0 = 0,
+            re1 = 0, im1 = 0,
+            re2 = 0, im2 = 0,
+            re3 = 0, im3 = 0;
+
+    /* Each coefficient is loaded once and applied to all of the windows */
+    for (size_t i = 0; i < nr_coeffs; i++) {
+        int32_t c = coeffs[i];
+
+        re0 += c * s0[2 * i]; im0 += c * s0[2 * i + 1];
+        re1 += c * s1[2 * i]; im1 += c * s1[2 * i + 1];
+        re2 += c * s2[2 * i]; im2 += c * s2[2 * i + 1];
+        re3 += c * s3[2 * i]; im3 += c * s3[2 * i + 1];
     }
 
-    do {
-        /* Temporary vector accumulators */
-        int32x4_t acc_re_v = { 0, 0, 0, 0 },
-                  acc_im_v = { 0, 0, 0, 0 };
+    pacc_re[0] = re0; pacc_im[0] = im0;
+    pacc_re[1] = re1; pacc_im[1] = im1;
+    pacc_re[2] = re2; pacc_im[2] = im2;
+    pacc_re[3] = re3; pacc_im[3] = im3;
+}
+
+void direct_fir_dot_real_block_scalar(const int16_t *coeffs, const int16_t *samples, size_t nr_coeffs,
+        size_t stride, int32_t *acc_re, int32_t *acc_im)
+{
+    _direct_fir_dot_real_block_body(coeffs, samples, nr_coeffs, stride, acc_re, acc_im);
+}
+
+#ifdef _FILTER_HAVE_X86_KERNELS
+FILTER_DEFINE_X86_VARIANTS(direct_fir_dot_real,
+        (const int16_t *coeffs, const int16_t *samples, size_t nr_coeffs, int32_t *pacc_re, int32_t *pacc_im),
+        (coeffs, samples, nr_coeffs, pacc_re, pacc_im))
+FILTER_DEFINE_X86_VARIANTS(direct_fir_dot_real_block,
+        (const int16_t *coeffs, const int16_t *samples, size_t nr_coeffs, size_t stride, int32_t *acc_re, int32_t *acc_im),
+        (coeffs, samples, nr_coeffs, stride, acc_re, acc_im))
+#endif /* defined(_FILTER_HAVE_X86_KERNELS) */
+
+/**
+ * Filter the mixed samples with the real low-pass coefficients
+ */
+static
+size_t _direct_fir_mix_process(struct direct_fir *fir, int16_t *out_buf, size_t nr_out_samples)
+{
+    size_t nr_out = 0,
+           block_span = fir->nr_coeffs + (FILTER_BLOCK_OUTPUTS - 1) * fir->decimate_factor;
+
+    /* A folded filter does half the multiplies, which beats sharing coefficient loads */
+    if (FIR_SYMMETRY_NONE != fir->fold.symmetry) {
+        while (nr_out < nr_out_samples && sample_history_avail(&fir->hist) >= fir->nr_coeffs) {
+            int32_t acc_re = 0,
+                    acc_im = 0;
 
-        /* Figure out how many samples to pull out */
-        size_t nr_samples_in = cur_buf->nr_samples - buf_offset,
-               start_coeff = fir->nr_coeffs - coeffs_remain;
+            filter_kernels->fir_fold_dot_iq(&fir->fold, sample_history_head(&fir->hist), &acc_re, &acc_im);
 
-        /* Snap to either the number of coefficients in the FIR or the number of remaining
-         * coefficients, whichever is smaller.
-         */
-        nr_samples_in = BL_MIN2(nr_samples_in, coeffs_remain);
+            out_buf[2 * nr_out    ] = round_q30_q15(acc_re);
+            out_buf[2 * nr_out + 1] = round_q30_q15(acc_im);
 
-        if (nr_samples_in != fir->nr_coeffs) {
-            DIAG("Samples from buffer %p: %zu, start coefficient: %zu (%zu remain) start offset %zu (of %u)",
-                    cur_buf, nr_samples_in, start_coeff, coeffs_remain, buf_offset, fir->sb_active->nr_samples);
+            sample_history_advance(&fir->hist, fir->decimate_factor);
+            nr_out++;
         }
+    }
+
+    while (nr_out + FILTER_BLOCK_OUTPUTS <= nr_out_samples && sample_history_avail(&fir->hist) >= block_span) {
+        int32_t acc_re[FILTER_BLOCK_OUTPUTS],
+                acc_im[FILTER_BLOCK_OUTPUTS];
 
-        for (size_t i = 0; i < nr_samples_in / 4; i++) {
-            size_t start_samp = i * 4;
-            int16_t *sample_base =
-                (int16_t *)((uint8_t *)cur_buf->data_buf + (sizeof(int16_t) * 2 * (buf_offset + start_samp)));
-
-            /* Samples loaded at offset */
-            int16x4x2_t samples;
-            int32x4_t f_acc;
-            int16x4_t c_re,
-                      c_im;
-
-            __builtin_prefetch(sample_base);
-            __builtin_prefetch(fir->fir_real_coeff + start_samp + start_coeff);
-            __builtin_prefetch(fir->fir_imag_coeff + start_samp + start_coeff);
-
-            samples = vld2_s16(sample_base);
-
-            /* c_re = vec4(fir_real_coeff + start_samp + start_coeff) */
-            c_re = vld1_s16(fir->fir_real_coeff + start_samp + start_coeff);
-            /* c_im = vec4(fir_imag_coeff + start_samp + start_coeff) */
-            c_im = vld1_s16(fir->fir_imag_coeff + start_samp + start_coeff);
-
-            /* f_re = s_re * c_re */
-            f_acc = vmull_s16(samples.val[0], c_re);
-            /* f_re -= s_im * c_im */
-            f_acc = vmlsl_s16(f_acc, samples.val[1], c_im);
-            acc_re_v = vaddq_s32(acc_re_v, f_acc);
-
-            /* f_im = s_im * c_re */
-            f_acc = vmull_s16(samples.val[1], c_re);
-            /* f_im += c_im * s_re */
-            f_acc = vmlal_s16(f_acc, c_im, samples.val[0]);
-            acc_im_v = vaddq_s32(acc_im_v, f_acc);
+        filter_kernels->direct_fir_dot_real_block(fir->fir_real_coeff, sample_history_head(&fir->hist),
+                fir->nr_coeffs, fir->decimate_factor, acc_re, acc_im);
+
+        for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+            out_buf[2 * nr_out    ] = round_q30_q15(acc_re[k]);
+            out_buf[2 * nr_out + 1] = round_q30_q15(acc_im[k]);
+            nr_out++;
         }
 
-        /* Reduce the accumulators */
-        acc_re += acc_re_v[0] + acc_re_v[1] + acc_re_v[2] + acc_re_v[3];
-        acc_im += acc_im_v[0] + acc_im_v[1] + acc_im_v[2] + acc_im_v[3];
+        sample_history_advance(&fir->hist, FILTER_BLOCK_OUTPUTS * fir->decimate_factor);
+    }
 
-        size_t res_start = nr_samples_in & ~((size_t)4 - 1);
+    while (nr_out < nr_out_samples && sample_history_avail(&fir->hist) >= fir->nr_coeffs) {
+        const int16_t *samples = sample_history_head(&fir->hist);
+        int32_t acc_re = 0,
+                acc_im = 0;
 
-        for (size_t i = 0; i < nr_samples_in % 4; i++) {
-            TSL_BUG_ON(i + res_start + start_coeff >= fir->nr_coeffs);
-            TSL_BUG_ON(i + res_start + buf_offset >= cur_buf->nr_samples);
-            DIAG("Processing sample %zu (base = %zu)", i + res_start, res_start);
+        filter_kernels->direct_fir_dot_real(fir->fir_real_coeff, samples, fir->nr_coeffs, &acc_re, &acc_im);
 
-            int16_t *sample = &((int16_t *)cur_buf->data_buf)[2 * (buf_offset + res_start + i)];
+        out_buf[2 * nr_out    ] = round_q30_q15(acc_re);
+        out_buf[2 * nr_out + 1] = round_q30_q15(acc_im);
 
-            int32_t s_re = sample[0],
-                    s_im = sample[1],
-                    c_re = fir->fir_real_coeff[i + start_coeff + res_start],
-                    c_im = fir->fir_imag_coeff[i + start_coeff + res_start],
-                    f_re = 0,
-                    f_im = 0;
+        sample_history_advance(&fir->hist, fir->decimate_factor);
+        nr_out++;
+    }
+
+    return nr_out;
+}
+
+/**
+ * Append 8-bit samples to the history as they are. The first time, the history is switched over
+ * to 8-bit samples, which is only possible before any samples have been pushed. Signed samples
+ * are offset into unsigned ones on the way in, so the kernels only have to handle one kind.
+ */
+static
+aresult_t _direct_fir_push_u8(struct direct_fir *fir, struct sample_buf *buf)
+{
+    aresult_t ret = A_OK;
 
-            /* Filter the sample */
-            cmul_q15_q30(c_re, c_im, s_re, s_im, &f_re, &f_im);
+    unsigned zero = COMPLEX_UINT_8 == buf->sample_type ? SAMPLE_UINT_8_ZERO : 128;
+    uint8_t *dest = NULL;
 
-            /* Accumulate the sample */
-            acc_re += f_re;
-            acc_im += f_im;
-        }
+    if (!sample_type_is_8bit(buf->sample_type) || (0 != fir->u8_zero && zero != fir->u8_zero)) {
+        DIAG("FIR: can't mix sample types once 8-bit samples have been pushed (got type %d)", buf->sample_type);
+        ret = A_E_INVAL;
+        goto done;
+    }
 
-        /* If we iterate through, we'll start at the beginning of the next buffer */
-        buf_offset = 0;
-        cur_buf = fir->sb_next;
-        coeffs_remain -= nr_samples_in;
+    if (0 == fir->u8_zero) {
+        uint32_t sum_re = 0,
+                 sum_im = 0;
 
-        if (0 != coeffs_remain) {
-            DIAG("COEFF: %zu remain, buffer = %p (prev = %p), %zu samples in",
-                    coeffs_remain, cur_buf, fir->sb_active, nr_samples_in);
+        TSL_BUG_IF_FAILED(sample_history_cleanup(&fir->hist));
+
+        if (FAILED(ret = sample_history_init(&fir->hist, 2 * sizeof(uint8_t)))) {
+            goto done;
         }
-    } while (0 != coeffs_remain);
 
-    /* Check if the next sample will start in the following buffer; if so, move along */
-    if (fir->sample_offset + fir->decimate_factor >= fir->sb_active->nr_samples) {
-        size_t cur_nr_samples = fir->sb_active->nr_samples;
+        for (size_t i = 0; i < 2 * fir->nr_coeffs; i++) {
+            sum_re += (uint32_t)(int32_t)fir->mac_coeff_re[i];
+            sum_im += (uint32_t)(int32_t)fir->mac_coeff_im[i];
+        }
 
-        TSL_BUG_IF_FAILED(sample_buf_decref(fir->sb_active));
+        fir->u8_zero = zero;
+        fir->u8_bias_re = 0u - zero * sum_re;
+        fir->u8_bias_im = 0u - zero * sum_im;
 
-        fir->sb_active = fir->sb_next;
-        fir->sb_next = NULL;
-        fir->sample_offset = (fir->sample_offset + fir->decimate_factor) - cur_nr_samples;
-    } else {
-        fir->sample_offset += fir->decimate_factor;
+        DIAG("FIR: filtering 8-bit samples directly, zero at %u", zero);
     }
 
-    fir->nr_samples -= fir->decimate_factor;
+    if (FAILED(ret = sample_history_reserve(&fir->hist, buf->nr_samples, (void **)&dest))) {
+        goto done;
+    }
 
-    /* Apply a phase (de)rotation, if appropriate */
-    if (!(0 == fir->rot_phase_incr_re && 0 == fir->rot_phase_incr_im)) {
-        /* Convert the accumulated sample to Q.15 */
-        TSL_BUG_IF_FAILED(_direct_fir_apply_derotation(fir, round_q30_q15(acc_re), round_q30_q15(acc_im),
-                    &acc_re, &acc_im));
+    if (COMPLEX_UINT_8 == buf->sample_type) {
+        memcpy(dest, buf->data_buf, 2 * buf->nr_samples);
+    } else {
+        for (size_t i = 0; i < 2 * buf->nr_samples; i++) {
+            dest[i] = buf->data_buf[i] ^ 0x80;
+        }
     }
 
-    /* Return the computed sample, in Q.15 (currently in Q.30 due to the prior multiplication) */
-    *psample_real = round_q30_q15(acc_re);
-    *psample_imag = round_q30_q15(acc_im);
+    sample_history_commit(&fir->hist, buf->nr_samples);
+    fir->max_push = BL_MAX2(fir->max_push, buf->nr_samples);
+
+    TSL_BUG_IF_FAILED(sample_buf_decref(buf));
 
 done:
     return ret;
 }
 
-#elif defined(_DIRECT_FIR_IMPLEMENTATION)
-static
-aresult_t _direct_fir_process_sample(struct direct_fir *fir, int16_t *psample_real, int16_t *psample_imag)
+aresult_t direct_fir_push_sample_buf(struct direct_fir *fir, struct sample_buf *buf)
 {
     aresult_t ret = A_OK;
 
-    int32_t acc_re = 0,
-            acc_im = 0;
-    size_t coeffs_remain = 0,
-           buf_offset = 0;
-    struct sample_buf *cur_buf = NULL;
+    TSL_ASSERT_ARG(NULL != fir);
+    TSL_ASSERT_ARG(NULL != buf);
 
-    TSL_ASSERT_ARG_DEBUG(NULL != fir);
-    TSL_ASSERT_ARG_DEBUG(NULL != psample_real);
-    TSL_ASSERT_ARG_DEBUG(NULL != psample_imag);
+    if (DIRECT_FIR_STRATEGY_MIX == fir->strategy) {
+        ret = _direct_fir_mix_push(fir, buf);
+        goto done;
+    }
 
-    coeffs_remain = fir->nr_coeffs;
-    cur_buf = fir->sb_active;
-    buf_offset = fir->sample_offset;
+    if (DIRECT_FIR_STRATEGY_FFT == fir->strategy) {
+        ret = fast_conv_push_sample_buf(fir->fast_conv, buf);
+        goto done;
+    }
 
-    /* Check if we have enough samples available */
-    if (fir->sample_offset + fir->nr_coeffs > fir->sb_active->nr_samples &&
-            fir->sb_next == NULL)
+    /* Keep 8-bit samples as they are if they are the first to arrive. The 8-bit kernels need
+     * the multiply-accumulate coefficients.
+     */
+    if (0 != fir->u8_zero ||
+            (sample_type_is_8bit(buf->sample_type) && NULL != fir->mac_coeff_re && NULL == fir->hist.samples))
     {
-        ret = A_E_DONE;
+        ret = _direct_fir_push_u8(fir, buf);
         goto done;
     }
 
-    /* Walk the number of samples in the current buffer up to the filter size */
-    do {
-        /* Figure out how many samples to pull out */
-        size_t nr_samples_in = cur_buf->nr_samples - buf_offset,
-               start_coeff = fir->nr_coeffs - coeffs_remain;
+    /* Copy the samples in behind the overlap from the previous buffers, so the filter always
+     * walks a single linear span.
+     */
+    if (FAILED(ret = sample_history_append_q15(&fir->hist, buf))) {
+        goto done;
+    }
 
-        /* Snap to either the number of coefficients in the FIR or the number of remaining
-         * coefficients, whichever is smaller.
-         */
-        nr_samples_in = BL_MIN2(nr_samples_in, coeffs_remain);
+    fir->max_push = BL_MAX2(fir->max_push, buf->nr_samples);
 
-        for (size_t i = 0; i < nr_samples_in; i++) {
-            TSL_BUG_ON(i + start_coeff >= fir->nr_coeffs);
-            TSL_BUG_ON(i + buf_offset >= cur_buf->nr_samples);
+    TSL_BUG_IF_FAILED(sample_buf_decref(buf));
 
-            int16_t *sample = &((int16_t *)cur_buf->data_buf)[2 * (buf_offset + i)];
+done:
+    return ret;
+}
 
-            int32_t s_re = (int32_t)sample[0],
-                    s_im = (int32_t)sample[1],
-                    c_re = fir->fir_real_coeff[i + start_coeff],
-                    c_im = fir->fir_imag_coeff[i + start_coeff],
-                    f_re = 0,
-                    f_im = 0;
+void direct_fir_dot_scalar(const struct direct_fir *fir, const int16_t *restrict samples, int32_t *pacc_re, int32_t *pacc_im)
+{
+    const int16_t *restrict c_re = fir->fir_real_coeff,
+                  *restrict c_im = fir->fir_imag_coeff;
+    int32_t acc_re = 0,
+            acc_im = 0;
 
-            /* Filter the sample */
-            cmul_q15_q30(c_re, c_im, s_re, s_im, &f_re, &f_im);
+    /* One linear span, no bounds checks: simple enough for the compiler to vectorize */
+    for (size_t i = 0; i < fir->nr_coeffs; i++) {
+        int32_t s_re = samples[2 * i],
+                s_im = samples[2 * i + 1];
 
-            /* Accumulate the sample */
-            acc_re += f_re;
-            acc_im += f_im;
-        }
+        acc_re += c_re[i] * s_re - c_im[i] * s_im;
+        acc_im += c_re[i] * s_im + c_im[i] * s_re;
+    }
 
-        /* If we iterate through, we'll start at the beginning of the next buffer */
-        buf_offset = 0;
-        cur_buf = fir->sb_next;
-        coeffs_remain -= nr_samples_in;
-    } while (coeffs_remain != 0);
-
-    /* Check if the next sample will start in the following buffer; if so, move along */
-    if (fir->sample_offset + fir->decimate_factor > fir->sb_active->nr_samples) {
-        TSL_BUG_IF_FAILED(sample_buf_decref(fir->sb_active));
-        fir->sb_active = fir->sb_next;
-        fir->sb_next = NULL;
-        fir->sample_offset = (fir->sample_offset + fir->decimate_factor) - fir->sb_active->nr_samples;
-    } else {
-        fir->sample_offset += fir->decimate_factor;
+    *pacc_re = acc_re;
+    *pacc_im = acc_im;
+}
+
+void direct_fir_dot_block_scalar(const struct direct_fir *fir, const int16_t *restrict samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im)
+{
+    const int16_t *restrict c_re = fir->fir_real_coeff,
+                  *restrict c_im = fir->fir_imag_coeff;
+    const int16_t *restrict s0 = samples,
+                  *restrict s1 = samples + 2 * stride,
+                  *restrict s2 = samples + 4 * stride,
+                  *restrict s3 = samples + 6 * stride;
+    int32_t re0 = 0, im0 = 0,
+            re1 = 0, im1 = 0,
+            re2 = 0, im2 = 0,
+            re3 = 0, im3 = 0;
+
+    for (size_t i = 0; i < fir->nr_coeffs; i++) {
+        int32_t r = c_re[i],
+                m = c_im[i];
+
+        re0 += r * s0[2 * i] - m * s0[2 * i + 1]; im0 += r * s0[2 * i + 1] + m * s0[2 * i];
+        re1 += r * s1[2 * i] - m * s1[2 * i + 1]; im1 += r * s1[2 * i + 1] + m * s1[2 * i];
+        re2 += r * s2[2 * i] - m * s2[2 * i + 1]; im2 += r * s2[2 * i + 1] + m * s2[2 * i];
+        re3 += r * s3[2 * i] - m * s3[2 * i + 1]; im3 += r * s3[2 * i + 1] + m * s3[2 * i];
     }
 
-    fir->nr_samples -= fir->decimate_factor;
+    acc_re[0] = re0; acc_im[0] = im0;
+    acc_re[1] = re1; acc_im[1] = im1;
+    acc_re[2] = re2; acc_im[2] = im2;
+    acc_re[3] = re3; acc_im[3] = im3;
+}
+
+/*
+ * The 8-bit kernels work on the unsigned samples as they are, over the interleaved
+ * multiply-accumulate coefficients. Each sum starts from the bias, which takes out the DC offset
+ * the unsigned samples carry, and the result is scaled up at the end; the result is the same as
+ * if each sample had been widened to Q.15 first. The sums can wrap on the way there, so they
+ * are kept unsigned.
+ */
+FILTER_ALWAYS_INLINE
+void _direct_fir_dot_u8_body(const struct direct_fir *fir, const uint8_t *restrict samples, int32_t *pacc_re,
+        int32_t *pacc_im)
+{
+    const int16_t *restrict c_re = fir->mac_coeff_re,
+                  *restrict c_im = fir->mac_coeff_im;
+    uint32_t acc_re = fir->u8_bias_re,
+             acc_im = fir->u8_bias_im;
 
-    /* Apply a phase rotation, if appropriate */
-    if (!(0 == fir->rot_phase_incr_re && 0 == fir->rot_phase_incr_im)) {
-        /* Convert the accumulated sample to Q.15 and apply derotation */
-        TSL_BUG_IF_FAILED(_direct_fir_apply_derotation(fir, round_q30_q15(acc_re), round_q30_q15(acc_im), &acc_re, &acc_im));
+    for (size_t i = 0; i < 2 * fir->nr_coeffs; i++) {
+        int16_t s = samples[i];
+
+        acc_re += (uint32_t)((int32_t)c_re[i] * s);
+        acc_im += (uint32_t)((int32_t)c_im[i] * s);
+    }
+
+    *pacc_re = filter_u8_sum_to_q30(acc_re);
+    *pacc_im = filter_u8_sum_to_q30(acc_im);
+}
+
+void direct_fir_dot_u8_scalar(const struct direct_fir *fir, const uint8_t *samples, int32_t *pacc_re, int32_t *pacc_im)
+{
+    _direct_fir_dot_u8_body(fir, samples, pacc_re, pacc_im);
+}
+
+FILTER_ALWAYS_INLINE
+void _direct_fir_dot_block_u8_body(const struct direct_fir *fir, const uint8_t *restrict samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im)
+{
+    const int16_t *restrict c_re = fir->mac_coeff_re,
+                  *restrict c_im = fir->mac_coeff_im;
+    const uint8_t *restrict s0 = samples,
+                  *restrict s1 = samples + 2 * stride,
+                  *restrict s2 = samples + 4 * stride,
+                  *restrict s3 = samples + 6 * stride;
+    uint32_t re0 = fir->u8_bias_re, im0 = fir->u8_bias_im,
+             re1 = fir->u8_bias_re, im1 = fir->u8_bias_im,
+             re2 = fir->u8_bias_re, im2 = fir->u8_bias_im,
+             re3 = fir->u8_bias_re, im3 = fir->u8_bias_im;
+
+    for (size_t i = 0; i < 2 * fir->nr_coeffs; i++) {
+        int32_t cr = c_re[i],
+                ci = c_im[i];
+        int16_t v0 = s0[i], v1 = s1[i], v2 = s2[i], v3 = s3[i];
+
+        re0 += (uint32_t)(cr * v0); im0 += (uint32_t)(ci * v0);
+        re1 += (uint32_t)(cr * v1); im1 += (uint32_t)(ci * v1);
+        re2 += (uint32_t)(cr * v2); im2 += (uint32_t)(ci * v2);
+        re3 += (uint32_t)(cr * v3); im3 += (uint32_t)(ci * v3);
+    }
+
+    acc_re[0] = filter_u8_sum_to_q30(re0); acc_im[0] = filter_u8_sum_to_q30(im0);
+    acc_re[1] = filter_u8_sum_to_q30(re1); acc_im[1] = filter_u8_sum_to_q30(im1);
+    acc_re[2] = filter_u8_sum_to_q30(re2); acc_im[2] = filter_u8_sum_to_q30(im2);
+    acc_re[3] = filter_u8_sum_to_q30(re3); acc_im[3] = filter_u8_sum_to_q30(im3);
+}
+
+void direct_fir_dot_block_u8_scalar(const struct direct_fir *fir, const uint8_t *samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im)
+{
+    _direct_fir_dot_block_u8_body(fir, samples, stride, acc_re, acc_im);
+}
+
+#ifdef _FILTER_HAVE_X86_KERNELS
+FILTER_DEFINE_X86_VARIANTS(direct_fir_dot_u8,
+        (const struct direct_fir *fir, const uint8_t *samples, int32_t *pacc_re, int32_t *pacc_im),
+        (fir, samples, pacc_re, pacc_im))
+FILTER_DEFINE_X86_VARIANTS(direct_fir_dot_block_u8,
+        (const struct direct_fir *fir, const uint8_t *samples, size_t stride, int32_t *acc_re, int32_t *acc_im),
+        (fir, samples, stride, acc_re, acc_im))
+#endif /* defined(_FILTER_HAVE_X86_KERNELS) */
+
+#if defined(_USE_ARM_NEON)
+#include <arm_neon.h>
+
+void direct_fir_dot_neon(const struct direct_fir *fir, const int16_t *samples, int32_t *pacc_re, int32_t *pacc_im)
+{
+    int32x4_t acc_re_v = { 0, 0, 0, 0 },
+              acc_im_v = { 0, 0, 0, 0 };
+    int32_t acc_re = 0,
+            acc_im = 0;
+    size_t nr_vec = fir->nr_coeffs & ~((size_t)4 - 1);
+
+    for (size_t i = 0; i < nr_vec; i += 4) {
+        int16x4x2_t s = vld2_s16(&samples[2 * i]);
+        int16x4_t c_re = vld1_s16(fir->fir_real_coeff + i),
+                  c_im = vld1_s16(fir->fir_imag_coeff + i);
+
+        /* re += s_re * c_re - s_im * c_im */
+        acc_re_v = vmlal_s16(acc_re_v, s.val[0], c_re);
+        acc_re_v = vmlsl_s16(acc_re_v, s.val[1], c_im);
+
+        /* im += s_im * c_re + s_re * c_im */
+        acc_im_v = vmlal_s16(acc_im_v, s.val[1], c_re);
+        acc_im_v = vmlal_s16(acc_im_v, s.val[0], c_im);
+    }
+
+    acc_re = acc_re_v[0] + acc_re_v[1] + acc_re_v[2] + acc_re_v[3];
+    acc_im = acc_im_v[0] + acc_im_v[1] + acc_im_v[2] + acc_im_v[3];
+
+    for (size_t i = nr_vec; i < fir->nr_coeffs; i++) {
+        int32_t f_re = 0,
+                f_im = 0;
+
+        cmul_q15_q30(fir->fir_real_coeff[i], fir->fir_imag_coeff[i], samples[2 * i], samples[2 * i + 1],
+                &f_re, &f_im);
+
+        acc_re += f_re;
+        acc_im += f_im;
+    }
+
+    *pacc_re = acc_re;
+    *pacc_im = acc_im;
+}
+
+void direct_fir_dot_block_neon(const struct direct_fir *fir, const int16_t *samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im)
+{
+    int32x4_t a_re[FILTER_BLOCK_OUTPUTS],
+              a_im[FILTER_BLOCK_OUTPUTS];
+    size_t nr_vec = fir->nr_coeffs & ~((size_t)4 - 1);
+
+    for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+        a_re[k] = vdupq_n_s32(0);
+        a_im[k] = vdupq_n_s32(0);
+    }
+
+    for (size_t i = 0; i < nr_vec; i += 4) {
+        int16x4_t c_re = vld1_s16(fir->fir_real_coeff + i),
+                  c_im = vld1_s16(fir->fir_imag_coeff + i);
+
+        for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+            int16x4x2_t s = vld2_s16(&samples[2 * (k * stride + i)]);
+
+            a_re[k] = vmlal_s16(a_re[k], s.val[0], c_re);
+            a_re[k] = vmlsl_s16(a_re[k], s.val[1], c_im);
+            a_im[k] = vmlal_s16(a_im[k], s.val[1], c_re);
+            a_im[k] = vmlal_s16(a_im[k], s.val[0], c_im);
+        }
+    }
+
+    for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+        const int16_t *s = &samples[2 * k * stride];
+        int32_t re = a_re[k][0] + a_re[k][1] + a_re[k][2] + a_re[k][3],
+                im = a_im[k][0] + a_im[k][1] + a_im[k][2] + a_im[k][3];
+
+        for (size_t i = nr_vec; i < fir->nr_coeffs; i++) {
+            int32_t f_re = 0,
+                    f_im = 0;
+
+            cmul_q15_q30(fir->fir_real_coeff[i], fir->fir_imag_coeff[i], s[2 * i], s[2 * i + 1], &f_re, &f_im);
+
+            re += f_re;
+            im += f_im;
+        }
+
+        acc_re[k] = re;
+        acc_im[k] = im;
     }
+}
+#endif /* defined(_USE_ARM_NEON) */
 
+/**
+ * Convert an accumulated output sample back to Q.15. The output is derotated later, a whole
+ * buffer at a time.
+ */
+static inline
+void _direct_fir_emit_sample(int32_t acc_re, int32_t acc_im, int16_t *psample_real, int16_t *psample_imag)
+{
     /* Return the computed sample, in Q.15 (currently in Q.30 due to the prior multiplications) */
     *psample_real = round_q30_q15(acc_re);
     *psample_imag = round_q30_q15(acc_im);
+}
+
+static
+aresult_t _direct_fir_process_sample(struct direct_fir *fir, int16_t *psample_real, int16_t *psample_imag)
+{
+    aresult_t ret = A_OK;
+
+    int32_t acc_re = 0,
+            acc_im = 0;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != fir);
+    TSL_ASSERT_ARG_DEBUG(NULL != psample_real);
+    TSL_ASSERT_ARG_DEBUG(NULL != psample_imag);
+
+    /* Check if we have enough samples available */
+    if (sample_history_avail(&fir->hist) < fir->nr_coeffs) {
+        ret = A_E_DONE;
+        goto done;
+    }
+
+    if (0 != fir->u8_zero) {
+        filter_kernels->direct_fir_dot_u8(fir, sample_history_head(&fir->hist), &acc_re, &acc_im);
+    } else {
+        filter_kernels->direct_fir_dot(fir, sample_history_head(&fir->hist), &acc_re, &acc_im);
+    }
+
+    sample_history_advance(&fir->hist, fir->decimate_factor);
+
+    _direct_fir_emit_sample(acc_re, acc_im, psample_real, psample_imag);
 
 done:
     return ret;
 }
-#else /* no FIR implementation defined */
-#error No FIR implementation has been defined.
-#endif /* _NEON_FIR_IMPLEMENTATION */
 
 aresult_t direct_fir_process(struct direct_fir *fir, int16_t *out_buf, size_t nr_out_samples,
         size_t *nr_out_samples_generated)
 {
     aresult_t ret = A_OK;
 
+    size_t nr_out = 0,
+           block_span = 0;
+
     TSL_ASSERT_ARG(NULL != fir);
     TSL_ASSERT_ARG(NULL != out_buf);
     TSL_ASSERT_ARG(0 != nr_out_samples);
     TSL_ASSERT_ARG(NULL != nr_out_samples_generated);
 
-    TSL_BUG_ON(NULL == fir->fir_real_coeff);
-    TSL_BUG_ON(NULL == fir->fir_imag_coeff);
     TSL_BUG_ON(0 == fir->nr_coeffs);
 
     *nr_out_samples_generated = 0;
 
-    if (NULL == fir->sb_active && NULL == fir->sb_next) {
+    if (DIRECT_FIR_STRATEGY_FFT == fir->strategy) {
+        ret = fast_conv_process(fir->fast_conv, out_buf, nr_out_samples, nr_out_samples_generated);
         goto done;
     }
 
-    for (size_t i = 0; i < nr_out_samples; i++) {
-        if (A_E_DONE == _direct_fir_process_sample(fir, &out_buf[2 * i], &out_buf[2 * i + 1])) {
-            *nr_out_samples_generated = i;
-            goto done;
+    TSL_BUG_ON(NULL == fir->fir_real_coeff);
+
+    if (DIRECT_FIR_STRATEGY_MIX == fir->strategy) {
+        *nr_out_samples_generated = _direct_fir_mix_process(fir, out_buf, nr_out_samples);
+        goto done;
+    }
+
+    TSL_BUG_ON(NULL == fir->fir_imag_coeff);
+
+    /* Compute whole blocks of outputs while there are enough samples for all of them */
+    block_span = fir->nr_coeffs + (FILTER_BLOCK_OUTPUTS - 1) * fir->decimate_factor;
+
+    while (nr_out + FILTER_BLOCK_OUTPUTS <= nr_out_samples && sample_history_avail(&fir->hist) >= block_span) {
+        int32_t acc_re[FILTER_BLOCK_OUTPUTS],
+                acc_im[FILTER_BLOCK_OUTPUTS];
+
+        if (0 != fir->u8_zero) {
+            fir->dot_block_u8(fir, sample_history_head(&fir->hist), fir->decimate_factor, acc_re, acc_im);
+        } else {
+            fir->dot_block(fir, sample_history_head(&fir->hist), fir->decimate_factor, acc_re, acc_im);
+        }
+        sample_history_advance(&fir->hist, FILTER_BLOCK_OUTPUTS * fir->decimate_factor);
+
+        for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+            _direct_fir_emit_sample(acc_re[k], acc_im[k], &out_buf[2 * nr_out], &out_buf[2 * nr_out + 1]);
+            nr_out++;
         }
     }
 
-    *nr_out_samples_generated = nr_out_samples;
+    while (nr_out < nr_out_samples && A_E_DONE != _direct_fir_process_sample(fir, &out_buf[2 * nr_out],
+                &out_buf[2 * nr_out + 1]))
+    {
+        nr_out++;
+    }
+
+    /* Apply a phase rotation, if appropriate */
+    if (0 != fir->rot_nco.phase_incr) {
+        nco_rotate(&fir->rot_nco, out_buf, nr_out);
+    }
+
+    *nr_out_samples_generated = nr_out;
 
 done:
     return ret;
@@ -456,18 +895,28 @@ aresult_t direct_fir_can_process(struct direct_fir *fir, bool *pcan_process, siz
 {
     aresult_t ret = A_OK;
 
+    size_t nr_avail = 0;
+
     TSL_ASSERT_ARG(NULL != fir);
     TSL_ASSERT_ARG(NULL != pcan_process);
 
+    if (DIRECT_FIR_STRATEGY_FFT == fir->strategy) {
+        ret = fast_conv_can_process(fir->fast_conv, pcan_process, pest_count);
+        goto done;
+    }
+
     /* The trick for this is to see if there are at least enough samples to run a single pass of the
      * FIR.
      */
-    *pcan_process = fir->nr_samples >= fir->nr_coeffs;
+    nr_avail = sample_history_avail(&fir->hist);
+
+    *pcan_process = nr_avail >= fir->nr_coeffs;
 
     if (NULL != pest_count) {
-        *pest_count = fir->nr_samples/fir->nr_coeffs;
+        *pest_count = nr_avail/fir->nr_coeffs;
     }
 
+done:
     return ret;
 }
 
@@ -478,8 +927,13 @@ aresult_t direct_fir_full(struct direct_fir *fir, bool *pfull)
     TSL_ASSERT_ARG_DEBUG(NULL != fir);
     TSL_ASSERT_ARG_DEBUG(NULL != pfull);
 
-    *pfull = (NULL != fir->sb_next);
+    if (DIRECT_FIR_STRATEGY_FFT == fir->strategy) {
+        ret = fast_conv_full(fir->fast_conv, pfull);
+        goto done;
+    }
+
+    *pfull = 0 != fir->max_push && sample_history_avail(&fir->hist) >= fir->nr_coeffs + fir->max_push;
 
+done:
     return ret;
 }
-
@@ -1,12 +1,54 @@
 #pragma once
 
+#include <filter/sample_history.h>
+#include <filter/fir_fold.h>
+#include <filter/nco.h>
+
 #include <tsl/result.h>
 
 #include <stdbool.h>
 
 struct sample_buf;
+struct decimation_chain;
+struct fast_conv;
+
+/**
+ * How a direct FIR brings the channel of interest down to baseband.
+ */
+enum direct_fir_strategy {
+    /**
+     * Pick whichever of the strategies below is cheaper. Only valid when requesting a strategy,
+     * see `direct_fir_choose_strategy`.
+     */
+    DIRECT_FIR_STRATEGY_AUTO = -1,
+
+    /**
+     * Apply complex (band-pass) coefficients to the input samples, then derotate the
+     * decimated output. Costs 4 multiplies per tap per output sample.
+     */
+    DIRECT_FIR_STRATEGY_COMPLEX = 0,
+
+    /**
+     * Mix every input sample down to baseband with an NCO, then apply the real low-pass
+     * coefficients. Costs 2 multiplies per tap per output sample, plus 4 multiplies per
+     * input sample for the mixer.
+     */
+    DIRECT_FIR_STRATEGY_MIX = 1,
+
+    /**
+     * Filter, decimate and shift in the frequency domain with overlap-save fast convolution.
+     * The cost grows with the log of the number of taps, so this wins for long filters. See
+     * `struct fast_conv`.
+     */
+    DIRECT_FIR_STRATEGY_FFT = 2,
+};
 
 struct direct_fir {
+    /**
+     * The strategy this FIR uses to filter
+     */
+    enum direct_fir_strategy strategy;
+
     /**
      * Real coefficients. Must be aligned to int32_t's natural alignment.
      */
@@ -17,6 +59,35 @@ struct direct_fir {
      */
     int16_t *fir_imag_coeff;
 
+    /**
+     * The coefficients interleaved for a pairwise multiply-accumulate over interleaved I/Q
+     * samples: [c_re, -c_im] gives the real part of the product, [c_im, c_re] the imaginary
+     * part. NULL if the FIR doesn't use complex coefficients, or if a coefficient can't be
+     * negated in Q.15.
+     */
+    int16_t *mac_coeff_re;
+    int16_t *mac_coeff_im;
+
+    /**
+     * Computes FILTER_BLOCK_OUTPUTS outputs at a time: a kernel built for exactly this number of
+     * coefficients and decimation if there is one (see `FILTER_FIXED_DIRECT_FIR`), otherwise the
+     * generic kernel.
+     */
+    void (*dot_block)(const struct direct_fir *fir, const int16_t *samples, size_t stride, int32_t *acc_re,
+            int32_t *acc_im);
+
+    /**
+     * The same as dot_block, for a history of raw 8-bit samples
+     */
+    void (*dot_block_u8)(const struct direct_fir *fir, const uint8_t *samples, size_t stride, int32_t *acc_re,
+            int32_t *acc_im);
+
+    /**
+     * The real coefficients folded in half, if they are symmetric. Only used by
+     * DIRECT_FIR_STRATEGY_MIX.
+     */
+    struct fir_fold fold;
+
     /**
      * The number of coefficients in this FIR
      */
@@ -28,49 +99,52 @@ struct direct_fir {
     unsigned decimate_factor;
 
     /**
-     * The offset of the next sample to be processed, in sb_active
+     * The samples waiting to be filtered, including the overlap from earlier sample buffers.
+     * For DIRECT_FIR_STRATEGY_MIX, these have already been mixed down to baseband.
      */
-    unsigned sample_offset;
+    struct sample_history hist;
 
     /**
-     * The total, pre-decimation number of samples available in the input buffer.
+     * The largest number of samples added to the history by a single push
      */
-    size_t nr_samples;
+    size_t max_push;
 
     /**
-     * Active sample buffer being processed
+     * If the history holds raw 8-bit samples rather than Q.15 samples, the unsigned value that
+     * represents zero. 0 otherwise. See `direct_fir_push_sample_buf`.
      */
-    struct sample_buf *sb_active;
+    unsigned u8_zero;
 
     /**
-     * Next sample buffer to be processed, if it's available
+     * What the accumulators start from when filtering 8-bit samples: -u8_zero times the sum of
+     * the real and imaginary multiply-accumulate coefficients. Starting from here takes the DC
+     * offset of the unsigned samples back out of the sums.
      */
-    struct sample_buf *sb_next;
+    uint32_t u8_bias_re;
+    uint32_t u8_bias_im;
 
     /**
-     * The real part of the Q.15 rotation phase increment
+     * The NCO that derotates each output sample, stepped once per output. Its phase increment
+     * is 0 if the FIR doesn't derotate.
      */
-    int16_t rot_phase_incr_re;
+    struct nco rot_nco;
 
     /**
-     * The imaginary part of the Q.15 rotaiton phase increment
+     * The NCO that mixes each input sample down to baseband. Only used by
+     * DIRECT_FIR_STRATEGY_MIX.
      */
-    int16_t rot_phase_incr_im;
+    struct nco mix_nco;
 
     /**
-     * The real part of the Q.15 rotation factor to be applied to each sample
+     * Optional decimation chain applied to the mixed samples before they are filtered. Owned
+     * by the FIR. Only used by DIRECT_FIR_STRATEGY_MIX.
      */
-    int16_t rot_phase_re;
+    struct decimation_chain *front_end;
 
     /**
-     * The imaginary part of the Q.15 rotation factor to be applied to each sample
+     * The fast convolution engine that does all of the work for DIRECT_FIR_STRATEGY_FFT
      */
-    int16_t rot_phase_im;
-
-    /**
-     * The rotation counter.
-     */
-    unsigned rot_counter;
+    struct fast_conv *fast_conv;
 };
 
 /**
@@ -94,6 +168,75 @@ aresult_t direct_fir_init(struct direct_fir *fir, size_t nr_coeffs, const int16_
         const int16_t *fir_imag_coeff, unsigned decimation_factor,
         bool derotate, uint32_t sampling_rate, int32_t freq_shift);
 
+/**
+ * Create a direct FIR that first mixes its input down to baseband, then applies real Q.15
+ * low-pass coefficients (DIRECT_FIR_STRATEGY_MIX). This function allocates memory.
+ *
+ * Sample buffers pushed into a mixing FIR are consumed immediately: the samples are mixed into
+ * a private buffer, and the sample buffer is released.
+ *
+ * Symmetric and antisymmetric coefficients are detected and folded (see `struct fir_fold`), which
+ * halves the multiplies per output sample.
+ *
+ * \param fir The FIR object. Pass a chunk of memory by reference.
+ * \param nr_coeffs The number of coefficients in the FIR
+ * \param fir_coeff The real low-pass coefficients for the FIR
+ * \param decimation_factor The decimation factor to apply
+ * \param sampling_rate The sampling rate of the input samples
+ * \param freq_shift The offset of the signal to be moved to baseband, in Hz
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t direct_fir_init_mix(struct direct_fir *fir, size_t nr_coeffs, const int16_t *fir_coeff,
+        unsigned decimation_factor, uint32_t sampling_rate, int32_t freq_shift);
+
+/**
+ * Create a FIR that does the same job as `direct_fir_init` with derotation, but with overlap-save
+ * fast convolution (DIRECT_FIR_STRATEGY_FFT). Output samples are produced a block at a time, so
+ * there is more latency than with a direct FIR. This function allocates memory.
+ *
+ * \param fir The FIR object. Pass a chunk of memory by reference.
+ * \param nr_coeffs The number of coefficients in the FIR
+ * \param fir_real_coeff The real coefficients for the FIR
+ * \param fir_imag_coeff The imaginary coefficients for the FIR
+ * \param decimation_factor The decimation factor to apply
+ * \param sampling_rate The sampling rate of the input samples
+ * \param freq_shift The offset of the signal to be moved to baseband, in Hz
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t direct_fir_init_fft(struct direct_fir *fir, size_t nr_coeffs, const int16_t *fir_real_coeff,
+        const int16_t *fir_imag_coeff, unsigned decimation_factor, uint32_t sampling_rate, int32_t freq_shift);
+
+/**
+ * Attach a decimation chain to a mixing FIR. Mixed samples are decimated by the chain before
+ * the FIR coefficients are applied, so the FIR's own decimation factor and coefficients must be
+ * for the chain's output rate. Must be called before the first sample buffer is pushed.
+ *
+ * \param fir The FIR, initialized with `direct_fir_init_mix`
+ * \param chain The decimation chain. The FIR takes ownership of the chain.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t direct_fir_set_front_end(struct direct_fir *fir, struct decimation_chain *chain);
+
+/**
+ * Estimate the number of multiplies needed to compute one output sample with the given
+ * strategy.
+ *
+ * \param strategy The filter strategy
+ * \param nr_coeffs The number of FIR coefficients
+ * \param decimation_factor The decimation factor
+ *
+ * \return The number of multiplies per output sample
+ */
+size_t direct_fir_cost(enum direct_fir_strategy strategy, size_t nr_coeffs, unsigned decimation_factor);
+
+/**
+ * Pick the cheaper strategy for the given filter length and decimation, per `direct_fir_cost`.
+ */
+enum direct_fir_strategy direct_fir_choose_strategy(size_t nr_coeffs, unsigned decimation_factor);
+
 /**
  * Cleanup memory and release sample buffers for the FIR
  *
@@ -104,7 +247,15 @@ aresult_t direct_fir_init(struct direct_fir *fir, size_t nr_coeffs, const int16_
 aresult_t direct_fir_cleanup(struct direct_fir *fir);
 
 /**
- * Push an updated sample buffer.
+ * Push an updated sample buffer. The samples are copied into the FIR's history and the sample
+ * buffer is released, so any number of sample buffers can be pushed before processing.
+ *
+ * COMPLEX_UINT_8 and COMPLEX_INT_8 samples are kept as 8-bit samples by a complex FIR, and
+ * filtered as they are, without ever being widened to Q.15 (signed samples are offset by 128
+ * on the way in, so the kernels only ever see unsigned samples). The output is exactly what
+ * the same samples, widened to Q.15, would have given. The first sample buffer pushed decides
+ * how samples are kept: after an 8-bit buffer, every buffer must be of the same type. The other
+ * strategies widen 8-bit samples as they consume them.
  *
  * \param fir The direct FIR to process
  * \param buf The buffer to push onto the queue
@@ -129,11 +280,12 @@ aresult_t direct_fir_process(struct direct_fir *fir, int16_t *out_buf, size_t nr
         size_t *nr_output_samples_generated);
 
 /**
- * Determine whether or not an additional sample buffer can be passed to the FIR, for further
- * processing.
+ * Determine whether or not the FIR already has a full sample buffer's worth of samples waiting,
+ * beyond the filter overlap. Pushing more is always possible, but callers that want to bound
+ * how far behind the FIR gets can use this as backpressure.
  *
  * \param fir The FIR in question
- * \param pfull Whether or not the FIR has space for an extra sample buffer, returned by reference.
+ * \param pfull Whether or not the FIR has a backlog, returned by reference.
  *
  * \return A_OK on success, an error code otherwise.
  */
@@ -0,0 +1,470 @@
+/*
+ *  direct_fir_batch.c - Many direct FIRs with arbitrary complex coefficients, sharing
+ *      a single input stream
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/filter.h>
+#include <filter/direct_fir_batch.h>
+#include <filter/kernels.h>
+#include <filter/kernels_priv.h>
+#include <filter/sample_buf.h>
+#include <filter/complex.h>
+
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+#include <tsl/safe_alloc.h>
+
+#include <string.h>
+
+#if defined(_USE_ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+aresult_t direct_fir_batch_init(struct direct_fir_batch *fir, size_t nr_channels, size_t nr_coeffs,
+        const int16_t *const *real_coeffs, const int16_t *const *imag_coeffs, unsigned decimation_factor,
+        bool derotate, uint32_t sampling_rate, const int32_t *freq_shifts)
+{
+    aresult_t ret = A_OK;
+
+    size_t nr_lanes = 0;
+
+    TSL_ASSERT_ARG(NULL != fir);
+    TSL_ASSERT_ARG(0 != nr_channels && nr_channels <= DIRECT_FIR_BATCH_MAX_CHANNELS);
+    TSL_ASSERT_ARG(0 != nr_coeffs);
+    TSL_ASSERT_ARG(NULL != real_coeffs);
+    TSL_ASSERT_ARG(NULL != imag_coeffs);
+    TSL_ASSERT_ARG(0 != decimation_factor);
+    TSL_ASSERT_ARG(false == derotate || (NULL != freq_shifts && 0 != sampling_rate));
+
+    memset(fir, 0, sizeof(struct direct_fir_batch));
+
+    if (FAILED(ret = filter_kernels_init())) {
+        goto done;
+    }
+
+    if (FAILED(ret = sample_history_init(&fir->hist, 2 * sizeof(int16_t)))) {
+        goto done;
+    }
+
+    nr_lanes = (nr_channels + DIRECT_FIR_BATCH_LANES - 1) & ~((size_t)DIRECT_FIR_BATCH_LANES - 1);
+
+    DIAG("FIR Batch: %zu channels (%zu lanes), %zu coefficients, decimation by %u, with%s derotation",
+            nr_channels, nr_lanes, nr_coeffs, decimation_factor, true == derotate ? "" : "out");
+
+    /* Interleave the coefficients so each input sample is applied to all channels at once. Padding lanes stay zero. */
+    if (FAILED(ret = TACALLOC((void **)&fir->coeff_re, nr_coeffs * nr_lanes, sizeof(int16_t), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fir->coeff_im, nr_coeffs * nr_lanes, sizeof(int16_t), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    for (size_t k = 0; k < nr_channels; k++) {
+        TSL_ASSERT_ARG(NULL != real_coeffs[k]);
+        TSL_ASSERT_ARG(NULL != imag_coeffs[k]);
+
+        for (size_t i = 0; i < nr_coeffs; i++) {
+            fir->coeff_re[i * nr_lanes + k] = real_coeffs[k][i];
+            fir->coeff_im[i * nr_lanes + k] = imag_coeffs[k][i];
+        }
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fir->acc_re, nr_lanes, sizeof(int32_t), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fir->acc_im, nr_lanes, sizeof(int32_t), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TCALLOC((void **)&fir->rot_nco, nr_channels, sizeof(struct nco)))) {
+        goto done;
+    }
+
+    fir->nr_coeffs = nr_coeffs;
+    fir->nr_channels = nr_channels;
+    fir->nr_lanes = nr_lanes;
+    fir->decimate_factor = decimation_factor;
+
+    for (size_t k = 0; k < nr_channels; k++) {
+        /* Derotate by each channel's shift over a whole decimation's worth of input samples */
+        if (FAILED(ret = nco_init(&fir->rot_nco[k], true == derotate ?
+                    nco_phase_incr(-(double)freq_shifts[k], (double)sampling_rate) * decimation_factor : 0)))
+        {
+            goto done;
+        }
+    }
+
+done:
+    if (FAILED(ret)) {
+        direct_fir_batch_cleanup(fir);
+    }
+
+    return ret;
+}
+
+aresult_t direct_fir_batch_cleanup(struct direct_fir_batch *fir)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != fir);
+
+    if (NULL != fir->coeff_re) {
+        TFREE(fir->coeff_re);
+    }
+
+    if (NULL != fir->coeff_im) {
+        TFREE(fir->coeff_im);
+    }
+
+    if (NULL != fir->acc_re) {
+        TFREE(fir->acc_re);
+    }
+
+    if (NULL != fir->acc_im) {
+        TFREE(fir->acc_im);
+    }
+
+    if (NULL != fir->rot_nco) {
+        TFREE(fir->rot_nco);
+    }
+
+    if (NULL != fir->u8_bias_re) {
+        TFREE(fir->u8_bias_re);
+    }
+
+    if (NULL != fir->u8_bias_im) {
+        TFREE(fir->u8_bias_im);
+    }
+
+    TSL_BUG_IF_FAILED(sample_history_cleanup(&fir->hist));
+
+    fir->decimate_factor = 0;
+
+    return ret;
+}
+
+/**
+ * Switch the history over to 8-bit samples, with zero at the given value, and work out each
+ * lane's bias.
+ */
+static
+aresult_t _direct_fir_batch_use_u8(struct direct_fir_batch *fir, unsigned zero)
+{
+    aresult_t ret = A_OK;
+
+    TSL_BUG_IF_FAILED(sample_history_cleanup(&fir->hist));
+
+    if (FAILED(ret = sample_history_init(&fir->hist, 2 * sizeof(uint8_t)))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fir->u8_bias_re, fir->nr_lanes, sizeof(uint32_t), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fir->u8_bias_im, fir->nr_lanes, sizeof(uint32_t), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    for (size_t k = 0; k < fir->nr_lanes; k++) {
+        uint32_t sum_re = 0,
+                 sum_im = 0;
+
+        for (size_t i = 0; i < fir->nr_coeffs; i++) {
+            uint32_t c_re = (uint32_t)(int32_t)fir->coeff_re[i * fir->nr_lanes + k],
+                     c_im = (uint32_t)(int32_t)fir->coeff_im[i * fir->nr_lanes + k];
+
+            sum_re += c_re - c_im;
+            sum_im += c_re + c_im;
+        }
+
+        fir->u8_bias_re[k] = 0u - zero * sum_re;
+        fir->u8_bias_im[k] = 0u - zero * sum_im;
+    }
+
+    fir->u8_zero = zero;
+
+    DIAG("FIR Batch: filtering 8-bit samples directly, zero at %u", zero);
+
+done:
+    return ret;
+}
+
+aresult_t direct_fir_batch_push_sample_buf(struct direct_fir_batch *fir, struct sample_buf *buf)
+{
+    aresult_t ret = A_OK;
+
+    unsigned zero = 0;
+    uint8_t *dest = NULL;
+
+    TSL_ASSERT_ARG(NULL != fir);
+    TSL_ASSERT_ARG(NULL != buf);
+
+    if (sample_type_is_8bit(buf->sample_type)) {
+        zero = COMPLEX_UINT_8 == buf->sample_type ? SAMPLE_UINT_8_ZERO : 128;
+    }
+
+    /* 8-bit samples are kept as they are, if they are the first to arrive */
+    if (0 != zero && 0 == fir->u8_zero && NULL == fir->hist.samples) {
+        if (FAILED(ret = _direct_fir_batch_use_u8(fir, zero))) {
+            goto done;
+        }
+    }
+
+    if (0 == fir->u8_zero) {
+        if (FAILED(ret = sample_history_append_q15(&fir->hist, buf))) {
+            goto done;
+        }
+    } else {
+        if (zero != fir->u8_zero) {
+            DIAG("FIR Batch: can't mix sample types once 8-bit samples have been pushed (got type %d)",
+                    buf->sample_type);
+            ret = A_E_INVAL;
+            goto done;
+        }
+
+        if (FAILED(ret = sample_history_reserve(&fir->hist, buf->nr_samples, (void **)&dest))) {
+            goto done;
+        }
+
+        /* Signed samples are offset into unsigned ones, so the kernels only handle one kind */
+        if (COMPLEX_UINT_8 == buf->sample_type) {
+            memcpy(dest, buf->data_buf, 2 * buf->nr_samples);
+        } else {
+            for (size_t i = 0; i < 2 * buf->nr_samples; i++) {
+                dest[i] = buf->data_buf[i] ^ 0x80;
+            }
+        }
+
+        sample_history_commit(&fir->hist, buf->nr_samples);
+    }
+
+    TSL_BUG_IF_FAILED(sample_buf_decref(buf));
+
+done:
+    return ret;
+}
+
+/**
+ * Accumulate a single input sample into every lane, i.e.
+ *   acc_re[k] += c_re[k] * s_re - c_im[k] * s_im
+ *   acc_im[k] += c_re[k] * s_im + c_im[k] * s_re
+ * The sums are done unsigned, since the 8-bit sums can wrap before their bias is taken out.
+ */
+FILTER_ALWAYS_INLINE
+void _direct_fir_batch_mac(uint32_t *restrict acc_re, uint32_t *restrict acc_im, const int16_t *restrict c_re,
+        const int16_t *restrict c_im, int16_t s_re, int16_t s_im, size_t nr_lanes)
+{
+    /* Written so the compiler can map each group of lanes to a single vector */
+    for (size_t l = 0; l < nr_lanes; l += DIRECT_FIR_BATCH_LANES) {
+        for (size_t j = 0; j < DIRECT_FIR_BATCH_LANES; j++) {
+            acc_re[l + j] += (uint32_t)((int32_t)c_re[l + j] * s_re - (int32_t)c_im[l + j] * s_im);
+            acc_im[l + j] += (uint32_t)((int32_t)c_re[l + j] * s_im + (int32_t)c_im[l + j] * s_re);
+        }
+    }
+}
+
+FILTER_ALWAYS_INLINE
+void _direct_fir_batch_dot_body(const struct direct_fir_batch *fir, const int16_t *samples)
+{
+    size_t nr_lanes = fir->nr_lanes;
+    const int16_t *c_re = fir->coeff_re,
+                  *c_im = fir->coeff_im;
+
+    memset(fir->acc_re, 0, nr_lanes * sizeof(int32_t));
+    memset(fir->acc_im, 0, nr_lanes * sizeof(int32_t));
+
+    for (size_t i = 0; i < fir->nr_coeffs; i++) {
+        _direct_fir_batch_mac((uint32_t *)fir->acc_re, (uint32_t *)fir->acc_im, c_re, c_im, samples[2 * i],
+                samples[2 * i + 1], nr_lanes);
+        c_re += nr_lanes;
+        c_im += nr_lanes;
+    }
+}
+
+void direct_fir_batch_dot_scalar(const struct direct_fir_batch *fir, const int16_t *samples)
+{
+    _direct_fir_batch_dot_body(fir, samples);
+}
+
+/**
+ * The same, over raw 8-bit samples. The accumulators start from the bias, and are scaled up to
+ * Q.30 at the end.
+ */
+FILTER_ALWAYS_INLINE
+void _direct_fir_batch_dot_u8_body(const struct direct_fir_batch *fir, const uint8_t *samples)
+{
+    size_t nr_lanes = fir->nr_lanes;
+    const int16_t *c_re = fir->coeff_re,
+                  *c_im = fir->coeff_im;
+
+    memcpy(fir->acc_re, fir->u8_bias_re, nr_lanes * sizeof(uint32_t));
+    memcpy(fir->acc_im, fir->u8_bias_im, nr_lanes * sizeof(uint32_t));
+
+    for (size_t i = 0; i < fir->nr_coeffs; i++) {
+        _direct_fir_batch_mac((uint32_t *)fir->acc_re, (uint32_t *)fir->acc_im, c_re, c_im, samples[2 * i],
+                samples[2 * i + 1], nr_lanes);
+        c_re += nr_lanes;
+        c_im += nr_lanes;
+    }
+
+    for (size_t l = 0; l < nr_lanes; l++) {
+        fir->acc_re[l] = filter_u8_sum_to_q30((uint32_t)fir->acc_re[l]);
+        fir->acc_im[l] = filter_u8_sum_to_q30((uint32_t)fir->acc_im[l]);
+    }
+}
+
+void direct_fir_batch_dot_u8_scalar(const struct direct_fir_batch *fir, const uint8_t *samples)
+{
+    _direct_fir_batch_dot_u8_body(fir, samples);
+}
+
+#ifdef _FILTER_HAVE_X86_KERNELS
+FILTER_DEFINE_X86_VARIANTS(direct_fir_batch_dot,
+        (const struct direct_fir_batch *fir, const int16_t *samples),
+        (fir, samples))
+FILTER_DEFINE_X86_VARIANTS(direct_fir_batch_dot_u8,
+        (const struct direct_fir_batch *fir, const uint8_t *samples),
+        (fir, samples))
+#endif /* defined(_FILTER_HAVE_X86_KERNELS) */
+
+#if defined(_USE_ARM_NEON)
+static inline
+void _direct_fir_batch_mac_neon(int32_t *acc_re, int32_t *acc_im, const int16_t *c_re, const int16_t *c_im,
+        int16_t s_re, int16_t s_im, size_t nr_lanes)
+{
+    for (size_t l = 0; l < nr_lanes; l += DIRECT_FIR_BATCH_LANES) {
+        int32x4_t a_re = vld1q_s32(acc_re + l),
+                  a_im = vld1q_s32(acc_im + l);
+        int16x4_t v_c_re = vld1_s16(c_re + l),
+                  v_c_im = vld1_s16(c_im + l);
+
+        a_re = vmlal_n_s16(a_re, v_c_re, s_re);
+        a_re = vmlsl_n_s16(a_re, v_c_im, s_im);
+        a_im = vmlal_n_s16(a_im, v_c_re, s_im);
+        a_im = vmlal_n_s16(a_im, v_c_im, s_re);
+
+        vst1q_s32(acc_re + l, a_re);
+        vst1q_s32(acc_im + l, a_im);
+    }
+}
+
+void direct_fir_batch_dot_neon(const struct direct_fir_batch *fir, const int16_t *samples)
+{
+    size_t nr_lanes = fir->nr_lanes;
+    const int16_t *c_re = fir->coeff_re,
+                  *c_im = fir->coeff_im;
+
+    memset(fir->acc_re, 0, nr_lanes * sizeof(int32_t));
+    memset(fir->acc_im, 0, nr_lanes * sizeof(int32_t));
+
+    for (size_t i = 0; i < fir->nr_coeffs; i++) {
+        _direct_fir_batch_mac_neon(fir->acc_re, fir->acc_im, c_re, c_im, samples[2 * i], samples[2 * i + 1], nr_lanes);
+        c_re += nr_lanes;
+        c_im += nr_lanes;
+    }
+}
+#endif /* defined(_USE_ARM_NEON) */
+
+/**
+ * Compute one output sample for every channel.
+ */
+static
+aresult_t _direct_fir_batch_process_sample(struct direct_fir_batch *fir, int16_t *const *out_bufs, size_t out_idx)
+{
+    aresult_t ret = A_OK;
+
+    if (sample_history_avail(&fir->hist) < fir->nr_coeffs) {
+        ret = A_E_DONE;
+        goto done;
+    }
+
+    if (0 != fir->u8_zero) {
+        filter_kernels->direct_fir_batch_dot_u8(fir, sample_history_head(&fir->hist));
+    } else {
+        filter_kernels->direct_fir_batch_dot(fir, sample_history_head(&fir->hist));
+    }
+
+    sample_history_advance(&fir->hist, fir->decimate_factor);
+
+    for (size_t k = 0; k < fir->nr_channels; k++) {
+        out_bufs[k][2 * out_idx    ] = round_q30_q15(fir->acc_re[k]);
+        out_bufs[k][2 * out_idx + 1] = round_q30_q15(fir->acc_im[k]);
+    }
+
+done:
+    return ret;
+}
+
+aresult_t direct_fir_batch_process(struct direct_fir_batch *fir, int16_t *const *out_bufs, size_t nr_out_samples,
+        size_t *pnr_out_samples_generated)
+{
+    aresult_t ret = A_OK;
+
+    size_t nr_out = 0;
+
+    TSL_ASSERT_ARG(NULL != fir);
+    TSL_ASSERT_ARG(NULL != out_bufs);
+    TSL_ASSERT_ARG(0 != nr_out_samples);
+    TSL_ASSERT_ARG(NULL != pnr_out_samples_generated);
+
+    TSL_BUG_ON(NULL == fir->coeff_re);
+    TSL_BUG_ON(NULL == fir->coeff_im);
+
+    while (nr_out < nr_out_samples && A_E_DONE != _direct_fir_batch_process_sample(fir, out_bufs, nr_out)) {
+        nr_out++;
+    }
+
+    /* Derotate each channel's outputs in one pass, if appropriate */
+    for (size_t k = 0; k < fir->nr_channels; k++) {
+        if (0 != fir->rot_nco[k].phase_incr) {
+            nco_rotate(&fir->rot_nco[k], out_bufs[k], nr_out);
+        }
+    }
+
+    *pnr_out_samples_generated = nr_out;
+
+    return ret;
+}
+
+aresult_t direct_fir_batch_can_process(struct direct_fir_batch *fir, bool *pcan_process, size_t *pest_count)
+{
+    aresult_t ret = A_OK;
+
+    size_t nr_avail = 0;
+
+    TSL_ASSERT_ARG(NULL != fir);
+    TSL_ASSERT_ARG(NULL != pcan_process);
+
+    nr_avail = sample_history_avail(&fir->hist);
+
+    *pcan_process = nr_avail >= fir->nr_coeffs;
+
+    if (NULL != pest_count) {
+        *pest_count = nr_avail >= fir->nr_coeffs ? (nr_avail - fir->nr_coeffs)/fir->decimate_factor + 1 : 0;
+    }
+
+    return ret;
+}
+
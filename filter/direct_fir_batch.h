@@ -0,0 +1,159 @@
+#pragma once
+
+#include <filter/nco.h>
+#include <filter/sample_history.h>
+
+#include <tsl/result.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+struct sample_buf;
+
+/**
+ * The number of channels computed per SIMD vector. Channel counts are padded up to a multiple
+ * of this.
+ */
+#define DIRECT_FIR_BATCH_LANES              4
+
+/**
+ * The maximum number of channels a single batched FIR can compute.
+ */
+#define DIRECT_FIR_BATCH_MAX_CHANNELS       32
+
+/**
+ * A batch of direct-form complex FIRs that share an input stream, a filter length and a
+ * decimation factor. Each input sample is loaded once and applied to every channel's
+ * coefficients, rather than once per channel.
+ */
+struct direct_fir_batch {
+    /**
+     * Real coefficients, interleaved by channel: coefficient i of channel k is at
+     * [i * nr_lanes + k].
+     */
+    int16_t *coeff_re;
+
+    /**
+     * Imaginary coefficients, interleaved the same way as coeff_re.
+     */
+    int16_t *coeff_im;
+
+    /**
+     * The number of coefficients in each FIR
+     */
+    size_t nr_coeffs;
+
+    /**
+     * The number of channels being computed
+     */
+    size_t nr_channels;
+
+    /**
+     * The number of channels, padded up to a multiple of DIRECT_FIR_BATCH_LANES
+     */
+    size_t nr_lanes;
+
+    /**
+     * Decimation factor. Determines how we walk through the sample buffer.
+     */
+    unsigned decimate_factor;
+
+    /**
+     * The samples waiting to be filtered, including the overlap from earlier sample buffers
+     */
+    struct sample_history hist;
+
+    /**
+     * Per-channel derotation NCOs, stepped once per output. The phase increment is zero if the
+     * channel is not derotated.
+     */
+    struct nco *rot_nco;
+
+    /**
+     * Accumulators, one per lane
+     */
+    int32_t *acc_re;
+    int32_t *acc_im;
+
+    /**
+     * If the history holds raw 8-bit samples rather than Q.15 samples, the unsigned value that
+     * represents zero. 0 otherwise. See `direct_fir_push_sample_buf`, which works the same way.
+     */
+    unsigned u8_zero;
+
+    /**
+     * What each lane's accumulators start from when filtering 8-bit samples, which takes the DC
+     * offset of the unsigned samples back out of the sums. Only allocated once 8-bit samples
+     * have been pushed.
+     */
+    uint32_t *u8_bias_re;
+    uint32_t *u8_bias_im;
+};
+
+/**
+ * Create a batch of direct coefficient FIRs, in Q.15. This function allocates memory.
+ *
+ * \param fir The batched FIR object. Pass a chunk of memory by reference.
+ * \param nr_channels The number of channels to compute
+ * \param nr_coeffs The number of coefficients in each channel's FIR
+ * \param real_coeffs Array of nr_channels pointers to each channel's real coefficients
+ * \param imag_coeffs Array of nr_channels pointers to each channel's imaginary coefficients
+ * \param decimation_factor The decimation factor to apply
+ * \param derotate Set to `true` to apply a per-channel derotator
+ * \param sampling_rate The sampling rate. Ignored if not derotating.
+ * \param freq_shifts Array of nr_channels frequency shifts, in Hz. Ignored if not derotating.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t direct_fir_batch_init(struct direct_fir_batch *fir, size_t nr_channels, size_t nr_coeffs,
+        const int16_t *const *real_coeffs, const int16_t *const *imag_coeffs, unsigned decimation_factor,
+        bool derotate, uint32_t sampling_rate, const int32_t *freq_shifts);
+
+/**
+ * Cleanup memory and release sample buffers for the batched FIR
+ *
+ * \param fir The batched FIR to cleanup.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t direct_fir_batch_cleanup(struct direct_fir_batch *fir);
+
+/**
+ * Push an updated sample buffer. The samples are copied into the FIR's history and the sample
+ * buffer is released, so any number of sample buffers can be pushed before processing.
+ *
+ * 8-bit samples are filtered as they are, as with `direct_fir_push_sample_buf`.
+ *
+ * \param fir The batched FIR
+ * \param buf The buffer to push onto the queue
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t direct_fir_batch_push_sample_buf(struct direct_fir_batch *fir, struct sample_buf *buf);
+
+/**
+ * Apply the FIRs to as many samples as possible, constrained by the number of input samples
+ * available and the size of the output buffers. Every channel produces the same number of
+ * output samples.
+ *
+ * \param fir The batched FIR to apply
+ * \param out_bufs Array of nr_channels output buffers, one per channel
+ * \param nr_out_samples The maximum number of samples each output buffer can hold
+ * \param pnr_out_samples_generated The number of samples written to each output buffer
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t direct_fir_batch_process(struct direct_fir_batch *fir, int16_t *const *out_bufs, size_t nr_out_samples,
+        size_t *pnr_out_samples_generated);
+
+/**
+ * Determine whether or not there are enough samples available to produce at least one filtered,
+ * decimated sample.
+ *
+ * \param fir The batched FIR in question
+ * \param pcan_process Whether or not at least one output sample can be produced
+ * \param pest_count The estimated count of samples that could be produced.
+ */
+aresult_t direct_fir_batch_can_process(struct direct_fir_batch *fir, bool *pcan_process, size_t *pest_count);
+
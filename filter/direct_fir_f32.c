@@ -0,0 +1,351 @@
+/*
+ *  direct_fir_f32.c - Direct-form FIR with complex coefficients, over float samples
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/filter.h>
+#include <filter/direct_fir_f32.h>
+#include <filter/kernels.h>
+#include <filter/kernels_priv.h>
+#include <filter/sample_buf.h>
+
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+#include <tsl/safe_alloc.h>
+
+#include <string.h>
+
+aresult_t direct_fir_f32_init(struct direct_fir_f32 *fir, size_t nr_coeffs, const float *real_coeff,
+        const float *imag_coeff, unsigned decimation_factor, bool derotate, uint32_t sampling_rate,
+        int32_t freq_shift)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != fir);
+    TSL_ASSERT_ARG(0 != nr_coeffs);
+    TSL_ASSERT_ARG(NULL != real_coeff);
+    TSL_ASSERT_ARG(NULL != imag_coeff);
+    TSL_ASSERT_ARG(0 != decimation_factor);
+
+    DIAG("FIR: Preparing %zu float coefficients, decimation by %u, with%s derotation, sampling rate = %u frequency_shift = %d",
+            nr_coeffs, decimation_factor, true == derotate ? "" : "out", sampling_rate, freq_shift);
+
+    memset(fir, 0, sizeof(struct direct_fir_f32));
+
+    if (FAILED(ret = filter_kernels_init())) {
+        goto done;
+    }
+
+    if (FAILED(ret = sample_history_init(&fir->hist, 2 * sizeof(float)))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fir->coeff_re, nr_coeffs, sizeof(float), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fir->coeff_im, nr_coeffs, sizeof(float), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    memcpy(fir->coeff_re, real_coeff, nr_coeffs * sizeof(float));
+    memcpy(fir->coeff_im, imag_coeff, nr_coeffs * sizeof(float));
+
+    /* Derotate by the shift over a whole decimation's worth of input samples, exactly */
+    if (FAILED(ret = nco_init(&fir->rot_nco, true == derotate ?
+                    nco_phase_incr(-(double)freq_shift, (double)sampling_rate) * decimation_factor : 0)))
+    {
+        goto done;
+    }
+
+    fir->nr_coeffs = nr_coeffs;
+    fir->decimate_factor = decimation_factor;
+
+done:
+    if (FAILED(ret)) {
+        direct_fir_f32_cleanup(fir);
+    }
+
+    return ret;
+}
+
+aresult_t direct_fir_f32_cleanup(struct direct_fir_f32 *fir)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != fir);
+
+    if (NULL != fir->coeff_re) {
+        TFREE(fir->coeff_re);
+    }
+
+    if (NULL != fir->coeff_im) {
+        TFREE(fir->coeff_im);
+    }
+
+    TSL_BUG_IF_FAILED(sample_history_cleanup(&fir->hist));
+
+    fir->nr_coeffs = 0;
+
+    return ret;
+}
+
+aresult_t direct_fir_f32_push_sample_buf(struct direct_fir_f32 *fir, struct sample_buf *buf)
+{
+    aresult_t ret = A_OK;
+
+    float *dest = NULL;
+
+    TSL_ASSERT_ARG(NULL != fir);
+    TSL_ASSERT_ARG(NULL != buf);
+
+    if (FAILED(ret = sample_history_reserve(&fir->hist, buf->nr_samples, (void **)&dest))) {
+        goto done;
+    }
+
+    if (FAILED(ret = sample_buf_copy_f32(buf, dest))) {
+        goto done;
+    }
+
+    sample_history_commit(&fir->hist, buf->nr_samples);
+
+    TSL_BUG_IF_FAILED(sample_buf_decref(buf));
+
+done:
+    return ret;
+}
+
+/**
+ * Add up the partial sums, always in the same order.
+ */
+FILTER_ALWAYS_INLINE
+float _direct_fir_f32_sum_lanes(const float *acc)
+{
+    float sum[DIRECT_FIR_F32_LANES / 2];
+
+    for (size_t j = 0; j < DIRECT_FIR_F32_LANES / 2; j++) {
+        sum[j] = acc[j] + acc[j + DIRECT_FIR_F32_LANES / 2];
+    }
+
+    return (sum[0] + sum[2]) + (sum[1] + sum[3]);
+}
+
+_Static_assert(8 == DIRECT_FIR_F32_LANES, "Lane sums assume 8 partial sums");
+
+/*
+ * Each partial sum takes every DIRECT_FIR_F32_LANES'th tap. The inner loop over the lanes is
+ * what gets vectorized; with FMA, each multiply-add is fused.
+ */
+FILTER_ALWAYS_INLINE
+void _direct_fir_f32_dot_body(const struct direct_fir_f32 *fir, const float *restrict samples, float *pacc_re,
+        float *pacc_im)
+{
+    const float *restrict c_re = fir->coeff_re,
+                *restrict c_im = fir->coeff_im;
+    float acc_re[DIRECT_FIR_F32_LANES] = { 0.0f },
+          acc_im[DIRECT_FIR_F32_LANES] = { 0.0f };
+    size_t nr_coeffs = fir->nr_coeffs,
+           i = 0;
+
+    for (; i + DIRECT_FIR_F32_LANES <= nr_coeffs; i += DIRECT_FIR_F32_LANES) {
+        for (size_t j = 0; j < DIRECT_FIR_F32_LANES; j++) {
+            float s_re = samples[2 * (i + j)],
+                  s_im = samples[2 * (i + j) + 1];
+
+            acc_re[j] += c_re[i + j] * s_re - c_im[i + j] * s_im;
+            acc_im[j] += c_re[i + j] * s_im + c_im[i + j] * s_re;
+        }
+    }
+
+    for (size_t j = 0; i < nr_coeffs; i++, j++) {
+        float s_re = samples[2 * i],
+              s_im = samples[2 * i + 1];
+
+        acc_re[j] += c_re[i] * s_re - c_im[i] * s_im;
+        acc_im[j] += c_re[i] * s_im + c_im[i] * s_re;
+    }
+
+    *pacc_re = _direct_fir_f32_sum_lanes(acc_re);
+    *pacc_im = _direct_fir_f32_sum_lanes(acc_im);
+}
+
+/*
+ * FILTER_BLOCK_OUTPUTS windows, stride complex samples apart, each summed exactly the way
+ * _direct_fir_f32_dot_body sums a single window.
+ */
+FILTER_ALWAYS_INLINE
+void _direct_fir_f32_dot_block_body(const struct direct_fir_f32 *fir, const float *restrict samples,
+        size_t stride, float *acc_re, float *acc_im)
+{
+    const float *restrict c_re = fir->coeff_re,
+                *restrict c_im = fir->coeff_im;
+    float re[FILTER_BLOCK_OUTPUTS][DIRECT_FIR_F32_LANES] = { { 0.0f } },
+          im[FILTER_BLOCK_OUTPUTS][DIRECT_FIR_F32_LANES] = { { 0.0f } };
+    size_t nr_coeffs = fir->nr_coeffs,
+           i = 0;
+
+    for (; i + DIRECT_FIR_F32_LANES <= nr_coeffs; i += DIRECT_FIR_F32_LANES) {
+        for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+            const float *restrict s = samples + 2 * k * stride;
+
+            for (size_t j = 0; j < DIRECT_FIR_F32_LANES; j++) {
+                float s_re = s[2 * (i + j)],
+                      s_im = s[2 * (i + j) + 1];
+
+                re[k][j] += c_re[i + j] * s_re - c_im[i + j] * s_im;
+                im[k][j] += c_re[i + j] * s_im + c_im[i + j] * s_re;
+            }
+        }
+    }
+
+    for (size_t j = 0; i < nr_coeffs; i++, j++) {
+        for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+            const float *restrict s = samples + 2 * k * stride;
+            float s_re = s[2 * i],
+                  s_im = s[2 * i + 1];
+
+            re[k][j] += c_re[i] * s_re - c_im[i] * s_im;
+            im[k][j] += c_re[i] * s_im + c_im[i] * s_re;
+        }
+    }
+
+    for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+        acc_re[k] = _direct_fir_f32_sum_lanes(re[k]);
+        acc_im[k] = _direct_fir_f32_sum_lanes(im[k]);
+    }
+}
+
+void direct_fir_f32_dot_scalar(const struct direct_fir_f32 *fir, const float *samples, float *pacc_re,
+        float *pacc_im)
+{
+    _direct_fir_f32_dot_body(fir, samples, pacc_re, pacc_im);
+}
+
+void direct_fir_f32_dot_block_scalar(const struct direct_fir_f32 *fir, const float *samples, size_t stride,
+        float *acc_re, float *acc_im)
+{
+    _direct_fir_f32_dot_block_body(fir, samples, stride, acc_re, acc_im);
+}
+
+#ifdef _FILTER_HAVE_X86_KERNELS
+FILTER_DEFINE_X86_VARIANTS(direct_fir_f32_dot,
+        (const struct direct_fir_f32 *fir, const float *samples, float *pacc_re, float *pacc_im),
+        (fir, samples, pacc_re, pacc_im))
+
+FILTER_DEFINE_X86_VARIANTS(direct_fir_f32_dot_block,
+        (const struct direct_fir_f32 *fir, const float *samples, size_t stride, float *acc_re, float *acc_im),
+        (fir, samples, stride, acc_re, acc_im))
+#endif /* defined(_FILTER_HAVE_X86_KERNELS) */
+
+/**
+ * Derotate the output samples, with the same phasors the Q.15 FIRs use.
+ */
+static
+void _direct_fir_f32_derotate(struct direct_fir_f32 *fir, float *out_buf, size_t nr_samples)
+{
+    const float scale = 1.0f / (float)(1 << Q_15_SHIFT);
+
+    for (size_t i = 0; i < nr_samples; i++) {
+        int16_t lo_re = 0,
+                lo_im = 0;
+        float s_re = out_buf[2 * i],
+              s_im = out_buf[2 * i + 1],
+              r_re = 0.0f,
+              r_im = 0.0f;
+
+        nco_step(&fir->rot_nco, &lo_re, &lo_im);
+        r_re = (float)lo_re * scale;
+        r_im = (float)lo_im * scale;
+
+        out_buf[2 * i    ] = s_re * r_re - s_im * r_im;
+        out_buf[2 * i + 1] = s_re * r_im + s_im * r_re;
+    }
+}
+
+aresult_t direct_fir_f32_process(struct direct_fir_f32 *fir, float *out_buf, size_t nr_out_samples,
+        size_t *pnr_out_samples_generated)
+{
+    aresult_t ret = A_OK;
+
+    size_t nr_out = 0,
+           block_span = 0;
+
+    TSL_ASSERT_ARG(NULL != fir);
+    TSL_ASSERT_ARG(NULL != out_buf);
+    TSL_ASSERT_ARG(0 != nr_out_samples);
+    TSL_ASSERT_ARG(NULL != pnr_out_samples_generated);
+
+    TSL_BUG_ON(0 == fir->nr_coeffs);
+
+    /* Compute whole blocks of outputs while there are enough samples for all of them */
+    block_span = fir->nr_coeffs + (FILTER_BLOCK_OUTPUTS - 1) * fir->decimate_factor;
+
+    while (nr_out + FILTER_BLOCK_OUTPUTS <= nr_out_samples && sample_history_avail(&fir->hist) >= block_span) {
+        float acc_re[FILTER_BLOCK_OUTPUTS],
+              acc_im[FILTER_BLOCK_OUTPUTS];
+
+        filter_kernels->direct_fir_f32_dot_block(fir, sample_history_head(&fir->hist), fir->decimate_factor,
+                acc_re, acc_im);
+        sample_history_advance(&fir->hist, FILTER_BLOCK_OUTPUTS * fir->decimate_factor);
+
+        for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+            out_buf[2 * nr_out    ] = acc_re[k];
+            out_buf[2 * nr_out + 1] = acc_im[k];
+            nr_out++;
+        }
+    }
+
+    while (nr_out < nr_out_samples && sample_history_avail(&fir->hist) >= fir->nr_coeffs) {
+        filter_kernels->direct_fir_f32_dot(fir, sample_history_head(&fir->hist), &out_buf[2 * nr_out],
+                &out_buf[2 * nr_out + 1]);
+        sample_history_advance(&fir->hist, fir->decimate_factor);
+        nr_out++;
+    }
+
+    /* Apply a phase rotation, if appropriate */
+    if (0 != fir->rot_nco.phase_incr) {
+        _direct_fir_f32_derotate(fir, out_buf, nr_out);
+    }
+
+    *pnr_out_samples_generated = nr_out;
+
+    return ret;
+}
+
+aresult_t direct_fir_f32_can_process(struct direct_fir_f32 *fir, bool *pcan_process, size_t *pest_count)
+{
+    aresult_t ret = A_OK;
+
+    size_t nr_avail = 0;
+
+    TSL_ASSERT_ARG(NULL != fir);
+    TSL_ASSERT_ARG(NULL != pcan_process);
+
+    nr_avail = sample_history_avail(&fir->hist);
+
+    *pcan_process = nr_avail >= fir->nr_coeffs;
+
+    if (NULL != pest_count) {
+        *pest_count = nr_avail >= fir->nr_coeffs ? (nr_avail - fir->nr_coeffs)/fir->decimate_factor + 1 : 0;
+    }
+
+    return ret;
+}
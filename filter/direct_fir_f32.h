@@ -0,0 +1,122 @@
+#pragma once
+
+#include <filter/sample_history.h>
+#include <filter/nco.h>
+
+#include <tsl/result.h>
+
+#include <stdbool.h>
+
+struct sample_buf;
+
+/**
+ * The number of partial sums the float kernels keep. Each one sums every DIRECT_FIR_F32_LANES'th
+ * product, so the sums are vectorized across taps, and every variant adds the products up in
+ * the same order.
+ */
+#define DIRECT_FIR_F32_LANES            8
+
+/**
+ * A direct-form FIR with complex coefficients, over complex float samples. Does the same job as
+ * a `struct direct_fir` with DIRECT_FIR_STRATEGY_COMPLEX, but the samples, coefficients and
+ * sums are all floats, so there's no need to scale the filter gain to keep the sums in range.
+ */
+struct direct_fir_f32 {
+    /**
+     * Real coefficients
+     */
+    float *coeff_re;
+
+    /**
+     * Imaginary coefficients
+     */
+    float *coeff_im;
+
+    /**
+     * The number of coefficients in this FIR
+     */
+    size_t nr_coeffs;
+
+    /**
+     * Decimation factor. Determines how we walk through the sample buffer.
+     */
+    unsigned decimate_factor;
+
+    /**
+     * The samples waiting to be filtered, as interleaved float I/Q, including the overlap from
+     * earlier sample buffers
+     */
+    struct sample_history hist;
+
+    /**
+     * The NCO that derotates each output sample, stepped once per output. Its phase increment
+     * is 0 if the FIR doesn't derotate.
+     */
+    struct nco rot_nco;
+};
+
+/**
+ * Create a direct coefficient FIR over float samples. This function allocates memory.
+ *
+ * \param fir The FIR object. Pass a chunk of memory by reference.
+ * \param nr_coeffs The number of coefficients in the FIR
+ * \param real_coeff The real coefficients for the FIR
+ * \param imag_coeff The imaginary coefficients for the FIR
+ * \param decimation_factor The decimation factor to apply
+ * \param derotate Set to `true` if you wish to apply a derotator. Useful if the filter will
+ *                 shift a signal to baseband.
+ * \param sampling_rate The sampling rate. Ignored if not using the phase derotator.
+ * \param freq_shift How far the filter shifts the signal down to baseband, in Hz. Ignored if not
+ *                   using the phase derotator.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t direct_fir_f32_init(struct direct_fir_f32 *fir, size_t nr_coeffs, const float *real_coeff,
+        const float *imag_coeff, unsigned decimation_factor, bool derotate, uint32_t sampling_rate,
+        int32_t freq_shift);
+
+/**
+ * Cleanup memory held by the FIR
+ *
+ * \param fir The FIR to cleanup.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t direct_fir_f32_cleanup(struct direct_fir_f32 *fir);
+
+/**
+ * Push an updated sample buffer. The samples are converted to floats on their way into the
+ * FIR's history (see `sample_buf_copy_f32`) and the sample buffer is released, so any number of
+ * sample buffers can be pushed before processing.
+ *
+ * \param fir The FIR
+ * \param buf The buffer to push
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t direct_fir_f32_push_sample_buf(struct direct_fir_f32 *fir, struct sample_buf *buf);
+
+/**
+ * Apply the FIR to as many samples as possible, up to nr_out_samples.
+ *
+ * \param fir The FIR to apply
+ * \param out_buf The buffer to write the interleaved float I/Q output samples to
+ * \param nr_out_samples The maximum number of output samples out_buf can hold
+ * \param pnr_out_samples_generated The number of valid samples in out_buf
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t direct_fir_f32_process(struct direct_fir_f32 *fir, float *out_buf, size_t nr_out_samples,
+        size_t *pnr_out_samples_generated);
+
+/**
+ * Determine whether or not there are enough samples available to produce at least one filtered,
+ * decimated sample.
+ *
+ * \param fir The FIR in question
+ * \param pcan_process Whether or not the FIR can produce a sample, returned by reference
+ * \param pest_count The number of samples that could be produced, or NULL.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t direct_fir_f32_can_process(struct direct_fir_f32 *fir, bool *pcan_process, size_t *pest_count);
@@ -0,0 +1,329 @@
+/*
+ *  direct_fir_x86.c - SSE4.1, AVX2 and AVX-512 kernels for the direct FIR
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/direct_fir.h>
+#include <filter/kernels_priv.h>
+
+#ifdef _FILTER_HAVE_X86_KERNELS
+
+#include <immintrin.h>
+
+/**
+ * Finish one blocked output with the coefficients the vector loop didn't cover
+ */
+static inline
+void _direct_fir_dot_tail(const struct direct_fir *fir, const int16_t *samples, size_t first,
+        int32_t *pacc_re, int32_t *pacc_im)
+{
+    int32_t acc_re = *pacc_re,
+            acc_im = *pacc_im;
+
+    for (size_t i = first; i < fir->nr_coeffs; i++) {
+        acc_re += (int32_t)fir->mac_coeff_re[2 * i] * samples[2 * i] + (int32_t)fir->mac_coeff_re[2 * i + 1] * samples[2 * i + 1];
+        acc_im += (int32_t)fir->mac_coeff_im[2 * i] * samples[2 * i] + (int32_t)fir->mac_coeff_im[2 * i + 1] * samples[2 * i + 1];
+    }
+
+    *pacc_re = acc_re;
+    *pacc_im = acc_im;
+}
+
+/*
+ * All of the kernels lean on pmaddwd, which multiplies adjacent pairs of int16s and sums each pair
+ * into an int32. With the samples interleaved as [re, im] and the coefficients interleaved as
+ * [c_re, -c_im] and [c_im, c_re], one pmaddwd each gives the real and imaginary parts of the
+ * complex product, already summed. The sums wrap exactly like the scalar int32 accumulators,
+ * so the result is bit-identical.
+ */
+
+static inline FILTER_TARGET_SSE41
+int32_t _direct_fir_hsum_sse41(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+FILTER_TARGET_SSE41
+void direct_fir_dot_sse41(const struct direct_fir *fir, const int16_t *samples, int32_t *pacc_re, int32_t *pacc_im)
+{
+    __m128i acc_re_v = _mm_setzero_si128(),
+            acc_im_v = _mm_setzero_si128();
+    size_t nr_vec = fir->nr_coeffs & ~((size_t)4 - 1);
+    int32_t acc_re = 0,
+            acc_im = 0;
+
+    if (NULL == fir->mac_coeff_re) {
+        direct_fir_dot_scalar(fir, samples, pacc_re, pacc_im);
+        return;
+    }
+
+    /* 4 complex samples per vector */
+    for (size_t i = 0; i < nr_vec; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)&samples[2 * i]),
+                c_re = _mm_load_si128((const __m128i *)&fir->mac_coeff_re[2 * i]),
+                c_im = _mm_load_si128((const __m128i *)&fir->mac_coeff_im[2 * i]);
+
+        acc_re_v = _mm_add_epi32(acc_re_v, _mm_madd_epi16(s, c_re));
+        acc_im_v = _mm_add_epi32(acc_im_v, _mm_madd_epi16(s, c_im));
+    }
+
+    acc_re = _direct_fir_hsum_sse41(acc_re_v);
+    acc_im = _direct_fir_hsum_sse41(acc_im_v);
+
+    for (size_t i = nr_vec; i < fir->nr_coeffs; i++) {
+        acc_re += (int32_t)fir->mac_coeff_re[2 * i] * samples[2 * i] + (int32_t)fir->mac_coeff_re[2 * i + 1] * samples[2 * i + 1];
+        acc_im += (int32_t)fir->mac_coeff_im[2 * i] * samples[2 * i] + (int32_t)fir->mac_coeff_im[2 * i + 1] * samples[2 * i + 1];
+    }
+
+    *pacc_re = acc_re;
+    *pacc_im = acc_im;
+}
+
+/**
+ * Reduce four vectors of partial sums at once, giving the sum of each in the matching lane
+ */
+static inline FILTER_TARGET_SSE41
+__m128i _direct_fir_hsum4_sse41(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+    return _mm_hadd_epi32(_mm_hadd_epi32(a, b), _mm_hadd_epi32(c, d));
+}
+
+FILTER_TARGET_SSE41
+void direct_fir_dot_block_sse41(const struct direct_fir *fir, const int16_t *samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im)
+{
+    __m128i a_re[FILTER_BLOCK_OUTPUTS],
+            a_im[FILTER_BLOCK_OUTPUTS];
+    size_t nr_vec = fir->nr_coeffs & ~((size_t)4 - 1);
+
+    if (NULL == fir->mac_coeff_re) {
+        direct_fir_dot_block_scalar(fir, samples, stride, acc_re, acc_im);
+        return;
+    }
+
+    for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+        a_re[k] = _mm_setzero_si128();
+        a_im[k] = _mm_setzero_si128();
+    }
+
+    for (size_t i = 0; i < nr_vec; i += 4) {
+        __m128i c_re = _mm_load_si128((const __m128i *)&fir->mac_coeff_re[2 * i]),
+                c_im = _mm_load_si128((const __m128i *)&fir->mac_coeff_im[2 * i]);
+
+        for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+            __m128i s = _mm_loadu_si128((const __m128i *)&samples[2 * (k * stride + i)]);
+
+            a_re[k] = _mm_add_epi32(a_re[k], _mm_madd_epi16(s, c_re));
+            a_im[k] = _mm_add_epi32(a_im[k], _mm_madd_epi16(s, c_im));
+        }
+    }
+
+    _mm_storeu_si128((__m128i *)acc_re, _direct_fir_hsum4_sse41(a_re[0], a_re[1], a_re[2], a_re[3]));
+    _mm_storeu_si128((__m128i *)acc_im, _direct_fir_hsum4_sse41(a_im[0], a_im[1], a_im[2], a_im[3]));
+
+    for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+        _direct_fir_dot_tail(fir, &samples[2 * k * stride], nr_vec, &acc_re[k], &acc_im[k]);
+    }
+}
+
+FILTER_TARGET_AVX2
+void direct_fir_dot_avx2(const struct direct_fir *fir, const int16_t *samples, int32_t *pacc_re, int32_t *pacc_im)
+{
+    __m256i acc_re_v = _mm256_setzero_si256(),
+            acc_im_v = _mm256_setzero_si256();
+    __m128i acc_re_h,
+            acc_im_h;
+    size_t nr_vec = fir->nr_coeffs & ~((size_t)8 - 1);
+    int32_t acc_re = 0,
+            acc_im = 0;
+
+    if (NULL == fir->mac_coeff_re) {
+        direct_fir_dot_scalar(fir, samples, pacc_re, pacc_im);
+        return;
+    }
+
+    /* 8 complex samples per vector */
+    for (size_t i = 0; i < nr_vec; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)&samples[2 * i]),
+                c_re = _mm256_load_si256((const __m256i *)&fir->mac_coeff_re[2 * i]),
+                c_im = _mm256_load_si256((const __m256i *)&fir->mac_coeff_im[2 * i]);
+
+        acc_re_v = _mm256_add_epi32(acc_re_v, _mm256_madd_epi16(s, c_re));
+        acc_im_v = _mm256_add_epi32(acc_im_v, _mm256_madd_epi16(s, c_im));
+    }
+
+    acc_re_h = _mm_add_epi32(_mm256_castsi256_si128(acc_re_v), _mm256_extracti128_si256(acc_re_v, 1));
+    acc_im_h = _mm_add_epi32(_mm256_castsi256_si128(acc_im_v), _mm256_extracti128_si256(acc_im_v, 1));
+
+    acc_re_h = _mm_add_epi32(acc_re_h, _mm_shuffle_epi32(acc_re_h, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc_re_h = _mm_add_epi32(acc_re_h, _mm_shuffle_epi32(acc_re_h, _MM_SHUFFLE(2, 3, 0, 1)));
+    acc_im_h = _mm_add_epi32(acc_im_h, _mm_shuffle_epi32(acc_im_h, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc_im_h = _mm_add_epi32(acc_im_h, _mm_shuffle_epi32(acc_im_h, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    acc_re = _mm_cvtsi128_si32(acc_re_h);
+    acc_im = _mm_cvtsi128_si32(acc_im_h);
+
+    for (size_t i = nr_vec; i < fir->nr_coeffs; i++) {
+        acc_re += (int32_t)fir->mac_coeff_re[2 * i] * samples[2 * i] + (int32_t)fir->mac_coeff_re[2 * i + 1] * samples[2 * i + 1];
+        acc_im += (int32_t)fir->mac_coeff_im[2 * i] * samples[2 * i] + (int32_t)fir->mac_coeff_im[2 * i + 1] * samples[2 * i + 1];
+    }
+
+    *pacc_re = acc_re;
+    *pacc_im = acc_im;
+}
+
+/**
+ * Fold the upper half of a vector of partial sums onto the lower half
+ */
+static inline FILTER_TARGET_AVX2
+__m128i _direct_fir_fold_avx2(__m256i v)
+{
+    return _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+FILTER_TARGET_AVX2
+void direct_fir_dot_block_avx2(const struct direct_fir *fir, const int16_t *samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im)
+{
+    __m256i a_re[FILTER_BLOCK_OUTPUTS],
+            a_im[FILTER_BLOCK_OUTPUTS];
+    size_t nr_vec = fir->nr_coeffs & ~((size_t)8 - 1);
+
+    if (NULL == fir->mac_coeff_re) {
+        direct_fir_dot_block_scalar(fir, samples, stride, acc_re, acc_im);
+        return;
+    }
+
+    for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+        a_re[k] = _mm256_setzero_si256();
+        a_im[k] = _mm256_setzero_si256();
+    }
+
+    for (size_t i = 0; i < nr_vec; i += 8) {
+        __m256i c_re = _mm256_load_si256((const __m256i *)&fir->mac_coeff_re[2 * i]),
+                c_im = _mm256_load_si256((const __m256i *)&fir->mac_coeff_im[2 * i]);
+
+        for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+            __m256i s = _mm256_loadu_si256((const __m256i *)&samples[2 * (k * stride + i)]);
+
+            a_re[k] = _mm256_add_epi32(a_re[k], _mm256_madd_epi16(s, c_re));
+            a_im[k] = _mm256_add_epi32(a_im[k], _mm256_madd_epi16(s, c_im));
+        }
+    }
+
+    _mm_storeu_si128((__m128i *)acc_re, _mm_hadd_epi32(
+                _mm_hadd_epi32(_direct_fir_fold_avx2(a_re[0]), _direct_fir_fold_avx2(a_re[1])),
+                _mm_hadd_epi32(_direct_fir_fold_avx2(a_re[2]), _direct_fir_fold_avx2(a_re[3]))));
+    _mm_storeu_si128((__m128i *)acc_im, _mm_hadd_epi32(
+                _mm_hadd_epi32(_direct_fir_fold_avx2(a_im[0]), _direct_fir_fold_avx2(a_im[1])),
+                _mm_hadd_epi32(_direct_fir_fold_avx2(a_im[2]), _direct_fir_fold_avx2(a_im[3]))));
+
+    for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+        _direct_fir_dot_tail(fir, &samples[2 * k * stride], nr_vec, &acc_re[k], &acc_im[k]);
+    }
+}
+
+/**
+ * Sum the lanes of a vector of 32-bit accumulators. Kept in its own function so that unoptimized
+ * builds don't give each expanded reduction in the blocked kernel its own stack slots.
+ */
+static inline FILTER_TARGET_AVX512
+int32_t _direct_fir_sum_avx512(__m512i v)
+{
+    return _mm512_reduce_add_epi32(v);
+}
+
+FILTER_TARGET_AVX512
+void direct_fir_dot_avx512(const struct direct_fir *fir, const int16_t *samples, int32_t *pacc_re, int32_t *pacc_im)
+{
+    __m512i acc_re_v = _mm512_setzero_si512(),
+            acc_im_v = _mm512_setzero_si512();
+    size_t nr_vec = fir->nr_coeffs & ~((size_t)16 - 1);
+    int32_t acc_re = 0,
+            acc_im = 0;
+
+    if (NULL == fir->mac_coeff_re) {
+        direct_fir_dot_scalar(fir, samples, pacc_re, pacc_im);
+        return;
+    }
+
+    /* 16 complex samples per vector */
+    for (size_t i = 0; i < nr_vec; i += 16) {
+        __m512i s = _mm512_loadu_si512((const void *)&samples[2 * i]),
+                c_re = _mm512_load_si512((const void *)&fir->mac_coeff_re[2 * i]),
+                c_im = _mm512_load_si512((const void *)&fir->mac_coeff_im[2 * i]);
+
+        acc_re_v = _mm512_add_epi32(acc_re_v, _mm512_madd_epi16(s, c_re));
+        acc_im_v = _mm512_add_epi32(acc_im_v, _mm512_madd_epi16(s, c_im));
+    }
+
+    acc_re = _direct_fir_sum_avx512(acc_re_v);
+    acc_im = _direct_fir_sum_avx512(acc_im_v);
+
+    for (size_t i = nr_vec; i < fir->nr_coeffs; i++) {
+        acc_re += (int32_t)fir->mac_coeff_re[2 * i] * samples[2 * i] + (int32_t)fir->mac_coeff_re[2 * i + 1] * samples[2 * i + 1];
+        acc_im += (int32_t)fir->mac_coeff_im[2 * i] * samples[2 * i] + (int32_t)fir->mac_coeff_im[2 * i + 1] * samples[2 * i + 1];
+    }
+
+    *pacc_re = acc_re;
+    *pacc_im = acc_im;
+}
+
+FILTER_TARGET_AVX512
+void direct_fir_dot_block_avx512(const struct direct_fir *fir, const int16_t *samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im)
+{
+    __m512i a_re[FILTER_BLOCK_OUTPUTS],
+            a_im[FILTER_BLOCK_OUTPUTS];
+    size_t nr_vec = fir->nr_coeffs & ~((size_t)16 - 1);
+
+    if (NULL == fir->mac_coeff_re) {
+        direct_fir_dot_block_scalar(fir, samples, stride, acc_re, acc_im);
+        return;
+    }
+
+    for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+        a_re[k] = _mm512_setzero_si512();
+        a_im[k] = _mm512_setzero_si512();
+    }
+
+    for (size_t i = 0; i < nr_vec; i += 16) {
+        __m512i c_re = _mm512_load_si512((const void *)&fir->mac_coeff_re[2 * i]),
+                c_im = _mm512_load_si512((const void *)&fir->mac_coeff_im[2 * i]);
+
+        for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+            __m512i s = _mm512_loadu_si512((const void *)&samples[2 * (k * stride + i)]);
+
+            a_re[k] = _mm512_add_epi32(a_re[k], _mm512_madd_epi16(s, c_re));
+            a_im[k] = _mm512_add_epi32(a_im[k], _mm512_madd_epi16(s, c_im));
+        }
+    }
+
+    for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+        acc_re[k] = _direct_fir_sum_avx512(a_re[k]);
+        acc_im[k] = _direct_fir_sum_avx512(a_im[k]);
+        _direct_fir_dot_tail(fir, &samples[2 * k * stride], nr_vec, &acc_re[k], &acc_im[k]);
+    }
+}
+
+#endif /* defined(_FILTER_HAVE_X86_KERNELS) */
+
@@ -0,0 +1,455 @@
+/*
+ *  fast_conv.c - Overlap-save fast convolution, with decimation and
+ *      frequency shifting done in the frequency domain.
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/fast_conv.h>
+#include <filter/fft.h>
+#include <filter/filter.h>
+#include <filter/filter_priv.h>
+#include <filter/sample_buf.h>
+
+#include <tsl/safe_alloc.h>
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+
+#include <math.h>
+#include <string.h>
+
+/**
+ * Determine whether n factors entirely into 2, 3 and 5, the radixes the FFT is fastest at.
+ */
+static
+bool _fast_conv_is_smooth(size_t n)
+{
+    static const size_t radixes[] = { 2, 3, 5 };
+
+    for (size_t i = 0; i < sizeof(radixes)/sizeof(radixes[0]); i++) {
+        while (0 == n % radixes[i]) {
+            n /= radixes[i];
+        }
+    }
+
+    return 1 == n;
+}
+
+/**
+ * Pick the transform size and the overlap between blocks for a filter. The overlap covers the
+ * filter, rounded up to a multiple of the decimation factor so every block starts on an output
+ * sample. The transform size is a multiple of the decimation factor, so the spectrum folds
+ * evenly, and is at least FAST_CONV_SIZE_FACTOR times the filter length.
+ */
+static
+void _fast_conv_size(size_t nr_coeffs, unsigned decimation, size_t *pnr_points, size_t *poverlap)
+{
+    size_t overlap = (nr_coeffs - 1 + decimation - 1) / decimation * decimation,
+           min_points = BL_MAX2(FAST_CONV_SIZE_FACTOR * nr_coeffs, overlap + decimation),
+           nr_out_points = (min_points + decimation - 1) / decimation;
+
+    while (false == _fast_conv_is_smooth(nr_out_points)) {
+        nr_out_points++;
+    }
+
+    *pnr_points = nr_out_points * decimation;
+    *poverlap = overlap;
+}
+
+size_t fast_conv_cost(size_t nr_coeffs, unsigned decimation)
+{
+    size_t nr_points = 0,
+           overlap = 0,
+           nr_out_points = 0,
+           nr_outputs = 0;
+
+    _fast_conv_size(nr_coeffs, decimation, &nr_points, &overlap);
+    nr_out_points = nr_points / decimation;
+    nr_outputs = (nr_points - overlap) / decimation;
+
+    /* Each radix-2 stage of a complex FFT costs about 2 real multiplies per point; the spectrum
+     * multiply costs 4 per point, and each output needs its phase corrected.
+     */
+    return (size_t)((2.0 * (double)nr_points * log2((double)nr_points) +
+                4.0 * (double)nr_points +
+                2.0 * (double)nr_out_points * log2((double)nr_out_points)) / (double)nr_outputs) + 4;
+}
+
+aresult_t fast_conv_new(struct fast_conv **pfc, size_t nr_coeffs, const int16_t *real_coeffs,
+        const int16_t *imag_coeffs, unsigned decimation, uint32_t sampling_rate, int32_t freq_shift)
+{
+    aresult_t ret = A_OK;
+
+    struct fast_conv *fc = NULL;
+    struct fft *setup = NULL;
+    float complex *taps = NULL;
+    size_t nr_points = 0,
+           overlap = 0,
+           nr_out_points = 0;
+    long rot_bins = 0;
+    double scale = 0.0,
+           peak = 0.0,
+           floor_mag = 0.0;
+
+    TSL_ASSERT_ARG(NULL != pfc);
+    TSL_ASSERT_ARG(0 != nr_coeffs);
+    TSL_ASSERT_ARG(NULL != real_coeffs);
+    TSL_ASSERT_ARG(NULL != imag_coeffs);
+    TSL_ASSERT_ARG(0 != decimation);
+    TSL_ASSERT_ARG(0 != sampling_rate);
+
+    *pfc = NULL;
+
+    _fast_conv_size(nr_coeffs, decimation, &nr_points, &overlap);
+    nr_out_points = nr_points / decimation;
+
+    DIAG("Fast convolution: %zu coefficients, decimation by %u, %zu point FFT, %zu new samples per block",
+            nr_coeffs, decimation, nr_points, nr_points - overlap);
+
+    if (FAILED(ret = TZAALLOC(fc, SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    fc->nr_points = nr_points;
+    fc->advance = nr_points - overlap;
+    fc->decimation = decimation;
+
+    if (FAILED(ret = sample_history_init(&fc->hist, 2 * sizeof(int16_t)))) {
+        goto done;
+    }
+
+    if (FAILED(ret = fft_new(&fc->fwd, nr_points, false))) {
+        goto done;
+    }
+
+    if (FAILED(ret = fft_new(&fc->inv, nr_out_points, true))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fc->filter, nr_points, sizeof(float complex), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fc->bins, nr_points, sizeof(size_t), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fc->block, nr_points, sizeof(float complex), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fc->spectrum, nr_points, sizeof(float complex), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fc->folded, nr_out_points, sizeof(float complex), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fc->out, nr_out_points, sizeof(float complex), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fc->pending, fc->advance / decimation, 2 * sizeof(int16_t), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    /* The direct FIR correlates: output n is sum(c[i] * x[n + i]). As a convolution, that's the
+     * reversed coefficients, ending at the last sample of the overlap.
+     */
+    if (FAILED(ret = TACALLOC((void **)&taps, nr_points, sizeof(float complex), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < nr_coeffs; i++) {
+        taps[overlap - i] = CMPLXF((float)real_coeffs[i], (float)imag_coeffs[i]);
+    }
+
+    if (FAILED(ret = fft_new(&setup, nr_points, false))) {
+        goto done;
+    }
+
+    TSL_BUG_IF_FAILED(fft_execute(setup, taps, fc->spectrum));
+
+    /* Shift the channel down to DC by rotating the spectrum by a whole number of bins, and fold in
+     * the Q.15 coefficient scale and the 1/N the unnormalized inverse transform leaves out.
+     */
+    fc->shift = (double)freq_shift / (double)sampling_rate;
+    rot_bins = lround(fc->shift * (double)nr_points);
+    fc->rot_bins = (size_t)(((rot_bins % (long)nr_points) + (long)nr_points) % (long)nr_points);
+    scale = 1.0 / ((double)nr_points * (double)(1 << Q_15_SHIFT));
+
+    for (size_t i = 0; i < nr_points; i++) {
+        peak = BL_MAX2(peak, cabsf(fc->spectrum[i]));
+    }
+
+    floor_mag = peak * pow(10.0, FAST_CONV_BIN_FLOOR_DB / 20.0);
+
+    for (size_t i = 0; i < nr_points; i++) {
+        float complex h = fc->spectrum[(i + fc->rot_bins) % nr_points];
+
+        if (cabsf(h) <= floor_mag) {
+            continue;
+        }
+
+        fc->filter[fc->nr_bins] = h * (float)scale;
+        fc->bins[fc->nr_bins] = i;
+        fc->nr_bins++;
+    }
+
+    DIAG("Fast convolution: keeping %zu of %zu bins of the filter response", fc->nr_bins, nr_points);
+
+    /* Whatever is left of the shift is corrected in the time domain, at the output rate */
+    fc->out_rot_incr = (float complex)cexp(CMPLX(0, -2.0 * M_PI * (double)decimation *
+                (fc->shift - (double)rot_bins / (double)nr_points)));
+    fc->block_phase = 0.0;
+
+    *pfc = fc;
+
+done:
+    if (NULL != setup) {
+        TSL_BUG_IF_FAILED(fft_delete(&setup));
+    }
+
+    if (NULL != taps) {
+        TFREE(taps);
+    }
+
+    if (FAILED(ret)) {
+        if (NULL != fc) {
+            TSL_BUG_IF_FAILED(fast_conv_delete(&fc));
+        }
+    }
+
+    return ret;
+}
+
+aresult_t fast_conv_delete(struct fast_conv **pfc)
+{
+    aresult_t ret = A_OK;
+
+    struct fast_conv *fc = NULL;
+
+    TSL_ASSERT_PTR_BY_REF(pfc);
+
+    fc = *pfc;
+
+    if (NULL != fc->fwd) {
+        TSL_BUG_IF_FAILED(fft_delete(&fc->fwd));
+    }
+
+    if (NULL != fc->inv) {
+        TSL_BUG_IF_FAILED(fft_delete(&fc->inv));
+    }
+
+    if (NULL != fc->filter) {
+        TFREE(fc->filter);
+    }
+
+    if (NULL != fc->bins) {
+        TFREE(fc->bins);
+    }
+
+    if (NULL != fc->block) {
+        TFREE(fc->block);
+    }
+
+    if (NULL != fc->spectrum) {
+        TFREE(fc->spectrum);
+    }
+
+    if (NULL != fc->folded) {
+        TFREE(fc->folded);
+    }
+
+    if (NULL != fc->out) {
+        TFREE(fc->out);
+    }
+
+    if (NULL != fc->pending) {
+        TFREE(fc->pending);
+    }
+
+    TSL_BUG_IF_FAILED(sample_history_cleanup(&fc->hist));
+
+    TFREE(fc);
+    *pfc = NULL;
+
+    return ret;
+}
+
+aresult_t fast_conv_push_sample_buf(struct fast_conv *fc, struct sample_buf *buf)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != fc);
+    TSL_ASSERT_ARG(NULL != buf);
+
+    if (FAILED(ret = sample_history_append_q15(&fc->hist, buf))) {
+        goto done;
+    }
+
+    fc->max_push = BL_MAX2(fc->max_push, buf->nr_samples);
+
+    TSL_BUG_IF_FAILED(sample_buf_decref(buf));
+
+done:
+    return ret;
+}
+
+static inline
+int16_t _fast_conv_saturate(float v)
+{
+    long s = lrintf(v);
+    return (int16_t)(s > INT16_MAX ? INT16_MAX : s < INT16_MIN ? INT16_MIN : s);
+}
+
+/**
+ * Filter one block of nr_points samples, leaving advance/decimation new output samples in the
+ * pending buffer.
+ */
+static
+void _fast_conv_block(struct fast_conv *fc)
+{
+    const int16_t *samples = sample_history_head(&fc->hist);
+    size_t nr_points = fc->nr_points,
+           nr_out_points = nr_points / fc->decimation,
+           first_out = (nr_points - fc->advance) / fc->decimation,
+           nr_out = fc->advance / fc->decimation;
+    float complex rot;
+
+    for (size_t i = 0; i < nr_points; i++) {
+        fc->block[i] = CMPLXF((float)samples[2 * i], (float)samples[2 * i + 1]);
+    }
+
+    TSL_BUG_IF_FAILED(fft_execute(fc->fwd, fc->block, fc->spectrum));
+
+    /* Multiply by the (rotated) filter response and fold the spectrum down, which decimates the
+     * time-domain output. Bins where the filter response is negligible are skipped entirely.
+     */
+    memset(fc->folded, 0, nr_out_points * sizeof(float complex));
+
+    for (size_t j = 0; j < fc->nr_bins; j++) {
+        size_t i = fc->bins[j],
+               k = i + fc->rot_bins;
+        float complex a = fc->spectrum[k < nr_points ? k : k - nr_points],
+                      b = fc->filter[j];
+
+        fc->folded[i % nr_out_points] += CMPLXF(crealf(a) * crealf(b) - cimagf(a) * cimagf(b),
+                                                crealf(a) * cimagf(b) + cimagf(a) * crealf(b));
+    }
+
+    TSL_BUG_IF_FAILED(fft_execute(fc->inv, fc->folded, fc->out));
+
+    /* The spectrum rotation is referenced to the start of the block, but the shift has to be
+     * continuous from one block to the next, and from one output to the next.
+     */
+    rot = (float complex)cexp(CMPLX(0, -2.0 * M_PI *
+                (fc->block_phase - (double)fc->rot_bins * (double)(nr_points - fc->advance) / (double)nr_points)));
+
+    for (size_t i = 0; i < nr_out; i++) {
+        float complex v = fc->out[first_out + i];
+
+        v = CMPLXF(crealf(v) * crealf(rot) - cimagf(v) * cimagf(rot),
+                   crealf(v) * cimagf(rot) + cimagf(v) * crealf(rot));
+
+        fc->pending[2 * i    ] = _fast_conv_saturate(crealf(v));
+        fc->pending[2 * i + 1] = _fast_conv_saturate(cimagf(v));
+
+        rot = CMPLXF(crealf(rot) * crealf(fc->out_rot_incr) - cimagf(rot) * cimagf(fc->out_rot_incr),
+                     crealf(rot) * cimagf(fc->out_rot_incr) + cimagf(rot) * crealf(fc->out_rot_incr));
+    }
+
+    fc->block_phase += fc->shift * (double)fc->advance;
+    fc->block_phase -= floor(fc->block_phase);
+
+    fc->nr_pending = nr_out;
+    fc->pending_offset = 0;
+
+    sample_history_advance(&fc->hist, fc->advance);
+}
+
+aresult_t fast_conv_process(struct fast_conv *fc, int16_t *out_buf, size_t nr_out_samples, size_t *pnr_out_samples)
+{
+    aresult_t ret = A_OK;
+
+    size_t nr_out = 0;
+
+    TSL_ASSERT_ARG(NULL != fc);
+    TSL_ASSERT_ARG(NULL != out_buf);
+    TSL_ASSERT_ARG(NULL != pnr_out_samples);
+
+    while (nr_out < nr_out_samples) {
+        size_t nr_copy = 0;
+
+        if (0 == fc->nr_pending) {
+            if (sample_history_avail(&fc->hist) < fc->nr_points) {
+                break;
+            }
+
+            _fast_conv_block(fc);
+        }
+
+        nr_copy = BL_MIN2(fc->nr_pending, nr_out_samples - nr_out);
+        memcpy(&out_buf[2 * nr_out], &fc->pending[2 * fc->pending_offset], nr_copy * 2 * sizeof(int16_t));
+
+        fc->pending_offset += nr_copy;
+        fc->nr_pending -= nr_copy;
+        nr_out += nr_copy;
+    }
+
+    *pnr_out_samples = nr_out;
+
+    return ret;
+}
+
+aresult_t fast_conv_can_process(struct fast_conv *fc, bool *pcan_process, size_t *pest_count)
+{
+    aresult_t ret = A_OK;
+
+    size_t nr_blocks = 0;
+
+    TSL_ASSERT_ARG(NULL != fc);
+    TSL_ASSERT_ARG(NULL != pcan_process);
+
+    if (sample_history_avail(&fc->hist) >= fc->nr_points) {
+        nr_blocks = (sample_history_avail(&fc->hist) - fc->nr_points) / fc->advance + 1;
+    }
+
+    *pcan_process = 0 != fc->nr_pending || 0 != nr_blocks;
+
+    if (NULL != pest_count) {
+        *pest_count = fc->nr_pending + nr_blocks * (fc->advance / fc->decimation);
+    }
+
+    return ret;
+}
+
+aresult_t fast_conv_full(struct fast_conv *fc, bool *pfull)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != fc);
+    TSL_ASSERT_ARG_DEBUG(NULL != pfull);
+
+    *pfull = 0 != fc->max_push && sample_history_avail(&fc->hist) >= fc->nr_points + fc->max_push;
+
+    return ret;
+}
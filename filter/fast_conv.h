@@ -0,0 +1,197 @@
+#pragma once
+
+#include <filter/sample_history.h>
+
+#include <tsl/result.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <complex.h>
+
+struct fft;
+struct sample_buf;
+
+/**
+ * The FFT is at least this many times longer than the filter, so each transform produces a
+ * useful number of new output samples.
+ */
+#define FAST_CONV_SIZE_FACTOR           4
+
+/**
+ * Bins of the filter's response more than this far below its peak power are left out of the
+ * spectrum multiply. Narrow channel filters are mostly stop band.
+ */
+#define FAST_CONV_BIN_FLOOR_DB          -110.0
+
+/**
+ * An overlap-save fast convolution filter. It does the same job as a complex direct FIR with
+ * derotation, but in the frequency domain:
+ *  1. Transform N input samples, overlapping the previous block by at least the filter length.
+ *  2. Multiply by the filter's spectrum, rotated so the channel ends up at DC.
+ *  3. Fold the spectrum down to N/D bins, which decimates by D in the time domain.
+ *  4. Inverse transform the N/D bins, keep the outputs that aren't corrupted by the circular
+ *     wrap-around, and correct their phase for the part of the frequency shift that isn't a
+ *     whole number of bins.
+ *
+ * The cost per output grows with the log of the filter length, rather than linearly.
+ */
+struct fast_conv {
+    /**
+     * The forward N-point and inverse N/D-point transforms
+     */
+    struct fft *fwd;
+    struct fft *inv;
+
+    /**
+     * The number of points in the forward transform (N)
+     */
+    size_t nr_points;
+
+    /**
+     * The number of new input samples consumed by each block (N - overlap). A multiple of the
+     * decimation factor.
+     */
+    size_t advance;
+
+    /**
+     * The decimation factor (D)
+     */
+    unsigned decimation;
+
+    /**
+     * The filter's spectrum, rotated down by rot_bins and scaled for the unnormalized inverse
+     * transform and the Q.15 coefficients. Only the nr_bins bins that aren't negligible are kept;
+     * bins holds the index of each.
+     */
+    float complex *filter;
+    size_t *bins;
+    size_t nr_bins;
+
+    /**
+     * Working buffers: the input block, its spectrum, the folded spectrum and the decimated
+     * output block.
+     */
+    float complex *block;
+    float complex *spectrum;
+    float complex *folded;
+    float complex *out;
+
+    /**
+     * The frequency shift, as a whole number of bins of the forward transform
+     */
+    size_t rot_bins;
+
+    /**
+     * The frequency shift, in cycles per input sample
+     */
+    double shift;
+
+    /**
+     * The phase of the frequency shift at the start of the current block, in cycles
+     */
+    double block_phase;
+
+    /**
+     * The phase correction from one output sample to the next, for the fractional bin
+     */
+    float complex out_rot_incr;
+
+    /**
+     * Filtered samples produced by the last block that haven't been collected yet, as
+     * interleaved Q.15 I/Q.
+     */
+    int16_t *pending;
+    size_t nr_pending;
+    size_t pending_offset;
+
+    /**
+     * The input samples, including the overlap with the previous block
+     */
+    struct sample_history hist;
+
+    /**
+     * The largest number of samples pushed in a single sample buffer
+     */
+    size_t max_push;
+};
+
+/**
+ * Create a fast convolution filter, equivalent to a direct FIR with the given complex Q.15
+ * coefficients, decimation and derotation.
+ *
+ * \param pfc The new filter, returned by reference
+ * \param nr_coeffs The number of coefficients
+ * \param real_coeffs The real part of the Q.15 coefficients
+ * \param imag_coeffs The imaginary part of the Q.15 coefficients
+ * \param decimation The decimation factor
+ * \param sampling_rate The input sampling rate, in Hz
+ * \param freq_shift The offset of the channel to be shifted down to baseband, in Hz
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t fast_conv_new(struct fast_conv **pfc, size_t nr_coeffs, const int16_t *real_coeffs,
+        const int16_t *imag_coeffs, unsigned decimation, uint32_t sampling_rate, int32_t freq_shift);
+
+/**
+ * Release a fast convolution filter.
+ *
+ * \param pfc The filter, passed by reference. Set to NULL on success.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t fast_conv_delete(struct fast_conv **pfc);
+
+/**
+ * Push a sample buffer of complex Q.15 samples into the filter. The samples are copied and the
+ * sample buffer is released.
+ *
+ * \param fc The filter
+ * \param buf The sample buffer
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t fast_conv_push_sample_buf(struct fast_conv *fc, struct sample_buf *buf);
+
+/**
+ * Filter as many samples as possible, constrained by the samples available and the space in
+ * the output buffer.
+ *
+ * \param fc The filter
+ * \param out_buf The output buffer, interleaved Q.15 I/Q
+ * \param nr_out_samples The number of samples out_buf can hold
+ * \param pnr_out_samples The number of samples written to out_buf, returned by reference
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t fast_conv_process(struct fast_conv *fc, int16_t *out_buf, size_t nr_out_samples, size_t *pnr_out_samples);
+
+/**
+ * Determine whether any output can be produced without pushing more samples.
+ *
+ * \param fc The filter
+ * \param pcan_process Whether there is output available, returned by reference
+ * \param pest_count The number of samples that could be produced, returned by reference. Optional.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t fast_conv_can_process(struct fast_conv *fc, bool *pcan_process, size_t *pest_count);
+
+/**
+ * Determine whether the filter already has a full sample buffer waiting beyond what it needs
+ * for the next block. See `direct_fir_full`.
+ *
+ * \param fc The filter
+ * \param pfull Whether there is a backlog, returned by reference
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t fast_conv_full(struct fast_conv *fc, bool *pfull);
+
+/**
+ * Estimate the number of real multiplies needed per output sample.
+ *
+ * \param nr_coeffs The number of filter coefficients
+ * \param decimation The decimation factor
+ */
+size_t fast_conv_cost(size_t nr_coeffs, unsigned decimation);
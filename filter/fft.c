@@ -0,0 +1,305 @@
+/*
+ *  fft.c - A small mixed-radix complex FFT, for filter banks and fast
+ *      convolution.
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/fft.h>
+#include <filter/filter_priv.h>
+
+#include <tsl/safe_alloc.h>
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+
+#include <math.h>
+
+/**
+ * The maximum number of (radix, remainder) pairs in a factorization. Enough for any
+ * 32-bit transform size.
+ */
+#define FFT_MAX_FACTORS             32
+
+/**
+ * An FFT plan. Decimation-in-time, recursive over the factors of the transform length.
+ */
+struct fft {
+    /**
+     * The number of points in the transform
+     */
+    size_t nr_points;
+
+    /**
+     * Whether this is an inverse transform
+     */
+    bool inverse;
+
+    /**
+     * The factorization of nr_points, as (radix, remaining length) pairs
+     */
+    size_t factors[2 * FFT_MAX_FACTORS];
+
+    /**
+     * Twiddle factors, exp(-/+ 2*pi*i*k/N) for k in [0, N)
+     */
+    float complex *twiddles;
+
+    /**
+     * Scratch space for the generic radix butterfly, sized to the largest radix
+     */
+    float complex *scratch;
+};
+
+/**
+ * Complex multiply without the C99 Annex G NaN/Inf recovery, which the compiler otherwise
+ * emits as a library call.
+ */
+static inline
+float complex _fft_cmul(float complex a, float complex b)
+{
+    return CMPLXF(crealf(a) * crealf(b) - cimagf(a) * cimagf(b),
+                  crealf(a) * cimagf(b) + cimagf(a) * crealf(b));
+}
+
+static
+void _fft_butterfly_2(struct fft *fft, float complex *out, size_t stride, size_t m)
+{
+    float complex *out2 = out + m;
+
+    for (size_t k = 0; k < m; k++) {
+        float complex t = _fft_cmul(out2[k], fft->twiddles[k * stride]);
+        out2[k] = out[k] - t;
+        out[k] += t;
+    }
+}
+
+static
+void _fft_butterfly_4(struct fft *fft, float complex *out, size_t stride, size_t m)
+{
+    for (size_t k = 0; k < m; k++) {
+        float complex s0 = _fft_cmul(out[k +     m], fft->twiddles[    k * stride]),
+                      s1 = _fft_cmul(out[k + 2 * m], fft->twiddles[2 * k * stride]),
+                      s2 = _fft_cmul(out[k + 3 * m], fft->twiddles[3 * k * stride]),
+                      s3 = s0 + s2,
+                      s4 = s0 - s2,
+                      s5 = out[k] - s1,
+                      s4_rot = CMPLXF(cimagf(s4), -crealf(s4));
+
+        out[k] += s1;
+        out[k + 2 * m] = out[k] - s3;
+        out[k] += s3;
+
+        /* s4_rot is -i * s4; the inverse transform rotates the other way */
+        if (false == fft->inverse) {
+            out[k +     m] = s5 + s4_rot;
+            out[k + 3 * m] = s5 - s4_rot;
+        } else {
+            out[k +     m] = s5 - s4_rot;
+            out[k + 3 * m] = s5 + s4_rot;
+        }
+    }
+}
+
+static
+void _fft_butterfly_generic(struct fft *fft, float complex *out, size_t stride, size_t p, size_t m)
+{
+    float complex *scratch = fft->scratch;
+    size_t n = fft->nr_points;
+
+    for (size_t u = 0; u < m; u++) {
+        for (size_t q1 = 0, k = u; q1 < p; q1++, k += m) {
+            scratch[q1] = out[k];
+        }
+
+        for (size_t q1 = 0, k = u; q1 < p; q1++, k += m) {
+            size_t tw_idx = 0;
+            float complex acc = scratch[0];
+
+            for (size_t q = 1; q < p; q++) {
+                tw_idx += stride * k;
+                tw_idx %= n;
+                acc += _fft_cmul(scratch[q], fft->twiddles[tw_idx]);
+            }
+
+            out[k] = acc;
+        }
+    }
+}
+
+static
+void _fft_work(struct fft *fft, float complex *out, const float complex *in, size_t stride,
+        const size_t *factors)
+{
+    size_t p = factors[0],
+           m = factors[1];
+
+    if (1 == m) {
+        for (size_t i = 0; i < p; i++) {
+            out[i] = in[i * stride];
+        }
+    } else {
+        /* Recursively compute the p sub-transforms of length m */
+        for (size_t i = 0; i < p; i++) {
+            _fft_work(fft, out + i * m, in + i * stride, stride * p, factors + 2);
+        }
+    }
+
+    switch (p) {
+    case 2:
+        _fft_butterfly_2(fft, out, stride, m);
+        break;
+    case 4:
+        _fft_butterfly_4(fft, out, stride, m);
+        break;
+    default:
+        _fft_butterfly_generic(fft, out, stride, p, m);
+        break;
+    }
+}
+
+aresult_t fft_new(struct fft **pfft, size_t nr_points, bool inverse)
+{
+    aresult_t ret = A_OK;
+
+    struct fft *fft = NULL;
+    size_t n = nr_points,
+           p = 4,
+           max_radix = 0,
+           nr_factors = 0;
+    double sign = (true == inverse) ? 1.0 : -1.0,
+           sqrt_n = floor(sqrt((double)nr_points));
+
+    TSL_ASSERT_ARG(NULL != pfft);
+    TSL_ASSERT_ARG(0 != nr_points);
+
+    *pfft = NULL;
+
+    if (FAILED(ret = TZAALLOC(fft, SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    fft->nr_points = nr_points;
+    fft->inverse = inverse;
+
+    /* Factor the transform length, preferring radix 4, then 2, 3, 5, ... */
+    do {
+        while (0 != n % p) {
+            switch (p) {
+            case 4:
+                p = 2;
+                break;
+            case 2:
+                p = 3;
+                break;
+            default:
+                p += 2;
+                break;
+            }
+
+            if ((double)p > sqrt_n) {
+                p = n;
+            }
+        }
+
+        n /= p;
+
+        TSL_BUG_ON(nr_factors >= FFT_MAX_FACTORS);
+        fft->factors[2 * nr_factors    ] = p;
+        fft->factors[2 * nr_factors + 1] = n;
+        nr_factors++;
+
+        max_radix = BL_MAX2(max_radix, p);
+    } while (n > 1);
+
+    if (FAILED(ret = TACALLOC((void **)&fft->twiddles, nr_points, sizeof(float complex), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < nr_points; i++) {
+        double phase = sign * 2.0 * M_PI * (double)i / (double)nr_points;
+        fft->twiddles[i] = CMPLXF((float)cos(phase), (float)sin(phase));
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&fft->scratch, max_radix, sizeof(float complex), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    DIAG("FFT: %zu points, %zu factors, largest radix %zu, %s", nr_points, nr_factors, max_radix,
+            true == inverse ? "inverse" : "forward");
+
+    *pfft = fft;
+
+done:
+    if (FAILED(ret)) {
+        if (NULL != fft) {
+            if (NULL != fft->twiddles) {
+                TFREE(fft->twiddles);
+            }
+            TFREE(fft);
+        }
+    }
+    return ret;
+}
+
+aresult_t fft_delete(struct fft **pfft)
+{
+    aresult_t ret = A_OK;
+
+    struct fft *fft = NULL;
+
+    TSL_ASSERT_PTR_BY_REF(pfft);
+
+    fft = *pfft;
+
+    if (NULL != fft->twiddles) {
+        TFREE(fft->twiddles);
+    }
+
+    if (NULL != fft->scratch) {
+        TFREE(fft->scratch);
+    }
+
+    TFREE(fft);
+    *pfft = NULL;
+
+    return ret;
+}
+
+aresult_t fft_execute(struct fft *fft, const float complex *in, float complex *out)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != fft);
+    TSL_ASSERT_ARG_DEBUG(NULL != in);
+    TSL_ASSERT_ARG_DEBUG(NULL != out);
+    TSL_ASSERT_ARG_DEBUG(in != out);
+
+    _fft_work(fft, out, in, 1, fft->factors);
+
+    return ret;
+}
+
+size_t fft_nr_points(const struct fft *fft)
+{
+    TSL_BUG_ON(NULL == fft);
+
+    return fft->nr_points;
+}
+
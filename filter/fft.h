@@ -0,0 +1,48 @@
+#pragma once
+
+#include <tsl/result.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <complex.h>
+
+struct fft;
+
+/**
+ * Create a new mixed-radix complex FFT plan. Sizes that factor into 2, 3, 4 and 5 are fastest,
+ * but any size is supported (large prime factors fall back to a generic O(p^2) butterfly).
+ *
+ * \param pfft The new FFT plan, returned by reference.
+ * \param nr_points The number of points in the transform.
+ * \param inverse Set to `true` for the (unnormalized) inverse transform, i.e. a positive
+ *                exponent in the twiddle factors.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t fft_new(struct fft **pfft, size_t nr_points, bool inverse);
+
+/**
+ * Release the resources held by an FFT plan.
+ *
+ * \param pfft The FFT plan, passed by reference. Set to NULL on success.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t fft_delete(struct fft **pfft);
+
+/**
+ * Execute the FFT. The transform is out-of-place; in and out must not overlap.
+ *
+ * \param fft The FFT plan
+ * \param in The nr_points input samples
+ * \param out The nr_points output bins
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t fft_execute(struct fft *fft, const float complex *in, float complex *out);
+
+/**
+ * Get the number of points this FFT plan was created for.
+ */
+size_t fft_nr_points(const struct fft *fft);
+
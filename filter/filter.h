@@ -5,6 +5,8 @@
  *
  * - Direct FIR (includes an optional phase derotator)
  * - Polyphase FIR (supports rational resampling)
+ * - Polyphase FFT filter bank channelizer
+ * - Halfband and CIC decimation chains
  *
  */
 
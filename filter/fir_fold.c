@@ -0,0 +1,268 @@
+/*
+ *  fir_fold.c - Take advantage of symmetric FIR coefficients
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/fir_fold.h>
+#include <filter/kernels.h>
+#include <filter/kernels_priv.h>
+
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+#include <tsl/safe_alloc.h>
+
+#include <stdbool.h>
+#include <string.h>
+
+/**
+ * Work out whether, and how, a set of coefficients can be folded.
+ *
+ * \return The symmetry of the coefficients. If not FIR_SYMMETRY_NONE, the index of the first
+ *         non-zero tap, the distance between non-zero taps and the number of folded
+ *         coefficients are returned by reference.
+ */
+static
+enum fir_symmetry _fir_fold_analyze(const int16_t *coeffs, size_t nr_taps, size_t *pfirst, size_t *pstep,
+        size_t *pnr_coeffs)
+{
+    enum fir_symmetry symmetry = FIR_SYMMETRY_NONE;
+    size_t half = nr_taps / 2,
+           first = 0,
+           step = 2;
+    bool even = true,
+         odd = true;
+
+    if (nr_taps < 2) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < half; i++) {
+        even = even && coeffs[i] == coeffs[nr_taps - 1 - i];
+        odd = odd && (int32_t)coeffs[i] == -(int32_t)coeffs[nr_taps - 1 - i];
+    }
+
+    /* The middle tap of an antisymmetric filter is its own negation */
+    if (0 != nr_taps % 2) {
+        odd = odd && 0 == coeffs[half];
+    }
+
+    if (!even && !odd) {
+        goto done;
+    }
+
+    symmetry = even ? FIR_SYMMETRY_EVEN : FIR_SYMMETRY_ODD;
+
+    /* Skip zero padding */
+    while (first < half && 0 == coeffs[first]) {
+        first++;
+    }
+
+    /* A halfband filter has every other tap zero, counting out from the first non-zero tap */
+    for (size_t i = first + 1; i < half; i += 2) {
+        if (0 != coeffs[i]) {
+            step = 1;
+            break;
+        }
+    }
+
+    *pfirst = first;
+    *pstep = step;
+    *pnr_coeffs = (half - first + step - 1) / step;
+
+done:
+    return symmetry;
+}
+
+aresult_t fir_fold_init(struct fir_fold *fold, const int16_t *coeffs, size_t nr_taps)
+{
+    aresult_t ret = A_OK;
+
+    size_t first = 0,
+           step = 0,
+           nr_coeffs = 0;
+    enum fir_symmetry symmetry = FIR_SYMMETRY_NONE;
+
+    TSL_ASSERT_ARG(NULL != fold);
+    TSL_ASSERT_ARG(NULL != coeffs);
+
+    memset(fold, 0, sizeof(*fold));
+
+    symmetry = _fir_fold_analyze(coeffs, nr_taps, &first, &step, &nr_coeffs);
+
+    if (FIR_SYMMETRY_NONE == symmetry) {
+        goto done;
+    }
+
+    /* Keep at least one coefficient around, so the kernels never see a NULL pointer */
+    if (FAILED(ret = TACALLOC((void **)&fold->coeffs, BL_MAX2(nr_coeffs, 1), sizeof(int16_t), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    for (size_t j = 0; j < nr_coeffs; j++) {
+        fold->coeffs[j] = coeffs[first + j * step];
+    }
+
+    fold->symmetry = symmetry;
+    fold->nr_taps = nr_taps;
+    fold->nr_coeffs = nr_coeffs;
+    fold->first = first;
+    fold->step = step;
+    fold->center = (FIR_SYMMETRY_EVEN == symmetry && 0 != nr_taps % 2) ? coeffs[nr_taps / 2] : 0;
+
+    DIAG("FIR: folded %zu %ssymmetric taps to %zu coefficients%s", nr_taps,
+            FIR_SYMMETRY_ODD == symmetry ? "anti" : "", nr_coeffs, 2 == step ? " (halfband)" : "");
+
+done:
+    return ret;
+}
+
+aresult_t fir_fold_cleanup(struct fir_fold *fold)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != fold);
+
+    if (NULL != fold->coeffs) {
+        TFREE(fold->coeffs);
+    }
+
+    fold->symmetry = FIR_SYMMETRY_NONE;
+
+    return ret;
+}
+
+size_t fir_fold_nr_mults(const int16_t *coeffs, size_t nr_taps)
+{
+    size_t first = 0,
+           step = 0,
+           nr_coeffs = 0,
+           nr_mults = nr_taps;
+
+    if (FIR_SYMMETRY_NONE != _fir_fold_analyze(coeffs, nr_taps, &first, &step, &nr_coeffs)) {
+        nr_mults = nr_coeffs + (0 != nr_taps % 2 && 0 != coeffs[nr_taps / 2]);
+    }
+
+    return nr_mults;
+}
+
+/**
+ * Sum the folded products for real samples. step and sign are always constants, so each
+ * combination gets its own loop, simple enough to vectorize.
+ */
+FILTER_ALWAYS_INLINE
+int32_t _fir_fold_sum(const int16_t *restrict coeffs, const int16_t *restrict lo, const int16_t *restrict hi,
+        size_t nr_coeffs, size_t step, int32_t sign)
+{
+    int32_t acc = 0;
+
+    for (size_t j = 0; j < nr_coeffs; j++) {
+        acc += (int32_t)coeffs[j] * ((int32_t)lo[j * step] + sign * hi[-(ptrdiff_t)(j * step)]);
+    }
+
+    return acc;
+}
+
+FILTER_ALWAYS_INLINE
+void _fir_fold_dot_body(const struct fir_fold *fold, const int16_t *restrict samples, int32_t *pacc)
+{
+    const int16_t *lo = samples + fold->first,
+                  *hi = samples + fold->nr_taps - 1 - fold->first;
+    int32_t acc = (int32_t)fold->center * samples[fold->nr_taps / 2];
+
+    if (FIR_SYMMETRY_EVEN == fold->symmetry) {
+        acc += 1 == fold->step ? _fir_fold_sum(fold->coeffs, lo, hi, fold->nr_coeffs, 1, 1) :
+                                 _fir_fold_sum(fold->coeffs, lo, hi, fold->nr_coeffs, 2, 1);
+    } else {
+        acc += 1 == fold->step ? _fir_fold_sum(fold->coeffs, lo, hi, fold->nr_coeffs, 1, -1) :
+                                 _fir_fold_sum(fold->coeffs, lo, hi, fold->nr_coeffs, 2, -1);
+    }
+
+    *pacc = acc;
+}
+
+void fir_fold_dot_scalar(const struct fir_fold *fold, const int16_t *samples, int32_t *pacc)
+{
+    _fir_fold_dot_body(fold, samples, pacc);
+}
+
+/**
+ * Sum the folded products for interleaved I/Q samples
+ */
+FILTER_ALWAYS_INLINE
+void _fir_fold_sum_iq(const int16_t *restrict coeffs, const int16_t *restrict lo, const int16_t *restrict hi,
+        size_t nr_coeffs, size_t step, int32_t sign, int32_t *pacc_re, int32_t *pacc_im)
+{
+    int32_t acc_re = 0,
+            acc_im = 0;
+
+    for (size_t j = 0; j < nr_coeffs; j++) {
+        int32_t c = coeffs[j];
+        ptrdiff_t k = 2 * j * step;
+
+        acc_re += c * ((int32_t)lo[k    ] + sign * hi[-k]);
+        acc_im += c * ((int32_t)lo[k + 1] + sign * hi[1 - k]);
+    }
+
+    *pacc_re += acc_re;
+    *pacc_im += acc_im;
+}
+
+FILTER_ALWAYS_INLINE
+void _fir_fold_dot_iq_body(const struct fir_fold *fold, const int16_t *restrict samples, int32_t *pacc_re,
+        int32_t *pacc_im)
+{
+    const int16_t *lo = samples + 2 * fold->first,
+                  *hi = samples + 2 * (fold->nr_taps - 1 - fold->first);
+    int32_t acc_re = (int32_t)fold->center * samples[2 * (fold->nr_taps / 2)    ],
+            acc_im = (int32_t)fold->center * samples[2 * (fold->nr_taps / 2) + 1];
+
+    if (FIR_SYMMETRY_EVEN == fold->symmetry) {
+        if (1 == fold->step) {
+            _fir_fold_sum_iq(fold->coeffs, lo, hi, fold->nr_coeffs, 1, 1, &acc_re, &acc_im);
+        } else {
+            _fir_fold_sum_iq(fold->coeffs, lo, hi, fold->nr_coeffs, 2, 1, &acc_re, &acc_im);
+        }
+    } else {
+        if (1 == fold->step) {
+            _fir_fold_sum_iq(fold->coeffs, lo, hi, fold->nr_coeffs, 1, -1, &acc_re, &acc_im);
+        } else {
+            _fir_fold_sum_iq(fold->coeffs, lo, hi, fold->nr_coeffs, 2, -1, &acc_re, &acc_im);
+        }
+    }
+
+    *pacc_re = acc_re;
+    *pacc_im = acc_im;
+}
+
+void fir_fold_dot_iq_scalar(const struct fir_fold *fold, const int16_t *samples, int32_t *pacc_re,
+        int32_t *pacc_im)
+{
+    _fir_fold_dot_iq_body(fold, samples, pacc_re, pacc_im);
+}
+
+#ifdef _FILTER_HAVE_X86_KERNELS
+FILTER_DEFINE_X86_VARIANTS(fir_fold_dot,
+        (const struct fir_fold *fold, const int16_t *samples, int32_t *pacc),
+        (fold, samples, pacc))
+FILTER_DEFINE_X86_VARIANTS(fir_fold_dot_iq,
+        (const struct fir_fold *fold, const int16_t *samples, int32_t *pacc_re, int32_t *pacc_im),
+        (fold, samples, pacc_re, pacc_im))
+#endif /* defined(_FILTER_HAVE_X86_KERNELS) */
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <tsl/result.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The symmetry of a set of FIR coefficients about their midpoint
+ */
+enum fir_symmetry {
+    /**
+     * No symmetry we can take advantage of
+     */
+    FIR_SYMMETRY_NONE = 0,
+
+    /**
+     * c[i] == c[N - 1 - i]. Every linear-phase low pass is like this.
+     */
+    FIR_SYMMETRY_EVEN,
+
+    /**
+     * c[i] == -c[N - 1 - i]. Differentiators and Hilbert transformers.
+     */
+    FIR_SYMMETRY_ODD,
+};
+
+/**
+ * A symmetric or antisymmetric FIR, folded in half. The two samples that share a coefficient are
+ * added (or subtracted) before the multiply, so a dot product over the folded filter takes half
+ * the multiplies.
+ *
+ * Zero taps are skipped as well: leading and trailing zeros (i.e. padding) are left out, and if
+ * every other tap is zero, as in a halfband filter, only the non-zero taps are kept.
+ *
+ * The folded dot product is bit-exact with the dot product over the original coefficients.
+ */
+struct fir_fold {
+    /**
+     * The symmetry of the original coefficients. FIR_SYMMETRY_NONE if the filter isn't folded,
+     * in which case nothing else here is valid.
+     */
+    enum fir_symmetry symmetry;
+
+    /**
+     * The number of taps in the original filter
+     */
+    size_t nr_taps;
+
+    /**
+     * The non-zero coefficients of the first half of the filter, not counting the middle tap.
+     * Coefficient j applies to samples first + j * step and nr_taps - 1 - first - j * step.
+     */
+    int16_t *coeffs;
+
+    /**
+     * The number of coefficients in coeffs
+     */
+    size_t nr_coeffs;
+
+    /**
+     * The index of the first non-zero tap
+     */
+    size_t first;
+
+    /**
+     * The distance between non-zero taps: 2 for a halfband filter, 1 otherwise
+     */
+    size_t step;
+
+    /**
+     * The middle tap, for an odd number of taps. Always 0 otherwise, or for an antisymmetric
+     * filter.
+     */
+    int16_t center;
+};
+
+/**
+ * Fold a set of real Q.15 coefficients, if they are symmetric or antisymmetric. This function
+ * allocates memory if the coefficients can be folded.
+ *
+ * \param fold The folded filter. If the coefficients can't be folded, fold->symmetry is set
+ *             to FIR_SYMMETRY_NONE.
+ * \param coeffs The coefficients
+ * \param nr_taps The number of coefficients
+ *
+ * \return A_OK on success, an error code otherwise. Not being able to fold the coefficients
+ *         is not an error.
+ */
+aresult_t fir_fold_init(struct fir_fold *fold, const int16_t *coeffs, size_t nr_taps);
+
+/**
+ * Release the memory held by a folded filter.
+ */
+aresult_t fir_fold_cleanup(struct fir_fold *fold);
+
+/**
+ * Count the multiplies a real dot product over these coefficients takes, folding them if
+ * possible. Doesn't allocate anything; useful for comparing filter strategies.
+ *
+ * \param coeffs The coefficients
+ * \param nr_taps The number of coefficients
+ *
+ * \return The number of multiplies per dot product
+ */
+size_t fir_fold_nr_mults(const int16_t *coeffs, size_t nr_taps);
@@ -0,0 +1,221 @@
+/*
+ *  fm_disc.c - FM discriminators
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/filter.h>
+#include <filter/fm_disc.h>
+#include <filter/kernels.h>
+#include <filter/kernels_priv.h>
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+
+/**
+ * Fractional bits the CORDIC keeps below the output LSB while it accumulates the angle
+ */
+#define FM_DISC_CORDIC_FRAC_BITS        15
+
+/**
+ * pi, in the CORDIC's angle units
+ */
+#define FM_DISC_CORDIC_PI               (INT32_C(1) << (Q_15_SHIFT + FM_DISC_CORDIC_FRAC_BITS))
+
+/**
+ * atan(2^-i), in the CORDIC's angle units
+ */
+static
+const int32_t _fm_disc_cordic_atan[FM_DISC_CORDIC_ITERATIONS] = {
+    134217728, 79233351, 41864727, 21251189, 10666833, 5338616, 2669960, 1335061,
+    667541, 333772, 166886, 83443, 41722, 20861, 10430, 5215,
+};
+
+/**
+ * Arctangent of y/x, over the whole circle, scaled to the Q.15 output and rounded. The angle of the smaller
+ * component over the larger is a polynomial over [0, 1] (good to about 2e-6 radians), then it
+ * is reflected into the right octant, and takes the sign of y. Every step is a select rather than a
+ * branch, so this is worked out across vector lanes.
+ */
+FILTER_ALWAYS_INLINE
+int16_t _fm_disc_atan2(float y, float x)
+{
+    static const float to_q15 = (float)(1 << Q_15_SHIFT) / (float)M_PI;
+    float ax = fabsf(x),
+          ay = fabsf(y),
+          mx = ax > ay ? ax : ay,
+          mn = ax > ay ? ay : ax,
+          /* If both are 0, so is the angle; FLT_MIN keeps the division defined */
+          a = mn / (mx + FLT_MIN),
+          s = a * a,
+          r = a * (0.99997726f + s * (-0.33262347f + s * (0.19354346f + s * (-0.11643287f +
+                      s * (0.05265332f + s * -0.01172120f)))));
+
+    /*
+     * Each reflection multiplies and offsets by constants picked by a comparison. Only the
+     * constants are selected: the compiler won't turn a choice between two float expressions
+     * into a select, so writing the reflections out as a ternary leaves a branch.
+     */
+    r = (ay > ax ? (float)M_PI_2 : 0.0f) + (ay > ax ? -r : r);
+    r = (x < 0.0f ? (float)M_PI : 0.0f) + (x < 0.0f ? -r : r);
+    r = copysignf(r, y) * to_q15;
+
+    /* Round to nearest, away from zero on a tie */
+    return (int16_t)(r + copysignf(0.5f, r));
+}
+
+/**
+ * The phase of a times the conjugate of b, with the arctangent done in float. Each product is
+ * scaled down by 4 first, the same as for the CORDIC, so a full scale negative sample can't
+ * overflow the sum.
+ */
+FILTER_ALWAYS_INLINE
+int16_t _fm_disc_q15_one(int32_t a_re, int32_t a_im, int32_t b_re, int32_t b_im)
+{
+    int32_t s_re = ((a_re * b_re) >> 2) + ((a_im * b_im) >> 2),
+            s_im = ((a_im * b_re) >> 2) - ((a_re * b_im) >> 2);
+
+    return _fm_disc_atan2((float)s_im, (float)s_re);
+}
+
+/**
+ * The phase of a times the conjugate of b, with a CORDIC in vectoring mode. The vector is
+ * flipped into the right half plane, then rotated onto the x axis by +/-atan(2^-i) at each step,
+ * adding up the rotations. Each product is scaled down by 4 first, so the CORDIC's gain of
+ * about 1.65 can't overflow. The iterations are unrolled, so the shifts are by constants and
+ * the loop over samples vectorizes.
+ */
+FILTER_ALWAYS_INLINE
+int16_t _fm_disc_cordic_one(int32_t a_re, int32_t a_im, int32_t b_re, int32_t b_im)
+{
+    int32_t x = ((a_re * b_re) >> 2) + ((a_im * b_im) >> 2),
+            y = ((a_im * b_re) >> 2) - ((a_re * b_im) >> 2),
+            angle = 0;
+    bool flip = x < 0,
+         zero = 0 == x && 0 == y;
+
+    /* Rotate by pi into the right half plane, starting from +/-pi */
+    angle = flip ? (y < 0 ? -FM_DISC_CORDIC_PI : FM_DISC_CORDIC_PI) : 0;
+    x = flip ? -x : x;
+    y = flip ? -y : y;
+
+#pragma GCC unroll 16
+    for (int i = 0; i < FM_DISC_CORDIC_ITERATIONS; i++) {
+        int32_t dx = y >> i,
+                dy = x >> i;
+        bool below = y < 0;
+
+        x = below ? x - dx : x + dx;
+        y = below ? y + dy : y - dy;
+        angle = below ? angle - _fm_disc_cordic_atan[i] : angle + _fm_disc_cordic_atan[i];
+    }
+
+    /* A zero vector has no angle, and the CORDIC would wander off anyway */
+    return zero ? 0 : (int16_t)((angle + (1 << (FM_DISC_CORDIC_FRAC_BITS - 1))) >> FM_DISC_CORDIC_FRAC_BITS);
+}
+
+/*
+ * The first sample pairs up with the last one from the previous call; the rest pair up with the
+ * sample before them, straight out of the buffer, so there's no dependency between iterations.
+ */
+#define _FM_DISC_BODY(one, samples, nr_samples, last, out) \
+    do { \
+        if (0 != (nr_samples)) { \
+            (out)[0] = one((samples)[0], (samples)[1], (last)[0], (last)[1]); \
+            for (size_t i = 1; i < (nr_samples); i++) { \
+                (out)[i] = one((samples)[2 * i], (samples)[2 * i + 1], \
+                        (samples)[2 * i - 2], (samples)[2 * i - 1]); \
+            } \
+            (last)[0] = (samples)[2 * (nr_samples) - 2]; \
+            (last)[1] = (samples)[2 * (nr_samples) - 1]; \
+        } \
+    } while (0)
+
+FILTER_ALWAYS_INLINE
+void _fm_disc_q15_body(const int16_t *restrict samples, size_t nr_samples, int16_t *restrict last,
+        int16_t *restrict out)
+{
+    _FM_DISC_BODY(_fm_disc_q15_one, samples, nr_samples, last, out);
+}
+
+FILTER_ALWAYS_INLINE
+void _fm_disc_q15_cordic_body(const int16_t *restrict samples, size_t nr_samples, int16_t *restrict last,
+        int16_t *restrict out)
+{
+    _FM_DISC_BODY(_fm_disc_cordic_one, samples, nr_samples, last, out);
+}
+
+/**
+ * The phase of a times the conjugate of b, for float samples
+ */
+FILTER_ALWAYS_INLINE
+int16_t _fm_disc_f32_one(float a_re, float a_im, float b_re, float b_im)
+{
+    return _fm_disc_atan2(a_im * b_re - a_re * b_im, a_re * b_re + a_im * b_im);
+}
+
+FILTER_ALWAYS_INLINE
+void _fm_disc_f32_body(const float *restrict samples, size_t nr_samples, float *restrict last,
+        int16_t *restrict out)
+{
+    _FM_DISC_BODY(_fm_disc_f32_one, samples, nr_samples, last, out);
+}
+
+void fm_disc_q15_scalar(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out)
+{
+    _fm_disc_q15_body(samples, nr_samples, last, out);
+}
+
+void fm_disc_q15_cordic_scalar(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out)
+{
+    _fm_disc_q15_cordic_body(samples, nr_samples, last, out);
+}
+
+void fm_disc_f32_scalar(const float *samples, size_t nr_samples, float *last, int16_t *out)
+{
+    _fm_disc_f32_body(samples, nr_samples, last, out);
+}
+
+#ifdef _FILTER_HAVE_X86_KERNELS
+FILTER_DEFINE_X86_VARIANTS(fm_disc_q15,
+        (const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out),
+        (samples, nr_samples, last, out))
+FILTER_DEFINE_X86_VARIANTS(fm_disc_q15_cordic,
+        (const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out),
+        (samples, nr_samples, last, out))
+FILTER_DEFINE_X86_VARIANTS(fm_disc_f32,
+        (const float *samples, size_t nr_samples, float *last, int16_t *out),
+        (samples, nr_samples, last, out))
+#endif /* defined(_FILTER_HAVE_X86_KERNELS) */
+
+void fm_disc_q15(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out)
+{
+    filter_kernels->fm_disc_q15(samples, nr_samples, last, out);
+}
+
+void fm_disc_q15_cordic(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out)
+{
+    filter_kernels->fm_disc_q15_cordic(samples, nr_samples, last, out);
+}
+
+void fm_disc_f32(const float *samples, size_t nr_samples, float *last, int16_t *out)
+{
+    filter_kernels->fm_disc_f32(samples, nr_samples, last, out);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * FM discriminators. Each one works out the phase difference between consecutive complex
+ * samples, scaled so that +/-pi is +/-(1 << Q_15_SHIFT), the same as the Q.15 output of the
+ * rest of the filters. The phase difference for every sample only depends on the sample and the
+ * one before it, so whole blocks of samples are handled at once, with the arctangent worked
+ * out in every lane in parallel.
+ */
+
+/**
+ * The number of CORDIC iterations the integer discriminator does. Each iteration halves the
+ * remaining angle, and 16 iterations leave it well under half of an output LSB.
+ */
+#define FM_DISC_CORDIC_ITERATIONS       16
+
+/**
+ * Discriminate interleaved Q.15 I/Q samples, with the arctangent done with a polynomial over
+ * float lanes. Uses the best kernel for this CPU.
+ *
+ * \param samples The interleaved I/Q samples
+ * \param nr_samples The number of complex samples
+ * \param last The previous complex sample, from the end of the previous call. Updated to the last
+ *             of these samples.
+ * \param out The phase differences, one per sample
+ */
+void fm_disc_q15(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out);
+
+/**
+ * The same as `fm_disc_q15`, but the arctangent is done with a CORDIC, in fixed point, so no
+ * floating point is used at all. Gives the same result on every CPU.
+ */
+void fm_disc_q15_cordic(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out);
+
+/**
+ * Discriminate interleaved float I/Q samples, with the arctangent done with a polynomial. Uses
+ * the best kernel for this CPU.
+ *
+ * \param samples The interleaved I/Q samples
+ * \param nr_samples The number of complex samples
+ * \param last The previous complex sample, updated to the last of these samples
+ * \param out The phase differences, one per sample
+ */
+void fm_disc_f32(const float *samples, size_t nr_samples, float *last, int16_t *out);
@@ -0,0 +1,280 @@
+/*
+ *  kernels.c - Runtime selection of DSP kernels for the CPU we're running on
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/kernels.h>
+#include <filter/kernels_priv.h>
+#include <filter/filter_priv.h>
+
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+
+#include <pthread.h>
+
+#if defined(_USE_ARM_NEON) && defined(__arm__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+static
+const struct filter_kernels _filter_kernels_scalar = {
+    .isa = FILTER_ISA_SCALAR,
+    .direct_fir_dot = direct_fir_dot_scalar,
+    .direct_fir_dot_block = direct_fir_dot_block_scalar,
+    .direct_fir_dot_u8 = direct_fir_dot_u8_scalar,
+    .direct_fir_dot_block_u8 = direct_fir_dot_block_u8_scalar,
+    .direct_fir_dot_real = direct_fir_dot_real_scalar,
+    .direct_fir_dot_real_block = direct_fir_dot_real_block_scalar,
+    .direct_fir_batch_dot = direct_fir_batch_dot_scalar,
+    .direct_fir_batch_dot_u8 = direct_fir_batch_dot_u8_scalar,
+    .dot_real = dot_real_scalar,
+    .dot_real_block = dot_real_block_scalar,
+    .fir_fold_dot = fir_fold_dot_scalar,
+    .fir_fold_dot_iq = fir_fold_dot_iq_scalar,
+    .nco_rotate = nco_rotate_scalar,
+    .direct_fir_f32_dot = direct_fir_f32_dot_scalar,
+    .direct_fir_f32_dot_block = direct_fir_f32_dot_block_scalar,
+    .fm_disc_q15 = fm_disc_q15_scalar,
+    .fm_disc_q15_cordic = fm_disc_q15_cordic_scalar,
+    .fm_disc_f32 = fm_disc_f32_scalar,
+};
+
+#ifdef _FILTER_HAVE_X86_KERNELS
+static
+const struct filter_kernels _filter_kernels_sse41 = {
+    .isa = FILTER_ISA_SSE41,
+    .direct_fir_dot = direct_fir_dot_sse41,
+    .direct_fir_dot_block = direct_fir_dot_block_sse41,
+    .direct_fir_dot_u8 = direct_fir_dot_u8_sse41,
+    .direct_fir_dot_block_u8 = direct_fir_dot_block_u8_sse41,
+    .direct_fir_dot_real = direct_fir_dot_real_sse41,
+    .direct_fir_dot_real_block = direct_fir_dot_real_block_sse41,
+    .direct_fir_batch_dot = direct_fir_batch_dot_sse41,
+    .direct_fir_batch_dot_u8 = direct_fir_batch_dot_u8_sse41,
+    .dot_real = dot_real_sse41,
+    .dot_real_block = dot_real_block_sse41,
+    .fir_fold_dot = fir_fold_dot_sse41,
+    .fir_fold_dot_iq = fir_fold_dot_iq_sse41,
+    .nco_rotate = nco_rotate_sse41,
+    .direct_fir_f32_dot = direct_fir_f32_dot_sse41,
+    .direct_fir_f32_dot_block = direct_fir_f32_dot_block_sse41,
+    .fm_disc_q15 = fm_disc_q15_sse41,
+    .fm_disc_q15_cordic = fm_disc_q15_cordic_sse41,
+    .fm_disc_f32 = fm_disc_f32_sse41,
+};
+
+static
+const struct filter_kernels _filter_kernels_avx2 = {
+    .isa = FILTER_ISA_AVX2,
+    .direct_fir_dot = direct_fir_dot_avx2,
+    .direct_fir_dot_block = direct_fir_dot_block_avx2,
+    .direct_fir_dot_u8 = direct_fir_dot_u8_avx2,
+    .direct_fir_dot_block_u8 = direct_fir_dot_block_u8_avx2,
+    .direct_fir_dot_real = direct_fir_dot_real_avx2,
+    .direct_fir_dot_real_block = direct_fir_dot_real_block_avx2,
+    .direct_fir_batch_dot = direct_fir_batch_dot_avx2,
+    .direct_fir_batch_dot_u8 = direct_fir_batch_dot_u8_avx2,
+    .dot_real = dot_real_avx2,
+    .dot_real_block = dot_real_block_avx2,
+    .fir_fold_dot = fir_fold_dot_avx2,
+    .fir_fold_dot_iq = fir_fold_dot_iq_avx2,
+    .nco_rotate = nco_rotate_avx2,
+    .direct_fir_f32_dot = direct_fir_f32_dot_avx2,
+    .direct_fir_f32_dot_block = direct_fir_f32_dot_block_avx2,
+    .fm_disc_q15 = fm_disc_q15_avx2,
+    .fm_disc_q15_cordic = fm_disc_q15_cordic_avx2,
+    .fm_disc_f32 = fm_disc_f32_avx2,
+};
+
+static
+const struct filter_kernels _filter_kernels_avx512 = {
+    .isa = FILTER_ISA_AVX512,
+    .direct_fir_dot = direct_fir_dot_avx512,
+    .direct_fir_dot_block = direct_fir_dot_block_avx512,
+    .direct_fir_dot_u8 = direct_fir_dot_u8_avx512,
+    .direct_fir_dot_block_u8 = direct_fir_dot_block_u8_avx512,
+    .direct_fir_dot_real = direct_fir_dot_real_avx512,
+    .direct_fir_dot_real_block = direct_fir_dot_real_block_avx512,
+    .direct_fir_batch_dot = direct_fir_batch_dot_avx512,
+    .direct_fir_batch_dot_u8 = direct_fir_batch_dot_u8_avx512,
+    .dot_real = dot_real_avx512,
+    .dot_real_block = dot_real_block_avx512,
+    .fir_fold_dot = fir_fold_dot_avx512,
+    .fir_fold_dot_iq = fir_fold_dot_iq_avx512,
+    .nco_rotate = nco_rotate_avx512,
+    .direct_fir_f32_dot = direct_fir_f32_dot_avx512,
+    .direct_fir_f32_dot_block = direct_fir_f32_dot_block_avx512,
+    .fm_disc_q15 = fm_disc_q15_avx512,
+    .fm_disc_q15_cordic = fm_disc_q15_cordic_avx512,
+    .fm_disc_f32 = fm_disc_f32_avx512,
+};
+#endif /* defined(_FILTER_HAVE_X86_KERNELS) */
+
+#ifdef _USE_ARM_NEON
+static
+const struct filter_kernels _filter_kernels_neon = {
+    .isa = FILTER_ISA_NEON,
+    .direct_fir_dot = direct_fir_dot_neon,
+    .direct_fir_dot_block = direct_fir_dot_block_neon,
+    .direct_fir_dot_u8 = direct_fir_dot_u8_scalar,
+    .direct_fir_dot_block_u8 = direct_fir_dot_block_u8_scalar,
+    .direct_fir_dot_real = direct_fir_dot_real_scalar,
+    .direct_fir_dot_real_block = direct_fir_dot_real_block_scalar,
+    .direct_fir_batch_dot = direct_fir_batch_dot_neon,
+    .direct_fir_batch_dot_u8 = direct_fir_batch_dot_u8_scalar,
+    .dot_real = dot_real_scalar,
+    .dot_real_block = dot_real_block_scalar,
+    .fir_fold_dot = fir_fold_dot_scalar,
+    .fir_fold_dot_iq = fir_fold_dot_iq_scalar,
+    .nco_rotate = nco_rotate_scalar,
+    .direct_fir_f32_dot = direct_fir_f32_dot_scalar,
+    .direct_fir_f32_dot_block = direct_fir_f32_dot_block_scalar,
+    .fm_disc_q15 = fm_disc_q15_scalar,
+    .fm_disc_q15_cordic = fm_disc_q15_cordic_scalar,
+    .fm_disc_f32 = fm_disc_f32_scalar,
+};
+#endif /* defined(_USE_ARM_NEON) */
+
+static
+const char *_filter_isa_names[FILTER_ISA_MAX] = {
+    [FILTER_ISA_SCALAR] = "scalar",
+    [FILTER_ISA_SSE41] = "sse4.1",
+    [FILTER_ISA_AVX2] = "avx2",
+    [FILTER_ISA_AVX512] = "avx512",
+    [FILTER_ISA_NEON] = "neon",
+};
+
+const struct filter_kernels *filter_kernels = &_filter_kernels_scalar;
+
+static
+pthread_once_t _filter_kernels_once = PTHREAD_ONCE_INIT;
+
+int filter_isa_supported(enum filter_isa isa)
+{
+    int supported = 0;
+
+    switch (isa) {
+    case FILTER_ISA_SCALAR:
+        supported = 1;
+        break;
+#ifdef _FILTER_HAVE_X86_KERNELS
+    case FILTER_ISA_SSE41:
+        supported = __builtin_cpu_supports("sse4.1");
+        break;
+    case FILTER_ISA_AVX2:
+        /* The AVX2 kernels also use FMA, which every CPU with AVX2 we care about has */
+        supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        break;
+    case FILTER_ISA_AVX512:
+        supported = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+        break;
+#endif
+#ifdef _USE_ARM_NEON
+    case FILTER_ISA_NEON:
+#if defined(__arm__)
+        supported = !!(getauxval(AT_HWCAP) & HWCAP_NEON);
+#else
+        /* Advanced SIMD is mandatory on AArch64 */
+        supported = 1;
+#endif
+        break;
+#endif
+    default:
+        break;
+    }
+
+    return supported;
+}
+
+const struct filter_kernels *filter_kernels_for_isa(enum filter_isa isa)
+{
+    const struct filter_kernels *kernels = NULL;
+
+    switch (isa) {
+    case FILTER_ISA_SCALAR:
+        kernels = &_filter_kernels_scalar;
+        break;
+#ifdef _FILTER_HAVE_X86_KERNELS
+    case FILTER_ISA_SSE41:
+        kernels = &_filter_kernels_sse41;
+        break;
+    case FILTER_ISA_AVX2:
+        kernels = &_filter_kernels_avx2;
+        break;
+    case FILTER_ISA_AVX512:
+        kernels = &_filter_kernels_avx512;
+        break;
+#endif
+#ifdef _USE_ARM_NEON
+    case FILTER_ISA_NEON:
+        kernels = &_filter_kernels_neon;
+        break;
+#endif
+    default:
+        break;
+    }
+
+    return kernels;
+}
+
+const char *filter_isa_name(enum filter_isa isa)
+{
+    return isa < FILTER_ISA_MAX ? _filter_isa_names[isa] : "unknown";
+}
+
+static
+void _filter_kernels_choose(void)
+{
+    static const enum filter_isa preference[] = {
+        FILTER_ISA_AVX512,
+        FILTER_ISA_AVX2,
+        FILTER_ISA_SSE41,
+        FILTER_ISA_NEON,
+    };
+
+#ifdef _FILTER_HAVE_X86_KERNELS
+    __builtin_cpu_init();
+#endif
+
+    for (size_t i = 0; i < sizeof(preference)/sizeof(preference[0]); i++) {
+        const struct filter_kernels *kernels = filter_kernels_for_isa(preference[i]);
+
+        if (NULL != kernels && filter_isa_supported(preference[i])) {
+            filter_kernels = kernels;
+            break;
+        }
+    }
+
+    DIAG("Using %s DSP kernels", filter_isa_name(filter_kernels->isa));
+}
+
+aresult_t filter_kernels_init(void)
+{
+    aresult_t ret = A_OK;
+
+    if (0 != pthread_once(&_filter_kernels_once, _filter_kernels_choose)) {
+        ret = A_E_INVAL;
+    }
+
+    return ret;
+}
+
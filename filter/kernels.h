@@ -0,0 +1,166 @@
+#pragma once
+
+#include <tsl/result.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct direct_fir;
+struct direct_fir_batch;
+struct direct_fir_f32;
+struct fir_fold;
+struct nco;
+
+/**
+ * The number of output samples the blocked kernels compute in a single pass
+ */
+#define FILTER_BLOCK_OUTPUTS            4
+
+/**
+ * The instruction set a set of DSP kernels was built for
+ */
+enum filter_isa {
+    FILTER_ISA_SCALAR = 0,
+    FILTER_ISA_SSE41,
+    FILTER_ISA_AVX2,
+    FILTER_ISA_AVX512,
+    FILTER_ISA_NEON,
+    FILTER_ISA_MAX,
+};
+
+/**
+ * The DSP inner loops, all built for one instruction set. Every integer variant gives exactly the
+ * same result as the scalar one.
+ */
+struct filter_kernels {
+    /**
+     * The instruction set these kernels use
+     */
+    enum filter_isa isa;
+
+    /**
+     * Complex dot product of a direct FIR's coefficients with interleaved I/Q samples, in Q.30
+     */
+    void (*direct_fir_dot)(const struct direct_fir *fir, const int16_t *samples, int32_t *pacc_re,
+            int32_t *pacc_im);
+
+    /**
+     * FILTER_BLOCK_OUTPUTS consecutive outputs of a direct FIR, with the windows stride complex
+     * samples apart. Each coefficient is loaded once and applied to every window.
+     */
+    void (*direct_fir_dot_block)(const struct direct_fir *fir, const int16_t *samples, size_t stride,
+            int32_t *acc_re, int32_t *acc_im);
+
+    /**
+     * direct_fir_dot and direct_fir_dot_block, over interleaved unsigned 8-bit I/Q samples. The
+     * DC offset is taken out (see `struct direct_fir`) and the result scaled, so the result is
+     * the same Q.30 sum the widened Q.15 samples give. The FIR must have multiply-accumulate
+     * coefficients.
+     */
+    void (*direct_fir_dot_u8)(const struct direct_fir *fir, const uint8_t *samples, int32_t *pacc_re,
+            int32_t *pacc_im);
+    void (*direct_fir_dot_block_u8)(const struct direct_fir *fir, const uint8_t *samples, size_t stride,
+            int32_t *acc_re, int32_t *acc_im);
+
+    /**
+     * Dot product of real coefficients with interleaved I/Q samples, in Q.30
+     */
+    void (*direct_fir_dot_real)(const int16_t *coeffs, const int16_t *samples, size_t nr_coeffs,
+            int32_t *pacc_re, int32_t *pacc_im);
+
+    /**
+     * FILTER_BLOCK_OUTPUTS real-coefficient dot products, with the windows stride complex samples
+     * apart.
+     */
+    void (*direct_fir_dot_real_block)(const int16_t *coeffs, const int16_t *samples, size_t nr_coeffs,
+            size_t stride, int32_t *acc_re, int32_t *acc_im);
+
+    /**
+     * Complex dot product for every channel of a batched FIR, into the batch's accumulators
+     */
+    void (*direct_fir_batch_dot)(const struct direct_fir_batch *fir, const int16_t *samples);
+
+    /**
+     * direct_fir_batch_dot over interleaved unsigned 8-bit I/Q samples, with the same result the
+     * widened Q.15 samples give
+     */
+    void (*direct_fir_batch_dot_u8)(const struct direct_fir_batch *fir, const uint8_t *samples);
+
+    /**
+     * Dot product of real coefficients with real samples, in Q.30
+     */
+    void (*dot_real)(const int16_t *samples, const int16_t *coeffs, size_t nr_coeffs, int32_t *pacc);
+
+    /**
+     * FILTER_BLOCK_OUTPUTS real dot products, each with its own samples and coefficients, computed
+     * in a single pass and reduced together.
+     */
+    void (*dot_real_block)(const int16_t *const *samples, const int16_t *const *coeffs, size_t nr_coeffs,
+            int32_t *acc);
+
+    /**
+     * Dot product of a folded symmetric filter with real samples, in Q.30
+     */
+    void (*fir_fold_dot)(const struct fir_fold *fold, const int16_t *samples, int32_t *pacc);
+
+    /**
+     * Dot product of a folded symmetric filter with interleaved I/Q samples, in Q.30
+     */
+    void (*fir_fold_dot_iq)(const struct fir_fold *fold, const int16_t *samples, int32_t *pacc_re,
+            int32_t *pacc_im);
+
+    /**
+     * Multiply interleaved Q.15 I/Q samples by an NCO's phasors in place, stepping the NCO
+     */
+    void (*nco_rotate)(struct nco *nco, int16_t *samples, size_t nr_samples);
+
+    /**
+     * direct_fir_dot and direct_fir_dot_block, over float samples and coefficients. The
+     * products are always added up in the same order, but the variants with FMA round
+     * differently, so these only agree with the scalar kernels to within rounding.
+     */
+    void (*direct_fir_f32_dot)(const struct direct_fir_f32 *fir, const float *samples, float *pacc_re,
+            float *pacc_im);
+    void (*direct_fir_f32_dot_block)(const struct direct_fir_f32 *fir, const float *samples, size_t stride,
+            float *acc_re, float *acc_im);
+
+    /**
+     * FM discriminators, see `fm_disc.h`. The CORDIC is integer-only, and gives the same result
+     * everywhere; the polynomial variants only agree to within rounding.
+     */
+    void (*fm_disc_q15)(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out);
+    void (*fm_disc_q15_cordic)(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out);
+    void (*fm_disc_f32)(const float *samples, size_t nr_samples, float *last, int16_t *out);
+};
+
+/**
+ * The kernels chosen for this CPU. Only valid once `filter_kernels_init` has been called.
+ */
+extern const struct filter_kernels *filter_kernels;
+
+/**
+ * Pick the best kernels the CPU we're running on supports. Safe to call any number of times,
+ * from any thread; the choice is only made once. Every filter calls this when it is created.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t filter_kernels_init(void);
+
+/**
+ * Determine whether the CPU we're running on supports an instruction set
+ */
+int filter_isa_supported(enum filter_isa isa);
+
+/**
+ * Get the kernels built for an instruction set, whether or not the CPU supports it. Used for
+ * testing the variants against each other.
+ *
+ * \return The kernels, or NULL if this build has no kernels for that instruction set.
+ */
+const struct filter_kernels *filter_kernels_for_isa(enum filter_isa isa);
+
+/**
+ * Get a human-readable name for an instruction set
+ */
+const char *filter_isa_name(enum filter_isa isa);
+
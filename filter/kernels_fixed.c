@@ -0,0 +1,287 @@
+/*
+ *  kernels_fixed.c - DSP kernels specialized for the filter shapes we actually use
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/kernels_fixed.h>
+#include <filter/kernels.h>
+#include <filter/kernels_priv.h>
+#include <filter/direct_fir.h>
+
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+
+/**
+ * Unroll the loop that follows completely. Only for loops with a constant trip count, long
+ * enough that the compiler vectorizes them before unrolling.
+ */
+#define FILTER_UNROLL_FULLY             _Pragma("GCC unroll 128")
+
+/**
+ * FILTER_BLOCK_OUTPUTS windows of a complex direct FIR, over the interleaved multiply-accumulate
+ * coefficients. nr_coeffs and stride are always constants.
+ *
+ * Summing the products of the interleaved coefficients in order gives the same int32 result as
+ * summing the complex products tap by tap, since the additions wrap.
+ */
+FILTER_ALWAYS_INLINE
+void _direct_fir_dot_block_fixed_body(const struct direct_fir *fir, const int16_t *restrict samples,
+        size_t nr_coeffs, size_t stride, int32_t *acc_re, int32_t *acc_im)
+{
+    const int16_t *restrict c_re = __builtin_assume_aligned(fir->mac_coeff_re, 64),
+                  *restrict c_im = __builtin_assume_aligned(fir->mac_coeff_im, 64),
+                  *restrict s0 = samples,
+                  *restrict s1 = samples + 2 * stride,
+                  *restrict s2 = samples + 4 * stride,
+                  *restrict s3 = samples + 6 * stride;
+    int32_t re0 = 0, im0 = 0,
+            re1 = 0, im1 = 0,
+            re2 = 0, im2 = 0,
+            re3 = 0, im3 = 0;
+
+    FILTER_UNROLL_FULLY
+    for (size_t i = 0; i < 2 * nr_coeffs; i++) {
+        int32_t cr = c_re[i],
+                ci = c_im[i];
+
+        re0 += cr * s0[i]; im0 += ci * s0[i];
+        re1 += cr * s1[i]; im1 += ci * s1[i];
+        re2 += cr * s2[i]; im2 += ci * s2[i];
+        re3 += cr * s3[i]; im3 += ci * s3[i];
+    }
+
+    acc_re[0] = re0; acc_im[0] = im0;
+    acc_re[1] = re1; acc_im[1] = im1;
+    acc_re[2] = re2; acc_im[2] = im2;
+    acc_re[3] = re3; acc_im[3] = im3;
+}
+
+/**
+ * The same, over raw 8-bit samples. See `struct filter_kernels` for how the DC offset is
+ * handled.
+ */
+FILTER_ALWAYS_INLINE
+void _direct_fir_dot_block_u8_fixed_body(const struct direct_fir *fir, const uint8_t *restrict samples,
+        size_t nr_coeffs, size_t stride, int32_t *acc_re, int32_t *acc_im)
+{
+    const int16_t *restrict c_re = __builtin_assume_aligned(fir->mac_coeff_re, 64),
+                  *restrict c_im = __builtin_assume_aligned(fir->mac_coeff_im, 64);
+    const uint8_t *restrict s0 = samples,
+                  *restrict s1 = samples + 2 * stride,
+                  *restrict s2 = samples + 4 * stride,
+                  *restrict s3 = samples + 6 * stride;
+    uint32_t re0 = fir->u8_bias_re, im0 = fir->u8_bias_im,
+             re1 = fir->u8_bias_re, im1 = fir->u8_bias_im,
+             re2 = fir->u8_bias_re, im2 = fir->u8_bias_im,
+             re3 = fir->u8_bias_re, im3 = fir->u8_bias_im;
+
+    FILTER_UNROLL_FULLY
+    for (size_t i = 0; i < 2 * nr_coeffs; i++) {
+        int32_t cr = c_re[i],
+                ci = c_im[i];
+        int16_t v0 = s0[i], v1 = s1[i], v2 = s2[i], v3 = s3[i];
+
+        re0 += (uint32_t)(cr * v0); im0 += (uint32_t)(ci * v0);
+        re1 += (uint32_t)(cr * v1); im1 += (uint32_t)(ci * v1);
+        re2 += (uint32_t)(cr * v2); im2 += (uint32_t)(ci * v2);
+        re3 += (uint32_t)(cr * v3); im3 += (uint32_t)(ci * v3);
+    }
+
+    acc_re[0] = filter_u8_sum_to_q30(re0); acc_im[0] = filter_u8_sum_to_q30(im0);
+    acc_re[1] = filter_u8_sum_to_q30(re1); acc_im[1] = filter_u8_sum_to_q30(im1);
+    acc_re[2] = filter_u8_sum_to_q30(re2); acc_im[2] = filter_u8_sum_to_q30(im2);
+    acc_re[3] = filter_u8_sum_to_q30(re3); acc_im[3] = filter_u8_sum_to_q30(im3);
+}
+
+/**
+ * FILTER_BLOCK_OUTPUTS real dot products, each with its own samples and coefficients. nr_coeffs
+ * is always a constant.
+ *
+ * The phase filters are short enough that the compiler unrolls the loop by itself once it has
+ * been vectorized. Forcing the unroll would happen before vectorization, and defeat it.
+ */
+FILTER_ALWAYS_INLINE
+void _dot_real_block_fixed_body(const int16_t *const *samples, const int16_t *const *coeffs, size_t nr_coeffs,
+        int32_t *acc)
+{
+    const int16_t *restrict s0 = samples[0], *restrict c0 = coeffs[0],
+                  *restrict s1 = samples[1], *restrict c1 = coeffs[1],
+                  *restrict s2 = samples[2], *restrict c2 = coeffs[2],
+                  *restrict s3 = samples[3], *restrict c3 = coeffs[3];
+    int32_t a0 = 0,
+            a1 = 0,
+            a2 = 0,
+            a3 = 0;
+
+    for (size_t i = 0; i < nr_coeffs; i++) {
+        a0 += (int32_t)s0[i] * c0[i];
+        a1 += (int32_t)s1[i] * c1[i];
+        a2 += (int32_t)s2[i] * c2[i];
+        a3 += (int32_t)s3[i] * c3[i];
+    }
+
+    acc[0] = a0;
+    acc[1] = a1;
+    acc[2] = a2;
+    acc[3] = a3;
+}
+
+/*
+ * Generate a kernel for every shape and instruction set. The scalar kernels are built for
+ * whatever the compiler was told to target, like the rest of the scalar kernels.
+ */
+#define _DIRECT_FIR_FIXED_KERNEL(target, isa, nr, dec) \
+    static target \
+    void _direct_fir_dot_block_##nr##_##dec##_##isa(const struct direct_fir *fir, const int16_t *samples, \
+            size_t stride, int32_t *acc_re, int32_t *acc_im) \
+    { \
+        (void)stride; \
+        _direct_fir_dot_block_fixed_body(fir, samples, nr, dec, acc_re, acc_im); \
+    } \
+    static target \
+    void _direct_fir_dot_block_u8_##nr##_##dec##_##isa(const struct direct_fir *fir, const uint8_t *samples, \
+            size_t stride, int32_t *acc_re, int32_t *acc_im) \
+    { \
+        (void)stride; \
+        _direct_fir_dot_block_u8_fixed_body(fir, samples, nr, dec, acc_re, acc_im); \
+    }
+
+#define _DOT_REAL_FIXED_KERNEL(target, isa, nr) \
+    static target \
+    void _dot_real_block_##nr##_##isa(const int16_t *const *samples, const int16_t *const *coeffs, \
+            size_t nr_coeffs, int32_t *acc) \
+    { \
+        (void)nr_coeffs; \
+        _dot_real_block_fixed_body(samples, coeffs, nr, acc); \
+    }
+
+#ifdef _FILTER_HAVE_X86_KERNELS
+#define _DIRECT_FIR_FIXED_KERNELS(nr, dec) \
+    _DIRECT_FIR_FIXED_KERNEL(, scalar, nr, dec) \
+    _DIRECT_FIR_FIXED_KERNEL(FILTER_TARGET_SSE41, sse41, nr, dec) \
+    _DIRECT_FIR_FIXED_KERNEL(FILTER_TARGET_AVX2, avx2, nr, dec) \
+    _DIRECT_FIR_FIXED_KERNEL(FILTER_TARGET_AVX512, avx512, nr, dec)
+
+#define _DIRECT_FIR_FIXED_ENTRY(nr, dec) \
+    { nr, dec, { \
+        [FILTER_ISA_SCALAR] = _direct_fir_dot_block_##nr##_##dec##_scalar, \
+        [FILTER_ISA_SSE41] = _direct_fir_dot_block_##nr##_##dec##_sse41, \
+        [FILTER_ISA_AVX2] = _direct_fir_dot_block_##nr##_##dec##_avx2, \
+        [FILTER_ISA_AVX512] = _direct_fir_dot_block_##nr##_##dec##_avx512, \
+    }, { \
+        [FILTER_ISA_SCALAR] = _direct_fir_dot_block_u8_##nr##_##dec##_scalar, \
+        [FILTER_ISA_SSE41] = _direct_fir_dot_block_u8_##nr##_##dec##_sse41, \
+        [FILTER_ISA_AVX2] = _direct_fir_dot_block_u8_##nr##_##dec##_avx2, \
+        [FILTER_ISA_AVX512] = _direct_fir_dot_block_u8_##nr##_##dec##_avx512, \
+    } },
+
+#define _DOT_REAL_FIXED_KERNELS(nr) \
+    _DOT_REAL_FIXED_KERNEL(, scalar, nr) \
+    _DOT_REAL_FIXED_KERNEL(FILTER_TARGET_SSE41, sse41, nr) \
+    _DOT_REAL_FIXED_KERNEL(FILTER_TARGET_AVX2, avx2, nr) \
+    _DOT_REAL_FIXED_KERNEL(FILTER_TARGET_AVX512, avx512, nr)
+
+#define _DOT_REAL_FIXED_ENTRY(nr) \
+    { nr, { \
+        [FILTER_ISA_SCALAR] = _dot_real_block_##nr##_scalar, \
+        [FILTER_ISA_SSE41] = _dot_real_block_##nr##_sse41, \
+        [FILTER_ISA_AVX2] = _dot_real_block_##nr##_avx2, \
+        [FILTER_ISA_AVX512] = _dot_real_block_##nr##_avx512, \
+    } },
+#else
+/* The NEON kernels are hand-written, so there are only scalar fixed-size kernels here */
+#define _DIRECT_FIR_FIXED_KERNELS(nr, dec) \
+    _DIRECT_FIR_FIXED_KERNEL(, scalar, nr, dec)
+
+#define _DIRECT_FIR_FIXED_ENTRY(nr, dec) \
+    { nr, dec, { [FILTER_ISA_SCALAR] = _direct_fir_dot_block_##nr##_##dec##_scalar }, \
+        { [FILTER_ISA_SCALAR] = _direct_fir_dot_block_u8_##nr##_##dec##_scalar } },
+
+#define _DOT_REAL_FIXED_KERNELS(nr) \
+    _DOT_REAL_FIXED_KERNEL(, scalar, nr)
+
+#define _DOT_REAL_FIXED_ENTRY(nr) \
+    { nr, { [FILTER_ISA_SCALAR] = _dot_real_block_##nr##_scalar } },
+#endif /* defined(_FILTER_HAVE_X86_KERNELS) */
+
+FILTER_FIXED_DIRECT_FIR(_DIRECT_FIR_FIXED_KERNELS)
+FILTER_FIXED_POLYPHASE(_DOT_REAL_FIXED_KERNELS)
+
+static const
+struct {
+    size_t nr_coeffs;
+    unsigned decimation;
+    filter_direct_fir_dot_block_fn dot_block[FILTER_ISA_MAX];
+    filter_direct_fir_dot_block_u8_fn dot_block_u8[FILTER_ISA_MAX];
+} _direct_fir_fixed[] = {
+    FILTER_FIXED_DIRECT_FIR(_DIRECT_FIR_FIXED_ENTRY)
+};
+
+static const
+struct {
+    size_t nr_coeffs;
+    filter_dot_real_block_fn dot_real_block[FILTER_ISA_MAX];
+} _dot_real_fixed[] = {
+    FILTER_FIXED_POLYPHASE(_DOT_REAL_FIXED_ENTRY)
+};
+
+filter_direct_fir_dot_block_fn filter_kernels_fixed_direct_fir(const struct filter_kernels *kernels,
+        size_t nr_coeffs, unsigned decimation)
+{
+    filter_direct_fir_dot_block_fn fn = NULL;
+
+    for (size_t i = 0; i < sizeof(_direct_fir_fixed)/sizeof(_direct_fir_fixed[0]); i++) {
+        if (_direct_fir_fixed[i].nr_coeffs == nr_coeffs && _direct_fir_fixed[i].decimation == decimation) {
+            fn = _direct_fir_fixed[i].dot_block[kernels->isa];
+            break;
+        }
+    }
+
+    return fn;
+}
+
+filter_direct_fir_dot_block_u8_fn filter_kernels_fixed_direct_fir_u8(const struct filter_kernels *kernels,
+        size_t nr_coeffs, unsigned decimation)
+{
+    filter_direct_fir_dot_block_u8_fn fn = NULL;
+
+    for (size_t i = 0; i < sizeof(_direct_fir_fixed)/sizeof(_direct_fir_fixed[0]); i++) {
+        if (_direct_fir_fixed[i].nr_coeffs == nr_coeffs && _direct_fir_fixed[i].decimation == decimation) {
+            fn = _direct_fir_fixed[i].dot_block_u8[kernels->isa];
+            break;
+        }
+    }
+
+    return fn;
+}
+
+filter_dot_real_block_fn filter_kernels_fixed_dot_real(const struct filter_kernels *kernels, size_t nr_coeffs)
+{
+    filter_dot_real_block_fn fn = NULL;
+
+    for (size_t i = 0; i < sizeof(_dot_real_fixed)/sizeof(_dot_real_fixed[0]); i++) {
+        if (_dot_real_fixed[i].nr_coeffs == nr_coeffs) {
+            fn = _dot_real_fixed[i].dot_real_block[kernels->isa];
+            break;
+        }
+    }
+
+    return fn;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <filter/kernels.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct direct_fir;
+
+/*
+ * Kernels built for one filter shape, with the number of taps (and, for the direct FIR, the
+ * decimation) known at compile time. With no loop bounds or strides to track, the compiler
+ * unrolls the whole filter and keeps all of the addressing in the instructions themselves.
+ *
+ * Each shape listed here costs a kernel per instruction set, so only list shapes that are
+ * actually used. Anything else uses the generic kernels.
+ */
+
+/**
+ * Direct FIR shapes, as (number of taps, decimation). These are the channel filters in etc/:
+ * the FLEX filter at 1 Msps, the POCSAG filters at 1.2 Msps and 2.5 Msps, and the FLEX filter
+ * at 3 Msps.
+ */
+#define FILTER_FIXED_DIRECT_FIR(X) \
+    X(128, 40) \
+    X(256, 25) \
+    X(256, 100) \
+    X(512, 120)
+
+/**
+ * Polyphase FIR shapes, as the number of coefficients in each phase filter. These are the
+ * 821 tap resampling filter in etc/, split 16 ways and 25 ways.
+ */
+#define FILTER_FIXED_POLYPHASE(X) \
+    X(36) \
+    X(52)
+
+typedef void (*filter_direct_fir_dot_block_fn)(const struct direct_fir *fir, const int16_t *samples,
+        size_t stride, int32_t *acc_re, int32_t *acc_im);
+
+typedef void (*filter_direct_fir_dot_block_u8_fn)(const struct direct_fir *fir, const uint8_t *samples,
+        size_t stride, int32_t *acc_re, int32_t *acc_im);
+
+typedef void (*filter_dot_real_block_fn)(const int16_t *const *samples, const int16_t *const *coeffs,
+        size_t nr_coeffs, int32_t *acc);
+
+/**
+ * Find a fixed-size replacement for kernels->direct_fir_dot_block. The FIR must use the
+ * interleaved multiply-accumulate coefficients (i.e. fir->mac_coeff_re is not NULL).
+ *
+ * \param kernels The kernels the replacement has to match
+ * \param nr_coeffs The number of taps
+ * \param decimation The decimation factor, which is always the stride between windows
+ *
+ * \return The kernel, or NULL if there is none for this shape and instruction set
+ */
+filter_direct_fir_dot_block_fn filter_kernels_fixed_direct_fir(const struct filter_kernels *kernels,
+        size_t nr_coeffs, unsigned decimation);
+
+/**
+ * Find a fixed-size replacement for kernels->direct_fir_dot_block_u8, under the same conditions
+ * as `filter_kernels_fixed_direct_fir`.
+ */
+filter_direct_fir_dot_block_u8_fn filter_kernels_fixed_direct_fir_u8(const struct filter_kernels *kernels,
+        size_t nr_coeffs, unsigned decimation);
+
+/**
+ * Find a fixed-size replacement for kernels->dot_real_block.
+ *
+ * \param kernels The kernels the replacement has to match
+ * \param nr_coeffs The number of coefficients in each dot product
+ *
+ * \return The kernel, or NULL if there is none for this shape and instruction set
+ */
+filter_dot_real_block_fn filter_kernels_fixed_dot_real(const struct filter_kernels *kernels, size_t nr_coeffs);
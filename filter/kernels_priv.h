@@ -0,0 +1,185 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <filter/kernels.h>
+#include <filter/sample_buf.h>
+
+struct direct_fir;
+struct direct_fir_batch;
+struct direct_fir_f32;
+struct fir_fold;
+struct nco;
+
+#if defined(__x86_64__) || defined(__i386__)
+#define _FILTER_HAVE_X86_KERNELS
+
+/*
+ * The x86 variants are built with per-function target attributes, so a single binary carries
+ * all of them, no matter what the compiler was told to target. The right one is picked at
+ * runtime.
+ */
+#define FILTER_TARGET_SSE41             __attribute__((target("sse4.1")))
+#define FILTER_TARGET_AVX2              __attribute__((target("avx2,fma")))
+#define FILTER_TARGET_AVX512            __attribute__((target("avx512f,avx512bw")))
+
+/**
+ * Define the x86 variants of a kernel whose portable body, _<name>_body, is written simply
+ * enough for the compiler to vectorize. The body is forced inline, so each variant is compiled
+ * for its own instruction set.
+ */
+#define FILTER_DEFINE_X86_VARIANTS(name, params, args) \
+    FILTER_TARGET_SSE41 void name##_sse41 params { _##name##_body args; } \
+    FILTER_TARGET_AVX2 void name##_avx2 params { _##name##_body args; } \
+    FILTER_TARGET_AVX512 void name##_avx512 params { _##name##_body args; }
+#endif /* x86 */
+
+#define FILTER_ALWAYS_INLINE            static inline __attribute__((always_inline))
+
+/**
+ * Scale a sum of products with 8-bit samples, with the DC offset already taken out, up to the
+ * sum the Q.15 samples would have given. The sums are kept unsigned, since they can wrap before
+ * the bias has been taken back out; only the scaled result is signed.
+ */
+FILTER_ALWAYS_INLINE
+int32_t filter_u8_sum_to_q30(uint32_t acc)
+{
+    return (int32_t)(acc << SAMPLE_8BIT_Q15_SHIFT);
+}
+
+/* The blocked kernels are written out by hand for this many outputs */
+_Static_assert(4 == FILTER_BLOCK_OUTPUTS, "Blocked kernels assume 4 outputs per pass");
+
+/*
+ * Kernel variants. See `struct filter_kernels` for what each one computes.
+ */
+void direct_fir_dot_scalar(const struct direct_fir *fir, const int16_t *samples, int32_t *pacc_re, int32_t *pacc_im);
+void direct_fir_dot_real_scalar(const int16_t *coeffs, const int16_t *samples, size_t nr_coeffs,
+        int32_t *pacc_re, int32_t *pacc_im);
+void direct_fir_dot_block_scalar(const struct direct_fir *fir, const int16_t *samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im);
+void direct_fir_dot_real_block_scalar(const int16_t *coeffs, const int16_t *samples, size_t nr_coeffs,
+        size_t stride, int32_t *acc_re, int32_t *acc_im);
+void direct_fir_dot_u8_scalar(const struct direct_fir *fir, const uint8_t *samples, int32_t *pacc_re, int32_t *pacc_im);
+void direct_fir_dot_block_u8_scalar(const struct direct_fir *fir, const uint8_t *samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im);
+void direct_fir_batch_dot_scalar(const struct direct_fir_batch *fir, const int16_t *samples);
+void direct_fir_batch_dot_u8_scalar(const struct direct_fir_batch *fir, const uint8_t *samples);
+void dot_real_scalar(const int16_t *samples, const int16_t *coeffs, size_t nr_coeffs, int32_t *pacc);
+void dot_real_block_scalar(const int16_t *const *samples, const int16_t *const *coeffs, size_t nr_coeffs,
+        int32_t *acc);
+void fir_fold_dot_scalar(const struct fir_fold *fold, const int16_t *samples, int32_t *pacc);
+void fir_fold_dot_iq_scalar(const struct fir_fold *fold, const int16_t *samples, int32_t *pacc_re,
+        int32_t *pacc_im);
+void nco_rotate_scalar(struct nco *nco, int16_t *samples, size_t nr_samples);
+void direct_fir_f32_dot_scalar(const struct direct_fir_f32 *fir, const float *samples, float *pacc_re,
+        float *pacc_im);
+void direct_fir_f32_dot_block_scalar(const struct direct_fir_f32 *fir, const float *samples, size_t stride,
+        float *acc_re, float *acc_im);
+void fm_disc_q15_scalar(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out);
+void fm_disc_q15_cordic_scalar(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out);
+void fm_disc_f32_scalar(const float *samples, size_t nr_samples, float *last, int16_t *out);
+
+#ifdef _FILTER_HAVE_X86_KERNELS
+void direct_fir_dot_sse41(const struct direct_fir *fir, const int16_t *samples, int32_t *pacc_re, int32_t *pacc_im);
+void direct_fir_dot_avx2(const struct direct_fir *fir, const int16_t *samples, int32_t *pacc_re, int32_t *pacc_im);
+void direct_fir_dot_avx512(const struct direct_fir *fir, const int16_t *samples, int32_t *pacc_re, int32_t *pacc_im);
+
+void direct_fir_dot_block_sse41(const struct direct_fir *fir, const int16_t *samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im);
+void direct_fir_dot_block_avx2(const struct direct_fir *fir, const int16_t *samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im);
+void direct_fir_dot_block_avx512(const struct direct_fir *fir, const int16_t *samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im);
+
+void direct_fir_dot_real_sse41(const int16_t *coeffs, const int16_t *samples, size_t nr_coeffs,
+        int32_t *pacc_re, int32_t *pacc_im);
+void direct_fir_dot_real_avx2(const int16_t *coeffs, const int16_t *samples, size_t nr_coeffs,
+        int32_t *pacc_re, int32_t *pacc_im);
+void direct_fir_dot_real_avx512(const int16_t *coeffs, const int16_t *samples, size_t nr_coeffs,
+        int32_t *pacc_re, int32_t *pacc_im);
+
+void direct_fir_dot_real_block_sse41(const int16_t *coeffs, const int16_t *samples, size_t nr_coeffs,
+        size_t stride, int32_t *acc_re, int32_t *acc_im);
+void direct_fir_dot_real_block_avx2(const int16_t *coeffs, const int16_t *samples, size_t nr_coeffs,
+        size_t stride, int32_t *acc_re, int32_t *acc_im);
+void direct_fir_dot_real_block_avx512(const int16_t *coeffs, const int16_t *samples, size_t nr_coeffs,
+        size_t stride, int32_t *acc_re, int32_t *acc_im);
+
+void direct_fir_dot_u8_sse41(const struct direct_fir *fir, const uint8_t *samples, int32_t *pacc_re, int32_t *pacc_im);
+void direct_fir_dot_u8_avx2(const struct direct_fir *fir, const uint8_t *samples, int32_t *pacc_re, int32_t *pacc_im);
+void direct_fir_dot_u8_avx512(const struct direct_fir *fir, const uint8_t *samples, int32_t *pacc_re, int32_t *pacc_im);
+
+void direct_fir_dot_block_u8_sse41(const struct direct_fir *fir, const uint8_t *samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im);
+void direct_fir_dot_block_u8_avx2(const struct direct_fir *fir, const uint8_t *samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im);
+void direct_fir_dot_block_u8_avx512(const struct direct_fir *fir, const uint8_t *samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im);
+
+void direct_fir_batch_dot_sse41(const struct direct_fir_batch *fir, const int16_t *samples);
+void direct_fir_batch_dot_avx2(const struct direct_fir_batch *fir, const int16_t *samples);
+void direct_fir_batch_dot_avx512(const struct direct_fir_batch *fir, const int16_t *samples);
+
+void direct_fir_batch_dot_u8_sse41(const struct direct_fir_batch *fir, const uint8_t *samples);
+void direct_fir_batch_dot_u8_avx2(const struct direct_fir_batch *fir, const uint8_t *samples);
+void direct_fir_batch_dot_u8_avx512(const struct direct_fir_batch *fir, const uint8_t *samples);
+
+void dot_real_sse41(const int16_t *samples, const int16_t *coeffs, size_t nr_coeffs, int32_t *pacc);
+void dot_real_avx2(const int16_t *samples, const int16_t *coeffs, size_t nr_coeffs, int32_t *pacc);
+void dot_real_avx512(const int16_t *samples, const int16_t *coeffs, size_t nr_coeffs, int32_t *pacc);
+
+void dot_real_block_sse41(const int16_t *const *samples, const int16_t *const *coeffs, size_t nr_coeffs,
+        int32_t *acc);
+void dot_real_block_avx2(const int16_t *const *samples, const int16_t *const *coeffs, size_t nr_coeffs,
+        int32_t *acc);
+void dot_real_block_avx512(const int16_t *const *samples, const int16_t *const *coeffs, size_t nr_coeffs,
+        int32_t *acc);
+
+void fir_fold_dot_sse41(const struct fir_fold *fold, const int16_t *samples, int32_t *pacc);
+void fir_fold_dot_avx2(const struct fir_fold *fold, const int16_t *samples, int32_t *pacc);
+void fir_fold_dot_avx512(const struct fir_fold *fold, const int16_t *samples, int32_t *pacc);
+
+void fir_fold_dot_iq_sse41(const struct fir_fold *fold, const int16_t *samples, int32_t *pacc_re,
+        int32_t *pacc_im);
+void fir_fold_dot_iq_avx2(const struct fir_fold *fold, const int16_t *samples, int32_t *pacc_re,
+        int32_t *pacc_im);
+void fir_fold_dot_iq_avx512(const struct fir_fold *fold, const int16_t *samples, int32_t *pacc_re,
+        int32_t *pacc_im);
+
+void nco_rotate_sse41(struct nco *nco, int16_t *samples, size_t nr_samples);
+void nco_rotate_avx2(struct nco *nco, int16_t *samples, size_t nr_samples);
+void nco_rotate_avx512(struct nco *nco, int16_t *samples, size_t nr_samples);
+
+void direct_fir_f32_dot_sse41(const struct direct_fir_f32 *fir, const float *samples, float *pacc_re,
+        float *pacc_im);
+void direct_fir_f32_dot_avx2(const struct direct_fir_f32 *fir, const float *samples, float *pacc_re,
+        float *pacc_im);
+void direct_fir_f32_dot_avx512(const struct direct_fir_f32 *fir, const float *samples, float *pacc_re,
+        float *pacc_im);
+
+void direct_fir_f32_dot_block_sse41(const struct direct_fir_f32 *fir, const float *samples, size_t stride,
+        float *acc_re, float *acc_im);
+void direct_fir_f32_dot_block_avx2(const struct direct_fir_f32 *fir, const float *samples, size_t stride,
+        float *acc_re, float *acc_im);
+void direct_fir_f32_dot_block_avx512(const struct direct_fir_f32 *fir, const float *samples, size_t stride,
+        float *acc_re, float *acc_im);
+void fm_disc_q15_sse41(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out);
+void fm_disc_q15_avx2(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out);
+void fm_disc_q15_avx512(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out);
+void fm_disc_q15_cordic_sse41(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out);
+void fm_disc_q15_cordic_avx2(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out);
+void fm_disc_q15_cordic_avx512(const int16_t *samples, size_t nr_samples, int16_t *last, int16_t *out);
+void fm_disc_f32_sse41(const float *samples, size_t nr_samples, float *last, int16_t *out);
+void fm_disc_f32_avx2(const float *samples, size_t nr_samples, float *last, int16_t *out);
+void fm_disc_f32_avx512(const float *samples, size_t nr_samples, float *last, int16_t *out);
+#endif /* defined(_FILTER_HAVE_X86_KERNELS) */
+
+#ifdef _USE_ARM_NEON
+void direct_fir_dot_neon(const struct direct_fir *fir, const int16_t *samples, int32_t *pacc_re, int32_t *pacc_im);
+void direct_fir_dot_block_neon(const struct direct_fir *fir, const int16_t *samples, size_t stride,
+        int32_t *acc_re, int32_t *acc_im);
+void direct_fir_batch_dot_neon(const struct direct_fir_batch *fir, const int16_t *samples);
+#endif /* defined(_USE_ARM_NEON) */
+
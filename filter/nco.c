@@ -0,0 +1,121 @@
+/*
+ *  nco.c - Numerically controlled oscillator
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/nco.h>
+#include <filter/complex.h>
+#include <filter/kernels.h>
+#include <filter/kernels_priv.h>
+
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+
+#include <math.h>
+#include <pthread.h>
+
+uint32_t nco_lut[NCO_LUT_ENTRIES];
+
+static
+pthread_once_t _nco_lut_once = PTHREAD_ONCE_INIT;
+
+static
+void _nco_lut_fill(void)
+{
+    for (size_t i = 0; i < NCO_LUT_ENTRIES; i++) {
+        double phase = 2.0 * M_PI * (double)i / (double)NCO_LUT_ENTRIES;
+        int16_t c = (int16_t)lrint(cos(phase) * (double)(1 << Q_15_SHIFT)),
+                s = (int16_t)lrint(sin(phase) * (double)(1 << Q_15_SHIFT));
+
+        nco_lut[i] = (uint32_t)(uint16_t)c | (uint32_t)(uint16_t)s << 16;
+    }
+}
+
+uint32_t nco_phase_incr(double freq_hz, double sampling_rate)
+{
+    /* Only the fractional part of a cycle matters; the accumulator wraps every 2*pi */
+    double cycles = freq_hz / sampling_rate;
+
+    return (uint32_t)(int64_t)llrint((cycles - trunc(cycles)) * 4294967296.0);
+}
+
+aresult_t nco_init(struct nco *nco, uint32_t phase_incr)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != nco);
+
+    if (0 != pthread_once(&_nco_lut_once, _nco_lut_fill)) {
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (FAILED(ret = filter_kernels_init())) {
+        goto done;
+    }
+
+    nco->phase = 0;
+    nco->phase_incr = phase_incr;
+
+done:
+    return ret;
+}
+
+/**
+ * The phase of every sample is worked out from the starting phase, rather than carried from
+ * one sample to the next, so there's no dependency between iterations and the loop vectorizes,
+ * with the table lookups as gathers.
+ */
+FILTER_ALWAYS_INLINE
+void _nco_rotate_body(struct nco *nco, int16_t *restrict samples, size_t nr_samples)
+{
+    const uint32_t *restrict lut = nco_lut;
+    uint32_t phase = nco->phase,
+             phase_incr = nco->phase_incr;
+
+    for (size_t i = 0; i < nr_samples; i++) {
+        uint32_t entry = lut[(phase + (uint32_t)i * phase_incr) >> (32 - NCO_LUT_BITS)];
+        int32_t c = (int16_t)(entry & 0xffff),
+                s = (int16_t)(entry >> 16),
+                s_re = samples[2 * i    ],
+                s_im = samples[2 * i + 1];
+
+        samples[2 * i    ] = round_q30_q15(s_re * c - s_im * s);
+        samples[2 * i + 1] = round_q30_q15(s_re * s + s_im * c);
+    }
+
+    nco->phase = phase + (uint32_t)nr_samples * phase_incr;
+}
+
+void nco_rotate_scalar(struct nco *nco, int16_t *samples, size_t nr_samples)
+{
+    _nco_rotate_body(nco, samples, nr_samples);
+}
+
+#ifdef _FILTER_HAVE_X86_KERNELS
+FILTER_DEFINE_X86_VARIANTS(nco_rotate,
+        (struct nco *nco, int16_t *samples, size_t nr_samples),
+        (nco, samples, nr_samples))
+#endif /* defined(_FILTER_HAVE_X86_KERNELS) */
+
+void nco_rotate(struct nco *nco, int16_t *samples, size_t nr_samples)
+{
+    filter_kernels->nco_rotate(nco, samples, nr_samples);
+}
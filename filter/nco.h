@@ -0,0 +1,89 @@
+#pragma once
+
+#include <tsl/result.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The number of phase bits used to look up the sine table. The spurs from truncating the phase
+ * are about 6 dB per bit down, so 12 bits keeps them under the Q.15 noise floor.
+ */
+#define NCO_LUT_BITS                    12
+#define NCO_LUT_ENTRIES                 (1ul << NCO_LUT_BITS)
+
+/**
+ * A numerically controlled oscillator. The phase is a 32-bit accumulator, in units of
+ * 2*pi/2^32, that wraps around exactly once per cycle; the phasor is looked up from a shared
+ * table of Q.15 cosines and sines. Unlike a phasor that is advanced by multiplying it by a
+ * rotation, the amplitude never drifts, and the phase after any number of steps is exact.
+ */
+struct nco {
+    /**
+     * The phase of the next phasor
+     */
+    uint32_t phase;
+
+    /**
+     * The phase increment per step
+     */
+    uint32_t phase_incr;
+};
+
+/**
+ * The shared table of phasors. Each entry holds the Q.15 cosine in its low 16 bits and the sine
+ * in its high 16 bits, so a phasor is a single load. Filled in by the first `nco_init`.
+ */
+extern uint32_t nco_lut[NCO_LUT_ENTRIES];
+
+/**
+ * Convert a frequency to an NCO phase increment.
+ *
+ * \param freq_hz The frequency. Negative frequencies rotate clockwise.
+ * \param sampling_rate The rate the NCO is stepped at
+ *
+ * \return The phase increment per step
+ */
+uint32_t nco_phase_incr(double freq_hz, double sampling_rate);
+
+/**
+ * Set up an NCO, starting from phase 0.
+ *
+ * \param nco The NCO
+ * \param phase_incr The phase increment per step, from `nco_phase_incr`
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t nco_init(struct nco *nco, uint32_t phase_incr);
+
+/**
+ * Look up the phasor for a phase, in Q.15.
+ */
+static inline
+void nco_lookup(uint32_t phase, int16_t *pre, int16_t *pim)
+{
+    uint32_t entry = nco_lut[phase >> (32 - NCO_LUT_BITS)];
+
+    *pre = (int16_t)(entry & 0xffff);
+    *pim = (int16_t)(entry >> 16);
+}
+
+/**
+ * Get the NCO's current phasor, in Q.15, and step the NCO.
+ */
+static inline
+void nco_step(struct nco *nco, int16_t *pre, int16_t *pim)
+{
+    nco_lookup(nco->phase, pre, pim);
+    nco->phase += nco->phase_incr;
+}
+
+/**
+ * Multiply interleaved Q.15 I/Q samples by the NCO's phasors in place, stepping the NCO once
+ * per sample. Uses the best kernel for this CPU.
+ *
+ * \param nco The NCO
+ * \param samples The samples to rotate
+ * \param nr_samples The number of complex samples
+ */
+void nco_rotate(struct nco *nco, int16_t *samples, size_t nr_samples);
@@ -0,0 +1,452 @@
+/*
+ *  pfb_channelizer.c - A polyphase FFT filter bank, for splitting a wideband
+ *      stream into many evenly spaced channels at once.
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/pfb_channelizer.h>
+#include <filter/filter.h>
+#include <filter/filter_priv.h>
+#include <filter/fft.h>
+#include <filter/sample_buf.h>
+
+#include <tsl/safe_alloc.h>
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+
+#include <complex.h>
+#include <math.h>
+#include <string.h>
+
+/**
+ * State for the polyphase filter bank.
+ *
+ * For an M-bin bank with decimation D and prototype filter h, bin k's output at the input
+ * sample n0 is:
+ *      y_k = exp(-2*pi*i*k*n0/M) * sum_r v_r * exp(2*pi*i*k*r/M)
+ * where v_r = sum_p h[p*M + r] * x[n0 - p*M - r] is the output of the r'th branch filter. The sum
+ * over r is an M-point inverse DFT, and the leading term is a rotation that only depends on
+ * n0 mod M, so it is constant when D == M and alternates sign on odd bins when D == M/2.
+ */
+struct pfb_channelizer {
+    /**
+     * Branch filters, stored branch-major. Branch r's p'th coefficient is at (r * nr_branch_coeffs + p).
+     */
+    int16_t *branch_coeffs;
+
+    /**
+     * The number of bins (M)
+     */
+    size_t nr_bins;
+
+    /**
+     * The number of coefficients in each branch filter (P). The prototype is zero-padded to M*P.
+     */
+    size_t nr_branch_coeffs;
+
+    /**
+     * Decimation factor for each bin (D)
+     */
+    unsigned decimation;
+
+    /**
+     * Input history, interleaved I/Q. Always holds at least (M*P - 1) samples before hist_pos.
+     */
+    int16_t *hist;
+
+    /**
+     * Capacity of the history buffer, in complex samples
+     */
+    size_t hist_cap;
+
+    /**
+     * Number of valid complex samples in the history buffer
+     */
+    size_t hist_len;
+
+    /**
+     * Offset of the first sample in the history buffer not yet consumed by an output frame
+     */
+    size_t hist_pos;
+
+    /**
+     * The input sample count, modulo M, of the newest sample in the next output frame, relative
+     * to the first frame.
+     */
+    size_t frame_phase;
+
+    /**
+     * The inverse FFT across the branches
+     */
+    struct fft *ifft;
+
+    /**
+     * The branch filter outputs, input to the inverse FFT
+     */
+    float complex *branch_out;
+
+    /**
+     * The output of the inverse FFT, one sample per bin
+     */
+    float complex *bin_out;
+
+    /**
+     * exp(-2*pi*i*j/M) for j in [0, M), for rotating the bin outputs by frame phase
+     */
+    float complex *rotations;
+};
+
+aresult_t pfb_channelizer_new(struct pfb_channelizer **ppfb, size_t nr_bins, unsigned decimation,
+        const int16_t *proto_coeffs, size_t nr_proto_coeffs)
+{
+    aresult_t ret = A_OK;
+
+    struct pfb_channelizer *pfb = NULL;
+    size_t nr_branch_coeffs = 0;
+
+    TSL_ASSERT_ARG(NULL != ppfb);
+    TSL_ASSERT_ARG(1 < nr_bins);
+    TSL_ASSERT_ARG(decimation == nr_bins || (0 == nr_bins % 2 && decimation == nr_bins/2));
+    TSL_ASSERT_ARG(NULL != proto_coeffs);
+    TSL_ASSERT_ARG(0 != nr_proto_coeffs);
+
+    *ppfb = NULL;
+
+    nr_branch_coeffs = (nr_proto_coeffs + nr_bins - 1)/nr_bins;
+
+    DIAG("PFB: %zu bins, decimation by %u, %zu prototype coefficients (%zu per branch)",
+            nr_bins, decimation, nr_proto_coeffs, nr_branch_coeffs);
+
+    if (FAILED(ret = TZAALLOC(pfb, SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    pfb->nr_bins = nr_bins;
+    pfb->nr_branch_coeffs = nr_branch_coeffs;
+    pfb->decimation = decimation;
+
+    if (FAILED(ret = TACALLOC((void **)&pfb->branch_coeffs, nr_bins * nr_branch_coeffs, sizeof(int16_t),
+                    SYS_CACHE_LINE_LENGTH)))
+    {
+        goto done;
+    }
+
+    /* Split the prototype into M branches; coefficient n belongs to branch n mod M */
+    for (size_t i = 0; i < nr_proto_coeffs; i++) {
+        pfb->branch_coeffs[(i % nr_bins) * nr_branch_coeffs + (i / nr_bins)] = proto_coeffs[i];
+    }
+
+    /* Start with M*P - 1 samples of zeroed history, and room for a reasonable block of input */
+    pfb->hist_len = nr_bins * nr_branch_coeffs - 1;
+    pfb->hist_pos = pfb->hist_len;
+    pfb->hist_cap = pfb->hist_len + 16 * nr_bins;
+
+    if (FAILED(ret = TACALLOC((void **)&pfb->hist, pfb->hist_cap, 2 * sizeof(int16_t), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = fft_new(&pfb->ifft, nr_bins, true))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&pfb->branch_out, nr_bins, sizeof(float complex), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&pfb->bin_out, nr_bins, sizeof(float complex), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&pfb->rotations, nr_bins, sizeof(float complex), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < nr_bins; i++) {
+        double phase = -2.0 * M_PI * (double)i / (double)nr_bins;
+        pfb->rotations[i] = CMPLXF((float)cos(phase), (float)sin(phase));
+    }
+
+    *ppfb = pfb;
+
+done:
+    if (FAILED(ret)) {
+        if (NULL != pfb) {
+            pfb_channelizer_delete(&pfb);
+        }
+    }
+    return ret;
+}
+
+aresult_t pfb_channelizer_delete(struct pfb_channelizer **ppfb)
+{
+    aresult_t ret = A_OK;
+
+    struct pfb_channelizer *pfb = NULL;
+
+    TSL_ASSERT_PTR_BY_REF(ppfb);
+
+    pfb = *ppfb;
+
+    if (NULL != pfb->ifft) {
+        TSL_BUG_IF_FAILED(fft_delete(&pfb->ifft));
+    }
+
+    if (NULL != pfb->branch_coeffs) {
+        TFREE(pfb->branch_coeffs);
+    }
+
+    if (NULL != pfb->hist) {
+        TFREE(pfb->hist);
+    }
+
+    if (NULL != pfb->branch_out) {
+        TFREE(pfb->branch_out);
+    }
+
+    if (NULL != pfb->bin_out) {
+        TFREE(pfb->bin_out);
+    }
+
+    if (NULL != pfb->rotations) {
+        TFREE(pfb->rotations);
+    }
+
+    TFREE(pfb);
+    *ppfb = NULL;
+
+    return ret;
+}
+
+size_t pfb_channelizer_max_out_samples(struct pfb_channelizer *pfb, size_t nr_in_samples)
+{
+    TSL_BUG_ON(NULL == pfb);
+
+    return (pfb->hist_len - pfb->hist_pos + nr_in_samples)/pfb->decimation;
+}
+
+/**
+ * Make sure the history buffer can take another nr_in_samples samples, growing it if needed.
+ */
+static
+aresult_t _pfb_channelizer_reserve(struct pfb_channelizer *pfb, size_t nr_in_samples)
+{
+    aresult_t ret = A_OK;
+
+    int16_t *new_hist = NULL;
+    size_t new_cap = 0;
+
+    if (pfb->hist_len + nr_in_samples <= pfb->hist_cap) {
+        goto done;
+    }
+
+    new_cap = pfb->hist_len + nr_in_samples;
+
+    DIAG("PFB: growing history from %zu to %zu samples", pfb->hist_cap, new_cap);
+
+    if (FAILED(ret = TACALLOC((void **)&new_hist, new_cap, 2 * sizeof(int16_t), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    memcpy(new_hist, pfb->hist, pfb->hist_len * 2 * sizeof(int16_t));
+    TFREE(pfb->hist);
+
+    pfb->hist = new_hist;
+    pfb->hist_cap = new_cap;
+
+done:
+    return ret;
+}
+
+/**
+ * Run each of the M branch filters, for the frame whose newest sample is at hist[newest].
+ */
+static
+void _pfb_channelizer_branch_filters(struct pfb_channelizer *pfb, size_t newest)
+{
+    static const float from_q15 = 1.0f/(float)(1 << Q_15_SHIFT);
+    size_t nr_bins = pfb->nr_bins,
+           nr_branch_coeffs = pfb->nr_branch_coeffs;
+
+    for (size_t r = 0; r < nr_bins; r++) {
+        const int16_t *coeffs = &pfb->branch_coeffs[r * nr_branch_coeffs];
+        const int16_t *sample = &pfb->hist[2 * (newest - r)];
+        int32_t acc_re = 0,
+                acc_im = 0;
+
+        for (size_t p = 0; p < nr_branch_coeffs; p++) {
+            int32_t c = coeffs[p];
+            acc_re += c * sample[0];
+            acc_im += c * sample[1];
+            sample -= 2 * nr_bins;
+        }
+
+        pfb->branch_out[r] = CMPLXF((float)acc_re * from_q15, (float)acc_im * from_q15);
+    }
+}
+
+static inline
+int16_t _pfb_channelizer_sat_q15(float v)
+{
+    long s = lrintf(v);
+
+    if (s > INT16_MAX) {
+        s = INT16_MAX;
+    } else if (s < INT16_MIN) {
+        s = INT16_MIN;
+    }
+
+    return (int16_t)s;
+}
+
+/**
+ * Channelize every full decimation period of samples in the history.
+ *
+ * \return The number of samples written to each bin
+ */
+static
+size_t _pfb_channelizer_run(struct pfb_channelizer *pfb, int16_t *const *bin_out)
+{
+    size_t nr_out = 0,
+           hist_keep = 0,
+           start = 0;
+
+    while (pfb->hist_len - pfb->hist_pos >= pfb->decimation) {
+        size_t newest = pfb->hist_pos + pfb->decimation - 1;
+
+        _pfb_channelizer_branch_filters(pfb, newest);
+        TSL_BUG_IF_FAILED(fft_execute(pfb->ifft, pfb->branch_out, pfb->bin_out));
+
+        for (size_t k = 0; k < pfb->nr_bins; k++) {
+            float complex y = pfb->bin_out[k];
+
+            if (NULL == bin_out[k]) {
+                continue;
+            }
+
+            if (0 != pfb->frame_phase) {
+                float complex rot = pfb->rotations[(k * pfb->frame_phase) % pfb->nr_bins];
+                y = CMPLXF(crealf(y) * crealf(rot) - cimagf(y) * cimagf(rot),
+                           crealf(y) * cimagf(rot) + cimagf(y) * crealf(rot));
+            }
+
+            bin_out[k][2 * nr_out    ] = _pfb_channelizer_sat_q15(crealf(y));
+            bin_out[k][2 * nr_out + 1] = _pfb_channelizer_sat_q15(cimagf(y));
+        }
+
+        pfb->hist_pos += pfb->decimation;
+        pfb->frame_phase = (pfb->frame_phase + pfb->decimation) % pfb->nr_bins;
+        nr_out++;
+    }
+
+    /* Slide the history down, keeping only what the next frame needs */
+    hist_keep = pfb->nr_bins * pfb->nr_branch_coeffs - 1;
+    start = pfb->hist_pos - hist_keep;
+    memmove(pfb->hist, &pfb->hist[2 * start], (pfb->hist_len - start) * 2 * sizeof(int16_t));
+    pfb->hist_len -= start;
+    pfb->hist_pos -= start;
+
+    return nr_out;
+}
+
+aresult_t pfb_channelizer_process(struct pfb_channelizer *pfb, const int16_t *in_samples, size_t nr_in_samples,
+        int16_t *const *bin_out, size_t max_out_samples, size_t *pnr_out_samples)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != pfb);
+    TSL_ASSERT_ARG(NULL != in_samples);
+    TSL_ASSERT_ARG(NULL != bin_out);
+    TSL_ASSERT_ARG(NULL != pnr_out_samples);
+    TSL_ASSERT_ARG(pfb_channelizer_max_out_samples(pfb, nr_in_samples) <= max_out_samples);
+
+    *pnr_out_samples = 0;
+
+    if (FAILED(ret = _pfb_channelizer_reserve(pfb, nr_in_samples))) {
+        goto done;
+    }
+
+    memcpy(&pfb->hist[2 * pfb->hist_len], in_samples, nr_in_samples * 2 * sizeof(int16_t));
+    pfb->hist_len += nr_in_samples;
+
+    *pnr_out_samples = _pfb_channelizer_run(pfb, bin_out);
+
+done:
+    return ret;
+}
+
+aresult_t pfb_channelizer_process_sample_buf(struct pfb_channelizer *pfb, const struct sample_buf *buf,
+        int16_t *const *bin_out, size_t max_out_samples, size_t *pnr_out_samples)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != pfb);
+    TSL_ASSERT_ARG(NULL != buf);
+    TSL_ASSERT_ARG(NULL != bin_out);
+    TSL_ASSERT_ARG(NULL != pnr_out_samples);
+    TSL_ASSERT_ARG(pfb_channelizer_max_out_samples(pfb, buf->nr_samples) <= max_out_samples);
+
+    *pnr_out_samples = 0;
+
+    if (FAILED(ret = _pfb_channelizer_reserve(pfb, buf->nr_samples))) {
+        goto done;
+    }
+
+    /* 8-bit samples are widened straight into the history */
+    if (FAILED(ret = sample_buf_copy_q15(buf, &pfb->hist[2 * pfb->hist_len]))) {
+        goto done;
+    }
+
+    pfb->hist_len += buf->nr_samples;
+
+    *pnr_out_samples = _pfb_channelizer_run(pfb, bin_out);
+
+done:
+    return ret;
+}
+
+aresult_t pfb_channelizer_find_bin(struct pfb_channelizer *pfb, uint32_t sample_rate, int32_t offset_hz,
+        unsigned *pbin, int32_t *presidual_hz)
+{
+    aresult_t ret = A_OK;
+
+    double bin_spacing = 0.0;
+    long bin = 0;
+
+    TSL_ASSERT_ARG(NULL != pfb);
+    TSL_ASSERT_ARG(0 != sample_rate);
+    TSL_ASSERT_ARG(NULL != pbin);
+    TSL_ASSERT_ARG(NULL != presidual_hz);
+
+    bin_spacing = (double)sample_rate / (double)pfb->nr_bins;
+    bin = lround((double)offset_hz / bin_spacing);
+
+    if (labs(bin) > (long)pfb->nr_bins/2) {
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    *presidual_hz = (int32_t)lround((double)offset_hz - (double)bin * bin_spacing);
+    *pbin = (unsigned)((bin + (long)pfb->nr_bins) % (long)pfb->nr_bins);
+
+done:
+    return ret;
+}
+
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <tsl/result.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct pfb_channelizer;
+struct sample_buf;
+
+/**
+ * Polyphase FFT filter bank channelizer.
+ *
+ * Splits a complex input stream sampled at f_s into nr_bins evenly spaced channels, where bin k
+ * is centered at k * f_s / nr_bins (bins above nr_bins/2 are the negative frequencies). Each bin
+ * is decimated by either nr_bins (critically sampled) or nr_bins/2 (2x oversampled, so channels
+ * that sit between bins are not aliased).
+ *
+ * The cost per input sample is roughly nr_proto_coeffs/decimation MACs plus one FFT of
+ * nr_bins points every decimation samples, regardless of how many bins are consumed.
+ */
+
+/**
+ * Create a new polyphase filter bank channelizer.
+ *
+ * \param ppfb The new channelizer, returned by reference.
+ * \param nr_bins The number of bins (M). Must be even if oversampling.
+ * \param decimation The decimation factor for each bin. Must be nr_bins or nr_bins/2.
+ * \param proto_coeffs The prototype low-pass filter, designed at the input sample rate, in Q.15.
+ *                     Its cutoff should be at about f_s/(2 * decimation).
+ * \param nr_proto_coeffs The number of prototype filter coefficients
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t pfb_channelizer_new(struct pfb_channelizer **ppfb, size_t nr_bins, unsigned decimation,
+        const int16_t *proto_coeffs, size_t nr_proto_coeffs);
+
+/**
+ * Release the resources used by a polyphase filter bank channelizer.
+ *
+ * \param ppfb The channelizer, passed by reference. Set to NULL on success.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t pfb_channelizer_delete(struct pfb_channelizer **ppfb);
+
+/**
+ * Channelize a block of complex Q.15 input samples. All input samples are consumed; any samples
+ * that do not yet make up a full decimation period are held until the next call.
+ *
+ * \param pfb The channelizer
+ * \param in_samples Interleaved I/Q input samples
+ * \param nr_in_samples The number of complex input samples
+ * \param bin_out Array of nr_bins output pointers, one per bin. Bins with a NULL pointer are not
+ *                written out. Each output is interleaved I/Q.
+ * \param max_out_samples The number of complex samples each output buffer can hold. Must be at
+ *                        least pfb_channelizer_max_out_samples(pfb, nr_in_samples).
+ * \param pnr_out_samples The number of samples written to each bin, returned by reference.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t pfb_channelizer_process(struct pfb_channelizer *pfb, const int16_t *in_samples, size_t nr_in_samples,
+        int16_t *const *bin_out, size_t max_out_samples, size_t *pnr_out_samples);
+
+/**
+ * Channelize the samples in a sample buffer, exactly as `pfb_channelizer_process` would. 8-bit
+ * samples are widened to Q.15 as they are copied into the channelizer's history. The sample
+ * buffer is not released.
+ */
+aresult_t pfb_channelizer_process_sample_buf(struct pfb_channelizer *pfb, const struct sample_buf *buf,
+        int16_t *const *bin_out, size_t max_out_samples, size_t *pnr_out_samples);
+
+/**
+ * Find the bin a channel at the given offset from the input center frequency falls in.
+ *
+ * \param pfb The channelizer
+ * \param sample_rate The input sample rate, in Hz
+ * \param offset_hz The channel's offset from the input center frequency, in Hz
+ * \param pbin The bin index, returned by reference
+ * \param presidual_hz The channel's offset from the bin's center frequency, returned by reference.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t pfb_channelizer_find_bin(struct pfb_channelizer *pfb, uint32_t sample_rate, int32_t offset_hz,
+        unsigned *pbin, int32_t *presidual_hz);
+
+/**
+ * The maximum number of samples per bin a call to pfb_channelizer_process with nr_in_samples
+ * input samples can produce.
+ */
+size_t pfb_channelizer_max_out_samples(struct pfb_channelizer *pfb, size_t nr_in_samples);
+
@@ -27,6 +27,10 @@
 #include <filter/filter_priv.h>
 #include <filter/sample_buf.h>
 #include <filter/utils.h>
+#include <filter/kernels.h>
+#include <filter/kernels_fixed.h>
+#include <filter/fir_fold.h>
+#include <filter/complex.h>
 
 #include <tsl/safe_alloc.h>
 #include <tsl/diag.h>
@@ -51,6 +55,7 @@ aresult_t polyphase_fir_new(struct polyphase_fir **pfir, size_t nr_coeffs, const
 
     struct polyphase_fir *fir = NULL;
     unsigned phase_coeffs = 0;
+    size_t nr_nonzero = 0;
 
     TSL_ASSERT_ARG(NULL != pfir);
     TSL_ASSERT_ARG(0 != nr_coeffs);
@@ -58,10 +63,18 @@ aresult_t polyphase_fir_new(struct polyphase_fir **pfir, size_t nr_coeffs, const
     TSL_ASSERT_ARG(0 < interpolate);
     TSL_ASSERT_ARG(0 < decimate);
 
+    if (FAILED(ret = filter_kernels_init())) {
+        goto done;
+    }
+
     if (FAILED(ret = TZAALLOC(fir, SYS_CACHE_LINE_LENGTH))) {
         goto done;
     }
 
+    if (FAILED(ret = sample_history_init(&fir->hist, sizeof(int16_t)))) {
+        goto done;
+    }
+
     fir->nr_phase_filters = interpolate;
     fir->interpolation = interpolate;
     fir->decimation = decimate;
@@ -82,6 +95,49 @@ aresult_t polyphase_fir_new(struct polyphase_fir **pfir, size_t nr_coeffs, const
         fir->phase_filters[(i % interpolate) * phase_coeffs + (i / interpolate)] = fir_coeff[i];
     }
 
+    /* Find the non-zero span of each phase filter */
+    if (FAILED(ret = TCALLOC((void **)&fir->phase_first, interpolate, sizeof(size_t)))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TCALLOC((void **)&fir->phase_nr, interpolate, sizeof(size_t)))) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < interpolate; i++) {
+        const int16_t *phase = &fir->phase_filters[i * phase_coeffs];
+        size_t first = 0,
+               last = phase_coeffs;
+
+        while (first < last && 0 == phase[first]) {
+            first++;
+        }
+
+        while (last > first && 0 == phase[last - 1]) {
+            last--;
+        }
+
+        fir->phase_first[i] = first;
+        fir->phase_nr[i] = last - first;
+        nr_nonzero += last - first;
+    }
+
+    fir->sparse_phases = nr_nonzero * 4 <= (size_t)interpolate * phase_coeffs * 3;
+
+    /* Use a kernel built for this exact phase filter length, if there is one */
+    fir->dot_real_block = filter_kernels_fixed_dot_real(filter_kernels, phase_coeffs);
+
+    if (NULL == fir->dot_real_block) {
+        fir->dot_real_block = filter_kernels->dot_real_block;
+    }
+
+    /* When only decimating, the one phase filter is the whole filter, so it might fold */
+    if (1 == interpolate) {
+        if (FAILED(ret = fir_fold_init(&fir->fold, fir_coeff, nr_coeffs))) {
+            goto done;
+        }
+    }
+
 #ifdef _DUMP_FILTER_COEFFICIENTS
     for (size_t i = 0; i < fir->nr_phase_filters; i++) {
         printf("\nPhase %4zu: ", i);
@@ -98,7 +154,7 @@ aresult_t polyphase_fir_new(struct polyphase_fir **pfir, size_t nr_coeffs, const
 done:
     if (FAILED(ret)) {
         if (NULL != fir) {
-            TFREE(fir);
+            polyphase_fir_delete(&fir);
         }
     }
     return ret;
@@ -125,6 +181,18 @@ aresult_t polyphase_fir_delete(struct polyphase_fir **pfir)
         TFREE(fir->phase_filters);
     }
 
+    if (NULL != fir->phase_first) {
+        TFREE(fir->phase_first);
+    }
+
+    if (NULL != fir->phase_nr) {
+        TFREE(fir->phase_nr);
+    }
+
+    TSL_BUG_IF_FAILED(fir_fold_cleanup(&fir->fold));
+
+    TSL_BUG_IF_FAILED(sample_history_cleanup(&fir->hist));
+
     TFREE(fir);
     *pfir = NULL;
 
@@ -138,34 +206,77 @@ aresult_t polyphase_fir_push_sample_buf(struct polyphase_fir *fir, struct sample
     TSL_ASSERT_ARG(NULL != fir);
     TSL_ASSERT_ARG(NULL != buf);
 
-    TSL_BUG_ON(fir->sb_active == buf);
-    TSL_BUG_ON(fir->sb_next == buf);
-
-    if (NULL == fir->sb_active) {
-        fir->sb_active = buf;
-        TSL_BUG_ON(NULL != fir->sb_next);
-    } else {
-        if (NULL == fir->sb_next) {
-            fir->sb_next = buf;
-        } else {
-            ret = A_E_BUSY;
-            goto done;
-        }
+    /* Copy the samples in behind the overlap from the previous buffers */
+    if (FAILED(ret = sample_history_append(&fir->hist, buf->data_buf, buf->nr_samples))) {
+        goto done;
+    }
+
+    fir->max_push = BL_MAX2(fir->max_push, buf->nr_samples);
+
+    TSL_BUG_IF_FAILED(sample_buf_decref(buf));
+
+done:
+    return ret;
+}
+
+aresult_t polyphase_fir_push_samples(struct polyphase_fir *fir, const int16_t *samples, size_t nr_samples)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != fir);
+    TSL_ASSERT_ARG(NULL != samples);
+
+    if (FAILED(ret = sample_history_append(&fir->hist, samples, nr_samples))) {
+        goto done;
     }
 
-    fir->nr_samples += buf->nr_samples;
+    fir->max_push = BL_MAX2(fir->max_push, nr_samples);
 
 done:
     return ret;
 }
 
+/**
+ * Compute outputs one at a time, with the folded filter or only the non-zero span of each phase
+ * filter. The outputs are exactly the same as applying the whole phase filter.
+ */
+static
+size_t _polyphase_fir_process_pruned(struct polyphase_fir *fir, int16_t *out_buf, size_t nr_out_samples)
+{
+    size_t phase_id = fir->last_phase,
+           nr_out = 0;
+
+    while (nr_out < nr_out_samples && sample_history_avail(&fir->hist) >= fir->nr_filter_coeffs) {
+        const int16_t *samples = sample_history_head(&fir->hist);
+        int32_t acc = 0;
+
+        if (FIR_SYMMETRY_NONE != fir->fold.symmetry) {
+            filter_kernels->fir_fold_dot(&fir->fold, samples, &acc);
+        } else if (0 != fir->phase_nr[phase_id]) {
+            size_t first = fir->phase_first[phase_id];
+
+            filter_kernels->dot_real(samples + first, &fir->phase_filters[fir->nr_filter_coeffs * phase_id + first],
+                    fir->phase_nr[phase_id], &acc);
+        }
+
+        out_buf[nr_out++] = round_q30_q15(acc);
+
+        phase_id += fir->decimation;
+        sample_history_advance(&fir->hist, phase_id / fir->interpolation);
+        phase_id %= fir->interpolation;
+    }
+
+    fir->last_phase = phase_id;
+
+    return nr_out;
+}
+
 aresult_t polyphase_fir_process(struct polyphase_fir *fir, int16_t *out_buf, size_t nr_out_samples,
         size_t *nr_out_samples_generated)
 {
     aresult_t ret = A_OK;
 
     size_t phase_id = 0,
-           nr_consumed = 0,
            nr_computed_samples = 0;
 
     TSL_ASSERT_ARG(NULL != fir);
@@ -175,28 +286,57 @@ aresult_t polyphase_fir_process(struct polyphase_fir *fir, int16_t *out_buf, siz
 
     *nr_out_samples_generated = 0;
 
-    if (NULL == fir->sb_active && NULL == fir->sb_next) {
+    if (FIR_SYMMETRY_NONE != fir->fold.symmetry || fir->sparse_phases) {
+        *nr_out_samples_generated = _polyphase_fir_process_pruned(fir, out_buf, nr_out_samples);
         goto done;
     }
 
     phase_id = fir->last_phase;
 
-    for (size_t i = 0; i < nr_out_samples && fir->nr_samples > fir->nr_filter_coeffs; i++) {
+    /* Work out where the next few outputs' windows start and which phase filter each of them
+     * uses, and compute them all in a single pass while there are enough samples.
+     */
+    while (nr_computed_samples + FILTER_BLOCK_OUTPUTS <= nr_out_samples) {
+        const int16_t *samples[FILTER_BLOCK_OUTPUTS],
+                      *coeffs[FILTER_BLOCK_OUTPUTS];
+        const int16_t *head = sample_history_head(&fir->hist);
+        int32_t acc[FILTER_BLOCK_OUTPUTS];
+        size_t offset = 0,
+               next_phase = phase_id;
+
+        for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+            samples[k] = head + offset;
+            coeffs[k] = &fir->phase_filters[fir->nr_filter_coeffs * next_phase];
+
+            next_phase += fir->decimation;
+            offset += next_phase / fir->interpolation;
+            next_phase %= fir->interpolation;
+        }
+
+        if (sample_history_avail(&fir->hist) < (size_t)(samples[FILTER_BLOCK_OUTPUTS - 1] - head) + fir->nr_filter_coeffs) {
+            break;
+        }
+
+        fir->dot_real_block(samples, coeffs, fir->nr_filter_coeffs, acc);
+
+        for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+            out_buf[nr_computed_samples++] = round_q30_q15(acc[k]);
+        }
+
+        sample_history_advance(&fir->hist, offset);
+        phase_id = next_phase;
+        fir->last_phase = phase_id;
+    }
+
+    for (size_t i = nr_computed_samples; i < nr_out_samples && sample_history_avail(&fir->hist) >= fir->nr_filter_coeffs; i++) {
         size_t interp_phase = 0;
         TSL_BUG_ON(phase_id >= fir->nr_phase_filters);
 
-        aresult_t filt_ret = dot_product_sample_buffers_real(
-                fir->sb_active,
-                fir->sb_next,
-                fir->sample_offset,
-                &fir->phase_filters[fir->nr_filter_coeffs * phase_id],
-                fir->nr_filter_coeffs,
-                &out_buf[i]);
-
-        if (filt_ret == A_E_DONE) {
-            *nr_out_samples_generated = i;
-            goto done;
-        } else if (FAILED(filt_ret)) {
+        if (FAILED(ret = dot_product_real(sample_history_head(&fir->hist),
+                        &fir->phase_filters[fir->nr_filter_coeffs * phase_id],
+                        fir->nr_filter_coeffs,
+                        &out_buf[i])))
+        {
             goto done;
         }
 
@@ -207,21 +347,7 @@ aresult_t polyphase_fir_process(struct polyphase_fir *fir, int16_t *out_buf, siz
 
         interp_phase = phase_id / fir->interpolation;
         phase_id = phase_id % fir->interpolation;
-        nr_consumed += interp_phase;
-        fir->nr_samples -= interp_phase;
-
-        /* Check if we're going to need to update the active buffer */
-        if (fir->sample_offset + interp_phase > fir->sb_active->nr_samples) {
-            /* Retire the active buffer, shift next to active */
-            size_t old_nr_samples = fir->sb_active->nr_samples;
-            TSL_BUG_IF_FAILED(sample_buf_decref(fir->sb_active));
-            fir->sb_active = fir->sb_next;
-            fir->sb_next = NULL;
-            fir->sample_offset = fir->sample_offset + interp_phase - old_nr_samples;
-        } else {
-            /* Continue walking the current buffer */
-            fir->sample_offset += interp_phase;
-        }
+        sample_history_advance(&fir->hist, interp_phase);
 
         fir->last_phase = phase_id;
     }
@@ -242,7 +368,7 @@ aresult_t polyphase_fir_can_process(struct polyphase_fir *fir, bool *pcan_proces
     /* The trick for this is to see if there are at least enough samples to run a single pass of the
      * FIR.
      */
-    *pcan_process = fir->nr_samples >= fir->nr_filter_coeffs;
+    *pcan_process = sample_history_avail(&fir->hist) >= fir->nr_filter_coeffs;
 
     return ret;
 }
@@ -254,7 +380,11 @@ aresult_t polyphase_fir_full(struct polyphase_fir *fir, bool *pfull)
     TSL_ASSERT_ARG_DEBUG(NULL != fir);
     TSL_ASSERT_ARG_DEBUG(NULL != pfull);
 
-    *pfull = (NULL != fir->sb_next);
+    /* Report full once a whole sample buffer is waiting beyond the filter overlap, so callers
+     * don't read ahead of the filter without bound.
+     */
+    *pfull = 0 != fir->max_push &&
+        sample_history_avail(&fir->hist) >= fir->nr_filter_coeffs + fir->max_push;
 
     return ret;
 }
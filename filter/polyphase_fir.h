@@ -11,6 +11,18 @@ aresult_t polyphase_fir_new(struct polyphase_fir **pfir, size_t nr_coeffs, const
         unsigned interpolate, unsigned decimate);
 aresult_t polyphase_fir_delete(struct polyphase_fir **pfir);
 aresult_t polyphase_fir_push_sample_buf(struct polyphase_fir *fir, struct sample_buf *buf);
+
+/**
+ * Push real samples straight into the polyphase FIR's history, for callers that produce their
+ * own samples rather than receiving sample buffers. The samples are copied.
+ *
+ * \param fir The polyphase FIR
+ * \param samples The samples to push
+ * \param nr_samples The number of samples
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t polyphase_fir_push_samples(struct polyphase_fir *fir, const int16_t *samples, size_t nr_samples);
 aresult_t polyphase_fir_process(struct polyphase_fir *fir, int16_t *out_buf, size_t nr_out_samples,
         size_t *nr_out_samples_generated);
 aresult_t polyphase_fir_can_process(struct polyphase_fir *fir, bool *pcan_process);
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <filter/sample_history.h>
+#include <filter/fir_fold.h>
+
+#include <stdbool.h>
 #include <stdint.h>
 
 struct sample_buf;
@@ -39,38 +43,57 @@ struct polyphase_fir {
     size_t nr_filter_coeffs;
 
     /**
-     * The last phase we processed
+     * The span of each phase filter that isn't zero: phase filter i's non-zero coefficients
+     * start at phase_first[i] and there are phase_nr[i] of them. Splitting a halfband filter
+     * into two phases leaves one of them almost all zeros.
      */
-    size_t last_phase;
+    size_t *phase_first;
+    size_t *phase_nr;
 
     /**
-     * The interpolation factor
+     * Whether the phase filters are mostly zeros, so it's cheaper to only apply the non-zero
+     * span of each phase filter than to compute outputs a block at a time.
      */
-    unsigned int interpolation;
+    bool sparse_phases;
 
     /**
-     * The decimation factor
+     * Computes FILTER_BLOCK_OUTPUTS outputs at a time: a kernel built for exactly
+     * nr_filter_coeffs coefficients if there is one (see `FILTER_FIXED_POLYPHASE`), otherwise
+     * the generic kernel.
      */
-    unsigned int decimation;
+    void (*dot_real_block)(const int16_t *const *samples, const int16_t *const *coeffs, size_t nr_coeffs,
+            int32_t *acc);
 
     /**
-     * The current sample buffer to process
+     * The filter folded in half, if it's symmetric and there is a single phase filter (i.e.
+     * we are only decimating). The phase filters of a symmetric filter aren't symmetric
+     * themselves, so there is nothing to fold when interpolating.
      */
-    struct sample_buf *sb_active;
+    struct fir_fold fold;
 
     /**
-     * The next sample buffer to process
+     * The last phase we processed
      */
-    struct sample_buf *sb_next;
+    size_t last_phase;
+
+    /**
+     * The interpolation factor
+     */
+    unsigned int interpolation;
+
+    /**
+     * The decimation factor
+     */
+    unsigned int decimation;
 
     /**
-     * The total number of samples contained in this polyphase FIR
+     * The samples waiting to be filtered, including the overlap from earlier sample buffers
      */
-    size_t nr_samples;
+    struct sample_history hist;
 
     /**
-     * The next sample to be processed, relative to the start of sb_active.
+     * The largest number of samples pushed in a single sample buffer
      */
-    size_t sample_offset;
+    size_t max_push;
 };
 
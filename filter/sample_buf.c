@@ -21,12 +21,14 @@
  */
 
 #include <filter/sample_buf.h>
+#include <filter/convert.h>
 
 #include <tsl/result.h>
 #include <tsl/diag.h>
 #include <tsl/assert.h>
 
 #include <stdatomic.h>
+#include <string.h>
 
 aresult_t sample_buf_decref(struct sample_buf *buf)
 {
@@ -42,3 +44,78 @@ aresult_t sample_buf_decref(struct sample_buf *buf)
     return ret;
 }
 
+
+/**
+ * Widen 8-bit samples to Q.15. type is always a constant, so each type gets its own loop.
+ */
+static inline __attribute__((always_inline))
+void _sample_buf_widen(const void *restrict samples, enum sample_type type, size_t nr, int16_t *restrict dest)
+{
+    for (size_t i = 0; i < nr; i++) {
+        dest[i] = sample_get_q15(samples, type, i);
+    }
+}
+
+aresult_t sample_buf_copy_q15(const struct sample_buf *buf, int16_t *dest)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != buf);
+    TSL_ASSERT_ARG_DEBUG(NULL != dest);
+
+    switch (buf->sample_type) {
+    case COMPLEX_UINT_8:
+        _sample_buf_widen(buf->data_buf, COMPLEX_UINT_8, 2 * buf->nr_samples, dest);
+        break;
+    case COMPLEX_INT_8:
+        _sample_buf_widen(buf->data_buf, COMPLEX_INT_8, 2 * buf->nr_samples, dest);
+        break;
+    case COMPLEX_FLOAT_32:
+        ret = convert_to_q15(CONVERT_FORMAT_CF32, buf->data_buf, buf->nr_samples, dest, NULL);
+        break;
+    default:
+        memcpy(dest, buf->data_buf, buf->nr_samples * 2 * sizeof(int16_t));
+        break;
+    }
+
+    return ret;
+}
+
+/**
+ * Scale Q.15 samples, or 8-bit samples widened to Q.15, to floats. type is always a constant,
+ * so each type gets its own loop.
+ */
+static inline __attribute__((always_inline))
+void _sample_buf_to_f32(const void *restrict samples, enum sample_type type, size_t nr, float *restrict dest)
+{
+    const float scale = 1.0f / (float)(1 << Q_15_SHIFT);
+
+    for (size_t i = 0; i < nr; i++) {
+        dest[i] = (float)sample_get_q15(samples, type, i) * scale;
+    }
+}
+
+aresult_t sample_buf_copy_f32(const struct sample_buf *buf, float *dest)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != buf);
+    TSL_ASSERT_ARG_DEBUG(NULL != dest);
+
+    switch (buf->sample_type) {
+    case COMPLEX_UINT_8:
+        _sample_buf_to_f32(buf->data_buf, COMPLEX_UINT_8, 2 * buf->nr_samples, dest);
+        break;
+    case COMPLEX_INT_8:
+        _sample_buf_to_f32(buf->data_buf, COMPLEX_INT_8, 2 * buf->nr_samples, dest);
+        break;
+    case COMPLEX_FLOAT_32:
+        memcpy(dest, buf->data_buf, buf->nr_samples * 2 * sizeof(float));
+        break;
+    default:
+        _sample_buf_to_f32(buf->data_buf, COMPLEX_INT_16, 2 * buf->nr_samples, dest);
+        break;
+    }
+
+    return ret;
+}
@@ -5,6 +5,8 @@
 #include <tsl/cal.h>
 #include <tsl/result.h>
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 struct sample_buf;
@@ -42,8 +44,35 @@ enum sample_type {
      * Samples are complex unsigned 32-bit integers
      */
     COMPLEX_UINT_32     = 5,
+
+    /**
+     * Samples are complex signed 8-bit integers. Sample s is worth s << SAMPLE_8BIT_Q15_SHIFT in Q.15.
+     */
+    COMPLEX_INT_8       = 6,
+
+    /**
+     * Samples are complex unsigned 8-bit integers, centered on SAMPLE_UINT_8_ZERO, as delivered
+     * by the RTL-SDR. Sample u is worth (u - SAMPLE_UINT_8_ZERO) << SAMPLE_8BIT_Q15_SHIFT in Q.15.
+     */
+    COMPLEX_UINT_8      = 7,
+
+    /**
+     * Samples are complex 32-bit floats, with full scale at +/-1.0. Sample f is worth
+     * f * (1 << Q_15_SHIFT) in Q.15.
+     */
+    COMPLEX_FLOAT_32    = 8,
 };
 
+/**
+ * How far an 8-bit sample is shifted up to get the equivalent Q.15 sample
+ */
+#define SAMPLE_8BIT_Q15_SHIFT           7
+
+/**
+ * The value of a COMPLEX_UINT_8 sample that represents zero
+ */
+#define SAMPLE_UINT_8_ZERO              127
+
 typedef aresult_t (*sample_buf_release_func_t)(struct sample_buf *buf);
 
 /**
@@ -103,3 +132,58 @@ struct sample_buf {
 
 aresult_t sample_buf_decref(struct sample_buf *buf);
 
+/**
+ * Determine whether a sample type holds 8-bit complex samples
+ */
+static inline
+bool sample_type_is_8bit(enum sample_type type)
+{
+    return COMPLEX_INT_8 == type || COMPLEX_UINT_8 == type;
+}
+
+/**
+ * Get component i (I and Q counting separately) of a buffer of complex samples, as Q.15.
+ * Buffers that are neither 8-bit type are taken to hold Q.15 samples already; float buffers have
+ * to be copied out with `sample_buf_copy_q15`.
+ */
+static inline
+int16_t sample_get_q15(const void *samples, enum sample_type type, size_t i)
+{
+    int16_t sample = 0;
+
+    switch (type) {
+    case COMPLEX_UINT_8:
+        sample = ((int16_t)((const uint8_t *)samples)[i] - SAMPLE_UINT_8_ZERO) * (1 << SAMPLE_8BIT_Q15_SHIFT);
+        break;
+    case COMPLEX_INT_8:
+        sample = (int16_t)((const int8_t *)samples)[i] * (1 << SAMPLE_8BIT_Q15_SHIFT);
+        break;
+    default:
+        sample = ((const int16_t *)samples)[i];
+        break;
+    }
+
+    return sample;
+}
+
+/**
+ * Copy the samples in a sample buffer out as interleaved Q.15 I/Q, widening 8-bit samples on
+ * the way.
+ *
+ * \param buf The sample buffer
+ * \param dest Where to write the buf->nr_samples complex samples
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t sample_buf_copy_q15(const struct sample_buf *buf, int16_t *dest);
+
+/**
+ * Copy the samples in a sample buffer out as interleaved float I/Q, with full scale at +/-1.0.
+ *
+ * \param buf The sample buffer
+ * \param dest Where to write the buf->nr_samples complex samples
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t sample_buf_copy_f32(const struct sample_buf *buf, float *dest);
+
@@ -0,0 +1,153 @@
+/*
+ *  sample_history.c - Contiguous sample history for filters
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/sample_history.h>
+#include <filter/sample_buf.h>
+
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/safe_alloc.h>
+#include <tsl/basic.h>
+
+#include <string.h>
+
+aresult_t sample_history_init(struct sample_history *hist, size_t sample_bytes)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != hist);
+    TSL_ASSERT_ARG(0 != sample_bytes);
+
+    memset(hist, 0, sizeof(*hist));
+    hist->sample_bytes = sample_bytes;
+
+    return ret;
+}
+
+aresult_t sample_history_cleanup(struct sample_history *hist)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != hist);
+
+    if (NULL != hist->samples) {
+        TFREE(hist->samples);
+    }
+
+    hist->cap = 0;
+    hist->nr = 0;
+    hist->offset = 0;
+
+    return ret;
+}
+
+aresult_t sample_history_reserve(struct sample_history *hist, size_t nr_samples, void **pdest)
+{
+    aresult_t ret = A_OK;
+
+    size_t sb = 0;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != hist);
+    TSL_ASSERT_ARG_DEBUG(NULL != pdest);
+
+    sb = hist->sample_bytes;
+    *pdest = NULL;
+
+    /* Drop the samples that have already been consumed. What remains is at most the filter
+     * overlap, so this is cheap.
+     */
+    if (hist->offset >= hist->nr) {
+        hist->offset -= hist->nr;
+        hist->nr = 0;
+    } else if (0 != hist->offset) {
+        memmove(hist->samples, hist->samples + hist->offset * sb, (hist->nr - hist->offset) * sb);
+        hist->nr -= hist->offset;
+        hist->offset = 0;
+    }
+
+    /* Grow the history if this is the most we've had to hold at once */
+    if (hist->nr + nr_samples > hist->cap) {
+        uint8_t *new_samples = NULL;
+        size_t new_cap = BL_MAX2(hist->nr + nr_samples, 2 * hist->cap);
+
+        if (FAILED(ret = TACALLOC((void **)&new_samples, new_cap, sb, SYS_CACHE_LINE_LENGTH))) {
+            goto done;
+        }
+
+        if (NULL != hist->samples) {
+            memcpy(new_samples, hist->samples, hist->nr * sb);
+            TFREE(hist->samples);
+        }
+
+        hist->samples = new_samples;
+        hist->cap = new_cap;
+    }
+
+    *pdest = hist->samples + hist->nr * sb;
+
+done:
+    return ret;
+}
+
+aresult_t sample_history_append(struct sample_history *hist, const void *src, size_t nr_samples)
+{
+    aresult_t ret = A_OK;
+
+    void *dest = NULL;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != src);
+
+    if (FAILED(ret = sample_history_reserve(hist, nr_samples, &dest))) {
+        goto done;
+    }
+
+    memcpy(dest, src, nr_samples * hist->sample_bytes);
+    sample_history_commit(hist, nr_samples);
+
+done:
+    return ret;
+}
+
+
+aresult_t sample_history_append_q15(struct sample_history *hist, const struct sample_buf *buf)
+{
+    aresult_t ret = A_OK;
+
+    int16_t *dest = NULL;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != hist);
+    TSL_ASSERT_ARG_DEBUG(NULL != buf);
+    TSL_ASSERT_ARG_DEBUG(2 * sizeof(int16_t) == hist->sample_bytes);
+
+    if (FAILED(ret = sample_history_reserve(hist, buf->nr_samples, (void **)&dest))) {
+        goto done;
+    }
+
+    if (FAILED(ret = sample_buf_copy_q15(buf, dest))) {
+        goto done;
+    }
+
+    sample_history_commit(hist, buf->nr_samples);
+
+done:
+    return ret;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <tsl/result.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct sample_buf;
+
+/**
+ * A contiguous history of samples for a filter. New samples are appended after whatever the
+ * filter has not consumed yet, so a filter kernel always sees the overlap from the previous
+ * sample buffer and the new samples as one linear span, no matter how many sample buffers the
+ * samples came from.
+ */
+struct sample_history {
+    /**
+     * The samples. Only [offset, nr) have not been consumed yet.
+     */
+    uint8_t *samples;
+
+    /**
+     * The size of a single sample, in bytes
+     */
+    size_t sample_bytes;
+
+    /**
+     * The capacity of the history, in samples
+     */
+    size_t cap;
+
+    /**
+     * The number of valid samples in the history
+     */
+    size_t nr;
+
+    /**
+     * The next sample to be consumed. Can be past nr if a decimating filter skips over samples
+     * that have not arrived yet.
+     */
+    size_t offset;
+};
+
+/**
+ * Initialize an empty sample history.
+ *
+ * \param hist The history
+ * \param sample_bytes The size of a single sample, in bytes
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t sample_history_init(struct sample_history *hist, size_t sample_bytes);
+
+/**
+ * Release the memory held by a sample history.
+ */
+aresult_t sample_history_cleanup(struct sample_history *hist);
+
+/**
+ * Make room for nr_samples new samples at the end of the history, discarding samples that have
+ * already been consumed. The new samples must then be written to the returned pointer and
+ * committed with `sample_history_commit`.
+ *
+ * \param hist The history
+ * \param nr_samples The number of samples to make room for
+ * \param pdest Where to write the new samples, returned by reference
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t sample_history_reserve(struct sample_history *hist, size_t nr_samples, void **pdest);
+
+/**
+ * Append nr_samples samples to the history, copying them from src.
+ */
+aresult_t sample_history_append(struct sample_history *hist, const void *src, size_t nr_samples);
+
+/**
+ * Append the samples in a sample buffer to a history of interleaved Q.15 I/Q samples, widening
+ * 8-bit samples on the way in. See `sample_buf_copy_q15`.
+ */
+aresult_t sample_history_append_q15(struct sample_history *hist, const struct sample_buf *buf);
+
+/**
+ * Commit samples written to the space returned by `sample_history_reserve`.
+ */
+static inline
+void sample_history_commit(struct sample_history *hist, size_t nr_samples)
+{
+    hist->nr += nr_samples;
+}
+
+/**
+ * The number of samples that have not been consumed yet
+ */
+static inline
+size_t sample_history_avail(const struct sample_history *hist)
+{
+    return hist->offset < hist->nr ? hist->nr - hist->offset : 0;
+}
+
+/**
+ * Get a pointer to the next sample to be consumed
+ */
+static inline
+void *sample_history_head(const struct sample_history *hist)
+{
+    return hist->samples + hist->offset * hist->sample_bytes;
+}
+
+/**
+ * Consume nr_samples samples. May run past the samples that are available.
+ */
+static inline
+void sample_history_advance(struct sample_history *hist, size_t nr_samples)
+{
+    hist->offset += nr_samples;
+}
+
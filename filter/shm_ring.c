@@ -0,0 +1,591 @@
+/*
+ *  shm_ring.c - Single producer shared memory sample ring, read in place by other processes
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <filter/shm_ring.h>
+
+#include <tsl/basic.h>
+#include <tsl/safe_alloc.h>
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * The producer's view of a ring
+ */
+struct shm_ring {
+    /**
+     * The mapped ring
+     */
+    struct shm_ring_header *hdr;
+
+    /**
+     * The size of the mapping, in bytes
+     */
+    size_t map_bytes;
+
+    /**
+     * Producer-private copy of the write cursor
+     */
+    uint64_t write_seq;
+
+    /**
+     * Whether this ring created the shared memory object, and has to unlink it
+     */
+    bool created;
+
+    /**
+     * The device and inode of the shared memory object, so it is only unlinked if another
+     * producer hasn't taken the name over since
+     */
+    dev_t dev;
+    ino_t ino;
+
+    /**
+     * The name of the shared memory object, with its leading '/'
+     */
+    char name[NAME_MAX + 1];
+};
+
+/**
+ * A consumer's view of a ring
+ */
+struct shm_ring_consumer {
+    /**
+     * The mapped ring
+     */
+    struct shm_ring_header *hdr;
+
+    /**
+     * The size of the mapping, in bytes
+     */
+    size_t map_bytes;
+
+    /**
+     * The sequence number of the next block to read
+     */
+    uint64_t next_seq;
+
+    /**
+     * The block handed out by `shm_ring_consumer_next`, or NULL
+     */
+    const struct shm_ring_block *cur;
+
+    /**
+     * The total number of blocks lost to the producer lapping this consumer
+     */
+    uint64_t nr_dropped;
+};
+
+static inline
+long _shm_ring_futex(_Atomic uint32_t *word, int op, uint32_t val, const struct timespec *timeout)
+{
+    return syscall(SYS_futex, (uint32_t *)word, op, val, timeout, NULL, 0);
+}
+
+/**
+ * Turn a ring name into a POSIX shared memory object name, adding the leading '/' if it's
+ * missing.
+ */
+static
+aresult_t _shm_ring_name(char *path, size_t path_len, const char *name)
+{
+    aresult_t ret = A_OK;
+
+    int len = 0;
+
+    if ('/' == *name) {
+        name++;
+    }
+
+    if ('\0' == *name || NULL != strchr(name, '/')) {
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    len = snprintf(path, path_len, "/%s", name);
+
+    if (0 > len || (size_t)len >= path_len) {
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+done:
+    return ret;
+}
+
+/**
+ * Get the block that holds the block with the given sequence number
+ */
+static inline
+struct shm_ring_block *_shm_ring_block(struct shm_ring_header *hdr, uint64_t seq)
+{
+    return (struct shm_ring_block *)((uint8_t *)hdr + sizeof(struct shm_ring_header) +
+            (size_t)(seq & (hdr->nr_blocks - 1)) * hdr->block_stride);
+}
+
+/**
+ * Mark the ring closed and wake up everyone waiting on it
+ */
+static
+void _shm_ring_close(struct shm_ring_header *hdr)
+{
+    atomic_fetch_or(&hdr->flags, SHM_RING_FLAG_CLOSED);
+    atomic_fetch_add(&hdr->wake_seq, 1);
+    _shm_ring_futex(&hdr->wake_seq, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+/**
+ * If a ring by this name is left over from a producer that's gone, mark it closed, so anyone
+ * still reading it doesn't wait on it forever.
+ */
+static
+void _shm_ring_close_stale(const char *path)
+{
+    int fd = -1;
+    struct stat st;
+    struct shm_ring_header *hdr = MAP_FAILED;
+
+    if (0 > (fd = shm_open(path, O_RDWR, 0))) {
+        goto done;
+    }
+
+    if (0 > fstat(fd, &st) || (size_t)st.st_size < sizeof(struct shm_ring_header)) {
+        goto done;
+    }
+
+    if (MAP_FAILED == (hdr = mmap(NULL, sizeof(struct shm_ring_header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0))) {
+        goto done;
+    }
+
+    if (SHM_RING_MAGIC == hdr->magic) {
+        _shm_ring_close(hdr);
+    }
+
+done:
+    if (MAP_FAILED != hdr) {
+        munmap(hdr, sizeof(struct shm_ring_header));
+    }
+
+    if (-1 != fd) {
+        close(fd);
+    }
+}
+
+/**
+ * Unlink the ring's shared memory object, unless another producer has since taken over the name
+ */
+static
+void _shm_ring_unlink(struct shm_ring *ring)
+{
+    int fd = -1;
+    struct stat st;
+
+    if (0 > (fd = shm_open(ring->name, O_RDONLY, 0))) {
+        goto done;
+    }
+
+    if (0 == fstat(fd, &st) && st.st_dev == ring->dev && st.st_ino == ring->ino) {
+        shm_unlink(ring->name);
+    }
+
+done:
+    if (-1 != fd) {
+        close(fd);
+    }
+}
+
+aresult_t shm_ring_new(struct shm_ring **pring, const char *name, enum shm_ring_sample_type sample_type,
+        uint32_t sample_rate, size_t block_bytes, size_t nr_blocks)
+{
+    aresult_t ret = A_OK;
+
+    struct shm_ring *ring = NULL;
+    struct shm_ring_header *hdr = NULL;
+    size_t block_stride = 0;
+    struct stat st;
+    int fd = -1;
+
+    TSL_ASSERT_ARG(NULL != pring);
+    TSL_ASSERT_ARG(NULL != name);
+    TSL_ASSERT_ARG(0 != block_bytes && block_bytes <= UINT32_MAX / 2);
+    TSL_ASSERT_ARG(2 <= nr_blocks && nr_blocks <= UINT32_MAX && 0 == (nr_blocks & (nr_blocks - 1)));
+
+    *pring = NULL;
+
+    block_stride = (sizeof(struct shm_ring_block) + block_bytes + SYS_CACHE_LINE_LENGTH - 1) &
+        ~((size_t)SYS_CACHE_LINE_LENGTH - 1);
+
+    if (FAILED(ret = TZAALLOC(ring, SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = _shm_ring_name(ring->name, sizeof(ring->name), name))) {
+        goto done;
+    }
+
+    /* Take over the name from any earlier producer */
+    _shm_ring_close_stale(ring->name);
+    shm_unlink(ring->name);
+
+    if (0 > (fd = shm_open(ring->name, O_RDWR | O_CREAT | O_EXCL, 0644))) {
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (0 > fstat(fd, &st)) {
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    ring->created = true;
+    ring->dev = st.st_dev;
+    ring->ino = st.st_ino;
+    ring->map_bytes = sizeof(struct shm_ring_header) + nr_blocks * block_stride;
+
+    if (0 > ftruncate(fd, ring->map_bytes)) {
+        ret = A_E_NOMEM;
+        goto done;
+    }
+
+    if (MAP_FAILED == (hdr = mmap(NULL, ring->map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0))) {
+        ret = A_E_NOMEM;
+        goto done;
+    }
+
+    ring->hdr = hdr;
+
+    /* The object starts out zeroed, so every block is marked as not written yet */
+    hdr->version = SHM_RING_VERSION;
+    hdr->sample_type = sample_type;
+    hdr->sample_rate = sample_rate;
+    hdr->nr_blocks = nr_blocks;
+    hdr->block_bytes = block_bytes;
+    hdr->block_stride = block_stride;
+
+    /* Consumers only trust the header once the magic number is there */
+    atomic_thread_fence(memory_order_release);
+    hdr->magic = SHM_RING_MAGIC;
+
+    *pring = ring;
+
+done:
+    if (-1 != fd) {
+        close(fd);
+    }
+
+    if (FAILED(ret)) {
+        if (NULL != ring) {
+            shm_ring_delete(&ring);
+        }
+    }
+
+    return ret;
+}
+
+aresult_t shm_ring_write(struct shm_ring *ring, const void *samples, size_t nr_bytes)
+{
+    aresult_t ret = A_OK;
+
+    struct shm_ring_header *hdr = NULL;
+    struct shm_ring_block *blk = NULL;
+    uint64_t seq = 0;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != ring);
+    TSL_ASSERT_ARG_DEBUG(NULL != samples || 0 == nr_bytes);
+
+    hdr = ring->hdr;
+
+    TSL_ASSERT_ARG_DEBUG(nr_bytes <= hdr->block_bytes);
+
+    seq = ring->write_seq;
+    blk = _shm_ring_block(hdr, seq);
+
+    /* Mark the block as being written first, so a consumer still reading what was here knows */
+    atomic_store_explicit(&blk->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    memcpy(blk->data, samples, nr_bytes);
+    blk->nr_bytes = nr_bytes;
+
+    atomic_store_explicit(&blk->seq, seq + 1, memory_order_release);
+
+    ring->write_seq = seq + 1;
+    atomic_store_explicit(&hdr->write_seq, seq + 1, memory_order_release);
+
+    /* Only pay for the system call if someone is actually asleep */
+    atomic_fetch_add(&hdr->wake_seq, 1);
+    if (0 != atomic_load(&hdr->nr_parked)) {
+        _shm_ring_futex(&hdr->wake_seq, FUTEX_WAKE, INT_MAX, NULL);
+    }
+
+    return ret;
+}
+
+aresult_t shm_ring_delete(struct shm_ring **pring)
+{
+    aresult_t ret = A_OK;
+
+    struct shm_ring *ring = NULL;
+
+    TSL_ASSERT_PTR_BY_REF(pring);
+
+    ring = *pring;
+
+    if (NULL != ring->hdr) {
+        _shm_ring_close(ring->hdr);
+        munmap(ring->hdr, ring->map_bytes);
+        ring->hdr = NULL;
+    }
+
+    if (true == ring->created) {
+        _shm_ring_unlink(ring);
+    }
+
+    TFREE(ring);
+    *pring = NULL;
+
+    return ret;
+}
+
+aresult_t shm_ring_consumer_new(struct shm_ring_consumer **pcons, const char *name)
+{
+    aresult_t ret = A_OK;
+
+    struct shm_ring_consumer *cons = NULL;
+    struct shm_ring_header *hdr = NULL;
+    char path[NAME_MAX + 1];
+    struct stat st;
+    int fd = -1;
+
+    TSL_ASSERT_ARG(NULL != pcons);
+    TSL_ASSERT_ARG(NULL != name);
+
+    *pcons = NULL;
+
+    if (FAILED(ret = _shm_ring_name(path, sizeof(path), name))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TZAALLOC(cons, SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    /* Read-write, since parking on the ring means updating the header */
+    if (0 > (fd = shm_open(path, O_RDWR, 0))) {
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (0 > fstat(fd, &st) || (size_t)st.st_size < sizeof(struct shm_ring_header)) {
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (MAP_FAILED == (hdr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0))) {
+        ret = A_E_NOMEM;
+        goto done;
+    }
+
+    cons->hdr = hdr;
+    cons->map_bytes = st.st_size;
+
+    if (SHM_RING_MAGIC != hdr->magic || SHM_RING_VERSION != hdr->version) {
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+
+    if (0 == hdr->nr_blocks || 0 != (hdr->nr_blocks & (hdr->nr_blocks - 1)) ||
+            hdr->block_stride < sizeof(struct shm_ring_block) + hdr->block_bytes ||
+            cons->map_bytes < sizeof(struct shm_ring_header) + (size_t)hdr->nr_blocks * hdr->block_stride)
+    {
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    cons->next_seq = atomic_load_explicit(&hdr->write_seq, memory_order_acquire);
+
+    *pcons = cons;
+
+done:
+    if (-1 != fd) {
+        close(fd);
+    }
+
+    if (FAILED(ret)) {
+        if (NULL != cons) {
+            shm_ring_consumer_delete(&cons);
+        }
+    }
+
+    return ret;
+}
+
+aresult_t shm_ring_consumer_next(struct shm_ring_consumer *cons, const void **psamples, size_t *pnr_bytes,
+        uint64_t *pnr_dropped, uint64_t timeout_ns)
+{
+    aresult_t ret = A_OK;
+
+    struct shm_ring_header *hdr = NULL;
+    uint64_t next = 0;
+    bool waited = false;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != cons);
+    TSL_ASSERT_ARG_DEBUG(NULL == cons->cur);
+    TSL_ASSERT_ARG_DEBUG(NULL != psamples);
+    TSL_ASSERT_ARG_DEBUG(NULL != pnr_bytes);
+    TSL_ASSERT_ARG_DEBUG(NULL != pnr_dropped);
+
+    hdr = cons->hdr;
+    next = cons->next_seq;
+
+    *psamples = NULL;
+    *pnr_bytes = 0;
+    *pnr_dropped = 0;
+
+    for (;;) {
+        uint64_t head = atomic_load_explicit(&hdr->write_seq, memory_order_acquire);
+        const struct shm_ring_block *blk = NULL;
+
+        if (head == next) {
+            if (0 != (atomic_load(&hdr->flags) & SHM_RING_FLAG_CLOSED)) {
+                ret = A_E_DONE;
+                goto done;
+            }
+
+            if (0 == timeout_ns || true == waited) {
+                /* Timed out, or woken up for some other reason */
+                goto done;
+            }
+
+            struct timespec ts = { .tv_sec = timeout_ns / 1000000000ull, .tv_nsec = timeout_ns % 1000000000ull };
+            uint32_t seq = 0;
+
+            /* Announce we're about to sleep, then check once more before actually doing so */
+            atomic_fetch_add(&hdr->nr_parked, 1);
+            seq = atomic_load(&hdr->wake_seq);
+
+            if (next == atomic_load(&hdr->write_seq)) {
+                _shm_ring_futex(&hdr->wake_seq, FUTEX_WAIT, seq, &ts);
+            }
+
+            atomic_fetch_sub(&hdr->nr_parked, 1);
+            waited = true;
+            continue;
+        }
+
+        /* The oldest block is the one the producer writes over next, so it can't be read safely */
+        if (head - next >= hdr->nr_blocks) {
+            uint64_t skipped = head - hdr->nr_blocks + 1 - next;
+
+            next += skipped;
+            *pnr_dropped += skipped;
+            cons->nr_dropped += skipped;
+        }
+
+        blk = _shm_ring_block(hdr, next);
+
+        if (next + 1 != atomic_load_explicit(&blk->seq, memory_order_acquire)) {
+            /* The producer got here first, so catch up again */
+            continue;
+        }
+
+        cons->cur = blk;
+        *psamples = blk->data;
+        *pnr_bytes = BL_MIN2(blk->nr_bytes, hdr->block_bytes);
+        break;
+    }
+
+done:
+    cons->next_seq = next;
+    return ret;
+}
+
+aresult_t shm_ring_consumer_release(struct shm_ring_consumer *cons)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != cons);
+    TSL_ASSERT_ARG_DEBUG(NULL != cons->cur);
+
+    /* Make sure the samples were read before checking they weren't written over in the meantime */
+    atomic_thread_fence(memory_order_acquire);
+
+    if (cons->next_seq + 1 != atomic_load_explicit(&cons->cur->seq, memory_order_relaxed)) {
+        cons->nr_dropped++;
+        ret = A_E_BUSY;
+    }
+
+    cons->next_seq++;
+    cons->cur = NULL;
+
+    return ret;
+}
+
+enum shm_ring_sample_type shm_ring_consumer_sample_type(const struct shm_ring_consumer *cons)
+{
+    return cons->hdr->sample_type;
+}
+
+uint32_t shm_ring_consumer_sample_rate(const struct shm_ring_consumer *cons)
+{
+    return cons->hdr->sample_rate;
+}
+
+uint64_t shm_ring_consumer_nr_dropped(const struct shm_ring_consumer *cons)
+{
+    return cons->nr_dropped;
+}
+
+aresult_t shm_ring_consumer_delete(struct shm_ring_consumer **pcons)
+{
+    aresult_t ret = A_OK;
+
+    struct shm_ring_consumer *cons = NULL;
+
+    TSL_ASSERT_PTR_BY_REF(pcons);
+
+    cons = *pcons;
+
+    if (NULL != cons->hdr) {
+        munmap(cons->hdr, cons->map_bytes);
+        cons->hdr = NULL;
+    }
+
+    TFREE(cons);
+    *pcons = NULL;
+
+    return ret;
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <tsl/result.h>
+#include <tsl/cal.h>
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Magic number at the start of every shared memory ring, "SRNG"
+ */
+#define SHM_RING_MAGIC                  0x53524e47ul
+
+/**
+ * The version of the shared memory ring layout. Bumped whenever the layout changes.
+ */
+#define SHM_RING_VERSION                1
+
+/**
+ * Set in the ring's flags when the producer has gone away. Nothing more will be written.
+ */
+#define SHM_RING_FLAG_CLOSED            (1ul << 0)
+
+/**
+ * The kind of samples carried in a ring
+ */
+enum shm_ring_sample_type {
+    /**
+     * Real 16-bit PCM, one value per sample
+     */
+    SHM_RING_SAMPLE_REAL_INT_16 = 0,
+
+    /**
+     * Interleaved 16-bit I/Q, in Q.15
+     */
+    SHM_RING_SAMPLE_COMPLEX_INT_16 = 1,
+
+    /**
+     * Interleaved signed 8-bit I/Q
+     */
+    SHM_RING_SAMPLE_COMPLEX_INT_8 = 2,
+};
+
+/**
+ * The header at the start of a shared memory ring. This is shared between processes, so it
+ * only ever grows at the end, and the version is bumped when it changes.
+ */
+struct shm_ring_header {
+    /**
+     * SHM_RING_MAGIC
+     */
+    uint32_t magic;
+
+    /**
+     * SHM_RING_VERSION
+     */
+    uint32_t version;
+
+    /**
+     * The kind of samples in the ring, an `enum shm_ring_sample_type`
+     */
+    uint32_t sample_type;
+
+    /**
+     * The sample rate of the samples in the ring, in Hz
+     */
+    uint32_t sample_rate;
+
+    /**
+     * The number of blocks in the ring, always a power of 2
+     */
+    uint32_t nr_blocks;
+
+    /**
+     * The most bytes of samples a single block can hold
+     */
+    uint32_t block_bytes;
+
+    /**
+     * The distance between the start of two blocks, in bytes
+     */
+    uint32_t block_stride;
+
+    /**
+     * SHM_RING_FLAG_*
+     */
+    _Atomic uint32_t flags;
+
+    /**
+     * The sequence number of the next block to be written; every block before it has been
+     * written. Written only by the producer.
+     */
+    _Atomic uint64_t write_seq CAL_ALIGN(64);
+
+    /**
+     * Bumped on every write. This is the futex word parked consumers wait on.
+     */
+    _Atomic uint32_t wake_seq;
+
+    /**
+     * Number of consumers parked in the kernel waiting for a block
+     */
+    _Atomic uint32_t nr_parked CAL_ALIGN(64);
+} CAL_ALIGN(64);
+
+/**
+ * The header at the start of every block in a ring. The samples follow right after it.
+ */
+struct shm_ring_block {
+    /**
+     * One more than the sequence number of the block held here, or 0 while the producer is
+     * writing the block.
+     */
+    _Atomic uint64_t seq;
+
+    /**
+     * The number of bytes of samples in the block
+     */
+    uint32_t nr_bytes;
+
+    uint32_t reserved;
+
+    /**
+     * The samples
+     */
+    uint8_t data[] CAL_ALIGN(64);
+};
+
+struct shm_ring;
+struct shm_ring_consumer;
+
+/**
+ * Create a single-producer shared memory ring that other processes can read samples from in
+ * place. If a ring by this name already exists, it is marked closed and unlinked first, so any
+ * process still reading it finds out. The producer never waits for consumers: a consumer that
+ * falls a whole ring behind loses blocks, and finds out from the gap in sequence numbers.
+ *
+ * \param pring The new ring, returned by reference
+ * \param name The name of the ring, a POSIX shared memory object name. The leading '/' is
+ *             optional.
+ * \param sample_type The kind of samples written to the ring
+ * \param sample_rate The sample rate, in Hz
+ * \param block_bytes The most bytes a single `shm_ring_write` will write
+ * \param nr_blocks The number of blocks in the ring. Must be a power of 2, at least 2.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t shm_ring_new(struct shm_ring **pring, const char *name, enum shm_ring_sample_type sample_type,
+        uint32_t sample_rate, size_t block_bytes, size_t nr_blocks);
+
+/**
+ * Write a block of samples to the ring. Only one thread may write to a given ring. Only makes a
+ * system call if a consumer is parked waiting for a block.
+ *
+ * \param ring The ring
+ * \param samples The samples
+ * \param nr_bytes The size of the samples, in bytes. At most the block_bytes the ring was
+ *                 created with.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t shm_ring_write(struct shm_ring *ring, const void *samples, size_t nr_bytes);
+
+/**
+ * Mark the ring closed, unlink it and unmap it.
+ *
+ * \param pring The ring, passed by reference. Set to NULL on success.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t shm_ring_delete(struct shm_ring **pring);
+
+/**
+ * Attach to a ring created by another process. The consumer starts at the next block to be
+ * written.
+ *
+ * \param pcons The new consumer, returned by reference
+ * \param name The name of the ring, as given to `shm_ring_new`
+ *
+ * \return A_OK on success, an error code otherwise, including if there is no such ring
+ */
+aresult_t shm_ring_consumer_new(struct shm_ring_consumer **pcons, const char *name);
+
+/**
+ * Get the next block of samples, waiting for up to timeout_ns for one to be written. The
+ * samples are read in place in the ring, and stay valid until `shm_ring_consumer_release`. If
+ * the consumer fell behind, the blocks it missed are skipped.
+ *
+ * \param cons The consumer
+ * \param psamples The samples, returned by reference. Set to NULL if nothing was written in
+ *                 time.
+ * \param pnr_bytes The size of the samples, in bytes, returned by reference
+ * \param pnr_dropped The number of blocks skipped over to get to this one, returned by
+ *                    reference
+ * \param timeout_ns The maximum time to wait, in nanoseconds. If 0, returns right away without
+ *                   making a system call.
+ *
+ * \return A_OK on success, A_E_DONE if the producer closed the ring and every block has been
+ *         read, an error code otherwise.
+ */
+aresult_t shm_ring_consumer_next(struct shm_ring_consumer *cons, const void **psamples, size_t *pnr_bytes,
+        uint64_t *pnr_dropped, uint64_t timeout_ns);
+
+/**
+ * Finish with the block returned by `shm_ring_consumer_next`.
+ *
+ * \param cons The consumer
+ *
+ * \return A_OK if the block was intact the whole time, A_E_BUSY if the producer lapped the
+ *         consumer and wrote over it while it was being read. The block is counted as dropped
+ *         in that case.
+ */
+aresult_t shm_ring_consumer_release(struct shm_ring_consumer *cons);
+
+/**
+ * The kind of samples in the ring
+ */
+enum shm_ring_sample_type shm_ring_consumer_sample_type(const struct shm_ring_consumer *cons);
+
+/**
+ * The sample rate of the samples in the ring, in Hz
+ */
+uint32_t shm_ring_consumer_sample_rate(const struct shm_ring_consumer *cons);
+
+/**
+ * The total number of blocks the consumer has lost, to being lapped by the producer
+ */
+uint64_t shm_ring_consumer_nr_dropped(const struct shm_ring_consumer *cons);
+
+/**
+ * Detach from a ring.
+ *
+ * \param pcons The consumer, passed by reference. Set to NULL on success.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t shm_ring_consumer_delete(struct shm_ring_consumer **pcons);
@@ -0,0 +1,193 @@
+#include <filter/filter.h>
+#include <filter/convert.h>
+#include <filter/kernels.h>
+#include <filter/sample_buf.h>
+
+#include <test/assert.h>
+#include <test/framework.h>
+
+#include <math.h>
+#include <string.h>
+
+#define TEST_CONVERT_NR_SAMPLES     1001
+
+static
+aresult_t test_convert_setup(void)
+{
+    return filter_kernels_init();
+}
+
+static
+aresult_t test_convert_cleanup(void)
+{
+    return A_OK;
+}
+
+/**
+ * Fill a buffer with raw samples in the given format. Every few samples is pinned to full
+ * scale, so there is something to count as clipped.
+ */
+static
+void _test_convert_fill(enum convert_format format, void *buf, size_t nr_samples, uint32_t *plcg)
+{
+    uint32_t lcg = *plcg;
+    size_t nr_bytes = nr_samples * convert_format_bytes(format);
+
+    if (CONVERT_FORMAT_CF32 == format) {
+        float *f = buf;
+
+        for (size_t i = 0; i < 2 * nr_samples; i++) {
+            lcg = lcg * 1103515245 + 12345;
+            /* Up to 1.25 times full scale, to exercise the saturation */
+            f[i] = (float)((int16_t)(lcg >> 16)) / 26214.0f;
+        }
+    } else {
+        uint8_t *b = buf;
+
+        for (size_t i = 0; i < nr_bytes; i++) {
+            lcg = lcg * 1103515245 + 12345;
+            b[i] = lcg >> 24;
+        }
+
+        for (size_t i = 0; i < nr_bytes; i += 37) {
+            b[i] = 0 == i % 2 ? 0xff : 0x00;
+        }
+    }
+
+    *plcg = lcg;
+}
+
+TEST_DECLARE_UNIT(test_known_values, convert)
+{
+    static const uint8_t cu8[] = { 127, 255, 0, 128 };
+    static const int8_t cs8[] = { -128, 127, 0, -1 };
+    /* I = 0x801 (-2047), Q = 0x7ff (2047); then I = 0xfff (-1), Q = 0x000 */
+    static const uint8_t cs12[] = { 0x01, 0xf8, 0x7f, 0xff, 0x0f, 0x00 };
+    static const float cf32[] = { 0.5f, -1.0f, 2.0f, -0.25f };
+    int16_t out[4];
+    struct convert_stats stats;
+
+    memset(&stats, 0, sizeof(stats));
+    TEST_ASSERT_OK(convert_to_q15(CONVERT_FORMAT_CU8, cu8, 2, out, &stats));
+    TEST_ASSERT_EQUALS(out[0], 0);
+    TEST_ASSERT_EQUALS(out[1], 128 << 7);
+    TEST_ASSERT_EQUALS(out[2], -127 * (1 << 7));
+    TEST_ASSERT_EQUALS(out[3], 1 << 7);
+    TEST_ASSERT_EQUALS(stats.nr_samples, 2);
+    TEST_ASSERT_EQUALS(stats.nr_clipped, 2);
+    TEST_ASSERT_EQUALS(stats.sum_i, -127 * (1 << 7));
+    TEST_ASSERT_EQUALS(stats.sum_q, 129 << 7);
+
+    /* 8-bit samples have to come out the same as the filters see them */
+    for (size_t i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUALS(out[i], sample_get_q15(cu8, COMPLEX_UINT_8, i));
+    }
+
+    TEST_ASSERT_OK(convert_to_q15(CONVERT_FORMAT_CS8, cs8, 2, out, NULL));
+    for (size_t i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUALS(out[i], sample_get_q15(cs8, COMPLEX_INT_8, i));
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    TEST_ASSERT_OK(convert_to_q15(CONVERT_FORMAT_CS12, cs12, 2, out, &stats));
+    TEST_ASSERT_EQUALS(out[0], -2047 * (1 << 3));
+    TEST_ASSERT_EQUALS(out[1], 2047 << 3);
+    TEST_ASSERT_EQUALS(out[2], -(1 << 3));
+    TEST_ASSERT_EQUALS(out[3], 0);
+    TEST_ASSERT_EQUALS(stats.nr_clipped, 1);
+
+    memset(&stats, 0, sizeof(stats));
+    TEST_ASSERT_OK(convert_to_q15(CONVERT_FORMAT_CF32, cf32, 2, out, &stats));
+    TEST_ASSERT_EQUALS(out[0], 1 << (Q_15_SHIFT - 1));
+    TEST_ASSERT_EQUALS(out[1], -(1 << Q_15_SHIFT));
+    TEST_ASSERT_EQUALS(out[2], INT16_MAX);
+    TEST_ASSERT_EQUALS(out[3], -(1 << (Q_15_SHIFT - 2)));
+    TEST_ASSERT_EQUALS(stats.nr_clipped, 2);
+
+    return A_OK;
+}
+
+/**
+ * Every variant has to agree with the scalar kernels, on the samples and the statistics, and
+ * gathering statistics alone has to give the same statistics as converting.
+ */
+TEST_DECLARE_UNIT(test_kernels_match_scalar, convert)
+{
+    static float in[2 * TEST_CONVERT_NR_SAMPLES];
+    static int16_t ref[2 * TEST_CONVERT_NR_SAMPLES],
+                   out[2 * TEST_CONVERT_NR_SAMPLES];
+    static const size_t lengths[] = { 0, 1, 15, 64, 333, TEST_CONVERT_NR_SAMPLES };
+    uint32_t lcg = 31;
+
+    for (int format = 0; format < CONVERT_FORMAT_MAX; format++) {
+        for (size_t l = 0; l < sizeof(lengths)/sizeof(lengths[0]); l++) {
+            size_t nr_samples = lengths[l];
+            struct convert_stats ref_stats;
+
+            _test_convert_fill(format, in, nr_samples, &lcg);
+
+            memset(&ref_stats, 0, sizeof(ref_stats));
+            convert_kernel(filter_kernels_for_isa(FILTER_ISA_SCALAR), format)(in, nr_samples, ref, &ref_stats);
+            TEST_ASSERT_EQUALS(ref_stats.nr_samples, nr_samples);
+
+            for (int isa = 0; isa < FILTER_ISA_MAX; isa++) {
+                const struct filter_kernels *kernels = filter_kernels_for_isa(isa);
+                struct convert_stats stats,
+                                     stats_only;
+                convert_fn fn = NULL;
+
+                if (NULL == kernels || !filter_isa_supported(isa)) {
+                    continue;
+                }
+
+                fn = convert_kernel(kernels, format);
+                TEST_ASSERT_NOT_NULL(fn);
+
+                memset(out, 0, sizeof(out));
+                memset(&stats, 0, sizeof(stats));
+                memset(&stats_only, 0, sizeof(stats_only));
+
+                fn(in, nr_samples, out, &stats);
+                fn(in, nr_samples, NULL, &stats_only);
+
+                TEST_ASSERT_EQUALS(memcmp(out, ref, 2 * nr_samples * sizeof(int16_t)), 0);
+                TEST_ASSERT_EQUALS(memcmp(&stats, &ref_stats, sizeof(stats)), 0);
+                TEST_ASSERT_EQUALS(memcmp(&stats_only, &ref_stats, sizeof(stats)), 0);
+
+                memset(out, 0, sizeof(out));
+                fn(in, nr_samples, out, NULL);
+                TEST_ASSERT_EQUALS(memcmp(out, ref, 2 * nr_samples * sizeof(int16_t)), 0);
+            }
+        }
+    }
+
+    return A_OK;
+}
+
+TEST_DECLARE_UNIT(test_stats_summary, convert)
+{
+    static int16_t in[2 * TEST_CONVERT_NR_SAMPLES];
+    struct convert_stats stats;
+    double dc_i = 0.0,
+           dc_q = 0.0,
+           power_dbfs = 0.0;
+
+    /* A tone at half of full scale, with a DC offset on I */
+    for (size_t i = 0; i < TEST_CONVERT_NR_SAMPLES; i++) {
+        in[2 * i    ] = (int16_t)(8192.0 * cos(0.1 * i)) + 1638;
+        in[2 * i + 1] = (int16_t)(8192.0 * sin(0.1 * i));
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    TEST_ASSERT_OK(convert_stats_update(CONVERT_FORMAT_CS16, in, TEST_CONVERT_NR_SAMPLES, &stats));
+    convert_stats_summary(&stats, &dc_i, &dc_q, &power_dbfs);
+
+    TEST_ASSERT(fabs(dc_i - 0.1) < 0.01);
+    TEST_ASSERT(fabs(dc_q) < 0.01);
+    TEST_ASSERT(fabs(power_dbfs - 10.0 * log10(0.25 + 0.01)) < 0.1);
+    TEST_ASSERT_EQUALS(stats.nr_clipped, 0);
+
+    return A_OK;
+}
+
+TEST_DECLARE_SUITE(convert, test_convert_cleanup, test_convert_setup, NULL, NULL);
@@ -0,0 +1,153 @@
+#include <filter/filter.h>
+#include <filter/decimation_chain.h>
+
+#include <test/assert.h>
+#include <test/framework.h>
+
+#include <tsl/safe_alloc.h>
+#include <tsl/basic.h>
+
+#include <math.h>
+#include <string.h>
+
+#define TEST_DEC_NR_SAMPLES         4096
+#define TEST_DEC_BLOCK              500
+
+static
+int16_t *test_dec_in = NULL;
+
+static
+int16_t *test_dec_out = NULL;
+
+static
+aresult_t test_decimation_chain_setup(void)
+{
+    aresult_t ret = A_OK;
+
+    if (FAILED(ret = TCALLOC((void **)&test_dec_in, TEST_DEC_NR_SAMPLES, 2 * sizeof(int16_t)))) {
+        goto done;
+    }
+
+    ret = TCALLOC((void **)&test_dec_out, TEST_DEC_NR_SAMPLES, 2 * sizeof(int16_t));
+
+done:
+    return ret;
+}
+
+static
+aresult_t test_decimation_chain_cleanup(void)
+{
+    if (NULL != test_dec_in) {
+        TFREE(test_dec_in);
+    }
+
+    if (NULL != test_dec_out) {
+        TFREE(test_dec_out);
+    }
+
+    return A_OK;
+}
+
+/**
+ * Fill the input with a complex tone at the given normalized frequency (cycles per sample)
+ */
+static
+void _test_dec_tone(double freq, double amplitude)
+{
+    for (size_t i = 0; i < TEST_DEC_NR_SAMPLES; i++) {
+        double phase = 2.0 * M_PI * freq * (double)i;
+        test_dec_in[2 * i    ] = (int16_t)lrint(amplitude * cos(phase));
+        test_dec_in[2 * i + 1] = (int16_t)lrint(amplitude * sin(phase));
+    }
+}
+
+/**
+ * Run the whole input through the chain in odd-sized blocks, in place, returning the RMS
+ * magnitude of the output once the filters have settled.
+ */
+static
+aresult_t _test_dec_run(struct decimation_chain *chain, size_t *pnr_out, double *prms)
+{
+    size_t nr_out = 0,
+           nr_settle = 0;
+    double power = 0.0;
+
+    for (size_t i = 0; i < TEST_DEC_NR_SAMPLES; i += TEST_DEC_BLOCK) {
+        size_t nr_in = BL_MIN2(TEST_DEC_BLOCK, TEST_DEC_NR_SAMPLES - i),
+               nr_block_out = 0;
+        int16_t *block = &test_dec_out[2 * nr_out];
+
+        /* Copy the input block to where its output goes, to exercise in-place decimation */
+        memmove(block, &test_dec_in[2 * i], nr_in * 2 * sizeof(int16_t));
+
+        TEST_ASSERT_OK(decimation_chain_process(chain, block, nr_in, block, &nr_block_out));
+        TEST_ASSERT_EQUALS(nr_block_out <= nr_in/decimation_chain_factor(chain) + 1, true);
+        nr_out += nr_block_out;
+    }
+
+    nr_settle = nr_out/4;
+    for (size_t i = nr_settle; i < nr_out; i++) {
+        double re = test_dec_out[2 * i],
+               im = test_dec_out[2 * i + 1];
+        power += re * re + im * im;
+    }
+
+    *pnr_out = nr_out;
+    *prms = sqrt(power/(double)(nr_out - nr_settle));
+
+    return A_OK;
+}
+
+TEST_DECLARE_UNIT(test_halfband, decimation)
+{
+    static const unsigned factors[] = { 2, 2, 2 };
+    struct decimation_chain *chain = NULL;
+    size_t nr_out = 0;
+    double rms = 0.0;
+
+    /* Something at DC must pass through with (nearly) unity gain, less the filters' start-up */
+    _test_dec_tone(0.0, 8000.0);
+    TEST_ASSERT_OK(decimation_chain_new(&chain, DECIMATION_CHAIN_HALFBAND, factors, 3));
+    TEST_ASSERT_EQUALS(decimation_chain_factor(chain), 8);
+    TEST_ASSERT_OK(_test_dec_run(chain, &nr_out, &rms));
+    TEST_INF("Halfband: %zu samples out, DC RMS %f", nr_out, rms);
+    TEST_ASSERT_EQUALS(nr_out >= TEST_DEC_NR_SAMPLES/8 - 24 && nr_out <= TEST_DEC_NR_SAMPLES/8, true);
+    TEST_ASSERT_EQUALS(fabs(rms - 8000.0) < 0.01 * 8000.0, true);
+    TEST_ASSERT_OK(decimation_chain_delete(&chain));
+    TEST_ASSERT_EQUALS(chain, NULL);
+
+    /* A tone that would alias into the band must be knocked down by at least 40 dB */
+    _test_dec_tone(0.45, 8000.0);
+    TEST_ASSERT_OK(decimation_chain_new(&chain, DECIMATION_CHAIN_HALFBAND, factors, 3));
+    TEST_ASSERT_OK(_test_dec_run(chain, &nr_out, &rms));
+    TEST_INF("Halfband: stopband RMS %f", rms);
+    TEST_ASSERT_EQUALS(rms < 0.01 * 8000.0, true);
+    TEST_ASSERT_OK(decimation_chain_delete(&chain));
+
+    return A_OK;
+}
+
+TEST_DECLARE_UNIT(test_cic, decimation)
+{
+    static const unsigned factors[] = { 4, 5 };
+    struct decimation_chain *chain = NULL;
+    size_t nr_out = 0;
+    double rms = 0.0;
+
+    /* Non-halfband factors are rejected for a halfband chain */
+    TEST_ASSERT_EQUALS(decimation_chain_new(&chain, DECIMATION_CHAIN_HALFBAND, factors, 2), A_E_INVAL);
+
+    _test_dec_tone(0.0, -8000.0);
+    TEST_ASSERT_OK(decimation_chain_new(&chain, DECIMATION_CHAIN_CIC, factors, 2));
+    TEST_ASSERT_EQUALS(decimation_chain_factor(chain), 20);
+    TEST_ASSERT_OK(_test_dec_run(chain, &nr_out, &rms));
+    TEST_INF("CIC: %zu samples out, DC RMS %f", nr_out, rms);
+    TEST_ASSERT_EQUALS(nr_out, TEST_DEC_NR_SAMPLES/20);
+    TEST_ASSERT_EQUALS(fabs(rms - 8000.0) < 0.01 * 8000.0, true);
+    TEST_ASSERT_OK(decimation_chain_delete(&chain));
+
+    return A_OK;
+}
+
+TEST_DECLARE_SUITE(decimation, test_decimation_chain_cleanup, test_decimation_chain_setup, NULL, NULL);
+
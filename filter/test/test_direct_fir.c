@@ -1,11 +1,55 @@
 #include <filter/filter.h>
+#include <filter/direct_fir_batch.h>
+#include <filter/direct_fir_f32.h>
+#include <filter/fir_fold.h>
+#include <filter/kernels.h>
+#include <filter/kernels_priv.h>
+#include <filter/kernels_fixed.h>
+#include <filter/sample_buf.h>
 
 #include <test/assert.h>
 #include <test/framework.h>
 
+#include <tsl/safe_alloc.h>
+
+#include <complex.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_FIR_NR_CHANNELS        5
+#define TEST_FIR_NR_COEFFS          64
+#define TEST_FIR_DECIMATION         5
+#define TEST_FIR_BUF_SAMPLES        500
+#define TEST_FIR_NR_BUFS            6
+#define TEST_FIR_OUT_SAMPLES        (TEST_FIR_NR_BUFS * TEST_FIR_BUF_SAMPLES / TEST_FIR_DECIMATION)
+
+static
+int16_t test_fir_coeffs[TEST_FIR_NR_CHANNELS][2][TEST_FIR_NR_COEFFS];
+
+static
+int32_t test_fir_offsets[TEST_FIR_NR_CHANNELS] = { -300000, -12500, 0, 25000, 412000 };
+
 static
 aresult_t test_direct_fir_setup(void)
 {
+    /* Shift a windowed-sinc low pass up to each channel, the same way multifm does */
+    for (size_t k = 0; k < TEST_FIR_NR_CHANNELS; k++) {
+        double f_offs = -2.0 * M_PI * (double)test_fir_offsets[k] / 1000000.0;
+
+        for (size_t i = 0; i < TEST_FIR_NR_COEFFS; i++) {
+            double t = (double)i - (double)(TEST_FIR_NR_COEFFS - 1)/2.0,
+                   fc = 0.05,
+                   sinc = (0.0 == t) ? 2.0 * fc : sin(2.0 * M_PI * fc * t)/(M_PI * t),
+                   win = 0.54 - 0.46 * cos(2.0 * M_PI * i/(TEST_FIR_NR_COEFFS - 1));
+            double complex tap = cexp(CMPLX(0, f_offs * (double)i)) * sinc * win;
+
+            test_fir_coeffs[k][0][i] = (int16_t)(creal(tap) * (double)(1 << Q_15_SHIFT));
+            test_fir_coeffs[k][1][i] = (int16_t)(cimag(tap) * (double)(1 << Q_15_SHIFT));
+        }
+    }
+
     return A_OK;
 }
 
@@ -15,11 +59,1071 @@ aresult_t test_direct_fir_cleanup(void)
     return A_OK;
 }
 
+static
+aresult_t _test_direct_fir_buf_release(struct sample_buf *buf)
+{
+    TFREE(buf);
+    return A_OK;
+}
+
+/**
+ * Make a buffer of random Q.15 samples
+ */
+static
+aresult_t _test_direct_fir_make_buf(size_t nr_samples, uint32_t *plcg, unsigned nr_refs, struct sample_buf **pbuf)
+{
+    struct sample_buf *buf = NULL;
+    int16_t *samples = NULL;
+
+    TEST_ASSERT_OK(TCALLOC((void **)&buf, 1, sizeof(struct sample_buf) + nr_samples * 2 * sizeof(int16_t)));
+
+    buf->nr_samples = nr_samples;
+    buf->sample_type = COMPLEX_INT_16;
+    buf->release = _test_direct_fir_buf_release;
+    atomic_store(&buf->refcount, nr_refs);
+
+    samples = (int16_t *)buf->data_buf;
+    for (size_t i = 0; i < 2 * nr_samples; i++) {
+        *plcg = *plcg * 1103515245 + 12345;
+        samples[i] = (int16_t)(*plcg >> 16) >> 2;
+    }
+
+    *pbuf = buf;
+
+    return A_OK;
+}
+
+/**
+ * Make a buffer of random 8-bit samples, and a buffer of the same samples widened to Q.15
+ */
+static
+aresult_t _test_direct_fir_make_8bit(enum sample_type type, uint32_t *plcg, unsigned nr_refs,
+        struct sample_buf **pbuf8, struct sample_buf **pbuf16)
+{
+    struct sample_buf *buf8 = NULL,
+                      *buf16 = NULL;
+
+    TEST_ASSERT_OK(TCALLOC((void **)&buf8, 1, sizeof(struct sample_buf) + TEST_FIR_BUF_SAMPLES * 2 * sizeof(uint8_t)));
+    TEST_ASSERT_OK(TCALLOC((void **)&buf16, 1, sizeof(struct sample_buf) + TEST_FIR_BUF_SAMPLES * 2 * sizeof(int16_t)));
+
+    buf8->nr_samples = TEST_FIR_BUF_SAMPLES;
+    buf8->sample_type = type;
+    buf8->release = _test_direct_fir_buf_release;
+    atomic_store(&buf8->refcount, nr_refs);
+
+    for (size_t i = 0; i < 2 * TEST_FIR_BUF_SAMPLES; i++) {
+        *plcg = *plcg * 1103515245 + 12345;
+        buf8->data_buf[i] = (uint8_t)(*plcg >> 16);
+    }
+
+    buf16->nr_samples = TEST_FIR_BUF_SAMPLES;
+    buf16->sample_type = COMPLEX_INT_16;
+    buf16->release = _test_direct_fir_buf_release;
+    atomic_store(&buf16->refcount, nr_refs);
+
+    TEST_ASSERT_OK(sample_buf_copy_q15(buf8, (int16_t *)buf16->data_buf));
+
+    *pbuf8 = buf8;
+    *pbuf16 = buf16;
+
+    return A_OK;
+}
 
 TEST_DECLARE_UNIT(test_smoke, flex)
 {
     return A_OK;
 }
 
+/**
+ * The batched FIR must produce exactly what a set of single-channel FIRs would.
+ */
+TEST_DECLARE_UNIT(test_batch_matches_single, flex)
+{
+    struct direct_fir single[TEST_FIR_NR_CHANNELS];
+    struct direct_fir_batch batch;
+    const int16_t *re_coeffs[TEST_FIR_NR_CHANNELS],
+                  *im_coeffs[TEST_FIR_NR_CHANNELS];
+    int16_t *single_out[TEST_FIR_NR_CHANNELS],
+            *batch_out[TEST_FIR_NR_CHANNELS];
+    size_t nr_single_out[TEST_FIR_NR_CHANNELS],
+           nr_batch_out = 0;
+    uint32_t lcg = 1;
+
+    for (size_t k = 0; k < TEST_FIR_NR_CHANNELS; k++) {
+        re_coeffs[k] = test_fir_coeffs[k][0];
+        im_coeffs[k] = test_fir_coeffs[k][1];
+        nr_single_out[k] = 0;
+        TEST_ASSERT_OK(direct_fir_init(&single[k], TEST_FIR_NR_COEFFS, re_coeffs[k], im_coeffs[k],
+                    TEST_FIR_DECIMATION, true, 1000000, test_fir_offsets[k]));
+        TEST_ASSERT_OK(TCALLOC((void **)&single_out[k], TEST_FIR_OUT_SAMPLES, 2 * sizeof(int16_t)));
+        TEST_ASSERT_OK(TCALLOC((void **)&batch_out[k], TEST_FIR_OUT_SAMPLES, 2 * sizeof(int16_t)));
+    }
+
+    TEST_ASSERT_OK(direct_fir_batch_init(&batch, TEST_FIR_NR_CHANNELS, TEST_FIR_NR_COEFFS, re_coeffs, im_coeffs,
+                TEST_FIR_DECIMATION, true, 1000000, test_fir_offsets));
+
+    for (size_t b = 0; b < TEST_FIR_NR_BUFS; b++) {
+        struct sample_buf *buf = NULL;
+        int16_t *batch_pos[TEST_FIR_NR_CHANNELS];
+        size_t nr_out = 0;
+
+        TEST_ASSERT_OK(_test_direct_fir_make_buf(TEST_FIR_BUF_SAMPLES, &lcg, TEST_FIR_NR_CHANNELS + 1, &buf));
+
+        for (size_t k = 0; k < TEST_FIR_NR_CHANNELS; k++) {
+            TEST_ASSERT_OK(direct_fir_push_sample_buf(&single[k], buf));
+            TEST_ASSERT_OK(direct_fir_process(&single[k], &single_out[k][2 * nr_single_out[k]],
+                        TEST_FIR_OUT_SAMPLES - nr_single_out[k], &nr_out));
+            nr_single_out[k] += nr_out;
+            batch_pos[k] = &batch_out[k][2 * nr_batch_out];
+        }
+
+        TEST_ASSERT_OK(direct_fir_batch_push_sample_buf(&batch, buf));
+        TEST_ASSERT_OK(direct_fir_batch_process(&batch, batch_pos, TEST_FIR_OUT_SAMPLES - nr_batch_out, &nr_out));
+        nr_batch_out += nr_out;
+    }
+
+    for (size_t k = 0; k < TEST_FIR_NR_CHANNELS; k++) {
+        TEST_ASSERT_EQUALS(nr_single_out[k], nr_batch_out);
+        TEST_ASSERT_EQUALS(memcmp(single_out[k], batch_out[k], nr_batch_out * 2 * sizeof(int16_t)), 0);
+    }
+
+    TEST_INF("Compared %zu output samples for %d channels", nr_batch_out, TEST_FIR_NR_CHANNELS);
+
+    for (size_t k = 0; k < TEST_FIR_NR_CHANNELS; k++) {
+        TEST_ASSERT_OK(direct_fir_cleanup(&single[k]));
+        TFREE(single_out[k]);
+        TFREE(batch_out[k]);
+    }
+
+    TEST_ASSERT_OK(direct_fir_batch_cleanup(&batch));
+
+    return A_OK;
+}
+
+/**
+ * Mixing to baseband then filtering must give (to within quantization error) the same result as
+ * filtering with complex coefficients and derotating.
+ */
+TEST_DECLARE_UNIT(test_mix_matches_complex, flex)
+{
+    struct direct_fir cplx,
+                      mix;
+    int16_t *cplx_out = NULL,
+            *mix_out = NULL,
+            *lpf = NULL;
+    size_t nr_cplx_out = 0,
+           nr_mix_out = 0;
+    double err_power = 0.0,
+           sig_power = 0.0;
+    uint32_t lcg = 7;
+
+    /* A plain low pass, for the mixer strategy */
+    TEST_ASSERT_OK(TCALLOC((void **)&lpf, TEST_FIR_NR_COEFFS, sizeof(int16_t)));
+    for (size_t i = 0; i < TEST_FIR_NR_COEFFS; i++) {
+        double t = (double)i - (double)(TEST_FIR_NR_COEFFS - 1)/2.0,
+               sinc = (0.0 == t) ? 0.1 : sin(2.0 * M_PI * 0.05 * t)/(M_PI * t),
+               win = 0.54 - 0.46 * cos(2.0 * M_PI * i/(TEST_FIR_NR_COEFFS - 1));
+        lpf[i] = (int16_t)(sinc * win * (double)(1 << Q_15_SHIFT));
+    }
+
+    TEST_ASSERT_OK(direct_fir_init(&cplx, TEST_FIR_NR_COEFFS, test_fir_coeffs[3][0], test_fir_coeffs[3][1],
+                TEST_FIR_DECIMATION, true, 1000000, test_fir_offsets[3]));
+    TEST_ASSERT_OK(direct_fir_init_mix(&mix, TEST_FIR_NR_COEFFS, lpf, TEST_FIR_DECIMATION, 1000000, test_fir_offsets[3]));
+
+    TEST_ASSERT_OK(TCALLOC((void **)&cplx_out, TEST_FIR_OUT_SAMPLES, 2 * sizeof(int16_t)));
+    TEST_ASSERT_OK(TCALLOC((void **)&mix_out, TEST_FIR_OUT_SAMPLES, 2 * sizeof(int16_t)));
+
+    for (size_t b = 0; b < TEST_FIR_NR_BUFS; b++) {
+        struct sample_buf *buf = NULL;
+        int16_t *samples = NULL;
+        size_t nr_out = 0;
+
+        TEST_ASSERT_OK(_test_direct_fir_make_buf(TEST_FIR_BUF_SAMPLES, &lcg, 2, &buf));
+
+        /* A tone in the channel, plus some of the noise */
+        samples = (int16_t *)buf->data_buf;
+        for (size_t i = 0; i < TEST_FIR_BUF_SAMPLES; i++) {
+            double phase = 2.0 * M_PI * (double)(test_fir_offsets[3] + 3000) *
+                (double)(b * TEST_FIR_BUF_SAMPLES + i) / 1000000.0;
+            samples[2 * i    ] = (int16_t)(8000.0 * cos(phase)) + (samples[2 * i    ] >> 4);
+            samples[2 * i + 1] = (int16_t)(8000.0 * sin(phase)) + (samples[2 * i + 1] >> 4);
+        }
+
+        TEST_ASSERT_OK(direct_fir_push_sample_buf(&cplx, buf));
+        TEST_ASSERT_OK(direct_fir_process(&cplx, &cplx_out[2 * nr_cplx_out], TEST_FIR_OUT_SAMPLES - nr_cplx_out, &nr_out));
+        nr_cplx_out += nr_out;
+
+        TEST_ASSERT_OK(direct_fir_push_sample_buf(&mix, buf));
+        TEST_ASSERT_OK(direct_fir_process(&mix, &mix_out[2 * nr_mix_out], TEST_FIR_OUT_SAMPLES - nr_mix_out, &nr_out));
+        nr_mix_out += nr_out;
+    }
+
+    TEST_ASSERT_EQUALS(nr_cplx_out, nr_mix_out);
+
+    for (size_t i = 0; i < 2 * nr_mix_out; i++) {
+        double diff = (double)cplx_out[i] - (double)mix_out[i];
+        err_power += diff * diff;
+        sig_power += (double)cplx_out[i] * (double)cplx_out[i];
+    }
+
+    TEST_INF("Mix vs. complex: %zu samples, SNR %f dB", nr_mix_out, 10.0 * log10(sig_power/err_power));
+
+    /* Both strategies carry their own quantization error; they should agree to well within 30 dB */
+    TEST_ASSERT_EQUALS(err_power * 1000.0 < sig_power, true);
+
+    TEST_ASSERT_EQUALS(direct_fir_choose_strategy(128, 40), DIRECT_FIR_STRATEGY_MIX);
+    TEST_ASSERT_EQUALS(direct_fir_choose_strategy(32, 40), DIRECT_FIR_STRATEGY_COMPLEX);
+
+    TEST_ASSERT_OK(direct_fir_cleanup(&cplx));
+    TEST_ASSERT_OK(direct_fir_cleanup(&mix));
+    TFREE(cplx_out);
+    TFREE(mix_out);
+    TFREE(lpf);
+
+    return A_OK;
+}
+
+/**
+ * Any number of sample buffers can be queued before filtering, and the result must be the same
+ * as filtering each buffer as it arrives.
+ */
+TEST_DECLARE_UNIT(test_queued_matches_streamed, flex)
+{
+    struct direct_fir streamed,
+                      queued;
+    int16_t *streamed_out = NULL,
+            *queued_out = NULL;
+    size_t nr_streamed_out = 0,
+           nr_queued_out = 0;
+    uint32_t lcg = 11;
+
+    TEST_ASSERT_OK(direct_fir_init(&streamed, TEST_FIR_NR_COEFFS, test_fir_coeffs[1][0], test_fir_coeffs[1][1],
+                TEST_FIR_DECIMATION, true, 1000000, test_fir_offsets[1]));
+    TEST_ASSERT_OK(direct_fir_init(&queued, TEST_FIR_NR_COEFFS, test_fir_coeffs[1][0], test_fir_coeffs[1][1],
+                TEST_FIR_DECIMATION, true, 1000000, test_fir_offsets[1]));
+
+    TEST_ASSERT_OK(TCALLOC((void **)&streamed_out, TEST_FIR_OUT_SAMPLES, 2 * sizeof(int16_t)));
+    TEST_ASSERT_OK(TCALLOC((void **)&queued_out, TEST_FIR_OUT_SAMPLES, 2 * sizeof(int16_t)));
+
+    for (size_t b = 0; b < TEST_FIR_NR_BUFS; b++) {
+        struct sample_buf *buf = NULL;
+        size_t nr_out = 0,
+               nr_samples = TEST_FIR_BUF_SAMPLES - 37 * b;
+
+        /* Vary the buffer sizes, so the decimation phase lands in different places */
+        TEST_ASSERT_OK(_test_direct_fir_make_buf(nr_samples, &lcg, 2, &buf));
+
+        TEST_ASSERT_OK(direct_fir_push_sample_buf(&streamed, buf));
+        TEST_ASSERT_OK(direct_fir_process(&streamed, &streamed_out[2 * nr_streamed_out],
+                    TEST_FIR_OUT_SAMPLES - nr_streamed_out, &nr_out));
+        nr_streamed_out += nr_out;
+
+        TEST_ASSERT_OK(direct_fir_push_sample_buf(&queued, buf));
+    }
+
+    TEST_ASSERT_OK(direct_fir_process(&queued, queued_out, TEST_FIR_OUT_SAMPLES, &nr_queued_out));
+
+    TEST_ASSERT_EQUALS(nr_streamed_out, nr_queued_out);
+    TEST_ASSERT_EQUALS(memcmp(streamed_out, queued_out, nr_queued_out * 2 * sizeof(int16_t)), 0);
+
+    TEST_ASSERT_OK(direct_fir_cleanup(&streamed));
+    TEST_ASSERT_OK(direct_fir_cleanup(&queued));
+    TFREE(streamed_out);
+    TFREE(queued_out);
+
+    return A_OK;
+}
+
+/**
+ * Every SIMD kernel must give exactly the same result as the scalar Q.15 reference, for any
+ * filter length, including ones that leave a tail after the last full vector.
+ */
+TEST_DECLARE_UNIT(test_kernels_match_scalar, flex)
+{
+    static const size_t nr_coeffs_cases[] = { 1, 3, 4, 7, 8, 9, 15, 16, 17, 31, 33, 61 };
+    int16_t c_re[61],
+            c_im[61],
+            samples[2 * 61];
+    uint32_t lcg = 23;
+
+    for (size_t n = 0; n < sizeof(nr_coeffs_cases)/sizeof(nr_coeffs_cases[0]); n++) {
+        size_t nr_coeffs = nr_coeffs_cases[n];
+
+        for (size_t trial = 0; trial < 64; trial++) {
+            struct direct_fir fir;
+            int32_t ref_re = 0,
+                    ref_im = 0,
+                    ref_real_re = 0,
+                    ref_real_im = 0,
+                    ref_real = 0;
+
+            /* Bounded so the scalar int32 accumulators can't overflow */
+            for (size_t i = 0; i < nr_coeffs; i++) {
+                lcg = lcg * 1103515245 + 12345;
+                c_re[i] = (int16_t)(lcg >> 16) >> 4;
+                lcg = lcg * 1103515245 + 12345;
+                c_im[i] = (int16_t)(lcg >> 16) >> 4;
+                lcg = lcg * 1103515245 + 12345;
+                samples[2 * i    ] = (int16_t)(lcg >> 16) >> 2;
+                lcg = lcg * 1103515245 + 12345;
+                samples[2 * i + 1] = (int16_t)(lcg >> 16) >> 2;
+            }
+
+            /* Every so often, a coefficient that can't be negated, to exercise the fallback */
+            if (0 == trial % 16) {
+                c_im[trial % nr_coeffs] = INT16_MIN;
+                samples[2 * (trial % nr_coeffs)    ] = 1;
+                samples[2 * (trial % nr_coeffs) + 1] = -1;
+            }
+
+            TEST_ASSERT_OK(direct_fir_init(&fir, nr_coeffs, c_re, c_im, 1, false, 0, 0));
+
+            direct_fir_dot_scalar(&fir, samples, &ref_re, &ref_im);
+            direct_fir_dot_real_scalar(c_re, samples, nr_coeffs, &ref_real_re, &ref_real_im);
+            dot_real_scalar(samples, c_re, nr_coeffs, &ref_real);
+
+            /* Every variant this CPU can run has to agree with the scalar kernels, bit for bit */
+            for (int isa = 0; isa < FILTER_ISA_MAX; isa++) {
+                const struct filter_kernels *kernels = filter_kernels_for_isa(isa);
+                int32_t acc_re = 0,
+                        acc_im = 0,
+                        acc = 0;
+
+                if (NULL == kernels || !filter_isa_supported(isa)) {
+                    continue;
+                }
+
+                kernels->direct_fir_dot(&fir, samples, &acc_re, &acc_im);
+                TEST_ASSERT_EQUALS(acc_re, ref_re);
+                TEST_ASSERT_EQUALS(acc_im, ref_im);
+
+                kernels->direct_fir_dot_real(c_re, samples, nr_coeffs, &acc_re, &acc_im);
+                TEST_ASSERT_EQUALS(acc_re, ref_real_re);
+                TEST_ASSERT_EQUALS(acc_im, ref_real_im);
+
+                kernels->dot_real(samples, c_re, nr_coeffs, &acc);
+                TEST_ASSERT_EQUALS(acc, ref_real);
+            }
+
+            TEST_ASSERT_OK(direct_fir_cleanup(&fir));
+        }
+    }
+
+    return A_OK;
+}
+
+/**
+ * The blocked kernels must give the same result as running the single-output scalar kernels on
+ * each window in turn.
+ */
+TEST_DECLARE_UNIT(test_block_kernels_match_scalar, flex)
+{
+    static const size_t nr_coeffs_cases[] = { 1, 4, 7, 16, 17, 33, 61 };
+    static const size_t strides[] = { 1, 2, 5 };
+    int16_t c_re[61],
+            c_im[61],
+            samples[2 * (61 + 3 * 5)];
+    uint32_t lcg = 41;
+
+    for (size_t n = 0; n < sizeof(nr_coeffs_cases)/sizeof(nr_coeffs_cases[0]); n++) {
+        size_t nr_coeffs = nr_coeffs_cases[n];
+
+        for (size_t trial = 0; trial < 16; trial++) {
+            struct direct_fir fir;
+
+            for (size_t i = 0; i < nr_coeffs; i++) {
+                lcg = lcg * 1103515245 + 12345;
+                c_re[i] = (int16_t)(lcg >> 16) >> 4;
+                lcg = lcg * 1103515245 + 12345;
+                c_im[i] = (int16_t)(lcg >> 16) >> 4;
+            }
+
+            for (size_t i = 0; i < sizeof(samples)/sizeof(samples[0]); i++) {
+                lcg = lcg * 1103515245 + 12345;
+                samples[i] = (int16_t)(lcg >> 16) >> 2;
+            }
+
+            if (0 == trial % 8) {
+                c_im[trial % nr_coeffs] = INT16_MIN;
+            }
+
+            TEST_ASSERT_OK(direct_fir_init(&fir, nr_coeffs, c_re, c_im, 1, false, 0, 0));
+
+            for (size_t t = 0; t < sizeof(strides)/sizeof(strides[0]); t++) {
+                size_t stride = strides[t];
+                int32_t ref_re[FILTER_BLOCK_OUTPUTS],
+                        ref_im[FILTER_BLOCK_OUTPUTS],
+                        ref_real_re[FILTER_BLOCK_OUTPUTS],
+                        ref_real_im[FILTER_BLOCK_OUTPUTS],
+                        ref_real[FILTER_BLOCK_OUTPUTS];
+                const int16_t *windows[FILTER_BLOCK_OUTPUTS],
+                              *coeffs[FILTER_BLOCK_OUTPUTS];
+
+                for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+                    const int16_t *window = &samples[2 * k * stride];
+
+                    direct_fir_dot_scalar(&fir, window, &ref_re[k], &ref_im[k]);
+                    direct_fir_dot_real_scalar(c_re, window, nr_coeffs, &ref_real_re[k], &ref_real_im[k]);
+
+                    /* Real samples, each with a different set of coefficients */
+                    windows[k] = &samples[k * stride];
+                    coeffs[k] = 0 == k % 2 ? c_re : c_im;
+                    dot_real_scalar(windows[k], coeffs[k], nr_coeffs, &ref_real[k]);
+                }
+
+                for (int isa = 0; isa < FILTER_ISA_MAX; isa++) {
+                    const struct filter_kernels *kernels = filter_kernels_for_isa(isa);
+                    int32_t acc_re[FILTER_BLOCK_OUTPUTS],
+                            acc_im[FILTER_BLOCK_OUTPUTS],
+                            acc[FILTER_BLOCK_OUTPUTS];
+
+                    if (NULL == kernels || !filter_isa_supported(isa)) {
+                        continue;
+                    }
+
+                    kernels->direct_fir_dot_block(&fir, samples, stride, acc_re, acc_im);
+                    TEST_ASSERT_EQUALS(memcmp(acc_re, ref_re, sizeof(acc_re)), 0);
+                    TEST_ASSERT_EQUALS(memcmp(acc_im, ref_im, sizeof(acc_im)), 0);
+
+                    kernels->direct_fir_dot_real_block(c_re, samples, nr_coeffs, stride, acc_re, acc_im);
+                    TEST_ASSERT_EQUALS(memcmp(acc_re, ref_real_re, sizeof(acc_re)), 0);
+                    TEST_ASSERT_EQUALS(memcmp(acc_im, ref_real_im, sizeof(acc_im)), 0);
+
+                    kernels->dot_real_block(windows, coeffs, nr_coeffs, acc);
+                    TEST_ASSERT_EQUALS(memcmp(acc, ref_real, sizeof(acc)), 0);
+                }
+            }
+
+            TEST_ASSERT_OK(direct_fir_cleanup(&fir));
+        }
+    }
+
+    return A_OK;
+}
+
+/**
+ * Folded symmetric, antisymmetric and halfband filters must give exactly the same result as the
+ * scalar kernels over the unfolded coefficients.
+ */
+TEST_DECLARE_UNIT(test_fold_kernels_match_scalar, flex)
+{
+    static const size_t nr_taps_cases[] = { 2, 3, 7, 8, 16, 31, 33, 60, 61 };
+    int16_t taps[61],
+            samples[2 * 61];
+    uint32_t lcg = 59;
+
+    for (size_t n = 0; n < sizeof(nr_taps_cases)/sizeof(nr_taps_cases[0]); n++) {
+        size_t nr_taps = nr_taps_cases[n];
+
+        /* Symmetric, antisymmetric, halfband, then symmetric with zero padding at each end */
+        for (size_t type = 0; type < 4; type++) {
+            struct fir_fold fold;
+            int32_t ref_re = 0,
+                    ref_im = 0,
+                    ref = 0;
+
+            for (size_t i = 0; i < (nr_taps + 1) / 2; i++) {
+                int16_t c = 0;
+
+                lcg = lcg * 1103515245 + 12345;
+                c = (int16_t)(lcg >> 16) >> 4;
+
+                if (2 == type && 0 != nr_taps % 2 && 0 == (nr_taps / 2 - i) % 2 && nr_taps / 2 != i) {
+                    c = 0;
+                } else if (3 == type && (0 == i || 1 == i)) {
+                    c = 0;
+                }
+
+                taps[i] = c;
+                taps[nr_taps - 1 - i] = 1 == type ? -c : c;
+            }
+
+            if (1 == type && 0 != nr_taps % 2) {
+                taps[nr_taps / 2] = 0;
+            }
+
+            for (size_t i = 0; i < 2 * nr_taps; i++) {
+                lcg = lcg * 1103515245 + 12345;
+                samples[i] = (int16_t)(lcg >> 16) >> 2;
+            }
+
+            TEST_ASSERT_OK(fir_fold_init(&fold, taps, nr_taps));
+            TEST_ASSERT_EQUALS(fold.symmetry, 1 == type ? FIR_SYMMETRY_ODD : FIR_SYMMETRY_EVEN);
+            TEST_ASSERT_EQUALS(fold.nr_coeffs < nr_taps, 1);
+
+            if (2 == type && 7 <= nr_taps && 0 != nr_taps % 2) {
+                TEST_ASSERT_EQUALS(fold.step, 2);
+            }
+
+            dot_real_scalar(samples, taps, nr_taps, &ref);
+            direct_fir_dot_real_scalar(taps, samples, nr_taps, &ref_re, &ref_im);
+
+            for (int isa = 0; isa < FILTER_ISA_MAX; isa++) {
+                const struct filter_kernels *kernels = filter_kernels_for_isa(isa);
+                int32_t acc_re = 0,
+                        acc_im = 0,
+                        acc = 0;
+
+                if (NULL == kernels || !filter_isa_supported(isa)) {
+                    continue;
+                }
+
+                kernels->fir_fold_dot(&fold, samples, &acc);
+                TEST_ASSERT_EQUALS(acc, ref);
+
+                kernels->fir_fold_dot_iq(&fold, samples, &acc_re, &acc_im);
+                TEST_ASSERT_EQUALS(acc_re, ref_re);
+                TEST_ASSERT_EQUALS(acc_im, ref_im);
+            }
+
+            TEST_ASSERT_OK(fir_fold_cleanup(&fold));
+        }
+    }
+
+    /* An asymmetric filter is left alone */
+    {
+        struct fir_fold fold;
+        static const int16_t asym[] = { 1, 2, 3, 2, 2 };
+
+        TEST_ASSERT_OK(fir_fold_init(&fold, asym, sizeof(asym)/sizeof(asym[0])));
+        TEST_ASSERT_EQUALS(fold.symmetry, FIR_SYMMETRY_NONE);
+        TEST_ASSERT_EQUALS(fir_fold_nr_mults(asym, sizeof(asym)/sizeof(asym[0])), 5);
+        TEST_ASSERT_OK(fir_fold_cleanup(&fold));
+    }
+
+    return A_OK;
+}
+
+/**
+ * The kernels built for fixed filter shapes must match the generic scalar kernels exactly, for
+ * every shape and instruction set.
+ */
+TEST_DECLARE_UNIT(test_fixed_kernels_match_generic, flex)
+{
+#define _TEST_FIXED_DIRECT_FIR_SHAPE(nr, dec) { nr, dec },
+#define _TEST_FIXED_POLYPHASE_SHAPE(nr) nr,
+    static const size_t direct_shapes[][2] = { FILTER_FIXED_DIRECT_FIR(_TEST_FIXED_DIRECT_FIR_SHAPE) };
+    static const size_t polyphase_shapes[] = { FILTER_FIXED_POLYPHASE(_TEST_FIXED_POLYPHASE_SHAPE) };
+#undef _TEST_FIXED_DIRECT_FIR_SHAPE
+#undef _TEST_FIXED_POLYPHASE_SHAPE
+    static int16_t c_re[1024],
+                   c_im[1024],
+                   samples[4096];
+    uint32_t lcg = 71;
+
+    for (size_t i = 0; i < sizeof(samples)/sizeof(samples[0]); i++) {
+        lcg = lcg * 1103515245 + 12345;
+        samples[i] = (int16_t)(lcg >> 16) >> 2;
+    }
+
+    for (size_t n = 0; n < sizeof(direct_shapes)/sizeof(direct_shapes[0]); n++) {
+        size_t nr_coeffs = direct_shapes[n][0];
+        unsigned decimation = direct_shapes[n][1];
+        struct direct_fir fir;
+        int32_t ref_re[FILTER_BLOCK_OUTPUTS],
+                ref_im[FILTER_BLOCK_OUTPUTS];
+
+        TEST_ASSERT_EQUALS(2 * (nr_coeffs + 3 * decimation) <= sizeof(samples)/sizeof(samples[0]), true);
+
+        for (size_t i = 0; i < nr_coeffs; i++) {
+            lcg = lcg * 1103515245 + 12345;
+            c_re[i] = (int16_t)(lcg >> 16) >> 4;
+            lcg = lcg * 1103515245 + 12345;
+            c_im[i] = (int16_t)(lcg >> 16) >> 4;
+        }
+
+        TEST_ASSERT_OK(direct_fir_init(&fir, nr_coeffs, c_re, c_im, decimation, false, 0, 0));
+        direct_fir_dot_block_scalar(&fir, samples, decimation, ref_re, ref_im);
+
+        for (int isa = 0; isa < FILTER_ISA_MAX; isa++) {
+            const struct filter_kernels *kernels = filter_kernels_for_isa(isa);
+            filter_direct_fir_dot_block_fn fixed = NULL;
+            int32_t acc_re[FILTER_BLOCK_OUTPUTS],
+                    acc_im[FILTER_BLOCK_OUTPUTS];
+
+            if (NULL == kernels || !filter_isa_supported(isa) ||
+                    NULL == (fixed = filter_kernels_fixed_direct_fir(kernels, nr_coeffs, decimation)))
+            {
+                continue;
+            }
+
+            fixed(&fir, samples, decimation, acc_re, acc_im);
+            TEST_ASSERT_EQUALS(memcmp(acc_re, ref_re, sizeof(acc_re)), 0);
+            TEST_ASSERT_EQUALS(memcmp(acc_im, ref_im, sizeof(acc_im)), 0);
+        }
+
+        TEST_ASSERT_OK(direct_fir_cleanup(&fir));
+    }
+
+    for (size_t n = 0; n < sizeof(polyphase_shapes)/sizeof(polyphase_shapes[0]); n++) {
+        size_t nr_coeffs = polyphase_shapes[n];
+        const int16_t *windows[FILTER_BLOCK_OUTPUTS],
+                      *coeffs[FILTER_BLOCK_OUTPUTS];
+        int32_t ref[FILTER_BLOCK_OUTPUTS];
+
+        for (size_t i = 0; i < 2 * nr_coeffs; i++) {
+            lcg = lcg * 1103515245 + 12345;
+            c_re[i] = (int16_t)(lcg >> 16) >> 4;
+        }
+
+        /* Irregular window starts and two different phase filters, like a resampler */
+        for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+            windows[k] = &samples[k * 7 + k / 2];
+            coeffs[k] = &c_re[(k % 2) * nr_coeffs];
+        }
+
+        dot_real_block_scalar(windows, coeffs, nr_coeffs, ref);
+
+        for (int isa = 0; isa < FILTER_ISA_MAX; isa++) {
+            const struct filter_kernels *kernels = filter_kernels_for_isa(isa);
+            filter_dot_real_block_fn fixed = NULL;
+            int32_t acc[FILTER_BLOCK_OUTPUTS];
+
+            if (NULL == kernels || !filter_isa_supported(isa) ||
+                    NULL == (fixed = filter_kernels_fixed_dot_real(kernels, nr_coeffs)))
+            {
+                continue;
+            }
+
+            fixed(windows, coeffs, nr_coeffs, acc);
+            TEST_ASSERT_EQUALS(memcmp(acc, ref, sizeof(acc)), 0);
+        }
+    }
+
+    return A_OK;
+}
+
+/**
+ * Asking for one output at a time never takes the blocked path; asking for everything at once
+ * mostly does. Both have to produce the same samples, for both strategies.
+ */
+TEST_DECLARE_UNIT(test_blocked_matches_single, flex)
+{
+    for (int mix = 0; mix < 2; mix++) {
+        struct direct_fir single,
+                          blocked;
+        int16_t *single_out = NULL,
+                *blocked_out = NULL;
+        size_t nr_single_out = 0,
+               nr_blocked_out = 0;
+        uint32_t lcg = 5;
+
+        if (0 == mix) {
+            TEST_ASSERT_OK(direct_fir_init(&single, TEST_FIR_NR_COEFFS, test_fir_coeffs[3][0], test_fir_coeffs[3][1],
+                        TEST_FIR_DECIMATION, true, 1000000, test_fir_offsets[3]));
+            TEST_ASSERT_OK(direct_fir_init(&blocked, TEST_FIR_NR_COEFFS, test_fir_coeffs[3][0], test_fir_coeffs[3][1],
+                        TEST_FIR_DECIMATION, true, 1000000, test_fir_offsets[3]));
+        } else {
+            TEST_ASSERT_OK(direct_fir_init_mix(&single, TEST_FIR_NR_COEFFS, test_fir_coeffs[2][0],
+                        TEST_FIR_DECIMATION, 1000000, test_fir_offsets[3]));
+            TEST_ASSERT_OK(direct_fir_init_mix(&blocked, TEST_FIR_NR_COEFFS, test_fir_coeffs[2][0],
+                        TEST_FIR_DECIMATION, 1000000, test_fir_offsets[3]));
+        }
+
+        TEST_ASSERT_OK(TCALLOC((void **)&single_out, TEST_FIR_OUT_SAMPLES, 2 * sizeof(int16_t)));
+        TEST_ASSERT_OK(TCALLOC((void **)&blocked_out, TEST_FIR_OUT_SAMPLES, 2 * sizeof(int16_t)));
+
+        for (size_t b = 0; b < TEST_FIR_NR_BUFS; b++) {
+            struct sample_buf *buf = NULL;
+            size_t nr_out = 0;
+
+            TEST_ASSERT_OK(_test_direct_fir_make_buf(TEST_FIR_BUF_SAMPLES, &lcg, 2, &buf));
+
+            TEST_ASSERT_OK(direct_fir_push_sample_buf(&single, buf));
+            do {
+                TEST_ASSERT_OK(direct_fir_process(&single, &single_out[2 * nr_single_out], 1, &nr_out));
+                nr_single_out += nr_out;
+            } while (0 != nr_out);
+
+            TEST_ASSERT_OK(direct_fir_push_sample_buf(&blocked, buf));
+            TEST_ASSERT_OK(direct_fir_process(&blocked, &blocked_out[2 * nr_blocked_out],
+                        TEST_FIR_OUT_SAMPLES - nr_blocked_out, &nr_out));
+            nr_blocked_out += nr_out;
+        }
+
+        TEST_ASSERT_EQUALS(nr_single_out, nr_blocked_out);
+        TEST_ASSERT_EQUALS(memcmp(single_out, blocked_out, nr_blocked_out * 2 * sizeof(int16_t)), 0);
+
+        TEST_ASSERT_OK(direct_fir_cleanup(&single));
+        TEST_ASSERT_OK(direct_fir_cleanup(&blocked));
+        TFREE(single_out);
+        TFREE(blocked_out);
+    }
+
+    return A_OK;
+}
+
+/**
+ * The overlap-save strategy has to match the complex direct FIR it stands in for, for a channel
+ * sitting exactly on an FFT bin and one that falls between bins.
+ */
+TEST_DECLARE_UNIT(test_fft_matches_complex, flex)
+{
+    static const size_t nr_taps = 255;
+    static const int32_t offsets[] = { 25000, -12500 };
+
+    for (size_t o = 0; o < sizeof(offsets)/sizeof(offsets[0]); o++) {
+        struct direct_fir cplx,
+                          fft;
+        int16_t *cplx_out = NULL,
+                *fft_out = NULL,
+                *taps = NULL;
+        size_t nr_cplx_out = 0,
+               nr_fft_out = 0;
+        double err_power = 0.0,
+               sig_power = 0.0,
+               f_offs = -2.0 * M_PI * (double)offsets[o] / 1000000.0;
+        uint32_t lcg = 13;
+
+        TEST_ASSERT_OK(TCALLOC((void **)&taps, nr_taps, 2 * sizeof(int16_t)));
+        for (size_t i = 0; i < nr_taps; i++) {
+            double t = (double)i - (double)(nr_taps - 1)/2.0,
+                   sinc = (0.0 == t) ? 0.02 : sin(2.0 * M_PI * 0.01 * t)/(M_PI * t),
+                   win = 0.54 - 0.46 * cos(2.0 * M_PI * i/(nr_taps - 1));
+            double complex tap = cexp(CMPLX(0, f_offs * (double)i)) * sinc * win;
+
+            taps[i] = (int16_t)(creal(tap) * (double)(1 << Q_15_SHIFT));
+            taps[nr_taps + i] = (int16_t)(cimag(tap) * (double)(1 << Q_15_SHIFT));
+        }
+
+        TEST_ASSERT_OK(direct_fir_init(&cplx, nr_taps, taps, &taps[nr_taps], TEST_FIR_DECIMATION, true, 1000000,
+                    offsets[o]));
+        TEST_ASSERT_OK(direct_fir_init_fft(&fft, nr_taps, taps, &taps[nr_taps], TEST_FIR_DECIMATION, 1000000,
+                    offsets[o]));
+
+        TEST_ASSERT_OK(TCALLOC((void **)&cplx_out, TEST_FIR_OUT_SAMPLES, 2 * sizeof(int16_t)));
+        TEST_ASSERT_OK(TCALLOC((void **)&fft_out, TEST_FIR_OUT_SAMPLES, 2 * sizeof(int16_t)));
+
+        for (size_t b = 0; b < TEST_FIR_NR_BUFS; b++) {
+            struct sample_buf *buf = NULL;
+            int16_t *samples = NULL;
+            size_t nr_out = 0;
+
+            TEST_ASSERT_OK(_test_direct_fir_make_buf(TEST_FIR_BUF_SAMPLES, &lcg, 2, &buf));
+
+            /* A tone in the channel, plus some of the noise */
+            samples = (int16_t *)buf->data_buf;
+            for (size_t i = 0; i < TEST_FIR_BUF_SAMPLES; i++) {
+                double phase = 2.0 * M_PI * (double)(offsets[o] + 2000) *
+                    (double)(b * TEST_FIR_BUF_SAMPLES + i) / 1000000.0;
+                samples[2 * i    ] = (int16_t)(8000.0 * cos(phase)) + (samples[2 * i    ] >> 4);
+                samples[2 * i + 1] = (int16_t)(8000.0 * sin(phase)) + (samples[2 * i + 1] >> 4);
+            }
+
+            TEST_ASSERT_OK(direct_fir_push_sample_buf(&cplx, buf));
+            TEST_ASSERT_OK(direct_fir_process(&cplx, &cplx_out[2 * nr_cplx_out], TEST_FIR_OUT_SAMPLES - nr_cplx_out, &nr_out));
+            nr_cplx_out += nr_out;
+
+            TEST_ASSERT_OK(direct_fir_push_sample_buf(&fft, buf));
+            TEST_ASSERT_OK(direct_fir_process(&fft, &fft_out[2 * nr_fft_out], TEST_FIR_OUT_SAMPLES - nr_fft_out, &nr_out));
+            nr_fft_out += nr_out;
+        }
+
+        /* The fast convolution works a block at a time, so it trails the direct FIR */
+        TEST_ASSERT_EQUALS(nr_fft_out > 0, true);
+        TEST_ASSERT_EQUALS(nr_fft_out <= nr_cplx_out, true);
+
+        for (size_t i = 0; i < 2 * nr_fft_out; i++) {
+            double diff = (double)cplx_out[i] - (double)fft_out[i];
+            err_power += diff * diff;
+            sig_power += (double)cplx_out[i] * (double)cplx_out[i];
+        }
+
+        TEST_INF("FFT vs. complex, offset %d Hz: %zu samples, SNR %f dB", offsets[o], nr_fft_out,
+                10.0 * log10(sig_power/err_power));
+
+        TEST_ASSERT_EQUALS(err_power * 1000.0 < sig_power, true);
+
+        TEST_ASSERT_OK(direct_fir_cleanup(&cplx));
+        TEST_ASSERT_OK(direct_fir_cleanup(&fft));
+        TFREE(cplx_out);
+        TFREE(fft_out);
+        TFREE(taps);
+    }
+
+    return A_OK;
+}
+
+/**
+ * Filtering 8-bit samples as they are must give exactly what filtering the same samples widened
+ * to Q.15 gives, for both 8-bit types, with every strategy and every kernel variant.
+ */
+TEST_DECLARE_UNIT(test_8bit_matches_q15, flex)
+{
+    static const enum sample_type types[] = { COMPLEX_UINT_8, COMPLEX_INT_8 };
+    static const size_t shapes[][2] = { { TEST_FIR_NR_COEFFS, TEST_FIR_DECIMATION }, { 128, 40 } };
+    static int16_t c_re[128],
+                   c_im[128];
+    int32_t offset = 25000;
+    uint32_t lcg = 97;
+
+    for (size_t t = 0; t < sizeof(types)/sizeof(types[0]); t++) {
+        for (size_t n = 0; n < sizeof(shapes)/sizeof(shapes[0]); n++) {
+            size_t nr_coeffs = shapes[n][0],
+                   max_out = TEST_FIR_NR_BUFS * TEST_FIR_BUF_SAMPLES / shapes[n][1];
+            unsigned decimation = shapes[n][1];
+            const int16_t *re_coeffs[1] = { c_re },
+                          *im_coeffs[1] = { c_im };
+            /* Index 0 is fed 8-bit samples, index 1 the same samples in Q.15 */
+            struct direct_fir cplx[2],
+                              mix[2];
+            struct direct_fir_batch batch[2];
+            int16_t *out[3][2];
+            size_t nr_out[3][2] = { { 0, 0 }, { 0, 0 }, { 0, 0 } };
+
+            for (size_t i = 0; i < nr_coeffs; i++) {
+                lcg = lcg * 1103515245 + 12345;
+                c_re[i] = (int16_t)(lcg >> 16) >> 4;
+                lcg = lcg * 1103515245 + 12345;
+                c_im[i] = (int16_t)(lcg >> 16) >> 4;
+            }
+
+            for (size_t j = 0; j < 2; j++) {
+                TEST_ASSERT_OK(direct_fir_init(&cplx[j], nr_coeffs, c_re, c_im, decimation, true, 1000000, offset));
+                TEST_ASSERT_OK(direct_fir_init_mix(&mix[j], nr_coeffs, c_re, decimation, 1000000, offset));
+                TEST_ASSERT_OK(direct_fir_batch_init(&batch[j], 1, nr_coeffs, re_coeffs, im_coeffs, decimation,
+                            true, 1000000, &offset));
+
+                for (size_t k = 0; k < 3; k++) {
+                    TEST_ASSERT_OK(TCALLOC((void **)&out[k][j], max_out, 2 * sizeof(int16_t)));
+                }
+            }
+
+            for (size_t b = 0; b < TEST_FIR_NR_BUFS; b++) {
+                struct sample_buf *bufs[2] = { NULL, NULL };
+
+                TEST_ASSERT_OK(_test_direct_fir_make_8bit(types[t], &lcg, 3, &bufs[0], &bufs[1]));
+
+                for (size_t j = 0; j < 2; j++) {
+                    TEST_ASSERT_OK(direct_fir_push_sample_buf(&cplx[j], bufs[j]));
+                    TEST_ASSERT_OK(direct_fir_push_sample_buf(&mix[j], bufs[j]));
+                    TEST_ASSERT_OK(direct_fir_batch_push_sample_buf(&batch[j], bufs[j]));
+                }
+
+                TEST_ASSERT_EQUALS(0 == cplx[0].u8_zero, false);
+                TEST_ASSERT_EQUALS(0 == batch[0].u8_zero, false);
+
+                /* Check every kernel variant against the scalar Q.15 kernels on the first windows */
+                if (0 == b) {
+                    const uint8_t *s8 = sample_history_head(&cplx[0].hist);
+                    const int16_t *s16 = sample_history_head(&cplx[1].hist);
+                    int32_t ref_re[FILTER_BLOCK_OUTPUTS],
+                            ref_im[FILTER_BLOCK_OUTPUTS],
+                            ref_batch_re = 0,
+                            ref_batch_im = 0;
+
+                    direct_fir_dot_block_scalar(&cplx[1], s16, decimation, ref_re, ref_im);
+                    direct_fir_batch_dot_scalar(&batch[1], s16);
+                    ref_batch_re = batch[1].acc_re[0];
+                    ref_batch_im = batch[1].acc_im[0];
+
+                    for (int isa = 0; isa < FILTER_ISA_MAX; isa++) {
+                        const struct filter_kernels *kernels = filter_kernels_for_isa(isa);
+                        int32_t acc_re[FILTER_BLOCK_OUTPUTS],
+                                acc_im[FILTER_BLOCK_OUTPUTS];
+
+                        if (NULL == kernels || !filter_isa_supported(isa)) {
+                            continue;
+                        }
+
+                        kernels->direct_fir_dot_u8(&cplx[0], s8, &acc_re[0], &acc_im[0]);
+                        TEST_ASSERT_EQUALS(acc_re[0], ref_re[0]);
+                        TEST_ASSERT_EQUALS(acc_im[0], ref_im[0]);
+
+                        kernels->direct_fir_dot_block_u8(&cplx[0], s8, decimation, acc_re, acc_im);
+                        TEST_ASSERT_EQUALS(memcmp(acc_re, ref_re, sizeof(acc_re)), 0);
+                        TEST_ASSERT_EQUALS(memcmp(acc_im, ref_im, sizeof(acc_im)), 0);
+
+                        kernels->direct_fir_batch_dot_u8(&batch[0], s8);
+                        TEST_ASSERT_EQUALS(batch[0].acc_re[0], ref_batch_re);
+                        TEST_ASSERT_EQUALS(batch[0].acc_im[0], ref_batch_im);
+                    }
+                }
+
+                for (size_t j = 0; j < 2; j++) {
+                    size_t nr = 0;
+                    int16_t *batch_pos = &out[2][j][2 * nr_out[2][j]];
+
+                    TEST_ASSERT_OK(direct_fir_process(&cplx[j], &out[0][j][2 * nr_out[0][j]], max_out - nr_out[0][j], &nr));
+                    nr_out[0][j] += nr;
+                    TEST_ASSERT_OK(direct_fir_process(&mix[j], &out[1][j][2 * nr_out[1][j]], max_out - nr_out[1][j], &nr));
+                    nr_out[1][j] += nr;
+                    TEST_ASSERT_OK(direct_fir_batch_process(&batch[j], &batch_pos, max_out - nr_out[2][j], &nr));
+                    nr_out[2][j] += nr;
+                }
+            }
+
+            for (size_t k = 0; k < 3; k++) {
+                TEST_ASSERT_EQUALS(0 == nr_out[k][0], false);
+                TEST_ASSERT_EQUALS(nr_out[k][0], nr_out[k][1]);
+                TEST_ASSERT_EQUALS(memcmp(out[k][0], out[k][1], nr_out[k][0] * 2 * sizeof(int16_t)), 0);
+            }
+
+            TEST_INF("Type %d, %zu coefficients, decimation by %u: compared %zu, %zu and %zu samples", types[t],
+                    nr_coeffs, decimation, nr_out[0][0], nr_out[1][0], nr_out[2][0]);
+
+            for (size_t j = 0; j < 2; j++) {
+                TEST_ASSERT_OK(direct_fir_cleanup(&cplx[j]));
+                TEST_ASSERT_OK(direct_fir_cleanup(&mix[j]));
+                TEST_ASSERT_OK(direct_fir_batch_cleanup(&batch[j]));
+
+                for (size_t k = 0; k < 3; k++) {
+                    TFREE(out[k][j]);
+                }
+            }
+        }
+    }
+
+    return A_OK;
+}
+
+/**
+ * The float kernels add the products up in the same order in every variant, so they can only
+ * differ from the scalar kernels by how FMA rounds. The compiler is free to fuse the blocked
+ * kernels differently from the single-output kernels too, so they only have to agree to within
+ * a few ULPs.
+ */
+TEST_DECLARE_UNIT(test_f32_kernels_match_scalar, flex)
+{
+    static const size_t nr_coeffs_cases[] = { 1, 7, 8, 9, 16, 17, 33, 61 };
+    static const size_t stride = 3;
+    float c_re[61],
+          c_im[61],
+          samples[2 * (61 + 3 * stride)];
+    uint32_t lcg = 29;
+
+    for (size_t n = 0; n < sizeof(nr_coeffs_cases)/sizeof(nr_coeffs_cases[0]); n++) {
+        size_t nr_coeffs = nr_coeffs_cases[n];
+        struct direct_fir_f32 fir;
+        float ref_re[FILTER_BLOCK_OUTPUTS],
+              ref_im[FILTER_BLOCK_OUTPUTS];
+
+        for (size_t i = 0; i < nr_coeffs; i++) {
+            lcg = lcg * 1103515245 + 12345;
+            c_re[i] = (float)(int16_t)(lcg >> 16) / 32768.0f;
+            lcg = lcg * 1103515245 + 12345;
+            c_im[i] = (float)(int16_t)(lcg >> 16) / 32768.0f;
+        }
+
+        for (size_t i = 0; i < sizeof(samples)/sizeof(samples[0]); i++) {
+            lcg = lcg * 1103515245 + 12345;
+            samples[i] = (float)(int16_t)(lcg >> 16) / 32768.0f;
+        }
+
+        TEST_ASSERT_OK(direct_fir_f32_init(&fir, nr_coeffs, c_re, c_im, 1, false, 0, 0));
+
+        for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+            direct_fir_f32_dot_scalar(&fir, &samples[2 * k * stride], &ref_re[k], &ref_im[k]);
+        }
+
+        for (int isa = 0; isa < FILTER_ISA_MAX; isa++) {
+            const struct filter_kernels *kernels = filter_kernels_for_isa(isa);
+            float acc_re[FILTER_BLOCK_OUTPUTS],
+                  acc_im[FILTER_BLOCK_OUTPUTS];
+
+            if (NULL == kernels || !filter_isa_supported(isa)) {
+                continue;
+            }
+
+            kernels->direct_fir_f32_dot_block(&fir, samples, stride, acc_re, acc_im);
+
+            for (size_t k = 0; k < FILTER_BLOCK_OUTPUTS; k++) {
+                float re = 0.0f,
+                      im = 0.0f;
+
+                kernels->direct_fir_f32_dot(&fir, &samples[2 * k * stride], &re, &im);
+                TEST_ASSERT(fabsf(re - acc_re[k]) < 2e-6f);
+                TEST_ASSERT(fabsf(im - acc_im[k]) < 2e-6f);
+
+                TEST_ASSERT(fabsf(re - ref_re[k]) < 1e-5f);
+                TEST_ASSERT(fabsf(im - ref_im[k]) < 1e-5f);
+            }
+        }
+
+        TEST_ASSERT_OK(direct_fir_f32_cleanup(&fir));
+    }
+
+    return A_OK;
+}
+
+/**
+ * A float FIR with the same coefficients has to give the same output as a Q.15 FIR, to within
+ * the Q.15 FIR's rounding, derotation included. The float FIR is fed COMPLEX_FLOAT_32 sample
+ * buffers, which have to convert back to exactly the same Q.15 samples.
+ */
+TEST_DECLARE_UNIT(test_f32_matches_q15, flex)
+{
+    struct direct_fir fir;
+    struct direct_fir_f32 fir_f32;
+    static int16_t out[2 * TEST_FIR_OUT_SAMPLES],
+                   check[2 * TEST_FIR_BUF_SAMPLES];
+    static float out_f32[2 * TEST_FIR_OUT_SAMPLES];
+    float c_re[TEST_FIR_NR_COEFFS],
+          c_im[TEST_FIR_NR_COEFFS];
+    const float q15 = (float)(1 << Q_15_SHIFT);
+    size_t nr_out = 0,
+           nr_out_f32 = 0;
+    int max_diff = 0;
+    uint32_t lcg = 7;
+
+    for (size_t i = 0; i < TEST_FIR_NR_COEFFS; i++) {
+        c_re[i] = (float)test_fir_coeffs[1][0][i] / q15;
+        c_im[i] = (float)test_fir_coeffs[1][1][i] / q15;
+    }
+
+    TEST_ASSERT_OK(direct_fir_init(&fir, TEST_FIR_NR_COEFFS, test_fir_coeffs[1][0], test_fir_coeffs[1][1],
+                TEST_FIR_DECIMATION, true, 1000000, test_fir_offsets[1]));
+    TEST_ASSERT_OK(direct_fir_f32_init(&fir_f32, TEST_FIR_NR_COEFFS, c_re, c_im, TEST_FIR_DECIMATION, true,
+                1000000, test_fir_offsets[1]));
+
+    for (size_t b = 0; b < TEST_FIR_NR_BUFS; b++) {
+        struct sample_buf *buf = NULL,
+                          *buf_f32 = NULL;
+        int16_t *samples = NULL;
+        float *samples_f32 = NULL;
+        size_t nr_new = 0;
+
+        TEST_ASSERT_OK(_test_direct_fir_make_buf(TEST_FIR_BUF_SAMPLES, &lcg, 1, &buf));
+        TEST_ASSERT_OK(TCALLOC((void **)&buf_f32, 1, sizeof(struct sample_buf) + TEST_FIR_BUF_SAMPLES * 2 * sizeof(float)));
+        buf_f32->nr_samples = TEST_FIR_BUF_SAMPLES;
+        buf_f32->sample_type = COMPLEX_FLOAT_32;
+        buf_f32->release = _test_direct_fir_buf_release;
+        atomic_store(&buf_f32->refcount, 1);
+
+        samples = (int16_t *)buf->data_buf;
+        samples_f32 = (float *)buf_f32->data_buf;
+        for (size_t i = 0; i < 2 * TEST_FIR_BUF_SAMPLES; i++) {
+            samples_f32[i] = (float)samples[i] / q15;
+        }
+
+        TEST_ASSERT_OK(sample_buf_copy_q15(buf_f32, check));
+        TEST_ASSERT_EQUALS(memcmp(check, samples, sizeof(check)), 0);
+
+        TEST_ASSERT_OK(direct_fir_push_sample_buf(&fir, buf));
+        TEST_ASSERT_OK(direct_fir_process(&fir, &out[2 * nr_out], TEST_FIR_OUT_SAMPLES - nr_out, &nr_new));
+        nr_out += nr_new;
+
+        TEST_ASSERT_OK(direct_fir_f32_push_sample_buf(&fir_f32, buf_f32));
+        TEST_ASSERT_OK(direct_fir_f32_process(&fir_f32, &out_f32[2 * nr_out_f32], TEST_FIR_OUT_SAMPLES - nr_out_f32,
+                    &nr_new));
+        nr_out_f32 += nr_new;
+    }
+
+    TEST_ASSERT_EQUALS(nr_out, nr_out_f32);
+
+    for (size_t i = 0; i < 2 * nr_out; i++) {
+        int diff = abs((int)lrintf(out_f32[i] * q15) - out[i]);
+        max_diff = diff > max_diff ? diff : max_diff;
+    }
+
+    TEST_INF("Compared %zu output samples, largest difference %d", nr_out, max_diff);
+    TEST_ASSERT(max_diff <= 2);
+
+    TEST_ASSERT_OK(direct_fir_cleanup(&fir));
+    TEST_ASSERT_OK(direct_fir_f32_cleanup(&fir_f32));
+
+    return A_OK;
+}
+
 TEST_DECLARE_SUITE(flex, test_direct_fir_cleanup, test_direct_fir_setup, NULL, NULL);
 
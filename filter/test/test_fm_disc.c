@@ -0,0 +1,214 @@
+#include <filter/filter.h>
+#include <filter/fm_disc.h>
+#include <filter/kernels.h>
+
+#include <test/assert.h>
+#include <test/framework.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_FM_DISC_NR_SAMPLES     1001
+
+static
+aresult_t test_fm_disc_setup(void)
+{
+    return filter_kernels_init();
+}
+
+static
+aresult_t test_fm_disc_cleanup(void)
+{
+    return A_OK;
+}
+
+/**
+ * An FM signal with a wandering frequency and amplitude, sweeping the phase differences all the
+ * way around the circle. Every so often the signal drops to nothing, so there are zero vectors.
+ */
+static
+void _test_fm_disc_fill(int16_t *samples, float *samples_f32, size_t nr_samples)
+{
+    double phase = 0.0;
+
+    for (size_t i = 0; i < nr_samples; i++) {
+        double amp = 0 == i % 97 ? 0.0 : 16000.0 + 15000.0 * sin(0.013 * i);
+
+        phase += M_PI * sin(0.0071 * i);
+        samples[2 * i    ] = (int16_t)lrint(amp * cos(phase));
+        samples[2 * i + 1] = (int16_t)lrint(amp * sin(phase));
+        samples_f32[2 * i    ] = (float)samples[2 * i    ] / (float)(1 << Q_15_SHIFT);
+        samples_f32[2 * i + 1] = (float)samples[2 * i + 1] / (float)(1 << Q_15_SHIFT);
+    }
+}
+
+/**
+ * The phase difference each discriminator should give, in Q.15
+ */
+static
+double _test_fm_disc_expected(const int16_t *samples, const int16_t *last, size_t i)
+{
+    const int16_t *b = 0 == i ? last : &samples[2 * i - 2];
+    double a_re = samples[2 * i],
+           a_im = samples[2 * i + 1],
+           s_re = a_re * b[0] + a_im * b[1],
+           s_im = a_im * b[0] - a_re * b[1];
+
+    return atan2(s_im, s_re) / M_PI * (double)(1 << Q_15_SHIFT);
+}
+
+/**
+ * Every discriminator has to come out within 3/4 of an LSB of the exact phase difference. Rounding
+ * accounts for half an LSB of that, so the approximations add very little.
+ */
+TEST_DECLARE_UNIT(test_accuracy, fmdisc)
+{
+    static int16_t samples[2 * TEST_FM_DISC_NR_SAMPLES],
+                   out[TEST_FM_DISC_NR_SAMPLES],
+                   out_cordic[TEST_FM_DISC_NR_SAMPLES],
+                   out_f32[TEST_FM_DISC_NR_SAMPLES];
+    static float samples_f32[2 * TEST_FM_DISC_NR_SAMPLES];
+    int16_t last[2] = { 1 << Q_15_SHIFT, 0 },
+            last_cordic[2] = { 1 << Q_15_SHIFT, 0 };
+    float last_f32[2] = { 1.0f, 0.0f };
+
+    _test_fm_disc_fill(samples, samples_f32, TEST_FM_DISC_NR_SAMPLES);
+
+    fm_disc_q15(samples, TEST_FM_DISC_NR_SAMPLES, last, out);
+    fm_disc_q15_cordic(samples, TEST_FM_DISC_NR_SAMPLES, last_cordic, out_cordic);
+    fm_disc_f32(samples_f32, TEST_FM_DISC_NR_SAMPLES, last_f32, out_f32);
+
+    for (size_t i = 0; i < TEST_FM_DISC_NR_SAMPLES; i++) {
+        static const int16_t first[2] = { 1 << Q_15_SHIFT, 0 };
+        double expected = _test_fm_disc_expected(samples, first, i);
+
+        /* The exact phase of a zero vector is whatever atan2 says, but it has to come out as 0 */
+        if (0 == samples[2 * i] && 0 == samples[2 * i + 1]) {
+            expected = 0.0;
+        }
+
+        if (0 < i && 0 == samples[2 * i - 2] && 0 == samples[2 * i - 1]) {
+            expected = 0.0;
+        }
+
+        TEST_ASSERT(fabs(out[i] - expected) <= 0.75);
+        TEST_ASSERT(fabs(out_cordic[i] - expected) <= 0.75);
+        TEST_ASSERT(fabs(out_f32[i] - expected) <= 0.75);
+    }
+
+    /* The last sample is carried over to the next call */
+    TEST_ASSERT_EQUALS(last[0], samples[2 * TEST_FM_DISC_NR_SAMPLES - 2]);
+    TEST_ASSERT_EQUALS(last[1], samples[2 * TEST_FM_DISC_NR_SAMPLES - 1]);
+    TEST_ASSERT_EQUALS(last_cordic[0], samples[2 * TEST_FM_DISC_NR_SAMPLES - 2]);
+    TEST_ASSERT_EQUALS(last_cordic[1], samples[2 * TEST_FM_DISC_NR_SAMPLES - 1]);
+    TEST_ASSERT(last_f32[0] == samples_f32[2 * TEST_FM_DISC_NR_SAMPLES - 2]);
+    TEST_ASSERT(last_f32[1] == samples_f32[2 * TEST_FM_DISC_NR_SAMPLES - 1]);
+
+    return A_OK;
+}
+
+/**
+ * Full scale samples, out at the corners, where the sums of the products are as big as they
+ * get. Neighbouring samples are never opposite each other, so the phase is never ambiguous.
+ */
+TEST_DECLARE_UNIT(test_full_scale, fmdisc)
+{
+    static const int16_t corners[4][2] = {
+        { -32768, -32768 },
+        { -32768, 32767 },
+        { 32767, 32767 },
+        { 32767, -32768 },
+    };
+    int16_t samples[2 * 16],
+            out[16],
+            out_cordic[16],
+            out_f32[16];
+    float samples_f32[2 * 16];
+    int16_t last[2] = { -32768, -32768 },
+            last_cordic[2] = { -32768, -32768 };
+    float last_f32[2] = { -1.0f, -1.0f };
+
+    /* Each corner twice, so there are phase differences of both 0 and pi/2 */
+    for (size_t i = 0; i < 16; i++) {
+        samples[2 * i    ] = corners[(i / 2) % 4][0];
+        samples[2 * i + 1] = corners[(i / 2) % 4][1];
+        samples_f32[2 * i    ] = (float)samples[2 * i    ] / (float)(1 << Q_15_SHIFT);
+        samples_f32[2 * i + 1] = (float)samples[2 * i + 1] / (float)(1 << Q_15_SHIFT);
+    }
+
+    fm_disc_q15(samples, 16, last, out);
+    fm_disc_q15_cordic(samples, 16, last_cordic, out_cordic);
+    fm_disc_f32(samples_f32, 16, last_f32, out_f32);
+
+    for (size_t i = 0; i < 16; i++) {
+        double expected = _test_fm_disc_expected(samples, corners[0], i);
+
+        TEST_ASSERT(fabs(out[i] - expected) <= 0.75);
+        TEST_ASSERT(fabs(out_cordic[i] - expected) <= 0.75);
+        TEST_ASSERT(fabs(out_f32[i] - expected) <= 0.75);
+    }
+
+    return A_OK;
+}
+
+/**
+ * Every variant has to agree with the scalar kernels: exactly for the CORDIC, and to within an
+ * LSB for the polynomials, where FMA changes the rounding. Splitting the samples across calls
+ * mustn't change anything.
+ */
+TEST_DECLARE_UNIT(test_kernels_match_scalar, fmdisc)
+{
+    static int16_t samples[2 * TEST_FM_DISC_NR_SAMPLES],
+                   ref[TEST_FM_DISC_NR_SAMPLES],
+                   ref_cordic[TEST_FM_DISC_NR_SAMPLES],
+                   ref_f32[TEST_FM_DISC_NR_SAMPLES],
+                   out[TEST_FM_DISC_NR_SAMPLES],
+                   out_cordic[TEST_FM_DISC_NR_SAMPLES],
+                   out_f32[TEST_FM_DISC_NR_SAMPLES];
+    static float samples_f32[2 * TEST_FM_DISC_NR_SAMPLES];
+    const struct filter_kernels *scalar = filter_kernels_for_isa(FILTER_ISA_SCALAR);
+    int16_t last[2] = { 0, 0 };
+    float last_f32[2] = { 0.0f, 0.0f };
+
+    _test_fm_disc_fill(samples, samples_f32, TEST_FM_DISC_NR_SAMPLES);
+
+    scalar->fm_disc_q15(samples, TEST_FM_DISC_NR_SAMPLES, last, ref);
+    memset(last, 0, sizeof(last));
+    scalar->fm_disc_q15_cordic(samples, TEST_FM_DISC_NR_SAMPLES, last, ref_cordic);
+    scalar->fm_disc_f32(samples_f32, TEST_FM_DISC_NR_SAMPLES, last_f32, ref_f32);
+
+    for (int isa = 0; isa < FILTER_ISA_MAX; isa++) {
+        const struct filter_kernels *kernels = filter_kernels_for_isa(isa);
+        int16_t last_q15[2] = { 0, 0 },
+                last_cordic[2] = { 0, 0 };
+        size_t offs = 0;
+
+        if (NULL == kernels || !filter_isa_supported(isa)) {
+            continue;
+        }
+
+        memset(last_f32, 0, sizeof(last_f32));
+
+        /* Odd-sized pieces, so the vector loops have tails */
+        while (offs < TEST_FM_DISC_NR_SAMPLES) {
+            size_t nr = TEST_FM_DISC_NR_SAMPLES - offs < 37 ? TEST_FM_DISC_NR_SAMPLES - offs : 37;
+
+            kernels->fm_disc_q15(&samples[2 * offs], nr, last_q15, &out[offs]);
+            kernels->fm_disc_q15_cordic(&samples[2 * offs], nr, last_cordic, &out_cordic[offs]);
+            kernels->fm_disc_f32(&samples_f32[2 * offs], nr, last_f32, &out_f32[offs]);
+            offs += nr;
+        }
+
+        TEST_ASSERT_EQUALS(memcmp(out_cordic, ref_cordic, sizeof(ref_cordic)), 0);
+
+        for (size_t i = 0; i < TEST_FM_DISC_NR_SAMPLES; i++) {
+            TEST_ASSERT(abs(out[i] - ref[i]) <= 1);
+            TEST_ASSERT(abs(out_f32[i] - ref_f32[i]) <= 1);
+        }
+    }
+
+    return A_OK;
+}
+
+TEST_DECLARE_SUITE(fmdisc, test_fm_disc_cleanup, test_fm_disc_setup, NULL, NULL);
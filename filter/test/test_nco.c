@@ -0,0 +1,116 @@
+#include <filter/filter.h>
+#include <filter/nco.h>
+#include <filter/kernels.h>
+
+#include <test/assert.h>
+#include <test/framework.h>
+
+#include <math.h>
+#include <string.h>
+
+#define TEST_NCO_NR_SAMPLES         1001
+
+static
+aresult_t test_nco_setup(void)
+{
+    return filter_kernels_init();
+}
+
+static
+aresult_t test_nco_cleanup(void)
+{
+    return A_OK;
+}
+
+/**
+ * Every variant has to rotate the same way as the scalar kernel, and leave the NCO at the same
+ * phase, however the samples are split up.
+ */
+TEST_DECLARE_UNIT(test_kernels_match_scalar, nco)
+{
+    static int16_t in[2 * TEST_NCO_NR_SAMPLES],
+                   ref[2 * TEST_NCO_NR_SAMPLES],
+                   out[2 * TEST_NCO_NR_SAMPLES];
+    static const size_t lengths[] = { 0, 1, 15, 64, 333, TEST_NCO_NR_SAMPLES };
+    uint32_t lcg = 17;
+    struct nco ref_nco,
+               nco;
+
+    for (size_t i = 0; i < 2 * TEST_NCO_NR_SAMPLES; i++) {
+        lcg = lcg * 1103515245 + 12345;
+        in[i] = (int16_t)(lcg >> 16);
+    }
+
+    for (size_t l = 0; l < sizeof(lengths)/sizeof(lengths[0]); l++) {
+        size_t nr_samples = lengths[l];
+
+        TEST_ASSERT_OK(nco_init(&ref_nco, nco_phase_incr(-12345.0, 250000.0)));
+        memcpy(ref, in, sizeof(in));
+        filter_kernels_for_isa(FILTER_ISA_SCALAR)->nco_rotate(&ref_nco, ref, nr_samples);
+
+        for (int isa = 0; isa < FILTER_ISA_MAX; isa++) {
+            const struct filter_kernels *kernels = filter_kernels_for_isa(isa);
+
+            if (NULL == kernels || !filter_isa_supported(isa)) {
+                continue;
+            }
+
+            TEST_ASSERT_OK(nco_init(&nco, ref_nco.phase_incr));
+            memcpy(out, in, sizeof(in));
+
+            /* In two pieces, to check the phase carries over */
+            kernels->nco_rotate(&nco, out, nr_samples / 3);
+            kernels->nco_rotate(&nco, &out[2 * (nr_samples / 3)], nr_samples - nr_samples / 3);
+
+            TEST_ASSERT_EQUALS(memcmp(out, ref, sizeof(out)), 0);
+            TEST_ASSERT_EQUALS(nco.phase, ref_nco.phase);
+        }
+    }
+
+    return A_OK;
+}
+
+/**
+ * The phase after any number of steps is exact, and the amplitude doesn't drift, no matter how
+ * long the NCO runs.
+ */
+TEST_DECLARE_UNIT(test_no_drift, nco)
+{
+    static int16_t samples[2 * TEST_NCO_NR_SAMPLES];
+    struct nco nco;
+    uint32_t phase_incr = nco_phase_incr(1000.0, 48000.0);
+    size_t nr_steps = 0;
+
+    TEST_ASSERT_OK(nco_init(&nco, phase_incr));
+
+    for (size_t j = 0; j < 10000; j++) {
+        for (size_t i = 0; i < TEST_NCO_NR_SAMPLES; i++) {
+            samples[2 * i    ] = 1 << Q_15_SHIFT;
+            samples[2 * i + 1] = 0;
+        }
+
+        nco_rotate(&nco, samples, TEST_NCO_NR_SAMPLES);
+        nr_steps += TEST_NCO_NR_SAMPLES;
+    }
+
+    TEST_ASSERT_EQUALS(nco.phase, (uint32_t)(nr_steps * phase_incr));
+
+    /* The last block came from the same table as the first, so it has the same amplitude */
+    for (size_t i = 0; i < TEST_NCO_NR_SAMPLES; i++) {
+        double mag = hypot(samples[2 * i], samples[2 * i + 1]);
+        TEST_ASSERT(fabs(mag - (double)(1 << Q_15_SHIFT)) < 2.0);
+    }
+
+    /* A whole number of cycles comes back to exactly phase 0 */
+    TEST_ASSERT_OK(nco_init(&nco, nco_phase_incr(1000.0, 48000.0)));
+    for (size_t i = 0; i < 48000; i++) {
+        int16_t re = 0,
+                im = 0;
+        nco_step(&nco, &re, &im);
+    }
+    TEST_ASSERT(nco.phase < 48000 || nco.phase > (uint32_t)-48000);
+
+    return A_OK;
+}
+
+TEST_DECLARE_SUITE(nco, test_nco_cleanup, test_nco_setup, NULL, NULL);
@@ -0,0 +1,170 @@
+#include <filter/filter.h>
+#include <filter/fft.h>
+#include <filter/pfb_channelizer.h>
+
+#include <test/assert.h>
+#include <test/framework.h>
+
+#include <tsl/safe_alloc.h>
+#include <tsl/assert.h>
+
+#include <complex.h>
+#include <math.h>
+
+#define TEST_PFB_NR_BINS            16
+#define TEST_PFB_NR_SAMPLES         4096
+
+static
+int16_t *test_pfb_proto = NULL;
+
+static
+size_t test_pfb_nr_proto = 0;
+
+static
+aresult_t test_pfb_channelizer_setup(void)
+{
+    aresult_t ret = A_OK;
+
+    /* Windowed-sinc low pass, cut off at half a bin */
+    test_pfb_nr_proto = 8 * TEST_PFB_NR_BINS;
+
+    if (FAILED(ret = TCALLOC((void **)&test_pfb_proto, test_pfb_nr_proto, sizeof(int16_t)))) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < test_pfb_nr_proto; i++) {
+        double t = (double)i - (double)(test_pfb_nr_proto - 1)/2.0,
+               fc = 0.5/(double)TEST_PFB_NR_BINS,
+               sinc = (0.0 == t) ? 2.0 * fc : sin(2.0 * M_PI * fc * t)/(M_PI * t),
+               win = 0.42 - 0.5 * cos(2.0 * M_PI * i/(test_pfb_nr_proto - 1)) +
+                     0.08 * cos(4.0 * M_PI * i/(test_pfb_nr_proto - 1));
+        test_pfb_proto[i] = (int16_t)(sinc * win * (double)(1 << Q_15_SHIFT));
+    }
+
+done:
+    return ret;
+}
+
+static
+aresult_t test_pfb_channelizer_cleanup(void)
+{
+    if (NULL != test_pfb_proto) {
+        TFREE(test_pfb_proto);
+    }
+
+    return A_OK;
+}
+
+TEST_DECLARE_UNIT(test_fft_vs_dft, pfb)
+{
+    static const size_t sizes[] = { 1, 2, 8, 12, 40, 64, 100, 7 * 11 };
+
+    for (size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        struct fft *fft = NULL;
+        float complex in[100],
+                      out[100];
+
+        for (size_t i = 0; i < n; i++) {
+            in[i] = CMPLXF(cosf(0.3f * i) + 0.1f * i, sinf(1.7f * i));
+        }
+
+        TEST_ASSERT_OK(fft_new(&fft, n, false));
+        TEST_ASSERT_OK(fft_execute(fft, in, out));
+
+        for (size_t k = 0; k < n; k++) {
+            double complex ref = 0;
+
+            for (size_t i = 0; i < n; i++) {
+                ref += in[i] * cexp(CMPLX(0, -2.0 * M_PI * (double)(i * k % n)/(double)n));
+            }
+
+            if (cabs(ref - out[k]) > 1e-3 * n) {
+                TEST_ERR("FFT size %zu bin %zu: got (%f, %f), expected (%f, %f)", n, k,
+                        crealf(out[k]), cimagf(out[k]), creal(ref), cimag(ref));
+                return A_E_INVAL;
+            }
+        }
+
+        TEST_ASSERT_OK(fft_delete(&fft));
+    }
+
+    return A_OK;
+}
+
+static
+aresult_t _test_pfb_tone(unsigned decimation)
+{
+    aresult_t ret = A_OK;
+
+    struct pfb_channelizer *pfb = NULL;
+    int16_t *in = NULL,
+            *out[TEST_PFB_NR_BINS];
+    size_t nr_out = 0;
+    double power[TEST_PFB_NR_BINS];
+    unsigned tone_bin = 0;
+    int32_t residual = 0;
+
+    TEST_ASSERT_OK(pfb_channelizer_new(&pfb, TEST_PFB_NR_BINS, decimation, test_pfb_proto, test_pfb_nr_proto));
+
+    /* A tone centered in bin 13, i.e. -3 bins */
+    TEST_ASSERT_OK(pfb_channelizer_find_bin(pfb, 1600000, -300000, &tone_bin, &residual));
+    TEST_ASSERT_EQUALS(tone_bin, 13);
+    TEST_ASSERT_EQUALS(residual, 0);
+
+    TEST_ASSERT_OK(TCALLOC((void **)&in, TEST_PFB_NR_SAMPLES, 2 * sizeof(int16_t)));
+
+    for (size_t i = 0; i < TEST_PFB_NR_SAMPLES; i++) {
+        double phase = 2.0 * M_PI * (double)tone_bin * (double)i/(double)TEST_PFB_NR_BINS;
+        in[2 * i    ] = (int16_t)(8192.0 * cos(phase));
+        in[2 * i + 1] = (int16_t)(8192.0 * sin(phase));
+    }
+
+    for (size_t k = 0; k < TEST_PFB_NR_BINS; k++) {
+        TEST_ASSERT_OK(TCALLOC((void **)&out[k], TEST_PFB_NR_SAMPLES, 2 * sizeof(int16_t)));
+        power[k] = 0.0;
+    }
+
+    /* Feed the tone in odd-sized chunks to exercise the history handling */
+    for (size_t offs = 0; offs < TEST_PFB_NR_SAMPLES; offs += 1000) {
+        size_t nr_in = BL_MIN2(1000, TEST_PFB_NR_SAMPLES - offs);
+        TEST_ASSERT_OK(pfb_channelizer_process(pfb, &in[2 * offs], nr_in, out, TEST_PFB_NR_SAMPLES, &nr_out));
+
+        /* Skip the filter's start-up transient */
+        for (size_t k = 0; 0 != offs && k < TEST_PFB_NR_BINS; k++) {
+            for (size_t i = 0; i < nr_out; i++) {
+                power[k] += (double)out[k][2 * i] * out[k][2 * i] + (double)out[k][2 * i + 1] * out[k][2 * i + 1];
+            }
+        }
+    }
+
+    for (size_t k = 0; k < TEST_PFB_NR_BINS; k++) {
+        TEST_INF("Decimation %u, bin %2zu: power %f", decimation, k, power[k]);
+        if (k != tone_bin && power[k] * 1000.0 > power[tone_bin]) {
+            TEST_ERR("Bin %zu has too much energy from the tone in bin %u", k, tone_bin);
+            ret = A_E_INVAL;
+        }
+    }
+
+    for (size_t k = 0; k < TEST_PFB_NR_BINS; k++) {
+        TFREE(out[k]);
+    }
+
+    TFREE(in);
+    TEST_ASSERT_OK(pfb_channelizer_delete(&pfb));
+
+    return ret;
+}
+
+TEST_DECLARE_UNIT(test_critically_sampled, pfb)
+{
+    return _test_pfb_tone(TEST_PFB_NR_BINS);
+}
+
+TEST_DECLARE_UNIT(test_oversampled, pfb)
+{
+    return _test_pfb_tone(TEST_PFB_NR_BINS/2);
+}
+
+TEST_DECLARE_SUITE(pfb, test_pfb_channelizer_cleanup, test_pfb_channelizer_setup, NULL, NULL);
+
@@ -1,8 +1,20 @@
 #include <filter/filter.h>
+#include <filter/sample_buf.h>
+#include <filter/complex.h>
 
 #include <test/assert.h>
 #include <test/framework.h>
 
+#include <tsl/safe_alloc.h>
+
+#include <stdatomic.h>
+#include <string.h>
+
+#define TEST_POLYPHASE_BUF_SAMPLES      400
+#define TEST_POLYPHASE_NR_BUFS          5
+#define TEST_POLYPHASE_OUT_SAMPLES      (TEST_POLYPHASE_NR_BUFS * TEST_POLYPHASE_BUF_SAMPLES * 3 / 2)
+#define TEST_POLYPHASE_HALFBAND_TAPS    23
+
 static const
 int16_t test_polyphase_fir_coeffs[] = {
     255, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
@@ -32,5 +44,206 @@ TEST_DECLARE_UNIT(test_smoke, polyphase)
     return A_OK;
 }
 
+static
+aresult_t _test_polyphase_fir_buf_release(struct sample_buf *buf)
+{
+    TFREE(buf);
+    return A_OK;
+}
+
+/**
+ * Computing outputs a block at a time must give the same samples, and leave the filter in the
+ * same phase, as computing them one at a time.
+ */
+TEST_DECLARE_UNIT(test_blocked_matches_single, polyphase)
+{
+    struct polyphase_fir *single = NULL,
+                         *blocked = NULL;
+    int16_t *single_out = NULL,
+            *blocked_out = NULL;
+    size_t nr_single_out = 0,
+           nr_blocked_out = 0;
+    uint32_t lcg = 3;
+
+    TEST_ASSERT_OK(polyphase_fir_new(&single, sizeof(test_polyphase_fir_coeffs)/sizeof(int16_t),
+                test_polyphase_fir_coeffs, 3, 2));
+    TEST_ASSERT_OK(polyphase_fir_new(&blocked, sizeof(test_polyphase_fir_coeffs)/sizeof(int16_t),
+                test_polyphase_fir_coeffs, 3, 2));
+
+    TEST_ASSERT_OK(TCALLOC((void **)&single_out, TEST_POLYPHASE_OUT_SAMPLES, sizeof(int16_t)));
+    TEST_ASSERT_OK(TCALLOC((void **)&blocked_out, TEST_POLYPHASE_OUT_SAMPLES, sizeof(int16_t)));
+
+    for (size_t b = 0; b < TEST_POLYPHASE_NR_BUFS; b++) {
+        struct sample_buf *buf = NULL;
+        int16_t *samples = NULL;
+        size_t nr_out = 0,
+               nr_samples = TEST_POLYPHASE_BUF_SAMPLES - 29 * b;
+
+        TEST_ASSERT_OK(TCALLOC((void **)&buf, 1, sizeof(struct sample_buf) + nr_samples * sizeof(int16_t)));
+        buf->nr_samples = nr_samples;
+        buf->sample_type = COMPLEX_INT_16;
+        buf->release = _test_polyphase_fir_buf_release;
+        atomic_store(&buf->refcount, 2);
+
+        samples = (int16_t *)buf->data_buf;
+        for (size_t i = 0; i < nr_samples; i++) {
+            lcg = lcg * 1103515245 + 12345;
+            samples[i] = (int16_t)(lcg >> 16) >> 2;
+        }
+
+        TEST_ASSERT_OK(polyphase_fir_push_sample_buf(single, buf));
+        do {
+            TEST_ASSERT_OK(polyphase_fir_process(single, &single_out[nr_single_out], 1, &nr_out));
+            nr_single_out += nr_out;
+        } while (0 != nr_out);
+
+        TEST_ASSERT_OK(polyphase_fir_push_sample_buf(blocked, buf));
+        TEST_ASSERT_OK(polyphase_fir_process(blocked, &blocked_out[nr_blocked_out],
+                    TEST_POLYPHASE_OUT_SAMPLES - nr_blocked_out, &nr_out));
+        nr_blocked_out += nr_out;
+    }
+
+    TEST_ASSERT_EQUALS(nr_single_out, nr_blocked_out);
+    TEST_ASSERT_EQUALS(memcmp(single_out, blocked_out, nr_blocked_out * sizeof(int16_t)), 0);
+
+    TEST_ASSERT_OK(polyphase_fir_delete(&single));
+    TEST_ASSERT_OK(polyphase_fir_delete(&blocked));
+    TFREE(single_out);
+    TFREE(blocked_out);
+
+    return A_OK;
+}
+
+/**
+ * Pushing samples straight into the filter's history must give exactly the same outputs as
+ * pushing them in sample buffers, however the samples are split up.
+ */
+TEST_DECLARE_UNIT(test_push_samples_matches_buf, polyphase)
+{
+    struct polyphase_fir *from_buf = NULL,
+                         *from_samples = NULL;
+    struct sample_buf *buf = NULL;
+    static int16_t buf_out[TEST_POLYPHASE_BUF_SAMPLES * 2],
+                   samples_out[TEST_POLYPHASE_BUF_SAMPLES * 2];
+    int16_t *samples = NULL;
+    size_t nr_buf_out = 0,
+           nr_samples_out = 0,
+           offs = 0;
+    uint32_t lcg = 7;
+
+    TEST_ASSERT_OK(polyphase_fir_new(&from_buf, sizeof(test_polyphase_fir_coeffs)/sizeof(int16_t),
+                test_polyphase_fir_coeffs, 3, 2));
+    TEST_ASSERT_OK(polyphase_fir_new(&from_samples, sizeof(test_polyphase_fir_coeffs)/sizeof(int16_t),
+                test_polyphase_fir_coeffs, 3, 2));
+
+    TEST_ASSERT_OK(TCALLOC((void **)&buf, 1, sizeof(struct sample_buf) + TEST_POLYPHASE_BUF_SAMPLES * sizeof(int16_t)));
+    buf->nr_samples = TEST_POLYPHASE_BUF_SAMPLES;
+    buf->sample_type = COMPLEX_INT_16;
+    buf->release = _test_polyphase_fir_buf_release;
+    atomic_store(&buf->refcount, 2);
+
+    samples = (int16_t *)buf->data_buf;
+    for (size_t i = 0; i < TEST_POLYPHASE_BUF_SAMPLES; i++) {
+        lcg = lcg * 1103515245 + 12345;
+        samples[i] = (int16_t)(lcg >> 16) >> 2;
+    }
+
+    TEST_ASSERT_OK(polyphase_fir_push_sample_buf(from_buf, buf));
+    TEST_ASSERT_OK(polyphase_fir_process(from_buf, buf_out, sizeof(buf_out)/sizeof(buf_out[0]), &nr_buf_out));
+
+    /* Odd-sized pieces, running the filter after each one */
+    while (offs < TEST_POLYPHASE_BUF_SAMPLES) {
+        size_t nr = TEST_POLYPHASE_BUF_SAMPLES - offs < 37 ? TEST_POLYPHASE_BUF_SAMPLES - offs : 37,
+               nr_out = 0;
+
+        TEST_ASSERT_OK(polyphase_fir_push_samples(from_samples, &samples[offs], nr));
+        TEST_ASSERT_OK(polyphase_fir_process(from_samples, &samples_out[nr_samples_out],
+                    sizeof(samples_out)/sizeof(samples_out[0]) - nr_samples_out, &nr_out));
+        nr_samples_out += nr_out;
+        offs += nr;
+    }
+
+    TEST_ASSERT_EQUALS(nr_samples_out, nr_buf_out);
+    TEST_ASSERT_EQUALS(memcmp(samples_out, buf_out, nr_buf_out * sizeof(int16_t)), 0);
+
+    TEST_ASSERT_OK(polyphase_fir_delete(&from_buf));
+    TEST_ASSERT_OK(polyphase_fir_delete(&from_samples));
+    TFREE(buf);
+
+    return A_OK;
+}
+
+/**
+ * A halfband filter folds when only decimating, and leaves one nearly empty phase filter when
+ * interpolating by 2. Either way, the outputs must be exactly those of the whole filter.
+ */
+TEST_DECLARE_UNIT(test_halfband_matches_reference, polyphase)
+{
+    static const unsigned factors[][2] = { { 1, 2 }, { 2, 1 }, { 2, 3 } };
+    int16_t taps[TEST_POLYPHASE_HALFBAND_TAPS];
+    uint32_t lcg = 11;
+
+    /* Every other tap is zero, counting out from the middle one */
+    for (size_t i = 0; i <= TEST_POLYPHASE_HALFBAND_TAPS / 2; i++) {
+        int16_t c = 0;
+
+        lcg = lcg * 1103515245 + 12345;
+        c = (int16_t)(lcg >> 16) >> 4;
+
+        if (0 == (TEST_POLYPHASE_HALFBAND_TAPS / 2 - i) % 2 && TEST_POLYPHASE_HALFBAND_TAPS / 2 != i) {
+            c = 0;
+        }
+
+        taps[i] = c;
+        taps[TEST_POLYPHASE_HALFBAND_TAPS - 1 - i] = c;
+    }
+
+    for (size_t f = 0; f < sizeof(factors)/sizeof(factors[0]); f++) {
+        struct polyphase_fir *pfir = NULL;
+        struct sample_buf *buf = NULL;
+        int16_t *samples = NULL,
+                out[TEST_POLYPHASE_BUF_SAMPLES * 2];
+        unsigned interpolate = factors[f][0],
+                 decimate = factors[f][1];
+        size_t nr_out = 0;
+
+        TEST_ASSERT_OK(polyphase_fir_new(&pfir, TEST_POLYPHASE_HALFBAND_TAPS, taps, interpolate, decimate));
+
+        TEST_ASSERT_OK(TCALLOC((void **)&buf, 1, sizeof(struct sample_buf) + TEST_POLYPHASE_BUF_SAMPLES * sizeof(int16_t)));
+        buf->nr_samples = TEST_POLYPHASE_BUF_SAMPLES;
+        buf->sample_type = COMPLEX_INT_16;
+        buf->release = _test_polyphase_fir_buf_release;
+        atomic_store(&buf->refcount, 2);
+
+        samples = (int16_t *)buf->data_buf;
+        for (size_t i = 0; i < TEST_POLYPHASE_BUF_SAMPLES; i++) {
+            lcg = lcg * 1103515245 + 12345;
+            samples[i] = (int16_t)(lcg >> 16) >> 2;
+        }
+
+        TEST_ASSERT_OK(polyphase_fir_push_sample_buf(pfir, buf));
+        TEST_ASSERT_OK(polyphase_fir_process(pfir, out, sizeof(out)/sizeof(out[0]), &nr_out));
+        TEST_ASSERT_EQUALS(0 == nr_out, false);
+
+        /* Output n applies phase filter (n * D) % I, starting at input sample (n * D) / I */
+        for (size_t n = 0; n < nr_out; n++) {
+            size_t phase = (n * decimate) % interpolate,
+                   start = (n * decimate) / interpolate;
+            int32_t acc = 0;
+
+            for (size_t i = phase, j = 0; i < TEST_POLYPHASE_HALFBAND_TAPS; i += interpolate, j++) {
+                acc += (int32_t)taps[i] * samples[start + j];
+            }
+
+            TEST_ASSERT_EQUALS(out[n], round_q30_q15(acc));
+        }
+
+        TEST_ASSERT_OK(polyphase_fir_delete(&pfir));
+        TFREE(buf);
+    }
+
+    return A_OK;
+}
+
 TEST_DECLARE_SUITE(polyphase, test_polyphase_fir_cleanup, test_polyphase_fir_setup, NULL, NULL);
 
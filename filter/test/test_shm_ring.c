@@ -0,0 +1,165 @@
+#include <filter/shm_ring.h>
+
+#include <test/assert.h>
+#include <test/framework.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_SHM_RING_NR_BLOCKS         4
+#define TEST_SHM_RING_BLOCK_SAMPLES     100
+
+static
+char test_shm_ring_name[64];
+
+static
+aresult_t test_shm_ring_setup(void)
+{
+    snprintf(test_shm_ring_name, sizeof(test_shm_ring_name), "test-shm-ring-%d", (int)getpid());
+    return A_OK;
+}
+
+static
+aresult_t test_shm_ring_cleanup(void)
+{
+    return A_OK;
+}
+
+/**
+ * Write block number seq to the ring, filled with a pattern that depends on seq
+ */
+static
+aresult_t _test_shm_ring_write(struct shm_ring *ring, unsigned seq)
+{
+    int16_t samples[TEST_SHM_RING_BLOCK_SAMPLES];
+
+    for (size_t i = 0; i < TEST_SHM_RING_BLOCK_SAMPLES; i++) {
+        samples[i] = (int16_t)(seq * 1000 + i);
+    }
+
+    return shm_ring_write(ring, samples, (seq % TEST_SHM_RING_BLOCK_SAMPLES + 1) * sizeof(int16_t));
+}
+
+/**
+ * Check the next block read from the ring is block number seq
+ */
+static
+aresult_t _test_shm_ring_check(struct shm_ring_consumer *cons, unsigned seq, uint64_t nr_dropped)
+{
+    const int16_t *samples = NULL;
+    size_t nr_bytes = 0;
+    uint64_t dropped = 0;
+
+    TEST_ASSERT_OK(shm_ring_consumer_next(cons, (const void **)&samples, &nr_bytes, &dropped, 0));
+    TEST_ASSERT_NOT_NULL(samples);
+    TEST_ASSERT_EQUALS(dropped, nr_dropped);
+    TEST_ASSERT_EQUALS(nr_bytes, (seq % TEST_SHM_RING_BLOCK_SAMPLES + 1) * sizeof(int16_t));
+
+    for (size_t i = 0; i < nr_bytes / sizeof(int16_t); i++) {
+        TEST_ASSERT_EQUALS(samples[i], (int16_t)(seq * 1000 + i));
+    }
+
+    TEST_ASSERT_OK(shm_ring_consumer_release(cons));
+
+    return A_OK;
+}
+
+/**
+ * Blocks are read back in order, in place, and a consumer only sees blocks written after it
+ * attached.
+ */
+TEST_DECLARE_UNIT(test_in_order, shm_ring)
+{
+    struct shm_ring *ring = NULL;
+    struct shm_ring_consumer *cons = NULL;
+    const void *samples = NULL;
+    size_t nr_bytes = 0;
+    uint64_t dropped = 0;
+
+    TEST_ASSERT_OK(shm_ring_new(&ring, test_shm_ring_name, SHM_RING_SAMPLE_REAL_INT_16, 16000,
+                TEST_SHM_RING_BLOCK_SAMPLES * sizeof(int16_t), TEST_SHM_RING_NR_BLOCKS));
+    TEST_ASSERT_OK(_test_shm_ring_write(ring, 0));
+
+    TEST_ASSERT_OK(shm_ring_consumer_new(&cons, test_shm_ring_name));
+    TEST_ASSERT_EQUALS(shm_ring_consumer_sample_type(cons), SHM_RING_SAMPLE_REAL_INT_16);
+    TEST_ASSERT_EQUALS(shm_ring_consumer_sample_rate(cons), 16000);
+
+    /* Nothing new yet */
+    TEST_ASSERT_OK(shm_ring_consumer_next(cons, &samples, &nr_bytes, &dropped, 0));
+    TEST_ASSERT_EQUALS(samples, NULL);
+
+    for (unsigned i = 1; i <= 10; i++) {
+        TEST_ASSERT_OK(_test_shm_ring_write(ring, i));
+        TEST_ASSERT_OK(_test_shm_ring_check(cons, i, 0));
+    }
+
+    TEST_ASSERT_EQUALS(shm_ring_consumer_nr_dropped(cons), 0);
+
+    /* Once the producer goes away, the consumer finds out */
+    TEST_ASSERT_OK(shm_ring_delete(&ring));
+    TEST_ASSERT_EQUALS(shm_ring_consumer_next(cons, &samples, &nr_bytes, &dropped, 1000000), A_E_DONE);
+    TEST_ASSERT_OK(shm_ring_consumer_delete(&cons));
+
+    return A_OK;
+}
+
+/**
+ * A consumer that falls behind skips to the oldest block that is safe to read, and is told how
+ * many it missed. A block written over while it's being read is reported at release.
+ */
+TEST_DECLARE_UNIT(test_lapped, shm_ring)
+{
+    struct shm_ring *ring = NULL,
+                    *stale = NULL;
+    struct shm_ring_consumer *cons = NULL;
+    const void *samples = NULL;
+    size_t nr_bytes = 0;
+    uint64_t dropped = 0;
+
+    TEST_ASSERT_OK(shm_ring_new(&ring, test_shm_ring_name, SHM_RING_SAMPLE_COMPLEX_INT_16, 250000,
+                TEST_SHM_RING_BLOCK_SAMPLES * sizeof(int16_t), TEST_SHM_RING_NR_BLOCKS));
+    TEST_ASSERT_OK(shm_ring_consumer_new(&cons, test_shm_ring_name));
+
+    for (unsigned i = 0; i < 10; i++) {
+        TEST_ASSERT_OK(_test_shm_ring_write(ring, i));
+    }
+
+    /* Blocks 0 through 6 are gone, and 7 is the oldest one not about to be written over */
+    TEST_ASSERT_OK(_test_shm_ring_check(cons, 7, 7));
+    TEST_ASSERT_OK(_test_shm_ring_check(cons, 8, 0));
+
+    TEST_ASSERT_OK(shm_ring_consumer_next(cons, &samples, &nr_bytes, &dropped, 0));
+    TEST_ASSERT_NOT_NULL(samples);
+
+    for (unsigned i = 10; i < 10 + TEST_SHM_RING_NR_BLOCKS; i++) {
+        TEST_ASSERT_OK(_test_shm_ring_write(ring, i));
+    }
+
+    TEST_ASSERT_EQUALS(shm_ring_consumer_release(cons), A_E_BUSY);
+    TEST_ASSERT_EQUALS(shm_ring_consumer_nr_dropped(cons), 8);
+
+    TEST_ASSERT_OK(_test_shm_ring_check(cons, 11, 1));
+
+    /* A new producer by the same name closes the ring out from under the old consumer */
+    stale = ring;
+    TEST_ASSERT_OK(shm_ring_new(&ring, test_shm_ring_name, SHM_RING_SAMPLE_COMPLEX_INT_16, 250000,
+                TEST_SHM_RING_BLOCK_SAMPLES * sizeof(int16_t), TEST_SHM_RING_NR_BLOCKS));
+    TEST_ASSERT_OK(_test_shm_ring_check(cons, 12, 0));
+    TEST_ASSERT_OK(_test_shm_ring_check(cons, 13, 0));
+    TEST_ASSERT_EQUALS(shm_ring_consumer_next(cons, &samples, &nr_bytes, &dropped, 0), A_E_DONE);
+    TEST_ASSERT_OK(shm_ring_consumer_delete(&cons));
+
+    /* Getting rid of the old producer leaves the new ring alone */
+    TEST_ASSERT_OK(shm_ring_delete(&stale));
+    TEST_ASSERT_OK(shm_ring_consumer_new(&cons, test_shm_ring_name));
+    TEST_ASSERT_OK(_test_shm_ring_write(ring, 20));
+    TEST_ASSERT_OK(_test_shm_ring_check(cons, 20, 0));
+
+    TEST_ASSERT_OK(shm_ring_consumer_delete(&cons));
+    TEST_ASSERT_OK(shm_ring_delete(&ring));
+
+    return A_OK;
+}
+
+TEST_DECLARE_SUITE(shm_ring, test_shm_ring_cleanup, test_shm_ring_setup, NULL, NULL);
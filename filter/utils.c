@@ -22,96 +22,105 @@
 
 #include <filter/utils.h>
 #include <filter/filter_priv.h>
-#include <filter/sample_buf.h>
 #include <filter/complex.h>
+#include <filter/kernels.h>
+#include <filter/kernels_priv.h>
 
 #include <tsl/errors.h>
 #include <tsl/diag.h>
 #include <tsl/assert.h>
 
+FILTER_ALWAYS_INLINE
+void _dot_real_body(const int16_t *restrict samples, const int16_t *restrict coeffs, size_t nr_coeffs,
+        int32_t *pacc)
+{
+    int32_t acc = 0;
+
+    for (size_t i = 0; i < nr_coeffs; i++) {
+        acc += (int32_t)samples[i] * coeffs[i];
+    }
+
+    *pacc = acc;
+}
+
+void dot_real_scalar(const int16_t *samples, const int16_t *coeffs, size_t nr_coeffs, int32_t *pacc)
+{
+    _dot_real_body(samples, coeffs, nr_coeffs, pacc);
+}
+
+FILTER_ALWAYS_INLINE
+void _dot_real_block_body(const int16_t *const *samples, const int16_t *const *coeffs, size_t nr_coeffs,
+        int32_t *acc)
+{
+    const int16_t *restrict s0 = samples[0], *restrict c0 = coeffs[0],
+                  *restrict s1 = samples[1], *restrict c1 = coeffs[1],
+                  *restrict s2 = samples[2], *restrict c2 = coeffs[2],
+                  *restrict s3 = samples[3], *restrict c3 = coeffs[3];
+    int32_t a0 = 0,
+            a1 = 0,
+            a2 = 0,
+            a3 = 0;
+
+    /* Four independent accumulator chains, sharing the loop and the final reduction */
+    for (size_t i = 0; i < nr_coeffs; i++) {
+        a0 += (int32_t)s0[i] * c0[i];
+        a1 += (int32_t)s1[i] * c1[i];
+        a2 += (int32_t)s2[i] * c2[i];
+        a3 += (int32_t)s3[i] * c3[i];
+    }
+
+    acc[0] = a0;
+    acc[1] = a1;
+    acc[2] = a2;
+    acc[3] = a3;
+}
+
+void dot_real_block_scalar(const int16_t *const *samples, const int16_t *const *coeffs, size_t nr_coeffs,
+        int32_t *acc)
+{
+    _dot_real_block_body(samples, coeffs, nr_coeffs, acc);
+}
+
+#ifdef _FILTER_HAVE_X86_KERNELS
+FILTER_DEFINE_X86_VARIANTS(dot_real,
+        (const int16_t *samples, const int16_t *coeffs, size_t nr_coeffs, int32_t *pacc),
+        (samples, coeffs, nr_coeffs, pacc))
+FILTER_DEFINE_X86_VARIANTS(dot_real_block,
+        (const int16_t *const *samples, const int16_t *const *coeffs, size_t nr_coeffs, int32_t *acc),
+        (samples, coeffs, nr_coeffs, acc))
+#endif /* defined(_FILTER_HAVE_X86_KERNELS) */
+
 /**
- * Compute the dot product of samples spread across a zero-copy buffer with a coefficient vector.
+ * Compute the dot product of a linear span of samples with a coefficient vector.
  *
  * All inputs and outputs from this function are real-valued (i.e. baseband).
  *
- * \param sb_active The current sample buffer. Must never be NULL.
- * \param sb_next The "next" sample buffer. Must not be NULL if sb_active has fewer than nr_coeffs samples in it.
- * \param buf_start_offset The start offset, in samples, from the start of sb_active to the sample to be dotted starting from.
- * \param coeffs The coefficients to be dotted with samples in sb_active, sb_next. All real-valued.
+ * \param samples The samples. There must be at least nr_coeffs samples.
+ * \param coeffs The coefficients to be dotted with the samples. All real-valued.
  * \param nr_coeffs The number of coefficients in the coeffs vector.
  * \param psample The resultant sample. Returned by reference.
  *
  * \return A_OK on success, an error code otherwise.
  */
-aresult_t dot_product_sample_buffers_real(
-        struct sample_buf *sb_active,
-        struct sample_buf *sb_next,
-        size_t buf_start_offset,
-        int16_t *coeffs,
+aresult_t dot_product_real(
+        const int16_t *restrict samples,
+        const int16_t *restrict coeffs,
         size_t nr_coeffs,
         int16_t *psample)
 {
     aresult_t ret = A_OK;
 
     int32_t acc_res = 0;
-    size_t coeffs_remain = 0,
-           buf_offset = 0;
-    struct sample_buf *cur_buf = NULL;
 
-    TSL_ASSERT_ARG_DEBUG(NULL != sb_active);
+    TSL_ASSERT_ARG_DEBUG(NULL != samples);
     TSL_ASSERT_ARG_DEBUG(NULL != coeffs);
     TSL_ASSERT_ARG_DEBUG(0 != nr_coeffs);
     TSL_ASSERT_ARG_DEBUG(NULL != psample);
 
-    coeffs_remain = nr_coeffs;
-    cur_buf = sb_active;
-    buf_offset = buf_start_offset;
-
-    /* Check if we have enough samples available
-     * TODO: we should check if there are enough samples in the following buffer, too.
-     */
-    if (buf_offset + nr_coeffs > sb_active->nr_samples && sb_next == NULL) {
-        ret = A_E_DONE;
-        goto done;
-    }
-
-    /* Walk the number of samples in the current buffer up to the filter size */
-    do {
-        /* Figure out how many samples to pull out */
-        size_t nr_samples_in = cur_buf->nr_samples - buf_offset,
-               start_coeff = nr_coeffs - coeffs_remain;
-
-        /* Snap to either the number of coefficients in the FIR or the number of remaining
-         * coefficients, whichever is smaller.
-         */
-        nr_samples_in = BL_MIN2(nr_samples_in, coeffs_remain);
-
-        for (size_t i = 0; i < nr_samples_in; i++) {
-#ifdef _TSL_DEBUG
-            TSL_BUG_ON(i + start_coeff >= nr_coeffs);
-            TSL_BUG_ON(i + buf_offset >= cur_buf->nr_samples);
-#endif /* defined(_TSL_DEBUG) */
-
-            int32_t sample = ((int16_t *)cur_buf->data_buf)[buf_offset + i],
-                    coeff = coeffs[start_coeff + i];
-
-            acc_res += sample * coeff;
-        }
-
-        /* If we iterate through, we'll start at the beginning of the next buffer */
-        buf_offset = 0;
-        coeffs_remain -= nr_samples_in;
-#ifdef _TSL_DEBUG
-        /* Check if we have coefficients remaining to process */
-        TSL_BUG_ON(cur_buf == sb_next && coeffs_remain != 0);
-#endif
-        cur_buf = sb_next;
-    } while (coeffs_remain != 0);
+    filter_kernels->dot_real(samples, coeffs, nr_coeffs, &acc_res);
 
     /* Return the computed sample, in Q.15 (currently in Q.30 due to the prior multiplications) */
     *psample = round_q30_q15(acc_res);
 
-done:
     return ret;
 }
-
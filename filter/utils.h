@@ -4,9 +4,7 @@
 
 #include <stdint.h>
 
-struct sample_buf;
+#include <stddef.h>
 
-aresult_t dot_product_sample_buffers_real(struct sample_buf *sb_active,
-        struct sample_buf *sb_next, size_t buf_start_offset,
-        int16_t *coeffs, size_t nr_coeffs, int16_t *psample);
+aresult_t dot_product_real(const int16_t *samples, const int16_t *coeffs, size_t nr_coeffs, int16_t *psample);
 
@@ -0,0 +1,229 @@
+/*
+ *  msg_json.c - Format decoded pager and AIS messages as JSON
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <msgfmt/msg_json.h>
+
+#include <pager/pager_flex.h>
+
+#include <ais/ais_decode.h>
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+static const
+char _msg_json_phase_id[] = {
+    [0] = 'A',
+    [1] = 'B',
+    [2] = 'C',
+    [3] = 'D',
+};
+
+/**
+ * Write a string out as the body of a JSON string
+ */
+static
+void _msg_json_put_string(FILE *fp, const char *str, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        char ch = str[i];
+
+        switch (ch) {
+        case '\n':
+        case '\r':
+            fputs("\\n", fp);
+            break;
+        case '\"':
+            fputs("\\\"", fp);
+            break;
+        case '\\':
+            fputs("\\\\", fp);
+            break;
+        case '/':
+            fputs("\\/", fp);
+            break;
+        case '\b':
+            fputs("<BKSP>", fp);
+            break;
+        case '\f':
+            fputs("<FF>", fp);
+            break;
+        case '\t':
+            fputs("\\t", fp);
+            break;
+        case 0x03:
+        case 0x04:
+        case 0x17:
+            fputc(' ', fp);
+            break;
+        default:
+            if (isprint(ch)) {
+                fputc(ch, fp);
+            } else {
+                fprintf(fp, "\\u%04x", (unsigned)(uint8_t)ch);
+            }
+        }
+    }
+}
+
+/**
+ * Start a message: take the file for this thread, so messages from different threads can't
+ * interleave, and write out the fields every message has.
+ */
+static
+void _msg_json_begin(FILE *fp, uint32_t freq_hz, const char *proto, const char *type)
+{
+    time_t now = time(NULL);
+    struct tm gmt;
+
+    /* TODO: this sucks, should move it closer to the capture clock */
+    gmtime_r(&now, &gmt);
+
+    flockfile(fp);
+
+    fprintf(fp, "{\"proto\":\"%s\",\"type\":\"%s\",\"timestamp\":\"%04i-%02i-%02i %02i:%02i:%02i UTC\"",
+            proto, type, gmt.tm_year + 1900, gmt.tm_mon + 1, gmt.tm_mday, gmt.tm_hour, gmt.tm_min, gmt.tm_sec);
+
+    if (0 != freq_hz) {
+        fprintf(fp, ",\"freqHz\":%u", freq_hz);
+    }
+}
+
+/**
+ * Finish a message, and give the file back
+ */
+static
+void _msg_json_end(FILE *fp)
+{
+    fputs("}\n", fp);
+    fflush(fp);
+    funlockfile(fp);
+}
+
+void msg_json_flex_alnum(FILE *fp, uint32_t freq_hz, uint16_t baud, uint8_t phase, uint8_t cycle_no,
+        uint8_t frame_no, uint64_t cap_code, bool fragmented, bool maildrop, uint8_t seq_num,
+        const char *message, size_t message_len)
+{
+    _msg_json_begin(fp, freq_hz, "flex", "alphanumeric");
+
+    fprintf(fp, ",\"baud\":%i,\"syncLevel\":%i,\"frameNo\":%u,\"cycleNo\":%u,\"phaseNo\":\"%c\",\"capCode\":%"PRIu64","
+            "\"fragment\":%s,\"maildrop\":%s,\"fragSeq\":%u,\"message\":\"",
+            baud, 0, frame_no, cycle_no, _msg_json_phase_id[phase], cap_code,
+            fragmented ? "true" : "false", maildrop ? "true" : "false", seq_num);
+    _msg_json_put_string(fp, message, message_len);
+    fputc('\"', fp);
+
+    _msg_json_end(fp);
+}
+
+void msg_json_flex_num(FILE *fp, uint32_t freq_hz, uint16_t baud, uint8_t phase, uint8_t cycle_no,
+        uint8_t frame_no, uint64_t cap_code, const char *message, size_t message_len)
+{
+    _msg_json_begin(fp, freq_hz, "flex", "numeric");
+
+    fprintf(fp, ",\"baud\":%i,\"syncLevel\":%i,\"frameNo\":%u,\"cycleNo\":%u,\"phaseNo\":\"%c\",\"capCode\":%"PRIu64","
+            "\"message\":\"",
+            baud, 0, frame_no, cycle_no, _msg_json_phase_id[phase], cap_code);
+    _msg_json_put_string(fp, message, message_len);
+    fputc('\"', fp);
+
+    _msg_json_end(fp);
+}
+
+void msg_json_flex_siv(FILE *fp, uint32_t freq_hz, uint16_t baud, uint8_t phase, uint8_t cycle_no,
+        uint8_t frame_no, uint64_t cap_code, uint8_t siv_msg_type, uint32_t data)
+{
+    switch (siv_msg_type) {
+    case PAGER_FLEX_SIV_TEMP_ADDRESS_ACTIVATION:
+        _msg_json_begin(fp, freq_hz, "flex", "tempAddrActivation");
+        fprintf(fp, ",\"baud\":%i,\"syncLevel\":%i,\"frameNo\":%u,\"cycleNo\":%u,\"phaseNo\":\"%c\",\"capCode\":%"PRIu64","
+                "\"startFrameNo\":%u,\"tempAddressId\":%u",
+                baud, 0, frame_no, cycle_no, _msg_json_phase_id[phase], cap_code, data & 0x7f, (data >> 7) & 0xf);
+        _msg_json_end(fp);
+        break;
+    }
+}
+
+void msg_json_pocsag(FILE *fp, uint32_t freq_hz, bool alnum, uint16_t baud_rate, uint32_t capcode,
+        const char *data, size_t data_len, uint8_t function)
+{
+    _msg_json_begin(fp, freq_hz, "pocsag", true == alnum ? "alphanumeric" : "numeric");
+
+    fprintf(fp, ",\"baud\":%i,\"capCode\":%u,\"function\":%u,\"message\":\"",
+            baud_rate, capcode, (unsigned)function);
+    _msg_json_put_string(fp, data, data_len);
+    fputc('\"', fp);
+
+    _msg_json_end(fp);
+}
+
+void msg_json_ais_position_report(FILE *fp, uint32_t freq_hz, const struct ais_position_report *pr,
+        const char *raw_msg)
+{
+    _msg_json_begin(fp, freq_hz, "ais", "positionReport");
+
+    fprintf(fp, ",\"mmsi\":%u,\"navStat\":%u,\"rateOfTurn\":%d,\"speedOverGround\":%f,\"positionAcc\":%u,"
+            "\"geoPosition\":{\"lon\":%f,\"lat\":%f},\"course\":%u,\"heading\":%u,\"seconds\":%u,\"rawAscii\":\"",
+            pr->mmsi, pr->nav_stat, pr->rate_of_turn, (double)pr->speed_over_ground, pr->position_acc,
+            (double)pr->longitude, (double)pr->latitude, pr->course, pr->heading, pr->timestamp);
+    _msg_json_put_string(fp, raw_msg, strlen(raw_msg));
+    fputc('\"', fp);
+
+    _msg_json_end(fp);
+}
+
+void msg_json_ais_base_station_report(FILE *fp, uint32_t freq_hz, const struct ais_base_station_report *br,
+        const char *raw_msg)
+{
+    _msg_json_begin(fp, freq_hz, "ais", "baseStationReport");
+
+    fprintf(fp, ",\"mmsi\":%u,\"baseStationDate\":\"%04u-%02u-%02u %02u:%02u:%02u UTC\","
+            "\"geoPosition\":{\"lon\":%f,\"lat\":%f},\"fixType\":\"%s\",\"rawAscii\":\"",
+            br->mmsi, br->year, br->month, br->day, br->hour, br->minute, br->second,
+            (double)br->longitude, (double)br->latitude, br->epfd_name);
+    _msg_json_put_string(fp, raw_msg, strlen(raw_msg));
+    fputc('\"', fp);
+
+    _msg_json_end(fp);
+}
+
+void msg_json_ais_static_voyage_data(FILE *fp, uint32_t freq_hz, const struct ais_static_voyage_data *svd,
+        const char *raw_msg)
+{
+    _msg_json_begin(fp, freq_hz, "ais", "staticAndVoyageData");
+
+    fprintf(fp, ",\"mmsi\":%u,\"version\":%u,\"imoNumber\":%u,\"callsign\":\"", svd->mmsi, svd->version, svd->imo_number);
+    _msg_json_put_string(fp, svd->callsign, strnlen(svd->callsign, sizeof(svd->callsign)));
+    fputs("\",\"shipName\":\"", fp);
+    _msg_json_put_string(fp, svd->ship_name, strnlen(svd->ship_name, sizeof(svd->ship_name)));
+    fprintf(fp, "\",\"shipType\":%u,\"dimensions\":{\"toBow\":%u,\"toStern\":%u,\"toPort\":%u,\"toStarboard\":%u},"
+            "\"fixType\":\"%s\",\"eta\":\"%02u-%02u %02u:%02u\",\"draught\":%f,\"destination\":\"",
+            svd->ship_type, svd->dim_to_bow, svd->dim_to_stern, svd->dim_to_port, svd->dim_to_starboard,
+            svd->epfd_name, svd->eta_month, svd->eta_day, svd->eta_hour, svd->eta_minute, (double)svd->draught);
+    _msg_json_put_string(fp, svd->destination, strnlen(svd->destination, sizeof(svd->destination)));
+    fputs("\",\"rawAscii\":\"", fp);
+    _msg_json_put_string(fp, raw_msg, strlen(raw_msg));
+    fputc('\"', fp);
+
+    _msg_json_end(fp);
+}
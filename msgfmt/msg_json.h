@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct ais_position_report;
+struct ais_base_station_report;
+struct ais_static_voyage_data;
+
+/**
+ * Every message is written out as a single line of JSON, and flushed. The file is locked while
+ * a message is being written, so messages from different threads sharing a file can't
+ * interleave.
+ *
+ * If freq_hz is non-zero, it is reported in the message as "freqHz", so messages from decoders
+ * running on different channels can be told apart.
+ */
+
+/**
+ * Write out a FLEX alphanumeric message.
+ *
+ * \param fp The file to write the message to
+ * \param freq_hz The frequency the message was received on, or 0 to leave it out
+ * \param baud The baud rate of the message
+ * \param phase The phase the message was received in, 0 through 3
+ * \param cycle_no The cycle number
+ * \param frame_no The frame number
+ * \param cap_code The capcode the message was addressed to
+ * \param fragmented Whether or not this is a fragment of a longer message
+ * \param maildrop Whether or not the maildrop flag was set
+ * \param seq_num The fragment sequence number
+ * \param message The message text
+ * \param message_len The length of the message text, in bytes
+ */
+void msg_json_flex_alnum(FILE *fp, uint32_t freq_hz, uint16_t baud, uint8_t phase, uint8_t cycle_no,
+        uint8_t frame_no, uint64_t cap_code, bool fragmented, bool maildrop, uint8_t seq_num,
+        const char *message, size_t message_len);
+
+/**
+ * Write out a FLEX numeric message.
+ *
+ * \param fp The file to write the message to
+ * \param freq_hz The frequency the message was received on, or 0 to leave it out
+ * \param baud The baud rate of the message
+ * \param phase The phase the message was received in, 0 through 3
+ * \param cycle_no The cycle number
+ * \param frame_no The frame number
+ * \param cap_code The capcode the message was addressed to
+ * \param message The message digits
+ * \param message_len The length of the message, in bytes
+ */
+void msg_json_flex_num(FILE *fp, uint32_t freq_hz, uint16_t baud, uint8_t phase, uint8_t cycle_no,
+        uint8_t frame_no, uint64_t cap_code, const char *message, size_t message_len);
+
+/**
+ * Write out a FLEX short instruction vector. Only temporary address activations are reported;
+ * other instruction types are ignored.
+ *
+ * \param fp The file to write the message to
+ * \param freq_hz The frequency the message was received on, or 0 to leave it out
+ * \param baud The baud rate of the message
+ * \param phase The phase the message was received in, 0 through 3
+ * \param cycle_no The cycle number
+ * \param frame_no The frame number
+ * \param cap_code The capcode the message was addressed to
+ * \param siv_msg_type The type of the short instruction vector, PAGER_FLEX_SIV_*
+ * \param data The body of the short instruction vector
+ */
+void msg_json_flex_siv(FILE *fp, uint32_t freq_hz, uint16_t baud, uint8_t phase, uint8_t cycle_no,
+        uint8_t frame_no, uint64_t cap_code, uint8_t siv_msg_type, uint32_t data);
+
+/**
+ * Write out a POCSAG message.
+ *
+ * \param fp The file to write the message to
+ * \param freq_hz The frequency the message was received on, or 0 to leave it out
+ * \param alnum true if this is an alphanumeric message, false if it is numeric
+ * \param baud_rate The baud rate of the message
+ * \param capcode The capcode the message was addressed to
+ * \param data The message
+ * \param data_len The length of the message, in bytes
+ * \param function The function bits of the address codeword
+ */
+void msg_json_pocsag(FILE *fp, uint32_t freq_hz, bool alnum, uint16_t baud_rate, uint32_t capcode,
+        const char *data, size_t data_len, uint8_t function);
+
+/**
+ * Write out an AIS position report.
+ *
+ * \param fp The file to write the message to
+ * \param freq_hz The frequency the message was received on, or 0 to leave it out
+ * \param pr The position report
+ * \param raw_msg The raw message, ASCII armored
+ */
+void msg_json_ais_position_report(FILE *fp, uint32_t freq_hz, const struct ais_position_report *pr,
+        const char *raw_msg);
+
+/**
+ * Write out an AIS base station report.
+ *
+ * \param fp The file to write the message to
+ * \param freq_hz The frequency the message was received on, or 0 to leave it out
+ * \param br The base station report
+ * \param raw_msg The raw message, ASCII armored
+ */
+void msg_json_ais_base_station_report(FILE *fp, uint32_t freq_hz, const struct ais_base_station_report *br,
+        const char *raw_msg);
+
+/**
+ * Write out an AIS static and voyage related data message.
+ *
+ * \param fp The file to write the message to
+ * \param freq_hz The frequency the message was received on, or 0 to leave it out
+ * \param svd The static and voyage data
+ * \param raw_msg The raw message, ASCII armored
+ */
+void msg_json_ais_static_voyage_data(FILE *fp, uint32_t freq_hz, const struct ais_static_voyage_data *svd,
+        const char *raw_msg);
@@ -2,6 +2,7 @@
 #include <multifm/receiver.h>
 #include <multifm/multifm.h>
 
+#include <filter/convert.h>
 #include <filter/sample_buf.h>
 
 #include <config/engine.h>
@@ -12,8 +13,6 @@
 
 #include <libdespairspy/airspy.h>
 
-#include <string.h>
-
 static
 aresult_t _airspy_worker_thread_delete(struct receiver *rx)
 {
@@ -64,9 +63,9 @@ int _airspy_on_sample_block(struct airspy_device *dev, void *ctx, airspy_transfe
 
     DIAG("Received %u samples", transfer->sample_count);
 
-    /* TODO: for now, just memcpy to the output */
-    memcpy(sbuf->data_buf, transfer->samples, transfer->sample_count * sizeof(int16_t) * 2);
-    sbuf->nr_samples = transfer->sample_count;
+    /* libairspy hands over float samples, full scale at +/-1.0 */
+    TSL_BUG_IF_FAILED(receiver_sample_buf_fill(&thr->rx, sbuf, CONVERT_FORMAT_CF32, transfer->samples,
+                transfer->sample_count));
 
     /* Something has gone very wrong... */
     if (FAILED(receiver_sample_buf_deliver(&thr->rx, sbuf))) {
@@ -190,6 +189,13 @@ aresult_t airspy_worker_thread_new(struct receiver **pthr, struct config *cfg)
         }
     }
 
+    /* Ask for the format we convert from, rather than relying on the library's default */
+    if (0 != airspy_set_sample_type(dev, AIRSPY_SAMPLE_FLOAT32_IQ)) {
+        MFM_MSG(SEV_FATAL, "BAD-SAMPLE-TYPE", "Unable to set the sample type, aborting.");
+        ret = A_E_INVAL;
+        goto done;
+    }
+
     /* Set the sample rate, as requested */
     if (0 != airspy_set_samplerate(dev, sample_rate)) {
         MFM_MSG(SEV_FATAL, "BAD-SAMPLE-RATE", "Unable to set sampling rate to %d Hz, aborting.",
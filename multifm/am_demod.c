@@ -0,0 +1,141 @@
+#include <multifm/am_demod.h>
+#include <multifm/demod_base.h>
+
+#include <filter/filter.h>
+#include <filter/dc_blocker.h>
+
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+#include <tsl/safe_alloc.h>
+
+#include <math.h>
+
+/**
+ * Where the DC blocker's pole sits, the same as the resampler's DC blocker
+ */
+#define AM_DEMOD_DC_POLE                0.9999
+
+struct multifm_am_demod {
+    struct demod_base demod;
+    struct dc_blocker dc;
+};
+
+aresult_t multifm_am_demod_init(struct demod_base **pdemod, const struct demod_params *params)
+{
+    aresult_t ret = A_OK;
+
+    struct multifm_am_demod *demod = NULL;
+
+    TSL_ASSERT_ARG(NULL != pdemod);
+    TSL_ASSERT_ARG(NULL != params);
+    *pdemod = NULL;
+
+    TSL_BUG_IF_FAILED(TZAALLOC(demod, SYS_CACHE_LINE_LENGTH));
+
+    demod->demod.output_type = DEMOD_OUTPUT_REAL_INT_16;
+    TSL_BUG_IF_FAILED(dc_blocker_init(&demod->dc, AM_DEMOD_DC_POLE));
+
+    *pdemod = &demod->demod;
+
+    return ret;
+}
+
+/**
+ * Convert a magnitude in Q.15 units to a PCM sample. A full scale sample on both I and Q has a
+ * magnitude past full scale, so it has to saturate.
+ */
+static inline
+int16_t _am_demod_envelope(float mag)
+{
+    return mag >= (float)INT16_MAX ? INT16_MAX : (int16_t)(mag + 0.5f);
+}
+
+aresult_t multifm_am_demod_process(struct demod_base *demod, const int16_t *in_samples, size_t nr_in_samples,
+        void *out, size_t *pnr_out_samples, size_t *pnr_out_bytes)
+{
+    aresult_t ret = A_OK;
+
+    struct multifm_am_demod *dam = NULL;
+    int16_t *out_samples = out;
+
+    TSL_ASSERT_ARG(NULL != demod);
+    TSL_ASSERT_ARG(NULL != in_samples);
+    TSL_ASSERT_ARG(0 != nr_in_samples);
+    TSL_ASSERT_ARG(NULL != out);
+    TSL_ASSERT_ARG(NULL != pnr_out_samples);
+
+    dam = BL_CONTAINER_OF(demod, struct multifm_am_demod, demod);
+
+    for (size_t i = 0; i < nr_in_samples; i++) {
+        float re = in_samples[2 * i    ],
+              im = in_samples[2 * i + 1];
+
+        out_samples[i] = _am_demod_envelope(sqrtf(re * re + im * im));
+    }
+
+    TSL_BUG_IF_FAILED(dc_blocker_apply(&dam->dc, out_samples, nr_in_samples));
+
+    *pnr_out_samples = nr_in_samples;
+    *pnr_out_bytes = nr_in_samples * sizeof(int16_t);
+
+    return ret;
+}
+
+aresult_t multifm_am_demod_process_f32(struct demod_base *demod, const float *in_samples, size_t nr_in_samples,
+        void *out, size_t *pnr_out_samples, size_t *pnr_out_bytes)
+{
+    aresult_t ret = A_OK;
+
+    static const float to_q15 = (float)(1 << Q_15_SHIFT);
+    struct multifm_am_demod *dam = NULL;
+    int16_t *out_samples = out;
+
+    TSL_ASSERT_ARG(NULL != demod);
+    TSL_ASSERT_ARG(NULL != in_samples);
+    TSL_ASSERT_ARG(0 != nr_in_samples);
+    TSL_ASSERT_ARG(NULL != out);
+    TSL_ASSERT_ARG(NULL != pnr_out_samples);
+
+    dam = BL_CONTAINER_OF(demod, struct multifm_am_demod, demod);
+
+    for (size_t i = 0; i < nr_in_samples; i++) {
+        float re = in_samples[2 * i    ],
+              im = in_samples[2 * i + 1];
+
+        out_samples[i] = _am_demod_envelope(sqrtf(re * re + im * im) * to_q15);
+    }
+
+    TSL_BUG_IF_FAILED(dc_blocker_apply(&dam->dc, out_samples, nr_in_samples));
+
+    *pnr_out_samples = nr_in_samples;
+    *pnr_out_bytes = nr_in_samples * sizeof(int16_t);
+
+    return ret;
+}
+
+aresult_t multifm_am_demod_cleanup(struct demod_base **pdemod)
+{
+    aresult_t ret = A_OK;
+
+    struct multifm_am_demod *demod = NULL;
+
+    TSL_ASSERT_ARG(NULL != pdemod);
+    TSL_ASSERT_ARG(NULL != *pdemod);
+
+    demod = BL_CONTAINER_OF(*pdemod, struct multifm_am_demod, demod);
+
+    TFREE(demod);
+
+    *pdemod = NULL;
+
+    return ret;
+}
+
+const struct demod_ops multifm_am_demod_ops = {
+    .name = "am",
+    .init = multifm_am_demod_init,
+    .process = multifm_am_demod_process,
+    .process_f32 = multifm_am_demod_process_f32,
+    .cleanup = multifm_am_demod_cleanup,
+};
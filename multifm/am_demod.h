@@ -0,0 +1,39 @@
+#pragma once
+
+#include <multifm/demod_base.h>
+
+#include <tsl/result.h>
+
+/**
+ * AM Demodulator
+ *
+ * An envelope detector: writes out the magnitude of each complex sample as real 16-bit PCM,
+ * with the carrier's DC taken out by a DC blocker.
+ */
+
+/**
+ * Initialize a new AM demodulator
+ */
+aresult_t multifm_am_demod_init(struct demod_base **pdemod, const struct demod_params *params);
+
+/**
+ * Detect the envelope of interleaved Q.15 I/Q samples
+ */
+aresult_t multifm_am_demod_process(struct demod_base *demod, const int16_t *in_samples, size_t nr_in_samples,
+        void *out, size_t *pnr_out_samples, size_t *pnr_out_bytes);
+
+/**
+ * Detect the envelope of interleaved float I/Q samples
+ */
+aresult_t multifm_am_demod_process_f32(struct demod_base *demod, const float *in_samples, size_t nr_in_samples,
+        void *out, size_t *pnr_out_samples, size_t *pnr_out_bytes);
+
+/**
+ * Cleanup the resources used by the AM demodulator
+ */
+aresult_t multifm_am_demod_cleanup(struct demod_base **pdemod);
+
+/**
+ * The AM demodulator's operations, registered as "am"
+ */
+extern const struct demod_ops multifm_am_demod_ops;
@@ -0,0 +1,286 @@
+/*
+ *  broadcast_ring.c - Lock-free single producer, multiple consumer broadcast ring
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <multifm/broadcast_ring.h>
+
+#include <tsl/safe_alloc.h>
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include <limits.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * A consumer's cursor, on its own cache line so consumers don't contend with each other
+ */
+struct broadcast_ring_cursor {
+    /**
+     * The sequence number of the next item this consumer will read
+     */
+    _Atomic uint64_t next CAL_CACHE_ALIGNED;
+};
+
+struct broadcast_ring {
+    /**
+     * Sequence number of the next item to be published. Written only by the producer.
+     */
+    _Atomic uint64_t head CAL_CACHE_ALIGNED;
+
+    /**
+     * Bumped on every publish. This is the futex word parked consumers wait on.
+     */
+    _Atomic uint32_t wake_seq;
+
+    /**
+     * Producer-private copy of the slowest consumer's cursor, so the producer only has to walk
+     * the cursors when the ring looks full.
+     */
+    uint64_t min_next;
+
+    /**
+     * Number of consumers parked in the kernel waiting for an item
+     */
+    _Atomic uint32_t nr_parked CAL_CACHE_ALIGNED;
+
+    /**
+     * The number of slots, always a power of 2
+     */
+    size_t nr_slots;
+
+    /**
+     * The items
+     */
+    void **slots;
+
+    /**
+     * The number of consumers
+     */
+    size_t nr_consumers;
+
+    /**
+     * The consumer cursors
+     */
+    struct broadcast_ring_cursor *cursors;
+};
+
+static inline
+long _broadcast_ring_futex(_Atomic uint32_t *word, int op, uint32_t val, const struct timespec *timeout)
+{
+    return syscall(SYS_futex, (uint32_t *)word, op, val, timeout, NULL, 0);
+}
+
+aresult_t broadcast_ring_new(struct broadcast_ring **pring, size_t nr_slots)
+{
+    aresult_t ret = A_OK;
+
+    struct broadcast_ring *ring = NULL;
+
+    TSL_ASSERT_ARG(NULL != pring);
+    TSL_ASSERT_ARG(0 != nr_slots && 0 == (nr_slots & (nr_slots - 1)));
+
+    *pring = NULL;
+
+    if (FAILED(ret = TZAALLOC(ring, SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&ring->slots, nr_slots, sizeof(void *), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&ring->cursors, BROADCAST_RING_MAX_CONSUMERS,
+                    sizeof(struct broadcast_ring_cursor), SYS_CACHE_LINE_LENGTH)))
+    {
+        goto done;
+    }
+
+    ring->nr_slots = nr_slots;
+
+    *pring = ring;
+
+done:
+    if (FAILED(ret)) {
+        if (NULL != ring) {
+            broadcast_ring_delete(&ring);
+        }
+    }
+
+    return ret;
+}
+
+aresult_t broadcast_ring_add_consumer(struct broadcast_ring *ring, unsigned *pconsumer)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != ring);
+    TSL_ASSERT_ARG(NULL != pconsumer);
+    TSL_ASSERT_ARG(0 == atomic_load(&ring->head));
+
+    if (BROADCAST_RING_MAX_CONSUMERS == ring->nr_consumers) {
+        ret = A_E_BUSY;
+        goto done;
+    }
+
+    atomic_store(&ring->cursors[ring->nr_consumers].next, 0);
+    *pconsumer = ring->nr_consumers++;
+
+done:
+    return ret;
+}
+
+size_t broadcast_ring_nr_consumers(struct broadcast_ring *ring)
+{
+    TSL_BUG_ON(NULL == ring);
+
+    return ring->nr_consumers;
+}
+
+aresult_t broadcast_ring_publish(struct broadcast_ring *ring, void *item)
+{
+    aresult_t ret = A_OK;
+
+    uint64_t head = 0;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != ring);
+
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    /* Only walk the consumer cursors if the ring looks full */
+    if (head - ring->min_next >= ring->nr_slots) {
+        uint64_t min_next = head;
+
+        for (size_t i = 0; i < ring->nr_consumers; i++) {
+            uint64_t next = atomic_load_explicit(&ring->cursors[i].next, memory_order_acquire);
+            if (next < min_next) {
+                min_next = next;
+            }
+        }
+
+        ring->min_next = min_next;
+
+        if (head - min_next >= ring->nr_slots) {
+            ret = A_E_BUSY;
+            goto done;
+        }
+    }
+
+    ring->slots[head & (ring->nr_slots - 1)] = item;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    /* Only pay for the system call if someone is actually asleep */
+    atomic_fetch_add(&ring->wake_seq, 1);
+    if (0 != atomic_load(&ring->nr_parked)) {
+        _broadcast_ring_futex(&ring->wake_seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+    }
+
+done:
+    return ret;
+}
+
+aresult_t broadcast_ring_consume(struct broadcast_ring *ring, unsigned consumer, void **pitem,
+        uint64_t timeout_ns)
+{
+    aresult_t ret = A_OK;
+
+    struct broadcast_ring_cursor *cursor = NULL;
+    uint64_t next = 0;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != ring);
+    TSL_ASSERT_ARG_DEBUG(consumer < ring->nr_consumers);
+    TSL_ASSERT_ARG_DEBUG(NULL != pitem);
+
+    *pitem = NULL;
+
+    cursor = &ring->cursors[consumer];
+    next = atomic_load_explicit(&cursor->next, memory_order_relaxed);
+
+    if (next == atomic_load_explicit(&ring->head, memory_order_acquire)) {
+        if (0 == timeout_ns) {
+            goto done;
+        }
+
+        struct timespec ts = { .tv_sec = timeout_ns / 1000000000ull, .tv_nsec = timeout_ns % 1000000000ull };
+        uint32_t seq = 0;
+
+        /* Announce we're about to sleep, then check once more before actually doing so */
+        atomic_fetch_add(&ring->nr_parked, 1);
+        seq = atomic_load(&ring->wake_seq);
+
+        if (next == atomic_load(&ring->head)) {
+            _broadcast_ring_futex(&ring->wake_seq, FUTEX_WAIT_PRIVATE, seq, &ts);
+        }
+
+        atomic_fetch_sub(&ring->nr_parked, 1);
+
+        if (next == atomic_load_explicit(&ring->head, memory_order_acquire)) {
+            /* Timed out, or woken up for some other reason */
+            goto done;
+        }
+    }
+
+    *pitem = ring->slots[next & (ring->nr_slots - 1)];
+
+    /* Hand the slot back to the producer */
+    atomic_store_explicit(&cursor->next, next + 1, memory_order_release);
+
+done:
+    return ret;
+}
+
+void broadcast_ring_wake_all(struct broadcast_ring *ring)
+{
+    TSL_BUG_ON(NULL == ring);
+
+    atomic_fetch_add(&ring->wake_seq, 1);
+    _broadcast_ring_futex(&ring->wake_seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+}
+
+aresult_t broadcast_ring_delete(struct broadcast_ring **pring)
+{
+    aresult_t ret = A_OK;
+
+    struct broadcast_ring *ring = NULL;
+
+    TSL_ASSERT_PTR_BY_REF(pring);
+
+    ring = *pring;
+
+    if (NULL != ring->slots) {
+        TFREE(ring->slots);
+    }
+
+    if (NULL != ring->cursors) {
+        TFREE(ring->cursors);
+    }
+
+    TFREE(ring);
+    *pring = NULL;
+
+    return ret;
+}
+
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <tsl/result.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct broadcast_ring;
+
+/**
+ * The maximum number of consumers a broadcast ring can have
+ */
+#define BROADCAST_RING_MAX_CONSUMERS    256
+
+/**
+ * Create a single-producer, multiple-consumer broadcast ring. Every item published to the ring
+ * is seen by every consumer, in order. Each consumer has its own cursor into the ring; the
+ * producer never takes a lock, and only makes a system call to wake consumers up when at least
+ * one consumer is actually parked waiting for an item.
+ *
+ * \param pring The new ring, returned by reference
+ * \param nr_slots The number of slots in the ring. Must be a power of 2.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t broadcast_ring_new(struct broadcast_ring **pring, size_t nr_slots);
+
+/**
+ * Add a consumer to the ring. Must be called before anything is published. The consumer starts
+ * at the first item published.
+ *
+ * \param ring The ring
+ * \param pconsumer The ID of the new consumer, returned by reference.
+ *
+ * \return A_OK on success, A_E_BUSY if the ring has no room for more consumers, an error code
+ *         otherwise.
+ */
+aresult_t broadcast_ring_add_consumer(struct broadcast_ring *ring, unsigned *pconsumer);
+
+/**
+ * Get the number of consumers of the ring.
+ */
+size_t broadcast_ring_nr_consumers(struct broadcast_ring *ring);
+
+/**
+ * Publish an item to every consumer. Only one thread may publish to a given ring.
+ *
+ * \param ring The ring
+ * \param item The item to publish
+ *
+ * \return A_OK on success, A_E_BUSY if the slowest consumer is a full ring behind. The item is
+ *         not published in that case.
+ */
+aresult_t broadcast_ring_publish(struct broadcast_ring *ring, void *item);
+
+/**
+ * Get the next item for a consumer, waiting for up to timeout_ns for one to be published.
+ *
+ * \param ring The ring
+ * \param consumer The consumer ID
+ * \param pitem The next item, returned by reference. Set to NULL if nothing was published in
+ *              time.
+ * \param timeout_ns The maximum time to wait, in nanoseconds. If 0, returns right away without
+ *                   making a system call.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t broadcast_ring_consume(struct broadcast_ring *ring, unsigned consumer, void **pitem,
+        uint64_t timeout_ns);
+
+/**
+ * Wake up every parked consumer, for example so they can notice they're being shut down.
+ */
+void broadcast_ring_wake_all(struct broadcast_ring *ring);
+
+/**
+ * Delete the ring. Any items still in the ring are not released.
+ *
+ * \param pring The ring, passed by reference. Set to NULL on success.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t broadcast_ring_delete(struct broadcast_ring **pring);
+
@@ -2,29 +2,35 @@
 #include <multifm/demod_base.h>
 
 #include <filter/filter.h>
+#include <filter/complex.h>
+#include <filter/nco.h>
 
 #include <tsl/errors.h>
 #include <tsl/assert.h>
 #include <tsl/diag.h>
 #include <tsl/safe_alloc.h>
 
-#include <complex.h>
 #include <math.h>
+#include <stdlib.h>
+
+/**
+ * Phase accumulator units per radian
+ */
+#define COSTAS_RAD_TO_PHASE         (4294967296.0f / (2.0f * (float)M_PI))
 
 struct multifm_costas_demod {
     struct demod_base demod;
     float f_shift;
     float alpha;
     float beta;
-    float last_phase;
+    struct nco nco;
     float f_dev;
     float f_dev_max;
     float f_dev_min;
     float e_max;
 };
 
-aresult_t multifm_costas_demod_init(struct demod_base **pdemod, float f_shift, float alpha, float beta,
-        int16_t e_max)
+aresult_t multifm_costas_demod_init(struct demod_base **pdemod, const struct demod_params *params)
 {
     aresult_t ret = A_OK;
 
@@ -32,17 +38,21 @@ aresult_t multifm_costas_demod_init(struct demod_base **pdemod, float f_shift, f
     static const float to_q15 = (float)(1 << Q_15_SHIFT);
 
     TSL_ASSERT_ARG(NULL != pdemod);
+    TSL_ASSERT_ARG(NULL != params);
 
     TSL_BUG_IF_FAILED(TZAALLOC(demod, SYS_CACHE_LINE_LENGTH));
 
-    demod->f_shift = f_shift;
-    demod->alpha = alpha;
-    demod->beta = beta;
+    demod->demod.output_type = DEMOD_OUTPUT_COMPLEX_INT_16;
+
+    demod->f_shift = params->costas_f_shift;
+    demod->alpha = params->costas_alpha;
+    demod->beta = params->costas_beta;
+
+    demod->e_max = (float)params->costas_e_max/to_q15;
 
-    demod->last_phase = 0.0f;
-    demod->e_max = (float)e_max/to_q15;
+    demod->f_dev = 2.0f * M_PI * demod->f_shift;
 
-    demod->f_dev = 2.0f * M_PI * f_shift;
+    TSL_BUG_IF_FAILED(nco_init(&demod->nco, (uint32_t)llrintf(demod->f_dev * COSTAS_RAD_TO_PHASE)));
 
     /* TODO: un-fix this error coefficient */
     demod->f_dev_max = demod->f_dev + 0.3f;
@@ -53,11 +63,13 @@ aresult_t multifm_costas_demod_init(struct demod_base **pdemod, float f_shift, f
     return ret;
 }
 
-aresult_t multifm_costas_demod_process(struct demod_base *demod, int16_t *in_samples, size_t nr_in_samples,
-        int16_t *out_samples, size_t *pnr_out_samples, size_t *pnr_out_bytes)
+aresult_t multifm_costas_demod_process(struct demod_base *demod, const int16_t *in_samples, size_t nr_in_samples,
+        void *out, size_t *pnr_out_samples, size_t *pnr_out_bytes)
 {
     aresult_t ret = A_OK;
 
+    int16_t *out_samples = out;
+
     static const float to_q15 = (float)(1 << Q_15_SHIFT);
     struct multifm_costas_demod *dc = NULL;
     float e_max = 0.0;
@@ -65,7 +77,7 @@ aresult_t multifm_costas_demod_process(struct demod_base *demod, int16_t *in_sam
     TSL_ASSERT_ARG(NULL != demod);
     TSL_ASSERT_ARG(NULL != in_samples);
     TSL_ASSERT_ARG(0 != nr_in_samples);
-    TSL_ASSERT_ARG(NULL != out_samples);
+    TSL_ASSERT_ARG(NULL != out);
     TSL_ASSERT_ARG(NULL != pnr_out_samples);
     TSL_ASSERT_ARG(NULL != pnr_out_bytes);
 
@@ -77,21 +89,28 @@ aresult_t multifm_costas_demod_process(struct demod_base *demod, int16_t *in_sam
     *pnr_out_bytes = 0;
 
     for (size_t i = 0; i < nr_in_samples; i++) {
-        /* Grab the sample */
-        float error = 0.0,
-              phase = 0.0;
-        complex float samp = CMPLX((float)in_samples[2 * i    ]/to_q15,
-                                   (float)in_samples[2 * i + 1]/to_q15);
-        complex float nco = cexpf(CMPLX(0, -dc->last_phase));
-        complex float out_samp = samp * nco;
+        float error = 0.0;
+        int16_t lo_re = 0,
+                lo_im = 0;
+        int32_t out_re = 0,
+                out_im = 0;
+
+        /* Derotate the sample by the current phase estimate */
+        nco_lookup(dc->nco.phase, &lo_re, &lo_im);
+        cmul_q15_q30(in_samples[2 * i], in_samples[2 * i + 1], lo_re, -lo_im, &out_re, &out_im);
+        out_re = round_q30_q15(out_re);
+        out_im = round_q30_q15(out_im);
 
-        error = cimagf(out_samp) * crealf(out_samp);
+        error = ((float)out_im / to_q15) * ((float)out_re / to_q15);
 
         if (error > e_max) error = e_max;
         else if (error < -e_max) error = -e_max;
 
         dc->f_dev = dc->f_dev + dc->beta * error;
-        phase = dc->last_phase + dc->f_dev + dc->alpha * error;
+
+        /* The accumulator wraps every 2*pi, so the phase never needs to be reduced */
+        dc->nco.phase_incr = (uint32_t)llrintf((dc->f_dev + dc->alpha * error) * COSTAS_RAD_TO_PHASE);
+        dc->nco.phase += dc->nco.phase_incr;
 
         if (dc->f_dev > dc->f_dev_max) {
             dc->f_dev = dc->f_dev_max;
@@ -99,13 +118,11 @@ aresult_t multifm_costas_demod_process(struct demod_base *demod, int16_t *in_sam
             dc->f_dev = dc->f_dev_min;
         }
 
-        dc->last_phase = fmodf(phase, 2 * M_PI);
-
-        TSL_BUG_ON(fabsf(crealf(out_samp)) > 1.0);
-        TSL_BUG_ON(fabsf(cimagf(out_samp)) > 1.0);
+        TSL_BUG_ON(abs(out_re) > (1 << Q_15_SHIFT));
+        TSL_BUG_ON(abs(out_im) > (1 << Q_15_SHIFT));
 
-        out_samples[2 * i    ] = crealf(out_samp) * to_q15;
-        out_samples[2 * i + 1] = cimagf(out_samp) * to_q15;
+        out_samples[2 * i    ] = out_re;
+        out_samples[2 * i + 1] = out_im;
     }
 
     *pnr_out_samples = nr_in_samples;
@@ -132,3 +149,11 @@ aresult_t multifm_costas_demod_cleanup(struct demod_base **pdemod)
     return ret;
 }
 
+
+const struct demod_ops multifm_costas_demod_ops = {
+    .name = "costas",
+    .init = multifm_costas_demod_init,
+    .process = multifm_costas_demod_process,
+    .process_f32 = NULL,
+    .cleanup = multifm_costas_demod_cleanup,
+};
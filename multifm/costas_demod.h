@@ -1,11 +1,35 @@
 #pragma once
 
+#include <multifm/demod_base.h>
+
 #include <tsl/result.h>
 
-struct demod_base;
+/**
+ * Costas Loop Demodulator
+ *
+ * Tracks a BPSK carrier with a Costas loop, and writes out the derotated complex samples, so
+ * the symbols end up on the real axis. The loop starts at `costas_f_shift` and is allowed to
+ * pull about 0.05 cycles per sample either side of it.
+ */
+
+/**
+ * Initialize a new Costas loop demodulator, from the `costas_*` parameters.
+ */
+aresult_t multifm_costas_demod_init(struct demod_base **pdemod, const struct demod_params *params);
+
+/**
+ * Derotate the samples by the loop's current estimate of the carrier, updating the estimate as
+ * it goes. Writes out interleaved Q.15 I/Q.
+ */
+aresult_t multifm_costas_demod_process(struct demod_base *demod, const int16_t *in_samples, size_t nr_in_samples,
+        void *out, size_t *pnr_out_samples, size_t *pnr_out_bytes);
 
-aresult_t multifm_costas_demod_init(struct demod_base **pdemod, float f_shift, float alpha, float beta, int16_t e_max);
-aresult_t multifm_costas_demod_process(struct demod_base *demod, int16_t *in_samples, size_t nr_in_samples,
-        int16_t *out_samples, size_t *pnr_out_samples, size_t *pnr_out_bytes);
+/**
+ * Cleanup the resources used by the Costas loop demodulator
+ */
 aresult_t multifm_costas_demod_cleanup(struct demod_base **pdemod);
 
+/**
+ * The Costas loop demodulator's operations, registered as "costas"
+ */
+extern const struct demod_ops multifm_costas_demod_ops;
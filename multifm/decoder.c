@@ -0,0 +1,300 @@
+/*
+ *  decoder.c - Protocol decoders that run on a channel's PCM, inside multifm
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <multifm/decoder.h>
+#include <multifm/multifm.h>
+
+#include <pager/pager_flex.h>
+#include <pager/pager_pocsag.h>
+
+#include <ais/ais_decode.h>
+
+#include <msgfmt/msg_json.h>
+
+#include <tsl/safe_alloc.h>
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+static
+const struct decoder_protocol _decoder_protocols[] = {
+    { .name = "flex", .type = DECODER_PROTOCOL_FLEX, .sample_rate = 16000 },
+    { .name = "pocsag", .type = DECODER_PROTOCOL_POCSAG, .sample_rate = 38400 },
+    { .name = "ais", .type = DECODER_PROTOCOL_AIS, .sample_rate = 48000 },
+};
+
+#define DECODER_NR_PROTOCOLS            (sizeof(_decoder_protocols)/sizeof(_decoder_protocols[0]))
+
+/**
+ * Where every decoder's messages go. NULL for stdout.
+ */
+static
+FILE *_decoder_sink = NULL;
+
+/**
+ * The decoder that is running on this thread. The pager decoders' callbacks don't carry any
+ * state of our own, but they are only ever called from inside `decoder_on_pcm`, on the
+ * channel's worker thread, so this is how a callback finds out which channel it is for.
+ */
+static __thread
+struct decoder *_decoder_current = NULL;
+
+const struct decoder_protocol *decoder_find(const char *name)
+{
+    const struct decoder_protocol *protocol = NULL;
+
+    if (NULL == name) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < DECODER_NR_PROTOCOLS; i++) {
+        if (0 == strcmp(_decoder_protocols[i].name, name)) {
+            protocol = &_decoder_protocols[i];
+            break;
+        }
+    }
+
+done:
+    return protocol;
+}
+
+aresult_t decoder_sink_open(const char *path)
+{
+    aresult_t ret = A_OK;
+
+    FILE *fp = NULL;
+
+    TSL_ASSERT_ARG(NULL != path);
+    TSL_ASSERT_ARG('\0' != *path);
+
+    if (NULL == (fp = fopen(path, "a"))) {
+        int errnum = errno;
+        MFM_MSG(SEV_ERROR, "BAD-DECODER-OUTPUT", "Failed to open decoder output file '%s': %s (%d)",
+                path, strerror(errnum), errnum);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    decoder_sink_close();
+    _decoder_sink = fp;
+
+done:
+    return ret;
+}
+
+void decoder_sink_close(void)
+{
+    if (NULL != _decoder_sink) {
+        fclose(_decoder_sink);
+        _decoder_sink = NULL;
+    }
+}
+
+/**
+ * The file this thread's messages go to
+ */
+static
+FILE *_decoder_sink_fp(void)
+{
+    return NULL == _decoder_sink ? stdout : _decoder_sink;
+}
+
+static
+aresult_t _decoder_on_flex_alnum_msg(struct pager_flex *flex, uint16_t baud, uint8_t phase, uint8_t cycle_no,
+        uint8_t frame_no, uint64_t cap_code, bool fragmented, bool maildrop, uint8_t seq_num,
+        const char *message_bytes, size_t message_len)
+{
+    msg_json_flex_alnum(_decoder_sink_fp(), _decoder_current->freq_hz, baud, phase, cycle_no, frame_no, cap_code,
+            fragmented, maildrop, seq_num, message_bytes, message_len);
+    return A_OK;
+}
+
+static
+aresult_t _decoder_on_flex_num_msg(struct pager_flex *flex, uint16_t baud, uint8_t phase, uint8_t cycle_no,
+        uint8_t frame_no, uint64_t cap_code, const char *message_bytes, size_t message_len)
+{
+    msg_json_flex_num(_decoder_sink_fp(), _decoder_current->freq_hz, baud, phase, cycle_no, frame_no, cap_code,
+            message_bytes, message_len);
+    return A_OK;
+}
+
+static
+aresult_t _decoder_on_flex_siv_msg(struct pager_flex *flex, uint16_t baud, uint8_t phase, uint8_t cycle_no,
+        uint8_t frame_no, uint64_t cap_code, uint8_t siv_msg_type, uint32_t data)
+{
+    msg_json_flex_siv(_decoder_sink_fp(), _decoder_current->freq_hz, baud, phase, cycle_no, frame_no, cap_code,
+            siv_msg_type, data);
+    return A_OK;
+}
+
+static
+aresult_t _decoder_on_pocsag_num_msg(struct pager_pocsag *pocsag, uint16_t baud_rate, uint32_t capcode,
+        const char *data, size_t data_len, uint8_t function)
+{
+    msg_json_pocsag(_decoder_sink_fp(), _decoder_current->freq_hz, false, baud_rate, capcode, data, data_len,
+            function);
+    return A_OK;
+}
+
+static
+aresult_t _decoder_on_pocsag_alnum_msg(struct pager_pocsag *pocsag, uint16_t baud_rate, uint32_t capcode,
+        const char *data, size_t data_len, uint8_t function)
+{
+    msg_json_pocsag(_decoder_sink_fp(), _decoder_current->freq_hz, true, baud_rate, capcode, data, data_len,
+            function);
+    return A_OK;
+}
+
+static
+aresult_t _decoder_on_ais_position_report(struct ais_decode *decode, void *state, struct ais_position_report *pr,
+        const char *raw_msg)
+{
+    msg_json_ais_position_report(_decoder_sink_fp(), _decoder_current->freq_hz, pr, raw_msg);
+    return A_OK;
+}
+
+static
+aresult_t _decoder_on_ais_base_station_report(struct ais_decode *decode, void *state, struct ais_base_station_report *br,
+        const char *raw_msg)
+{
+    msg_json_ais_base_station_report(_decoder_sink_fp(), _decoder_current->freq_hz, br, raw_msg);
+    return A_OK;
+}
+
+static
+aresult_t _decoder_on_ais_static_voyage_data(struct ais_decode *decode, void *state, struct ais_static_voyage_data *svd,
+        const char *raw_msg)
+{
+    msg_json_ais_static_voyage_data(_decoder_sink_fp(), _decoder_current->freq_hz, svd, raw_msg);
+    return A_OK;
+}
+
+aresult_t decoder_new(struct decoder **pdec, const struct decoder_protocol *protocol, uint32_t freq_hz)
+{
+    aresult_t ret = A_OK;
+
+    struct decoder *dec = NULL;
+
+    TSL_ASSERT_ARG(NULL != pdec);
+    TSL_ASSERT_ARG(NULL != protocol);
+
+    *pdec = NULL;
+
+    if (FAILED(ret = TZAALLOC(dec, SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    dec->protocol = protocol;
+    dec->freq_hz = freq_hz;
+
+    switch (protocol->type) {
+    case DECODER_PROTOCOL_FLEX:
+        ret = pager_flex_new(&dec->flex, freq_hz, _decoder_on_flex_alnum_msg, _decoder_on_flex_num_msg,
+                _decoder_on_flex_siv_msg);
+        break;
+    case DECODER_PROTOCOL_POCSAG:
+        ret = pager_pocsag_new(&dec->pocsag, freq_hz, _decoder_on_pocsag_num_msg, _decoder_on_pocsag_alnum_msg, false);
+        break;
+    case DECODER_PROTOCOL_AIS:
+        ret = ais_decode_new(&dec->ais, freq_hz, _decoder_on_ais_position_report, _decoder_on_ais_base_station_report,
+                _decoder_on_ais_static_voyage_data);
+        break;
+    }
+
+    if (FAILED(ret)) {
+        goto done;
+    }
+
+    *pdec = dec;
+
+done:
+    if (FAILED(ret)) {
+        if (NULL != dec) {
+            TFREE(dec);
+        }
+    }
+
+    return ret;
+}
+
+aresult_t decoder_delete(struct decoder **pdec)
+{
+    aresult_t ret = A_OK;
+
+    struct decoder *dec = NULL;
+
+    TSL_ASSERT_PTR_BY_REF(pdec);
+
+    dec = *pdec;
+
+    switch (dec->protocol->type) {
+    case DECODER_PROTOCOL_FLEX:
+        TSL_BUG_IF_FAILED(pager_flex_delete(&dec->flex));
+        break;
+    case DECODER_PROTOCOL_POCSAG:
+        TSL_BUG_IF_FAILED(pager_pocsag_delete(&dec->pocsag));
+        break;
+    case DECODER_PROTOCOL_AIS:
+        TSL_BUG_IF_FAILED(ais_decode_delete(&dec->ais));
+        break;
+    }
+
+    TFREE(dec);
+    *pdec = NULL;
+
+    return ret;
+}
+
+aresult_t decoder_on_pcm(struct decoder *dec, const int16_t *samples, size_t nr_samples)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != dec);
+    TSL_ASSERT_ARG(NULL != samples);
+
+    if (0 == nr_samples) {
+        goto done;
+    }
+
+    _decoder_current = dec;
+
+    switch (dec->protocol->type) {
+    case DECODER_PROTOCOL_FLEX:
+        ret = pager_flex_on_pcm(dec->flex, samples, nr_samples);
+        break;
+    case DECODER_PROTOCOL_POCSAG:
+        ret = pager_pocsag_on_pcm(dec->pocsag, samples, nr_samples);
+        break;
+    case DECODER_PROTOCOL_AIS:
+        ret = ais_decode_on_pcm(dec->ais, samples, nr_samples);
+        break;
+    }
+
+    _decoder_current = NULL;
+
+done:
+    return ret;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <tsl/result.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct pager_flex;
+struct pager_pocsag;
+struct ais_decode;
+
+/**
+ * The protocols a channel can decode in-process
+ */
+enum decoder_protocol_type {
+    DECODER_PROTOCOL_FLEX = 0,
+    DECODER_PROTOCOL_POCSAG = 1,
+    DECODER_PROTOCOL_AIS = 2,
+};
+
+/**
+ * A protocol decoder a channel can run on its PCM
+ */
+struct decoder_protocol {
+    /**
+     * The name the protocol goes by in the configuration
+     */
+    const char *name;
+
+    /**
+     * The protocol
+     */
+    enum decoder_protocol_type type;
+
+    /**
+     * The PCM sample rate the decoder expects, in Hz
+     */
+    unsigned sample_rate;
+};
+
+/**
+ * A protocol decoder, running on a channel's demodulated PCM
+ */
+struct decoder {
+    /**
+     * The protocol being decoded
+     */
+    const struct decoder_protocol *protocol;
+
+    /**
+     * The center frequency of the channel, reported with every message
+     */
+    uint32_t freq_hz;
+
+    union {
+        struct pager_flex *flex;
+        struct pager_pocsag *pocsag;
+        struct ais_decode *ais;
+    };
+};
+
+/**
+ * Find a protocol decoder by name.
+ *
+ * \param name The name of the protocol, such as "pocsag"
+ *
+ * \return The protocol, or NULL if there is no protocol by that name
+ */
+const struct decoder_protocol *decoder_find(const char *name);
+
+/**
+ * Direct the messages from every decoder to the given file, appending to it. Until this is
+ * called, messages go to stdout.
+ *
+ * \param path The file to write the messages to
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t decoder_sink_open(const char *path);
+
+/**
+ * Close the file the messages were going to, if there was one, and go back to stdout.
+ */
+void decoder_sink_close(void);
+
+/**
+ * Create a protocol decoder for a channel.
+ *
+ * \param pdec The new decoder, returned by reference
+ * \param protocol The protocol to decode, from `decoder_find`
+ * \param freq_hz The center frequency of the channel
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t decoder_new(struct decoder **pdec, const struct decoder_protocol *protocol, uint32_t freq_hz);
+
+/**
+ * Release a protocol decoder.
+ *
+ * \param pdec The decoder, passed by reference. Set to NULL on success.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t decoder_delete(struct decoder **pdec);
+
+/**
+ * Decode a block of PCM samples. Any messages found are written to the sink before this
+ * returns.
+ *
+ * \param dec The decoder
+ * \param samples The PCM samples, in Q.15, at the protocol's sample rate
+ * \param nr_samples The number of samples
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t decoder_on_pcm(struct decoder *dec, const int16_t *samples, size_t nr_samples);
@@ -21,14 +21,20 @@
  */
 
 #include <multifm/demod.h>
+#include <multifm/demod_pool.h>
+#include <multifm/broadcast_ring.h>
 #include <multifm/multifm.h>
 
-#include <multifm/fm_demod.h>
+#include <multifm/demod_base.h>
+#include <multifm/decoder.h>
 
 #include <filter/direct_fir.h>
+#include <filter/fir_fold.h>
 #include <filter/sample_buf.h>
+#include <filter/shm_ring.h>
 #include <filter/complex.h>
 
+#include <tsl/basic.h>
 #include <tsl/frame_alloc.h>
 #include <tsl/errors.h>
 #include <tsl/assert.h>
@@ -38,6 +44,7 @@
 #include <stdatomic.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <math.h>
 #include <unistd.h>
 #include <string.h>
 
@@ -45,78 +52,262 @@
 #include <arm_neon.h>
 #endif
 
+/**
+ * How long a demodulator thread waits on the broadcast ring before checking whether it should
+ * shut down, in nanoseconds
+ */
+#define DEMOD_THREAD_RING_WAIT_NS       1000000000ull
+
+/**
+ * The number of samples per channel that are filtered and then demodulated in one go, when the
+ * filter and discriminator are fused. Small enough that a tile of filtered samples stays in the
+ * L1 cache, large enough to keep the vectorized discriminator busy.
+ */
+#define DEMOD_FUSED_TILE_LEN            64
+
+_Static_assert(0 == LPF_OUTPUT_LEN % DEMOD_FUSED_TILE_LEN, "Fused tiles must evenly divide the output buffer");
+
+/**
+ * Demodulate a block of filtered samples for a channel, appending the demodulated samples to the
+ * channel's output buffer.
+ */
+static
+void _demod_channel_demod(struct demod_channel *chan, enum demod_numeric_format format, size_t nr_samples)
+{
+    struct demod_base *demod = chan->demod;
+    size_t nr_out_samples = 0,
+           nr_out_bytes = 0;
+    void *out = &chan->out_buf[chan->nr_out_bytes];
+
+    TSL_BUG_ON(chan->nr_out_bytes + nr_samples * demod_output_sample_bytes(demod->output_type) >
+            sizeof(chan->out_buf));
+
+    if (DEMOD_NUMERIC_FORMAT_F32 == format) {
+        TSL_BUG_IF_FAILED(demod->ops->process_f32(demod, chan->filt_samp_buf_f32, nr_samples,
+                    out, &nr_out_samples, &nr_out_bytes));
+    } else {
+        TSL_BUG_IF_FAILED(demod->ops->process(demod, chan->filt_samp_buf, nr_samples,
+                    out, &nr_out_samples, &nr_out_bytes));
+    }
+
+    chan->nr_pcm_samples += nr_out_samples;
+    chan->nr_out_bytes += nr_out_bytes;
+}
+
+/**
+ * Write demodulated samples out to the channel's FIFO, counting them as dropped if nothing is
+ * reading the FIFO.
+ */
+static
+void _demod_channel_write(struct demod_channel *chan, const void *out, size_t nr_bytes)
+{
+    if (0 > write(chan->fifo_fd, out, nr_bytes)) {
+        int errnum = errno;
+        if (errnum == EPIPE) {
+            if (0 == chan->nr_dropped_samples) {
+                MFM_MSG(SEV_WARNING, "FIFO-REMOTE-END-DISCONNECTED", "Remote end of FIFO disconnected. "
+                        "Until a process picks up the FIFO, we're dropping samples.");
+            }
+            chan->nr_dropped_samples += chan->nr_pcm_samples;
+        } else {
+            PANIC("Failed to write %zu bytes to the output fifo. Reason: %s (%d)",
+                    nr_bytes, strerror(errnum), errnum);
+        }
+    } else if (0 != chan->nr_dropped_samples) {
+        MFM_MSG(SEV_WARNING, "FIFO-RESUMED", "Remote FIFO end reconnected. Dropped %zu samples in the interim.",
+                chan->nr_dropped_samples);
+        chan->nr_dropped_samples = 0;
+    }
+}
+
+/**
+ * Hand the channel's demodulated samples to its decoder and write them out to its FIFO and its
+ * ring, and empty the output buffer.
+ */
+static
+void _demod_channel_flush(struct demod_channel *chan)
+{
+    const void *out = chan->out_buf;
+    size_t nr_bytes = chan->nr_out_bytes;
+
+    /* Run the PCM samples through the channel's post-demodulation chain, if it has one */
+    if (NULL != chan->post_demod) {
+        const int16_t *post_out = NULL;
+
+        TSL_BUG_IF_FAILED(post_demod_process(chan->post_demod, (int16_t *)chan->out_buf, chan->nr_pcm_samples,
+                    &post_out, &chan->nr_pcm_samples));
+        out = post_out;
+        nr_bytes = chan->nr_pcm_samples * sizeof(int16_t);
+    }
+
+    chan->total_nr_pcm_samples += chan->nr_pcm_samples;
+
+    /* Decode the PCM samples right here, if the channel has a decoder */
+    if (NULL != chan->decoder) {
+        TSL_BUG_IF_FAILED(decoder_on_pcm(chan->decoder, out, chan->nr_pcm_samples));
+    }
+
+    /* x. Write out the resulting PCM samples */
+    if (-1 != chan->fifo_fd) {
+        _demod_channel_write(chan, out, nr_bytes);
+    }
+
+    /* Readers of the ring keep up or lose blocks, so this never waits */
+    if (NULL != chan->out_ring) {
+        TSL_BUG_IF_FAILED(shm_ring_write(chan->out_ring, out, nr_bytes));
+    }
+
+    chan->nr_pcm_samples = 0;
+    chan->nr_out_bytes = 0;
+}
+
+/**
+ * Demodulate a block of filtered samples for a channel, and write the results out to the
+ * channel's FIFO.
+ */
 static
-aresult_t demod_thread_process(struct demod_thread *dthr, struct sample_buf *sbuf)
+aresult_t _demod_channel_process(struct demod_channel *chan, enum demod_numeric_format format, size_t nr_samples)
 {
     aresult_t ret = A_OK;
 
-    bool can_process = false;
+    size_t nr_filt_bytes = nr_samples * 2 * (DEMOD_NUMERIC_FORMAT_F32 == format ? sizeof(float) : sizeof(int16_t));
 
-    TSL_ASSERT_ARG(NULL != dthr);
-    TSL_ASSERT_ARG(NULL != sbuf);
+    if (-1 != chan->debug_signal_fd) {
+        if (0 > write(chan->debug_signal_fd, chan->filt_samp_buf, nr_filt_bytes)) {
+            int errnum = errno;
+            MFM_MSG(SEV_WARNING, "CANT-WRITE-DEBUG-FILE", "Unable to write %zu bytes to post-demod debug file. Reason: %s (%d). Skipping.",
+                    nr_filt_bytes, strerror(errnum), errnum);
+        }
+    }
 
-    TSL_BUG_IF_FAILED(direct_fir_push_sample_buf(&dthr->fir, sbuf));
-    TSL_BUG_IF_FAILED(direct_fir_can_process(&dthr->fir, &can_process, NULL));
+    /* 2. Perform quadrature demod, write to output demodulation buffer. */
+    chan->nr_pcm_samples = 0;
+    chan->nr_out_bytes = 0;
+    _demod_channel_demod(chan, format, nr_samples);
+    _demod_channel_flush(chan);
 
-    TSL_BUG_ON(false == can_process);
+    return ret;
+}
 
-    while (true == can_process) {
-        size_t nr_samples = 0,
-               nr_processed_bytes = 0;
+/**
+ * Hand a sample buffer to the demodulator's FIR. The FIR copies the samples into its history,
+ * so any number of buffers can be pushed before the FIR is run.
+ */
+static inline
+void _demod_thread_push(struct demod_thread *dthr, struct sample_buf *sbuf)
+{
+    if (DEMOD_NUMERIC_FORMAT_F32 == dthr->numeric_format) {
+        TSL_BUG_IF_FAILED(direct_fir_f32_push_sample_buf(&dthr->fir_f32, sbuf));
+    } else if (1 == dthr->nr_channels) {
+        TSL_BUG_IF_FAILED(direct_fir_push_sample_buf(&dthr->fir, sbuf));
+    } else {
+        TSL_BUG_IF_FAILED(direct_fir_batch_push_sample_buf(&dthr->batch_fir, sbuf));
+    }
+}
+
+/**
+ * Run the demodulator's FIR, writing up to nr_max filtered samples to the start of each
+ * channel's filtered sample buffer. All channels in a batch produce the same number of samples.
+ *
+ * \return The number of filtered samples per channel
+ */
+static
+size_t _demod_thread_filter(struct demod_thread *dthr, size_t nr_max)
+{
+    size_t nr_samples = 0;
+
+    if (DEMOD_NUMERIC_FORMAT_F32 == dthr->numeric_format) {
+        TSL_BUG_IF_FAILED(direct_fir_f32_process(&dthr->fir_f32, dthr->channels[0].filt_samp_buf_f32,
+                    nr_max, &nr_samples));
+    } else if (1 == dthr->nr_channels) {
+        TSL_BUG_IF_FAILED(direct_fir_process(&dthr->fir, dthr->channels[0].filt_samp_buf,
+                    nr_max, &nr_samples));
+    } else {
+        TSL_BUG_IF_FAILED(direct_fir_batch_process(&dthr->batch_fir, dthr->batch_out,
+                    nr_max, &nr_samples));
+    }
 
-        /* 1. Filter using FIR, decimate by the specified factor. Iterate over the output
-         *    buffer samples.
-         */
-        TSL_BUG_IF_FAILED(direct_fir_process(&dthr->fir, dthr->filt_samp_buf + dthr->nr_fm_samples,
-                    LPF_OUTPUT_LEN - dthr->nr_fm_samples, &nr_samples));
+    return nr_samples;
+}
 
-        dthr->total_nr_demod_samples += nr_samples;
+/**
+ * Filter and demodulate up to LPF_OUTPUT_LEN samples per channel, a tile at a time. Each tile
+ * is demodulated straight after it is filtered, while it's still in the L1 cache, so the
+ * filtered samples never make a round trip through memory; only the PCM samples build up, and
+ * they are written out at the end.
+ *
+ * \return The number of samples demodulated per channel
+ */
+static
+size_t _demod_thread_process_fused(struct demod_thread *dthr)
+{
+    size_t nr_samples = 0,
+           nr_tile = 0;
+
+    do {
+        nr_tile = _demod_thread_filter(dthr, DEMOD_FUSED_TILE_LEN);
 
-        if (-1 != dthr->debug_signal_fd) {
-            if (0 > write(dthr->debug_signal_fd, dthr->filt_samp_buf + dthr->nr_fm_samples, nr_samples * 2 * sizeof(int16_t))) {
-                int errnum = errno;
-                MFM_MSG(SEV_WARNING, "CANT-WRITE-DEBUG-FILE", "Unable to write %zu bytes to post-demod debug file. Reason: %s (%d). Skipping.",
-                        nr_samples * 2 * sizeof(int16_t), strerror(errnum), errnum);
+        if (0 != nr_tile) {
+            for (size_t i = 0; i < dthr->nr_channels; i++) {
+                _demod_channel_demod(&dthr->channels[i], dthr->numeric_format, nr_tile);
             }
         }
 
-        dthr->nr_fm_samples += nr_samples;
+        nr_samples += nr_tile;
+    } while (DEMOD_FUSED_TILE_LEN == nr_tile && nr_samples + DEMOD_FUSED_TILE_LEN <= LPF_OUTPUT_LEN);
 
-        /* 2. Perform quadrature demod, write to output demodulation buffer. */
-        /* TODO: smarten this up a lot - this sucks */
-        dthr->nr_pcm_samples = 0;
+    for (size_t i = 0; i < dthr->nr_channels; i++) {
+        _demod_channel_flush(&dthr->channels[i]);
+    }
 
-        TSL_BUG_IF_FAILED(multifm_fm_demod_process(dthr->demod, dthr->filt_samp_buf, dthr->nr_fm_samples,
-                    dthr->out_buf, &dthr->nr_pcm_samples, &nr_processed_bytes));
+    return nr_samples;
+}
 
-        /* x. Write out the resulting PCM samples */
-        if (0 > write(dthr->fifo_fd, dthr->out_buf, nr_processed_bytes)) {
-            int errnum = errno;
-            if (errnum == EPIPE) {
-                if (0 == dthr->nr_dropped_samples) {
-                    MFM_MSG(SEV_WARNING, "FIFO-REMOTE-END-DISCONNECTED", "Remote end of FIFO disconnected. "
-                            "Until a process picks up the FIFO, we're dropping samples.");
-                }
-                dthr->nr_dropped_samples += dthr->nr_pcm_samples;
-            } else {
-                PANIC("Failed to write %zu bytes to the output fifo. Reason: %s (%d)",
-                        sizeof(int16_t) * dthr->nr_pcm_samples,
-                        strerror(errnum), errnum);
+/**
+ * Filter and demodulate everything that has been pushed to the demodulator's FIR.
+ */
+static
+aresult_t _demod_thread_drain(struct demod_thread *dthr)
+{
+    aresult_t ret = A_OK;
+
+    bool can_process = false;
+
+    if (DEMOD_NUMERIC_FORMAT_F32 == dthr->numeric_format) {
+        TSL_BUG_IF_FAILED(direct_fir_f32_can_process(&dthr->fir_f32, &can_process, NULL));
+    } else if (1 == dthr->nr_channels) {
+        TSL_BUG_IF_FAILED(direct_fir_can_process(&dthr->fir, &can_process, NULL));
+    } else {
+        TSL_BUG_IF_FAILED(direct_fir_batch_can_process(&dthr->batch_fir, &can_process, NULL));
+    }
+
+    while (true == can_process) {
+        size_t nr_samples = 0;
+
+        if (true == dthr->fused) {
+            nr_samples = _demod_thread_process_fused(dthr);
+        } else {
+            /* 1. Filter using FIR, decimate by the specified factor. Iterate over the output
+             *    buffer samples. All channels in a batch produce the same number of samples.
+             */
+            nr_samples = _demod_thread_filter(dthr, LPF_OUTPUT_LEN);
+
+            for (size_t i = 0; i < dthr->nr_channels; i++) {
+                TSL_BUG_IF_FAILED(_demod_channel_process(&dthr->channels[i], dthr->numeric_format, nr_samples));
             }
-        } else if (0 != dthr->nr_dropped_samples) {
-            MFM_MSG(SEV_WARNING, "FIFO-RESUMED", "Remote FIFO end reconnected. Dropped %zu samples in the interim.",
-                    dthr->nr_dropped_samples);
-            dthr->nr_dropped_samples = 0;
         }
 
-        TSL_BUG_IF_FAILED(direct_fir_can_process(&dthr->fir, &can_process, NULL));
+        dthr->total_nr_demod_samples += nr_samples;
 
-        /* We're done with this batch of samples, woohoo */
-        dthr->nr_fm_samples = 0;
+        if (DEMOD_NUMERIC_FORMAT_F32 == dthr->numeric_format) {
+            TSL_BUG_IF_FAILED(direct_fir_f32_can_process(&dthr->fir_f32, &can_process, NULL));
+        } else if (1 == dthr->nr_channels) {
+            TSL_BUG_IF_FAILED(direct_fir_can_process(&dthr->fir, &can_process, NULL));
+        } else {
+            TSL_BUG_IF_FAILED(direct_fir_batch_can_process(&dthr->batch_fir, &can_process, NULL));
+        }
     }
 
-    /* Force the thread to wait until a new buffer is available */
-
     return ret;
 }
 
@@ -131,13 +322,45 @@ aresult_t _demod_thread_work(struct worker_thread *wthr)
 
     while (worker_thread_is_running(wthr)) {
         struct sample_buf *buf = NULL;
+        struct broadcast_ring *ring = atomic_load(&dthr->ring);
+
+        if (NULL != ring) {
+            /* Samples come from the receiver's broadcast ring, no need for the lock */
+            pthread_mutex_unlock(&dthr->wq_mtx);
+
+            TSL_BUG_IF_FAILED(broadcast_ring_consume(ring, dthr->ring_consumer, (void **)&buf,
+                        DEMOD_THREAD_RING_WAIT_NS));
+
+            if (NULL != buf) {
+                /* Take everything else that has been published since, then filter it in one go */
+                do {
+                    _demod_thread_push(dthr, buf);
+                    TSL_BUG_IF_FAILED(broadcast_ring_consume(ring, dthr->ring_consumer, (void **)&buf, 0));
+                } while (NULL != buf);
+
+                TSL_BUG_IF_FAILED(_demod_thread_drain(dthr));
+            }
+
+            pthread_mutex_lock(&dthr->wq_mtx);
+            continue;
+        }
+
         TSL_BUG_IF_FAILED(work_queue_pop(&dthr->wq, (void **)&buf));
 
         if (NULL != buf) {
+            /* Take every buffer that is queued up, then filter them all in one go */
+            do {
+                pthread_mutex_unlock(&dthr->wq_mtx);
+                _demod_thread_push(dthr, buf);
+                pthread_mutex_lock(&dthr->wq_mtx);
+
+                TSL_BUG_IF_FAILED(work_queue_pop(&dthr->wq, (void **)&buf));
+            } while (NULL != buf);
+
             pthread_mutex_unlock(&dthr->wq_mtx);
 
-            /* Process the buffer */
-            TSL_BUG_IF_FAILED(demod_thread_process(dthr, buf));
+            /* Process the buffers */
+            TSL_BUG_IF_FAILED(_demod_thread_drain(dthr));
 
             /* Re-acquire the lock */
             pthread_mutex_lock(&dthr->wq_mtx);
@@ -160,6 +383,187 @@ aresult_t _demod_thread_work(struct worker_thread *wthr)
     return ret;
 }
 
+aresult_t demod_thread_attach_ring(struct demod_thread *dthr, struct broadcast_ring *ring)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != dthr);
+    TSL_ASSERT_ARG(NULL != ring);
+    TSL_ASSERT_ARG(NULL == dthr->pool);
+    TSL_ASSERT_ARG(NULL == atomic_load(&dthr->ring));
+
+    if (FAILED(ret = broadcast_ring_add_consumer(ring, &dthr->ring_consumer))) {
+        MFM_MSG(SEV_ERROR, "TOO-MANY-CONSUMERS", "Too many demodulator threads for the broadcast ring.");
+        goto done;
+    }
+
+    /* Kick the worker thread so it notices the ring, rather than waiting on its work queue */
+    pthread_mutex_lock(&dthr->wq_mtx);
+    atomic_store(&dthr->ring, ring);
+    pthread_cond_signal(&dthr->wq_cv);
+    pthread_mutex_unlock(&dthr->wq_mtx);
+
+done:
+    return ret;
+}
+
+size_t demod_thread_run_pending(struct demod_thread *dthr)
+{
+    size_t nr_bufs = 0,
+           nr_pending = 0;
+
+    TSL_BUG_ON(NULL == dthr->pool);
+
+    do {
+        /* Only this worker can take the count down, so at least this many are queued */
+        nr_pending = atomic_load(&dthr->pool_nr_pending);
+
+        for (size_t i = 0; i < nr_pending; i++) {
+            struct sample_buf *buf = NULL;
+
+            pthread_mutex_lock(&dthr->wq_mtx);
+            TSL_BUG_IF_FAILED(work_queue_pop(&dthr->wq, (void **)&buf));
+            pthread_mutex_unlock(&dthr->wq_mtx);
+
+            /* The pending count is only bumped once the buffer is on the queue */
+            TSL_BUG_ON(NULL == buf);
+
+            _demod_thread_push(dthr, buf);
+        }
+
+        /* Filter everything that was pending in one go */
+        TSL_BUG_IF_FAILED(_demod_thread_drain(dthr));
+        nr_bufs += nr_pending;
+
+        /* Once the count hits zero, the next delivery will schedule us again */
+    } while (nr_pending != atomic_fetch_sub(&dthr->pool_nr_pending, nr_pending));
+
+    return nr_bufs;
+}
+
+aresult_t demod_thread_deliver(struct demod_thread *dthr, struct sample_buf *buf)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != dthr);
+    TSL_ASSERT_ARG_DEBUG(NULL != buf);
+
+    pthread_mutex_lock(&dthr->wq_mtx);
+    TSL_BUG_IF_FAILED(work_queue_push(&dthr->wq, buf));
+    pthread_mutex_unlock(&dthr->wq_mtx);
+
+    if (NULL != dthr->pool) {
+        /* Only an idle demodulator needs to be scheduled; a busy one will find the buffer itself */
+        if (0 == atomic_fetch_add(&dthr->pool_nr_pending, 1)) {
+            demod_pool_schedule(dthr->pool, dthr);
+        }
+        goto done;
+    }
+
+    /* Signal there is data ready, if the thread is waiting on the condvar */
+    pthread_cond_signal(&dthr->wq_cv);
+
+done:
+    return ret;
+}
+
+/**
+ * Create the shared memory ring a channel writes its output to. A block has to hold the most a
+ * single flush can write: a full output buffer, or whatever the post-demodulation chain's
+ * resamplers can turn that into.
+ */
+static
+aresult_t _demod_channel_ring_new(struct demod_channel *chan, const char *name, double sample_rate)
+{
+    aresult_t ret = A_OK;
+
+    enum shm_ring_sample_type sample_type = SHM_RING_SAMPLE_REAL_INT_16;
+    size_t block_bytes = sizeof(chan->out_buf);
+
+    switch (chan->demod->output_type) {
+    case DEMOD_OUTPUT_REAL_INT_16:
+        sample_type = SHM_RING_SAMPLE_REAL_INT_16;
+        break;
+    case DEMOD_OUTPUT_COMPLEX_INT_16:
+        sample_type = SHM_RING_SAMPLE_COMPLEX_INT_16;
+        break;
+    case DEMOD_OUTPUT_COMPLEX_INT_8:
+        sample_type = SHM_RING_SAMPLE_COMPLEX_INT_8;
+        break;
+    default:
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (NULL != chan->post_demod) {
+        block_bytes = BL_MAX2(block_bytes, chan->post_demod->resample_buf_len * sizeof(int16_t));
+    }
+
+    ret = shm_ring_new(&chan->out_ring, name, sample_type, (uint32_t)lrint(sample_rate), block_bytes,
+            DEMOD_OUT_RING_NR_BLOCKS);
+
+done:
+    return ret;
+}
+
+/**
+ * Release the resources held by a channel.
+ */
+static
+void _demod_channel_cleanup(struct demod_channel *chan)
+{
+    if (-1 != chan->fifo_fd) {
+        close(chan->fifo_fd);
+        chan->fifo_fd = -1;
+    }
+
+    if (NULL != chan->out_ring) {
+        TSL_BUG_IF_FAILED(shm_ring_delete(&chan->out_ring));
+    }
+
+    if (-1 != chan->debug_signal_fd) {
+        close(chan->debug_signal_fd);
+        chan->debug_signal_fd = -1;
+    }
+
+    if (NULL != chan->demod) {
+        TSL_BUG_IF_FAILED(demod_delete(&chan->demod));
+    }
+
+    if (NULL != chan->post_demod) {
+        TSL_BUG_IF_FAILED(post_demod_delete(&chan->post_demod));
+    }
+
+    if (NULL != chan->decoder) {
+        TSL_BUG_IF_FAILED(decoder_delete(&chan->decoder));
+    }
+}
+
+/**
+ * Release the filters and channels of a demodulator thread.
+ */
+static
+void _demod_thread_cleanup(struct demod_thread *thr)
+{
+    if (DEMOD_NUMERIC_FORMAT_F32 == thr->numeric_format) {
+        if (0 != thr->nr_channels) {
+            TSL_BUG_IF_FAILED(direct_fir_f32_cleanup(&thr->fir_f32));
+        }
+    } else if (1 == thr->nr_channels) {
+        TSL_BUG_IF_FAILED(direct_fir_cleanup(&thr->fir));
+    } else if (1 < thr->nr_channels) {
+        TSL_BUG_IF_FAILED(direct_fir_batch_cleanup(&thr->batch_fir));
+    }
+
+    if (NULL != thr->channels) {
+        for (size_t i = 0; i < thr->nr_channels; i++) {
+            _demod_channel_cleanup(&thr->channels[i]);
+        }
+
+        TFREE(thr->channels);
+    }
+}
+
 aresult_t demod_thread_delete(struct demod_thread **pthr)
 {
     aresult_t ret = A_OK;
@@ -171,16 +575,15 @@ aresult_t demod_thread_delete(struct demod_thread **pthr)
 
     thr = *pthr;
 
-    TSL_BUG_IF_FAILED(worker_thread_request_shutdown(&thr->wthr));
-    TSL_BUG_IF_FAILED(worker_thread_delete(&thr->wthr));
-    TSL_BUG_IF_FAILED(work_queue_release(&thr->wq));
-
-    if (-1 != thr->fifo_fd) {
-        close(thr->fifo_fd);
-        thr->fifo_fd = -1;
+    /* Pooled demodulators don't have a thread of their own; the pool must already be stopped */
+    if (NULL == thr->pool) {
+        TSL_BUG_IF_FAILED(worker_thread_request_shutdown(&thr->wthr));
+        TSL_BUG_IF_FAILED(worker_thread_delete(&thr->wthr));
     }
 
-    TSL_BUG_IF_FAILED(direct_fir_cleanup(&thr->fir));
+    TSL_BUG_IF_FAILED(work_queue_release(&thr->wq));
+
+    _demod_thread_cleanup(thr);
 
     TFREE(thr);
 
@@ -190,23 +593,20 @@ aresult_t demod_thread_delete(struct demod_thread **pthr)
 }
 
 /**
- * Prepare a FIR for channelizing. Converts tuned LPF to a band-pass filter.
+ * Calculate the coefficients of a channelizing FIR. Converts tuned LPF to a band-pass filter.
  *
- * \param thr The thread to attach the FIR to
  * \param lpf_taps The taps for the direct-form FIR. These are real, the filter must be at baseband.
  * \param lpf_nr_taps The number of taps in the direct-form FIR. This is the order of the filter + 1.
  * \param offset_hz The offset, in hertz, from the center frequency
  * \param sample_rate The sample rate of the input stream
- * \param decimation The decimation factor for the output from this FIR.
- *
- * \return A_OK on success, an error code otherwise
+ * \param gain The linear gain to apply to the filter
+ * \param coeffs The Q.15 coefficients, lpf_nr_taps real coefficients followed by lpf_nr_taps
+ *               imaginary coefficients.
  */
 static
-aresult_t _demod_fir_prepare(struct demod_thread *thr, const double *lpf_taps, size_t lpf_nr_taps, int32_t offset_hz, uint32_t sample_rate, int decimation, double gain)
+void _demod_fir_coeffs(const double *lpf_taps, size_t lpf_nr_taps, int32_t offset_hz, uint32_t sample_rate,
+        double gain, int16_t *coeffs)
 {
-    aresult_t ret = A_OK;
-
-    int16_t *coeffs = NULL;
     double f_offs = -2.0 * M_PI * (double)offset_hz / (double)sample_rate;
 #ifdef _DUMP_LPF
     int64_t power = 0;
@@ -216,15 +616,6 @@ aresult_t _demod_fir_prepare(struct demod_thread *thr, const double *lpf_taps, s
 
     DIAG("Preparing LPF for offset %d Hz", offset_hz);
 
-    TSL_ASSERT_ARG(NULL != thr);
-    TSL_ASSERT_ARG(NULL != lpf_taps);
-    TSL_ASSERT_ARG(0 != lpf_nr_taps);
-
-    if (FAILED(ret = TACALLOC((void *)&coeffs, lpf_nr_taps, sizeof(int16_t) * 2, SYS_CACHE_LINE_LENGTH))) {
-        MFM_MSG(SEV_FATAL, "NO-MEM", "Out of memory for FIR.");
-        goto done;
-    }
-
 #ifdef _DUMP_LPF
     fprintf(stderr, "lpf_shifted_%d = [\n", offset_hz);
 #endif /* defined(_DUMP_LPF) */
@@ -256,11 +647,250 @@ aresult_t _demod_fir_prepare(struct demod_thread *thr, const double *lpf_taps, s
     fprintf(stderr, "];\n");
     fprintf(stderr, "%% Total power: %llu (%016llx) (%f)\n", power, power, dpower);
 #endif /* defined(_DUMP_LPF) */
+}
+
+/**
+ * Prepare the float channelizing FIR for a demodulator thread. The band-pass coefficients are
+ * computed the same way as `_demod_fir_coeffs` computes them, but are never quantized.
+ *
+ * \param thr The thread to attach the FIR to
+ * \param lpf_taps The taps for the direct-form FIR. These are real, the filter must be at baseband.
+ * \param lpf_nr_taps The number of taps in the direct-form FIR
+ * \param channel The channel to prepare the filter for
+ * \param sample_rate The sample rate of the input stream
+ * \param decimation The decimation factor for the output from this FIR.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+static
+aresult_t _demod_fir_prepare_f32(struct demod_thread *thr, const double *lpf_taps, size_t lpf_nr_taps,
+        const struct demod_channel_cfg *channel, uint32_t sample_rate, int decimation)
+{
+    aresult_t ret = A_OK;
+
+    float *coeffs = NULL;
+    double f_offs = -2.0 * M_PI * (double)channel->offset_hz / (double)sample_rate;
+
+    if (FAILED(ret = TACALLOC((void *)&coeffs, lpf_nr_taps, sizeof(float) * 2, SYS_CACHE_LINE_LENGTH))) {
+        MFM_MSG(SEV_FATAL, "NO-MEM", "Out of memory for FIR.");
+        goto done;
+    }
+
+    for (size_t i = 0; i < lpf_nr_taps; i++) {
+        const double complex lpf_tap = channel->gain * cexp(CMPLX(0, f_offs * (double)i)) * lpf_taps[i];
+
+        coeffs[              i] = (float)creal(lpf_tap);
+        coeffs[lpf_nr_taps + i] = (float)cimag(lpf_tap);
+    }
+
+    MFM_MSG(SEV_INFO, "FIR-STRATEGY", "Channel at offset %d Hz: %zu float multiplies/sample, complex",
+            channel->offset_hz, direct_fir_cost(DIRECT_FIR_STRATEGY_COMPLEX, lpf_nr_taps, decimation));
+
+    if (FAILED(ret = direct_fir_f32_init(&thr->fir_f32, lpf_nr_taps, coeffs, &coeffs[lpf_nr_taps], decimation,
+                    true, sample_rate, channel->offset_hz)))
+    {
+        MFM_MSG(SEV_FATAL, "NO-MEM", "Out of memory for FIR.");
+        goto done;
+    }
+
+done:
+    if (NULL != coeffs) {
+        TFREE(coeffs);
+    }
+
+    return ret;
+}
+
+/**
+ * Prepare the channelizing FIRs for a demodulator thread. A single channel gets a direct FIR,
+ * multiple channels get a batched FIR that processes every channel per input sample.
+ *
+ * \param thr The thread to attach the FIR to
+ * \param lpf_taps The taps for the direct-form FIR. These are real, the filter must be at baseband.
+ * \param lpf_nr_taps The number of taps in the direct-form FIR. This is the order of the filter + 1.
+ * \param channels The channels to prepare filters for
+ * \param nr_channels The number of channels
+ * \param sample_rate The sample rate of the input stream
+ * \param decimation The decimation factor for the output from this FIR.
+ * \param strategy The requested filter strategy for a single channel
+ * \param fft_threshold The number of taps from which a single channel may switch to fast convolution,
+ *                      if the strategy is automatic and it is cheaper. 0 to never switch.
+ * \param front_end The decimation chain to run ahead of the FIR, or NULL
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+static
+aresult_t _demod_fir_prepare(struct demod_thread *thr, const double *lpf_taps, size_t lpf_nr_taps,
+        const struct demod_channel_cfg *channels, size_t nr_channels, uint32_t sample_rate, int decimation,
+        enum direct_fir_strategy strategy, size_t fft_threshold, const struct demod_front_end_cfg *front_end)
+{
+    aresult_t ret = A_OK;
+
+    int16_t *coeffs = NULL;
+    struct decimation_chain *chain = NULL;
+    const int16_t *real_coeffs[DEMOD_THREAD_MAX_CHANNELS],
+                  *imag_coeffs[DEMOD_THREAD_MAX_CHANNELS];
+    int32_t offsets[DEMOD_THREAD_MAX_CHANNELS];
+
+    TSL_ASSERT_ARG(NULL != thr);
+    TSL_ASSERT_ARG(NULL != lpf_taps);
+    TSL_ASSERT_ARG(0 != lpf_nr_taps);
+    TSL_ASSERT_ARG(0 != nr_channels && nr_channels <= DEMOD_THREAD_MAX_CHANNELS);
+
+    if (DEMOD_NUMERIC_FORMAT_F32 == thr->numeric_format) {
+        if (1 != nr_channels || NULL != front_end) {
+            MFM_MSG(SEV_FATAL, "FLOAT-NOT-SUPPORTED", "Float filtering needs one channel per thread, without a decimation chain.");
+            ret = A_E_INVAL;
+            goto done;
+        }
+
+        if (DIRECT_FIR_STRATEGY_AUTO != strategy && DIRECT_FIR_STRATEGY_COMPLEX != strategy) {
+            MFM_MSG(SEV_WARNING, "FIR-STRATEGY-IGNORED", "Float filtering always uses complex coefficients, ignoring the %s strategy.",
+                    DIRECT_FIR_STRATEGY_FFT == strategy ? "fft" : "mix");
+        }
+
+        ret = _demod_fir_prepare_f32(thr, lpf_taps, lpf_nr_taps, &channels[0], sample_rate, decimation);
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void *)&coeffs, lpf_nr_taps * nr_channels, sizeof(int16_t) * 2, SYS_CACHE_LINE_LENGTH))) {
+        MFM_MSG(SEV_FATAL, "NO-MEM", "Out of memory for FIR.");
+        goto done;
+    }
+
+    if (NULL != front_end) {
+        unsigned chain_factor = 0;
+
+        if (1 != nr_channels) {
+            MFM_MSG(SEV_FATAL, "FRONT-END-BATCHED", "A decimation chain can only be used with one channel per thread.");
+            ret = A_E_INVAL;
+            goto done;
+        }
+
+        if (FAILED(ret = decimation_chain_new(&chain, front_end->type, front_end->factors, front_end->nr_factors))) {
+            MFM_MSG(SEV_FATAL, "BAD-DECIMATION-CHAIN", "Failed to create decimation chain.");
+            goto done;
+        }
+
+        chain_factor = decimation_chain_factor(chain);
+
+        if (0 != decimation % chain_factor) {
+            MFM_MSG(SEV_FATAL, "BAD-DECIMATION-CHAIN", "Decimation chain factor %u does not divide decimation factor %d",
+                    chain_factor, decimation);
+            ret = A_E_INVAL;
+            goto done;
+        }
+
+        for (size_t i = 0; i < lpf_nr_taps; i++) {
+            coeffs[i] = (int16_t)(channels[0].gain * lpf_taps[i] * (double)(1ll << Q_15_SHIFT));
+        }
+
+        /* Costs are per output sample of the whole channel filter */
+        MFM_MSG(SEV_INFO, "FIR-STRATEGY", "Channel at offset %d Hz: %zu multiplies/sample complex, %zu with a /%u %s front end",
+                channels[0].offset_hz, direct_fir_cost(DIRECT_FIR_STRATEGY_COMPLEX, lpf_nr_taps, decimation),
+                decimation_chain_cost(chain) * decimation + 4 * decimation +
+                    2 * fir_fold_nr_mults(coeffs, lpf_nr_taps),
+                chain_factor, DECIMATION_CHAIN_CIC == front_end->type ? "CIC" : "halfband");
+
+        if (DIRECT_FIR_STRATEGY_COMPLEX == strategy || DIRECT_FIR_STRATEGY_FFT == strategy) {
+            MFM_MSG(SEV_WARNING, "FIR-STRATEGY-IGNORED", "A decimation chain needs the mix strategy, ignoring the %s strategy.",
+                    DIRECT_FIR_STRATEGY_FFT == strategy ? "fft" : "complex");
+        }
+
+        if (FAILED(ret = direct_fir_init_mix(&thr->fir, lpf_nr_taps, coeffs, decimation / chain_factor, sample_rate,
+                        channels[0].offset_hz)))
+        {
+            MFM_MSG(SEV_FATAL, "NO-MEM", "Out of memory for FIR.");
+            goto done;
+        }
+
+        TSL_BUG_IF_FAILED(direct_fir_set_front_end(&thr->fir, chain));
+        chain = NULL;
 
-    /* Create a Direct Type FIR implementation */
-    TSL_BUG_IF_FAILED(direct_fir_init(&thr->fir, lpf_nr_taps, coeffs, &coeffs[base], decimation, true, sample_rate, offset_hz));
+        goto done;
+    }
+
+    if (1 == nr_channels) {
+        size_t cplx_cost = direct_fir_cost(DIRECT_FIR_STRATEGY_COMPLEX, lpf_nr_taps, decimation),
+               mix_cost = 0,
+               fft_cost = direct_fir_cost(DIRECT_FIR_STRATEGY_FFT, lpf_nr_taps, decimation);
+
+        /* The mixing FIR folds symmetric taps, so only count the multiplies it actually does */
+        for (size_t i = 0; i < lpf_nr_taps; i++) {
+            coeffs[i] = (int16_t)(channels[0].gain * lpf_taps[i] * (double)(1ll << Q_15_SHIFT));
+        }
+
+        mix_cost = direct_fir_cost(DIRECT_FIR_STRATEGY_MIX, fir_fold_nr_mults(coeffs, lpf_nr_taps), decimation);
+
+        if (DIRECT_FIR_STRATEGY_AUTO == strategy) {
+            strategy = mix_cost < cplx_cost ? DIRECT_FIR_STRATEGY_MIX : DIRECT_FIR_STRATEGY_COMPLEX;
+
+            /* Fast convolution adds a block of latency, so only consider it for long filters */
+            if (0 != fft_threshold && lpf_nr_taps >= fft_threshold &&
+                    fft_cost < BL_MIN2(cplx_cost, mix_cost))
+            {
+                strategy = DIRECT_FIR_STRATEGY_FFT;
+            }
+        }
+
+        MFM_MSG(SEV_INFO, "FIR-STRATEGY", "Channel at offset %d Hz: %zu multiplies/sample complex, %zu mix-then-filter, "
+                "%zu fast convolution, using %s",
+                channels[0].offset_hz, cplx_cost, mix_cost, fft_cost,
+                DIRECT_FIR_STRATEGY_MIX == strategy ? "mix-then-filter" :
+                    DIRECT_FIR_STRATEGY_FFT == strategy ? "fast convolution" : "complex");
+    } else if (DIRECT_FIR_STRATEGY_MIX == strategy || DIRECT_FIR_STRATEGY_FFT == strategy) {
+        MFM_MSG(SEV_WARNING, "FIR-STRATEGY-IGNORED", "Batched channels always use complex coefficients, ignoring the %s strategy.",
+                DIRECT_FIR_STRATEGY_FFT == strategy ? "fft" : "mix");
+    }
+
+    if (1 == nr_channels && DIRECT_FIR_STRATEGY_MIX == strategy) {
+        /* The mixer takes care of the frequency shift, so the real taps scaled above are used as-is */
+        if (FAILED(ret = direct_fir_init_mix(&thr->fir, lpf_nr_taps, coeffs, decimation, sample_rate,
+                        channels[0].offset_hz)))
+        {
+            MFM_MSG(SEV_FATAL, "NO-MEM", "Out of memory for FIR.");
+        }
+
+        goto done;
+    }
+
+    for (size_t i = 0; i < nr_channels; i++) {
+        int16_t *chan_coeffs = &coeffs[2 * lpf_nr_taps * i];
+
+        _demod_fir_coeffs(lpf_taps, lpf_nr_taps, channels[i].offset_hz, sample_rate, channels[i].gain, chan_coeffs);
+
+        real_coeffs[i] = chan_coeffs;
+        imag_coeffs[i] = &chan_coeffs[lpf_nr_taps];
+        offsets[i] = channels[i].offset_hz;
+    }
+
+    if (1 == nr_channels && DIRECT_FIR_STRATEGY_FFT == strategy) {
+        /* Filter, decimate and derotate in the frequency domain */
+        if (FAILED(ret = direct_fir_init_fft(&thr->fir, lpf_nr_taps, real_coeffs[0], imag_coeffs[0], decimation,
+                        sample_rate, offsets[0])))
+        {
+            MFM_MSG(SEV_FATAL, "NO-MEM", "Out of memory for fast convolution FIR.");
+            goto done;
+        }
+    } else if (1 == nr_channels) {
+        /* Create a Direct Type FIR implementation */
+        TSL_BUG_IF_FAILED(direct_fir_init(&thr->fir, lpf_nr_taps, real_coeffs[0], imag_coeffs[0], decimation, true,
+                    sample_rate, offsets[0]));
+    } else {
+        /* Create a batch of Direct Type FIRs, sharing the input samples */
+        if (FAILED(ret = direct_fir_batch_init(&thr->batch_fir, nr_channels, lpf_nr_taps, real_coeffs, imag_coeffs,
+                        decimation, true, sample_rate, offsets)))
+        {
+            MFM_MSG(SEV_FATAL, "NO-MEM", "Out of memory for batched FIR.");
+            goto done;
+        }
+    }
 
 done:
+    if (NULL != chain) {
+        TSL_BUG_IF_FAILED(decimation_chain_delete(&chain));
+    }
+
     if (NULL != coeffs) {
         TFREE(coeffs);
     }
@@ -269,20 +899,28 @@ done:
 }
 
 aresult_t demod_thread_new(struct demod_thread **pthr, unsigned core_id,
-        int32_t offset_hz, uint32_t samp_hz, const char *out_fifo, int decimation_factor,
+        uint32_t samp_hz, int decimation_factor,
         const double *lpf_taps, size_t lpf_nr_taps,
-        const char *fir_debug_output,
-        double channel_gain)
+        const struct demod_channel_cfg *channels, size_t nr_channels,
+        enum direct_fir_strategy strategy, size_t fft_threshold, const struct demod_front_end_cfg *front_end,
+        enum demod_numeric_format numeric_format, struct demod_pool *pool)
 {
     aresult_t ret = A_OK;
 
     struct demod_thread *thr = NULL;
 
     TSL_ASSERT_ARG(NULL != pthr);
-    TSL_ASSERT_ARG(NULL != out_fifo && '\0' != *out_fifo);
     TSL_ASSERT_ARG(0 != decimation_factor);
     TSL_ASSERT_ARG(NULL != lpf_taps);
     TSL_ASSERT_ARG(0 != lpf_nr_taps);
+    TSL_ASSERT_ARG(NULL != channels);
+    TSL_ASSERT_ARG(0 != nr_channels && nr_channels <= DEMOD_THREAD_MAX_CHANNELS);
+
+    for (size_t i = 0; i < nr_channels; i++) {
+        TSL_ASSERT_ARG((NULL != channels[i].out_fifo && '\0' != *channels[i].out_fifo) ||
+                (NULL != channels[i].out_ring && '\0' != *channels[i].out_ring) ||
+                NULL != channels[i].decoder);
+    }
 
     *pthr = NULL;
 
@@ -290,8 +928,15 @@ aresult_t demod_thread_new(struct demod_thread **pthr, unsigned core_id,
         goto done;
     }
 
-    thr->fifo_fd = -1;
-    thr->debug_signal_fd = -1;
+    if (FAILED(ret = TACALLOC((void **)&thr->channels, nr_channels, sizeof(struct demod_channel), SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < nr_channels; i++) {
+        thr->channels[i].fifo_fd = -1;
+        thr->channels[i].debug_signal_fd = -1;
+        thr->batch_out[i] = thr->channels[i].filt_samp_buf;
+    }
 
     /* Initialize the work queue */
     if (FAILED(ret = work_queue_new(&thr->wq, 128))) {
@@ -311,45 +956,120 @@ aresult_t demod_thread_new(struct demod_thread **pthr, unsigned core_id,
     }
 
     /* Initialize the filter */
-    if (FAILED(ret = _demod_fir_prepare(thr, lpf_taps, lpf_nr_taps, offset_hz, samp_hz, decimation_factor, channel_gain))) {
+    thr->numeric_format = numeric_format;
+
+    if (FAILED(ret = _demod_fir_prepare(thr, lpf_taps, lpf_nr_taps, channels, nr_channels, samp_hz, decimation_factor,
+                    strategy, fft_threshold, front_end)))
+    {
         goto done;
     }
 
-    /* Set up the demodulator */
-    TSL_BUG_IF_FAILED(multifm_fm_demod_init(&thr->demod));
+    thr->nr_channels = nr_channels;
+
+    thr->fused = true;
+
+    for (size_t i = 0; i < nr_channels; i++) {
+        struct demod_channel *chan = &thr->channels[i];
+        const char *fir_debug_output = channels[i].fir_debug_output;
 
-    /* Open the debug output file, if applicable */
-    if (NULL != fir_debug_output && '\0' != *fir_debug_output) {
-        if (0 > (thr->debug_signal_fd = open(fir_debug_output, O_WRONLY))) {
+        /* Set up the demodulator */
+        if (DEMOD_NUMERIC_FORMAT_F32 == numeric_format && NULL == channels[i].demod->process_f32) {
+            MFM_MSG(SEV_ERROR, "DEMOD-NO-FLOAT", "The '%s' demodulator can't work on float samples.",
+                    channels[i].demod->name);
             ret = A_E_INVAL;
-            MFM_MSG(SEV_FATAL, "CANT-OPEN-SIGNAL-DEBUG", "Unable to open signal debug dump file '%s'", fir_debug_output);
             goto done;
         }
+
+        if (FAILED(ret = demod_new(&chan->demod, channels[i].demod, &channels[i].demod_params))) {
+            MFM_MSG(SEV_ERROR, "CANT-CREATE-DEMOD", "Failed to create the '%s' demodulator.",
+                    channels[i].demod->name);
+            goto done;
+        }
+
+        /* Set up the post-demodulation chain, which only works on PCM */
+        if (0 != channels[i].post_demod.nr_stages) {
+            if (DEMOD_OUTPUT_REAL_INT_16 != chan->demod->output_type) {
+                MFM_MSG(SEV_ERROR, "POST-DEMOD-NOT-PCM", "The '%s' demodulator doesn't put out PCM, so it can't "
+                        "have post-demodulation stages.", channels[i].demod->name);
+                ret = A_E_INVAL;
+                goto done;
+            }
+
+            if (FAILED(ret = post_demod_new(&chan->post_demod, &channels[i].post_demod, LPF_OUTPUT_LEN,
+                            (double)samp_hz / (double)decimation_factor)))
+            {
+                MFM_MSG(SEV_ERROR, "CANT-CREATE-POST-DEMOD", "Failed to create the post-demodulation chain.");
+                goto done;
+            }
+        }
+
+        /* Set up the protocol decoder, which also only works on PCM */
+        if (NULL != channels[i].decoder) {
+            if (DEMOD_OUTPUT_REAL_INT_16 != chan->demod->output_type) {
+                MFM_MSG(SEV_ERROR, "DECODER-NOT-PCM", "The '%s' demodulator doesn't put out PCM, so it can't "
+                        "feed a decoder.", channels[i].demod->name);
+                ret = A_E_INVAL;
+                goto done;
+            }
+
+            if (FAILED(ret = decoder_new(&chan->decoder, channels[i].decoder, channels[i].freq_hz))) {
+                MFM_MSG(SEV_ERROR, "CANT-CREATE-DECODER", "Failed to create the '%s' decoder.",
+                        channels[i].decoder->name);
+                goto done;
+            }
+        }
+
+        /* Open the debug output file, if applicable */
+        if (NULL != fir_debug_output && '\0' != *fir_debug_output) {
+            if (0 > (chan->debug_signal_fd = open(fir_debug_output, O_WRONLY))) {
+                ret = A_E_INVAL;
+                MFM_MSG(SEV_FATAL, "CANT-OPEN-SIGNAL-DEBUG", "Unable to open signal debug dump file '%s'", fir_debug_output);
+                goto done;
+            }
+
+            /* Dumping the filtered signal needs whole buffers of it, so it can't be fused */
+            thr->fused = false;
+        }
+
+        /* Open the output FIFO, if the samples are going anywhere other than the decoder */
+        if (NULL != channels[i].out_fifo && 0 > (chan->fifo_fd = open(channels[i].out_fifo, O_WRONLY))) {
+            ret = A_E_INVAL;
+            MFM_MSG(SEV_FATAL, "CANT-OPEN-FIFO", "Unable to open output fifo '%s'", channels[i].out_fifo);
+            goto done;
+        }
+
+        /* Create the output ring, which doesn't wait for a reader to show up */
+        if (NULL != channels[i].out_ring) {
+            if (FAILED(ret = _demod_channel_ring_new(chan, channels[i].out_ring,
+                            post_demod_output_rate(&channels[i].post_demod, (double)samp_hz / (double)decimation_factor))))
+            {
+                MFM_MSG(SEV_FATAL, "CANT-CREATE-RING", "Unable to create output ring '%s'", channels[i].out_ring);
+                goto done;
+            }
+        }
     }
 
-    /* Open the output FIFO */
-    if (0 > (thr->fifo_fd = open(out_fifo, O_WRONLY))) {
-        ret = A_E_INVAL;
-        MFM_MSG(SEV_FATAL, "CANT-OPEN-FIFO", "Unable to open output fifo '%s'", out_fifo);
-        goto done;
+    if (1 < nr_channels) {
+        DIAG("Demodulator thread handles %zu channels with a batched FIR", nr_channels);
     }
 
     list_init(&thr->dt_node);
 
-    TSL_BUG_IF_FAILED(worker_thread_new(&thr->wthr, _demod_thread_work, core_id));
+    if (NULL != pool) {
+        if (FAILED(ret = demod_pool_add(pool, thr))) {
+            goto done;
+        }
+        thr->pool = pool;
+    } else {
+        TSL_BUG_IF_FAILED(worker_thread_new(&thr->wthr, _demod_thread_work, core_id));
+    }
 
     *pthr = thr;
 
 done:
     if (FAILED(ret)) {
         if (NULL != thr) {
-            if (-1 != thr->fifo_fd) {
-                close(thr->fifo_fd);
-                thr->fifo_fd = -1;
-            }
-
-            TSL_BUG_IF_FAILED(direct_fir_cleanup(&thr->fir));
-
+            _demod_thread_cleanup(thr);
             TFREE(thr);
         }
     }
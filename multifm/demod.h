@@ -5,17 +5,199 @@
 #include <tsl/worker_thread.h>
 
 #include <filter/direct_fir.h>
+#include <filter/direct_fir_batch.h>
+#include <filter/direct_fir_f32.h>
+#include <filter/decimation_chain.h>
 #include <filter/dc_blocker.h>
 
+#include <multifm/demod_base.h>
+#include <multifm/post_demod.h>
+
 #include <pthread.h>
+#include <stdatomic.h>
 
 #define LPF_OUTPUT_LEN              1024
 
+/**
+ * The number of blocks in a channel's shared memory output ring. Each block holds one flush of
+ * the channel's output buffer.
+ */
+#define DEMOD_OUT_RING_NR_BLOCKS    128
+
 struct polyphase_fir;
-struct demod_base;
+struct decoder;
+struct decoder_protocol;
+struct demod_pool;
+struct broadcast_ring;
+struct shm_ring;
+struct sample_buf;
+
+/**
+ * The number format a demodulator thread filters and demodulates in
+ */
+enum demod_numeric_format {
+    /**
+     * Q.15 samples and coefficients, with any of the direct FIR strategies
+     */
+    DEMOD_NUMERIC_FORMAT_Q15 = 0,
+
+    /**
+     * Float samples and coefficients, with a `struct direct_fir_f32`. Only one channel per
+     * thread, without a decimation chain.
+     */
+    DEMOD_NUMERIC_FORMAT_F32 = 1,
+};
 
 /**
- * Demodulator thread context
+ * Configuration for a single channel handled by a demodulator thread
+ */
+struct demod_channel_cfg {
+    /**
+     * Offset of the channel from the center of the input stream, in Hz
+     */
+    int32_t offset_hz;
+
+    /**
+     * Path to the output FIFO, or NULL if the channel doesn't write to one
+     */
+    const char *out_fifo;
+
+    /**
+     * Name of the shared memory ring to write the output to, or NULL if the channel doesn't
+     * write to one
+     */
+    const char *out_ring;
+
+    /**
+     * Path to dump the filtered signal to, or NULL
+     */
+    const char *fir_debug_output;
+
+    /**
+     * The gain of the channelizing FIR, expressed in linear units
+     */
+    double gain;
+
+    /**
+     * The demodulator for this channel
+     */
+    const struct demod_ops *demod;
+
+    /**
+     * The parameters for the demodulator
+     */
+    struct demod_params demod_params;
+
+    /**
+     * The stages the demodulated samples go through before they are written out. Only valid
+     * for demodulators that put out real PCM.
+     */
+    struct post_demod_cfg post_demod;
+
+    /**
+     * The protocol decoder to run on the channel's PCM, or NULL for none
+     */
+    const struct decoder_protocol *decoder;
+
+    /**
+     * The center frequency of the channel, in Hz. Reported with every decoded message.
+     */
+    uint32_t freq_hz;
+};
+
+/**
+ * Configuration for a decimation chain that runs ahead of a channel's FIR
+ */
+struct demod_front_end_cfg {
+    /**
+     * The type of decimation chain
+     */
+    enum decimation_chain_type type;
+
+    /**
+     * The decimation factor of each stage of the chain
+     */
+    const unsigned *factors;
+
+    /**
+     * The number of stages in the chain
+     */
+    size_t nr_factors;
+};
+
+/**
+ * Per-channel demodulator state
+ */
+struct demod_channel {
+    /**
+     * The file descriptor for the output FIFO, or -1 if there isn't one
+     */
+    int fifo_fd;
+
+    /**
+     * The shared memory ring the output is written to, or NULL if there isn't one
+     */
+    struct shm_ring *out_ring;
+
+    /**
+     * The file descriptor for dumping the filtered signal
+     */
+    int debug_signal_fd;
+
+    /**
+     * Demodulator state
+     */
+    struct demod_base *demod;
+
+    /**
+     * The chain the demodulated samples go through before they are written out, or NULL
+     */
+    struct post_demod *post_demod;
+
+    /**
+     * The protocol decoder the channel's PCM is fed to, or NULL
+     */
+    struct decoder *decoder;
+
+    /**
+     * Total number of PCM samples generated
+     */
+    size_t total_nr_pcm_samples;
+
+    /**
+     * Number of samples dropped on the floor
+     */
+    size_t nr_dropped_samples;
+
+    /**
+     * Number of good PCM samples
+     */
+    size_t nr_pcm_samples;
+
+    /**
+     * Number of bytes of demodulated samples in the output buffer
+     */
+    size_t nr_out_bytes;
+
+    /**
+     * Filtered samples to be processed, in the thread's numeric format
+     */
+    union {
+        int16_t filt_samp_buf[2 * LPF_OUTPUT_LEN];
+        float filt_samp_buf_f32[2 * LPF_OUTPUT_LEN];
+    };
+
+    /**
+     * Output demodulated sample buffer, big enough for LPF_OUTPUT_LEN samples of the widest
+     * output type (16-bit I/Q)
+     */
+    uint8_t out_buf[LPF_OUTPUT_LEN * 2 * sizeof(int16_t)];
+};
+
+/**
+ * Demodulator thread context. A demodulator thread filters and demodulates a group of channels
+ * that share an input stream. If there is more than one channel in the group, the channel
+ * filters are computed together with a batched FIR, so each input sample is only read once.
  */
 struct demod_thread {
     /**
@@ -24,19 +206,34 @@ struct demod_thread {
     struct work_queue wq CAL_CACHE_ALIGNED;
 
     /**
-     * The FIR filter being applied by this thread (usually for baseband selection)
+     * The FIR filter being applied by this thread (usually for baseband selection), if this
+     * thread handles a single channel
      */
     struct direct_fir fir;
 
     /**
-     * The file descriptor for the output FIFO
+     * The batched FIR filter being applied by this thread, if this thread handles more than
+     * one channel
      */
-    int fifo_fd;
+    struct direct_fir_batch batch_fir;
 
     /**
-     * The file descriptor for dumping the filtered signal
+     * The float FIR filter being applied by this thread, if it works in
+     * DEMOD_NUMERIC_FORMAT_F32. Always a single channel.
      */
-    int debug_signal_fd;
+    struct direct_fir_f32 fir_f32;
+
+    /**
+     * The number format this thread filters and demodulates in
+     */
+    enum demod_numeric_format numeric_format;
+
+    /**
+     * Whether the channels are demodulated a tile at a time, as soon as each tile has been
+     * filtered, rather than a whole buffer at a time. Only turned off if a channel dumps its
+     * filtered signal.
+     */
+    bool fused;
 
     /**
      * Mutex for the work queue. Always must be held while manipulating it.
@@ -51,67 +248,140 @@ struct demod_thread {
     pthread_cond_t wq_cv;
 
     /**
-     * Demodulator worker thread state
+     * Demodulator worker thread state. Not used if the demodulator runs in a pool.
      */
     struct worker_thread wthr;
 
     /**
-     * Demodulator state
+     * The broadcast ring this demodulator's worker thread takes sample buffers from, if the
+     * samples aren't delivered through the work queue
      */
-    struct demod_base *demod;
+    struct broadcast_ring *_Atomic ring;
 
     /**
-     * Linked list node demodulator thread
+     * This demodulator's consumer ID for the broadcast ring
      */
-    struct list_entry dt_node;
+    unsigned ring_consumer;
 
     /**
-     * Total number of samples demodulated
+     * The pool this demodulator runs in, or NULL if it has its own worker thread
      */
-    size_t total_nr_demod_samples;
+    struct demod_pool *pool;
 
     /**
-     * Total number of PCM samples generated
+     * The number of sample buffers delivered but not yet processed. Only maintained for
+     * demodulators in a pool.
      */
-    size_t total_nr_pcm_samples;
+    atomic_size_t pool_nr_pending;
 
     /**
-     * Number of samples dropped on the floor
+     * The pool worker this demodulator is scheduled on
      */
-    size_t nr_dropped_samples;
+    atomic_uint pool_owner;
+
+    /**
+     * Moving average of the time taken to process a sample buffer, in nanoseconds
+     */
+    _Atomic uint64_t pool_avg_ns;
 
     /**
-     * Number of FM signal samples available
+     * Linked list node demodulator thread
      */
-    size_t nr_fm_samples;
+    struct list_entry dt_node;
 
     /**
-     * Filtered samples to be processed
+     * Total number of samples demodulated
      */
-    int16_t filt_samp_buf[2 * LPF_OUTPUT_LEN];
+    size_t total_nr_demod_samples;
 
     /**
-     * Number of good PCM samples
+     * The number of channels this thread handles
      */
-    size_t nr_pcm_samples;
+    size_t nr_channels;
 
     /**
-     * Output demodulated sample buffer
+     * The state of each channel
      */
-    int16_t out_buf[LPF_OUTPUT_LEN];
+    struct demod_channel *channels;
+
+    /**
+     * Output pointers for the batched FIR, one per channel
+     */
+    int16_t *batch_out[DIRECT_FIR_BATCH_MAX_CHANNELS];
 };
 
 aresult_t demod_thread_delete(struct demod_thread **pthr);
 
+/**
+ * The maximum number of channels a single demodulator thread can handle
+ */
+#define DEMOD_THREAD_MAX_CHANNELS       DIRECT_FIR_BATCH_MAX_CHANNELS
+
 /**
  * Create a new demodulation thread.
  *
- * \param demod_gain The gain of the channelizing FIR, expressed in linear units.
+ * \param pthr The new thread, returned by reference
+ * \param core_id The core to run the thread on
+ * \param samp_hz The sample rate of the input stream
+ * \param decimation_factor The overall decimation factor of the channel filters, including the
+ *                          front end decimation chain, if any
+ * \param lpf_taps The real low-pass filter taps, shifted to each channel's offset. If there is a
+ *                 front end, these are designed for the front end's output rate.
+ * \param lpf_nr_taps The number of low-pass filter taps
+ * \param channels The configuration of each channel this thread will demodulate. All channels
+ *                 must share the same input stream.
+ * \param nr_channels The number of channels, at most DEMOD_THREAD_MAX_CHANNELS.
+ * \param strategy How a single-channel thread should filter its channel. Threads handling
+ *                 more than one channel always use complex coefficients with a batched FIR.
+ * \param fft_threshold The number of taps at or above which a single-channel thread switches to fast
+ *                      convolution, when the strategy is DIRECT_FIR_STRATEGY_AUTO and fast
+ *                      convolution is the cheapest. 0 to disable.
+ * \param front_end The decimation chain to run ahead of the channel FIR, or NULL for none. Only
+ *                  valid for single-channel threads, and forces the mix strategy.
+ * \param numeric_format The number format to filter and demodulate in. The strategy is ignored
+ *                       for DEMOD_NUMERIC_FORMAT_F32.
+ * \param pool The worker pool to run the demodulator in, or NULL to give the demodulator its own
+ *             worker thread on core_id.
  *
+ * \return A_OK on success, an error code otherwise.
  */
 aresult_t demod_thread_new(struct demod_thread **pthr, unsigned core_id,
-        int32_t offset_hz, uint32_t samp_hz, const char *out_fifo, int decimation_factor,
+        uint32_t samp_hz, int decimation_factor,
         const double *lpf_taps, size_t lpf_nr_taps,
-        const char *fir_debug_output,
-        double channel_gain);
+        const struct demod_channel_cfg *channels, size_t nr_channels,
+        enum direct_fir_strategy strategy, size_t fft_threshold, const struct demod_front_end_cfg *front_end,
+        enum demod_numeric_format numeric_format, struct demod_pool *pool);
+
+/**
+ * Process every sample buffer pending for a demodulator that runs in a pool. Called by the pool
+ * workers; a demodulator is only ever run by one worker at a time.
+ *
+ * \param dthr The demodulator
+ *
+ * \return The number of sample buffers processed
+ */
+size_t demod_thread_run_pending(struct demod_thread *dthr);
+
+/**
+ * Have a demodulator thread take its sample buffers from a broadcast ring, rather than having
+ * them handed over with `demod_thread_deliver`. Must be called before anything is published to
+ * the ring. Not valid for demodulators that run in a pool.
+ *
+ * \param dthr The demodulator thread
+ * \param ring The ring to consume from
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t demod_thread_attach_ring(struct demod_thread *dthr, struct broadcast_ring *ring);
+
+/**
+ * Hand a sample buffer to a demodulator thread, and wake the thread up. The caller must
+ * already hold a reference on the buffer on behalf of this thread.
+ *
+ * \param dthr The demodulator thread
+ * \param buf The sample buffer to process
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t demod_thread_deliver(struct demod_thread *dthr, struct sample_buf *buf);
 
@@ -1,6 +1,140 @@
 #pragma once
 
+#include <tsl/result.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct demod_base;
+
+/**
+ * The kind of samples a demodulator writes out
+ */
+enum demod_output_type {
+    /**
+     * Real 16-bit PCM, one value per sample
+     */
+    DEMOD_OUTPUT_REAL_INT_16 = 0,
+
+    /**
+     * Interleaved 16-bit I/Q, in Q.15
+     */
+    DEMOD_OUTPUT_COMPLEX_INT_16 = 1,
+
+    /**
+     * Interleaved signed 8-bit I/Q, scaled so Q.15 full scale is 8-bit full scale
+     */
+    DEMOD_OUTPUT_COMPLEX_INT_8 = 2,
+};
+
+/**
+ * Parameters for a demodulator. Each demodulator only looks at the ones that apply to it.
+ */
+struct demod_params {
+    /**
+     * FM: use the fixed-point CORDIC discriminator, rather than the polynomial over floats
+     */
+    bool integer_discriminator;
+
+    /**
+     * Raw I/Q: the width of each output component, 8 or 16 bits
+     */
+    unsigned iq_output_bits;
+
+    /**
+     * Costas: the initial frequency offset of the carrier, in cycles per sample
+     */
+    float costas_f_shift;
+
+    /**
+     * Costas: the loop's proportional and integral gains
+     */
+    float costas_alpha;
+    float costas_beta;
+
+    /**
+     * Costas: the largest phase error the loop will act on, in Q.15
+     */
+    int16_t costas_e_max;
+};
+
+/**
+ * The operations a demodulator implements. A demodulator takes filtered, baseband complex
+ * samples, and writes out samples of its output type.
+ */
+struct demod_ops {
+    /**
+     * The name the demodulator goes by in the configuration
+     */
+    const char *name;
+
+    /**
+     * Create a demodulator. The `ops` and `output_type` of the demodulator base are filled in.
+     */
+    aresult_t (*init)(struct demod_base **pdemod, const struct demod_params *params);
+
+    /**
+     * Demodulate interleaved Q.15 I/Q samples. The output buffer must have room for
+     * nr_in_samples samples of the demodulator's output type.
+     */
+    aresult_t (*process)(struct demod_base *demod, const int16_t *in_samples, size_t nr_in_samples,
+            void *out, size_t *pnr_out_samples, size_t *pnr_out_bytes);
+
+    /**
+     * Demodulate interleaved float I/Q samples, with full scale at +/-1.0. NULL if the
+     * demodulator can't work on float samples.
+     */
+    aresult_t (*process_f32)(struct demod_base *demod, const float *in_samples, size_t nr_in_samples,
+            void *out, size_t *pnr_out_samples, size_t *pnr_out_bytes);
+
+    /**
+     * Release the demodulator
+     */
+    aresult_t (*cleanup)(struct demod_base **pdemod);
+};
+
+/**
+ * Common state every demodulator starts with
+ */
 struct demod_base {
+    /**
+     * The operations for this demodulator
+     */
+    const struct demod_ops *ops;
 
+    /**
+     * The kind of samples this demodulator writes out
+     */
+    enum demod_output_type output_type;
 };
 
+/**
+ * Find a demodulator by name.
+ *
+ * \param name The name of the demodulator, such as "fm"
+ *
+ * \return The demodulator's operations, or NULL if there is no demodulator by that name
+ */
+const struct demod_ops *demod_find(const char *name);
+
+/**
+ * Create a demodulator.
+ *
+ * \param pdemod The new demodulator, returned by reference
+ * \param ops The demodulator to create, from `demod_find`
+ * \param params The demodulator's parameters
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t demod_new(struct demod_base **pdemod, const struct demod_ops *ops, const struct demod_params *params);
+
+/**
+ * Release a demodulator created with `demod_new`.
+ */
+aresult_t demod_delete(struct demod_base **pdemod);
+
+/**
+ * Get the size of a single output sample of the given type, in bytes
+ */
+size_t demod_output_sample_bytes(enum demod_output_type type);
@@ -0,0 +1,551 @@
+/*
+ *  demod_pool.c - A pool of worker threads that run demodulators as units of work
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <multifm/demod_pool.h>
+#include <multifm/demod.h>
+#include <multifm/multifm.h>
+
+#include <tsl/worker_thread.h>
+#include <tsl/safe_alloc.h>
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * How often the home workers of the demodulators are rebalanced, in nanoseconds
+ */
+#define DEMOD_POOL_REBALANCE_NS         1000000000ull
+
+/**
+ * How long an idle worker sleeps before looking for work to steal, in nanoseconds
+ */
+#define DEMOD_POOL_IDLE_WAIT_NS         10000000ull
+
+/**
+ * The weight of a new measurement in the processing time average, as a shift (1/8)
+ */
+#define DEMOD_POOL_EWMA_SHIFT           3
+
+/**
+ * A single pool worker
+ */
+struct demod_pool_worker {
+    /**
+     * Lock protecting the ready queue. Always must be held while manipulating it.
+     */
+    pthread_mutex_t mtx CAL_CACHE_ALIGNED;
+
+    /**
+     * Condition variable signalled when a demodulator is made ready on this worker
+     */
+    pthread_cond_t cv;
+
+    /**
+     * Ring of demodulators with work pending, whose home is this worker
+     */
+    struct demod_thread **ready;
+
+    /**
+     * Index of the head of the ready ring
+     */
+    size_t ready_head;
+
+    /**
+     * Number of demodulators in the ready ring
+     */
+    size_t nr_ready;
+
+    /**
+     * The worker thread
+     */
+    struct worker_thread wthr;
+
+    /**
+     * The pool this worker belongs to
+     */
+    struct demod_pool *pool;
+
+    /**
+     * Index of this worker in the pool
+     */
+    size_t id;
+
+    /**
+     * Number of times this worker ran a demodulator
+     */
+    size_t nr_runs;
+
+    /**
+     * Number of times this worker stole a demodulator from another worker
+     */
+    size_t nr_steals;
+};
+
+struct demod_pool {
+    /**
+     * The workers
+     */
+    struct demod_pool_worker *workers;
+
+    /**
+     * The number of workers
+     */
+    size_t nr_workers;
+
+    /**
+     * The core each worker is pinned to
+     */
+    int cores[DEMOD_POOL_MAX_WORKERS];
+
+    /**
+     * Every demodulator attached to the pool
+     */
+    struct demod_thread **units;
+
+    /**
+     * The number of demodulators attached to the pool
+     */
+    size_t nr_units;
+
+    /**
+     * The capacity of units
+     */
+    size_t units_cap;
+
+    /**
+     * Time of the last rebalance, in nanoseconds. Only touched by worker 0.
+     */
+    uint64_t last_rebalance_ns;
+
+    /**
+     * Number of times a demodulator was moved to a new home worker
+     */
+    size_t nr_moves;
+
+    /**
+     * The number of workers that have been started
+     */
+    size_t nr_started;
+};
+
+static inline
+uint64_t _demod_pool_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Take a ready demodulator off a worker's ring. The owner takes from the head, thieves take from
+ * the tail, so the thief gets the demodulator that has waited the least.
+ */
+static
+struct demod_thread *_demod_pool_worker_take(struct demod_pool_worker *w, bool steal)
+{
+    struct demod_thread *dthr = NULL;
+    size_t cap = w->pool->nr_units;
+
+    pthread_mutex_lock(&w->mtx);
+
+    if (0 != w->nr_ready) {
+        if (false == steal) {
+            dthr = w->ready[w->ready_head];
+            w->ready_head = (w->ready_head + 1) % cap;
+        } else {
+            dthr = w->ready[(w->ready_head + w->nr_ready - 1) % cap];
+        }
+        w->nr_ready--;
+    }
+
+    pthread_mutex_unlock(&w->mtx);
+
+    return dthr;
+}
+
+/**
+ * Find another worker with a backlog, and steal a demodulator from it.
+ */
+static
+struct demod_thread *_demod_pool_steal(struct demod_pool_worker *w)
+{
+    struct demod_pool *pool = w->pool;
+    struct demod_thread *dthr = NULL;
+
+    for (size_t i = 1; i < pool->nr_workers && NULL == dthr; i++) {
+        struct demod_pool_worker *victim = &pool->workers[(w->id + i) % pool->nr_workers];
+
+        /* Peek without the lock, to avoid bouncing the lock of every idle worker around */
+        if (0 == __atomic_load_n(&victim->nr_ready, __ATOMIC_RELAXED)) {
+            continue;
+        }
+
+        dthr = _demod_pool_worker_take(victim, true);
+    }
+
+    if (NULL != dthr) {
+        w->nr_steals++;
+    }
+
+    return dthr;
+}
+
+/**
+ * Run a demodulator until it has no more work pending, and fold the time it took per sample
+ * buffer into its average.
+ */
+static
+void _demod_pool_run(struct demod_pool_worker *w, struct demod_thread *dthr)
+{
+    uint64_t start_ns = _demod_pool_now_ns(),
+             elapsed_ns = 0;
+    int64_t avg_ns = (int64_t)atomic_load_explicit(&dthr->pool_avg_ns, memory_order_relaxed);
+    size_t nr_bufs = 0;
+
+    nr_bufs = demod_thread_run_pending(dthr);
+
+    elapsed_ns = _demod_pool_now_ns() - start_ns;
+
+    if (0 != nr_bufs) {
+        int64_t sample_ns = (int64_t)(elapsed_ns/nr_bufs);
+
+        avg_ns = 0 == avg_ns ? sample_ns : avg_ns + ((sample_ns - avg_ns) >> DEMOD_POOL_EWMA_SHIFT);
+        atomic_store_explicit(&dthr->pool_avg_ns, (uint64_t)avg_ns, memory_order_relaxed);
+    }
+
+    w->nr_runs++;
+}
+
+/**
+ * Move one demodulator from the most loaded worker to the least loaded worker, if doing so
+ * makes the load more even. All demodulators see sample buffers at the same rate, so the load
+ * of a worker is just the sum of the average processing times of the demodulators it is home to.
+ */
+static
+void _demod_pool_rebalance(struct demod_pool *pool)
+{
+    uint64_t load[DEMOD_POOL_MAX_WORKERS];
+    size_t heavy = 0,
+           light = 0;
+    struct demod_thread *best = NULL;
+    uint64_t diff = 0,
+             best_miss = UINT64_MAX;
+
+    memset(load, 0, sizeof(load));
+
+    for (size_t i = 0; i < pool->nr_units; i++) {
+        struct demod_thread *dthr = pool->units[i];
+        load[atomic_load(&dthr->pool_owner)] += atomic_load_explicit(&dthr->pool_avg_ns, memory_order_relaxed);
+    }
+
+    for (size_t i = 1; i < pool->nr_workers; i++) {
+        if (load[i] > load[heavy]) {
+            heavy = i;
+        }
+
+        if (load[i] < load[light]) {
+            light = i;
+        }
+    }
+
+    /* Don't churn over small differences */
+    diff = load[heavy] - load[light];
+    if (heavy == light || diff < load[heavy]/8) {
+        return;
+    }
+
+    /* Pick the demodulator whose move gets the two workers closest to even */
+    for (size_t i = 0; i < pool->nr_units; i++) {
+        struct demod_thread *dthr = pool->units[i];
+        uint64_t cost = atomic_load_explicit(&dthr->pool_avg_ns, memory_order_relaxed),
+                 miss = 0;
+
+        if (heavy != atomic_load(&dthr->pool_owner) || cost >= diff) {
+            continue;
+        }
+
+        miss = 2 * cost > diff ? 2 * cost - diff : diff - 2 * cost;
+
+        if (miss < best_miss) {
+            best = dthr;
+            best_miss = miss;
+        }
+    }
+
+    if (NULL != best) {
+        DIAG("Moving demodulator %p from worker %zu (%llu ns) to worker %zu (%llu ns)", best, heavy,
+                (unsigned long long)load[heavy], light, (unsigned long long)load[light]);
+        atomic_store(&best->pool_owner, light);
+        pool->nr_moves++;
+    }
+}
+
+static
+aresult_t _demod_pool_worker_work(struct worker_thread *wthr)
+{
+    aresult_t ret = A_OK;
+
+    struct demod_pool_worker *w = BL_CONTAINER_OF(wthr, struct demod_pool_worker, wthr);
+    struct demod_pool *pool = w->pool;
+
+    while (worker_thread_is_running(wthr)) {
+        struct demod_thread *dthr = NULL;
+
+        if (NULL == (dthr = _demod_pool_worker_take(w, false))) {
+            dthr = _demod_pool_steal(w);
+        }
+
+        if (NULL != dthr) {
+            _demod_pool_run(w, dthr);
+        } else {
+            /* Nothing to do anywhere; wait to be woken up, or to check for work to steal */
+            pthread_mutex_lock(&w->mtx);
+            if (0 == w->nr_ready) {
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                ts.tv_nsec += DEMOD_POOL_IDLE_WAIT_NS;
+                if (ts.tv_nsec >= 1000000000l) {
+                    ts.tv_sec++;
+                    ts.tv_nsec -= 1000000000l;
+                }
+                pthread_cond_timedwait(&w->cv, &w->mtx, &ts);
+            }
+            pthread_mutex_unlock(&w->mtx);
+        }
+
+        if (0 == w->id) {
+            uint64_t now = _demod_pool_now_ns();
+
+            if (now - pool->last_rebalance_ns >= DEMOD_POOL_REBALANCE_NS) {
+                _demod_pool_rebalance(pool);
+                pool->last_rebalance_ns = now;
+            }
+        }
+    }
+
+    DIAG("Pool worker %zu ran %zu demodulators, %zu of them stolen, before termination.", w->id, w->nr_runs,
+            w->nr_steals);
+
+    return ret;
+}
+
+aresult_t demod_pool_new(struct demod_pool **ppool, size_t nr_workers, const int *cores)
+{
+    aresult_t ret = A_OK;
+
+    struct demod_pool *pool = NULL;
+
+    TSL_ASSERT_ARG(NULL != ppool);
+    TSL_ASSERT_ARG(0 != nr_workers && nr_workers <= DEMOD_POOL_MAX_WORKERS);
+
+    *ppool = NULL;
+
+    if (FAILED(ret = TZAALLOC(pool, SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TACALLOC((void **)&pool->workers, nr_workers, sizeof(struct demod_pool_worker),
+                    SYS_CACHE_LINE_LENGTH)))
+    {
+        goto done;
+    }
+
+    pool->nr_workers = nr_workers;
+
+    for (size_t i = 0; i < nr_workers; i++) {
+        struct demod_pool_worker *w = &pool->workers[i];
+
+        if (0 != pthread_mutex_init(&w->mtx, NULL)) {
+            ret = A_E_INVAL;
+            goto done;
+        }
+
+        if (0 != pthread_cond_init(&w->cv, NULL)) {
+            ret = A_E_INVAL;
+            goto done;
+        }
+
+        w->pool = pool;
+        w->id = i;
+        pool->cores[i] = NULL != cores ? cores[i] : WORKER_THREAD_CPU_MASK_ANY;
+    }
+
+    *ppool = pool;
+
+done:
+    if (FAILED(ret)) {
+        if (NULL != pool) {
+            demod_pool_delete(&pool);
+        }
+    }
+
+    return ret;
+}
+
+aresult_t demod_pool_add(struct demod_pool *pool, struct demod_thread *dthr)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != pool);
+    TSL_ASSERT_ARG(NULL != dthr);
+    TSL_ASSERT_ARG(0 == pool->nr_started);
+
+    if (pool->nr_units == pool->units_cap) {
+        struct demod_thread **new_units = NULL;
+        size_t new_cap = 0 == pool->units_cap ? 16 : 2 * pool->units_cap;
+
+        if (FAILED(ret = TCALLOC((void **)&new_units, new_cap, sizeof(struct demod_thread *)))) {
+            goto done;
+        }
+
+        if (NULL != pool->units) {
+            memcpy(new_units, pool->units, pool->nr_units * sizeof(struct demod_thread *));
+            TFREE(pool->units);
+        }
+
+        pool->units = new_units;
+        pool->units_cap = new_cap;
+    }
+
+    /* Spread the demodulators out evenly to start with; rebalancing will sort out the rest */
+    atomic_store(&dthr->pool_owner, pool->nr_units % pool->nr_workers);
+    pool->units[pool->nr_units++] = dthr;
+
+done:
+    return ret;
+}
+
+aresult_t demod_pool_start(struct demod_pool *pool)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != pool);
+    TSL_ASSERT_ARG(0 == pool->nr_started);
+    TSL_ASSERT_ARG(0 != pool->nr_units);
+
+    /* A demodulator is in at most one ready ring at a time, so each ring can hold all of them */
+    for (size_t i = 0; i < pool->nr_workers; i++) {
+        if (FAILED(ret = TCALLOC((void **)&pool->workers[i].ready, pool->nr_units, sizeof(struct demod_thread *)))) {
+            goto done;
+        }
+    }
+
+    pool->last_rebalance_ns = _demod_pool_now_ns();
+
+    for (size_t i = 0; i < pool->nr_workers; i++) {
+        if (FAILED(ret = worker_thread_new(&pool->workers[i].wthr, _demod_pool_worker_work, pool->cores[i]))) {
+            MFM_MSG(SEV_ERROR, "POOL-THREAD-START-FAIL", "Failed to start demodulator pool worker %zu, aborting.", i);
+            goto done;
+        }
+
+        pool->nr_started++;
+    }
+
+    MFM_MSG(SEV_INFO, "DEMOD-POOL", "Running %zu demodulators on %zu pool workers", pool->nr_units, pool->nr_workers);
+
+done:
+    return ret;
+}
+
+void demod_pool_schedule(struct demod_pool *pool, struct demod_thread *dthr)
+{
+    unsigned owner = atomic_load(&dthr->pool_owner);
+    struct demod_pool_worker *w = &pool->workers[owner];
+    size_t nr_ready = 0;
+
+    pthread_mutex_lock(&w->mtx);
+    w->ready[(w->ready_head + w->nr_ready) % pool->nr_units] = dthr;
+    nr_ready = ++w->nr_ready;
+    pthread_mutex_unlock(&w->mtx);
+
+    pthread_cond_signal(&w->cv);
+
+    /* The home worker is backed up, so nudge a neighbour to come and steal */
+    if (1 < nr_ready && 1 < pool->nr_workers) {
+        pthread_cond_signal(&pool->workers[(owner + 1) % pool->nr_workers].cv);
+    }
+}
+
+aresult_t demod_pool_stop(struct demod_pool *pool)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != pool);
+
+    if (0 == pool->nr_started) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < pool->nr_started; i++) {
+        TSL_BUG_IF_FAILED(worker_thread_request_shutdown(&pool->workers[i].wthr));
+    }
+
+    for (size_t i = 0; i < pool->nr_started; i++) {
+        TSL_BUG_IF_FAILED(worker_thread_delete(&pool->workers[i].wthr));
+    }
+
+    MFM_MSG(SEV_INFO, "DEMOD-POOL-STOPPED", "Demodulator pool stopped, moved demodulators between workers %zu times",
+            pool->nr_moves);
+
+    pool->nr_started = 0;
+
+done:
+    return ret;
+}
+
+aresult_t demod_pool_delete(struct demod_pool **ppool)
+{
+    aresult_t ret = A_OK;
+
+    struct demod_pool *pool = NULL;
+
+    TSL_ASSERT_PTR_BY_REF(ppool);
+
+    pool = *ppool;
+
+    TSL_BUG_IF_FAILED(demod_pool_stop(pool));
+
+    if (NULL != pool->workers) {
+        for (size_t i = 0; i < pool->nr_workers; i++) {
+            if (NULL != pool->workers[i].ready) {
+                TFREE(pool->workers[i].ready);
+            }
+        }
+
+        TFREE(pool->workers);
+    }
+
+    if (NULL != pool->units) {
+        TFREE(pool->units);
+    }
+
+    TFREE(pool);
+    *ppool = NULL;
+
+    return ret;
+}
+
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <tsl/result.h>
+
+#include <stddef.h>
+
+struct demod_pool;
+struct demod_thread;
+
+/**
+ * The maximum number of workers in a demodulator pool
+ */
+#define DEMOD_POOL_MAX_WORKERS          64
+
+/**
+ * Create a pool of demodulator workers. Rather than each demodulator getting its own thread,
+ * demodulators attached to the pool are units of work, run by whichever worker gets to them
+ * first. Each demodulator has a home worker; idle workers steal ready demodulators from the
+ * other workers, and the home workers are rebalanced periodically based on how long each
+ * demodulator takes to process a sample buffer.
+ *
+ * \param ppool The new pool, returned by reference
+ * \param nr_workers The number of worker threads
+ * \param cores The core to pin each worker to, or NULL to let the workers float.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t demod_pool_new(struct demod_pool **ppool, size_t nr_workers, const int *cores);
+
+/**
+ * Attach a demodulator to the pool. Called by `demod_thread_new`. Must be called before the pool
+ * is started. The pool does not take ownership of the demodulator.
+ *
+ * \param pool The pool
+ * \param dthr The demodulator
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t demod_pool_add(struct demod_pool *pool, struct demod_thread *dthr);
+
+/**
+ * Start the pool's worker threads.
+ */
+aresult_t demod_pool_start(struct demod_pool *pool);
+
+/**
+ * Mark a demodulator as having work ready. Called by `demod_thread_deliver` when a demodulator
+ * goes from idle to having pending sample buffers.
+ *
+ * \param pool The pool
+ * \param dthr The demodulator that has work ready
+ */
+void demod_pool_schedule(struct demod_pool *pool, struct demod_thread *dthr);
+
+/**
+ * Stop the pool's worker threads. Once this returns, no demodulator attached to the pool will be
+ * run again, so the demodulators can safely be deleted.
+ */
+aresult_t demod_pool_stop(struct demod_pool *pool);
+
+/**
+ * Delete the pool. Stops the workers, if they are still running.
+ *
+ * \param ppool The pool, passed by reference. Set to NULL on success.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t demod_pool_delete(struct demod_pool **ppool);
+
@@ -0,0 +1,108 @@
+/*
+ *  demod_registry.c - The demodulators a channel can use, by name
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <multifm/demod_base.h>
+#include <multifm/fm_demod.h>
+#include <multifm/am_demod.h>
+#include <multifm/costas_demod.h>
+#include <multifm/iq_demod.h>
+
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+
+#include <string.h>
+
+static
+const struct demod_ops *_demod_registry[] = {
+    &multifm_fm_demod_ops,
+    &multifm_am_demod_ops,
+    &multifm_costas_demod_ops,
+    &multifm_iq_demod_ops,
+};
+
+#define DEMOD_REGISTRY_LEN              (sizeof(_demod_registry)/sizeof(_demod_registry[0]))
+
+const struct demod_ops *demod_find(const char *name)
+{
+    const struct demod_ops *ops = NULL;
+
+    if (NULL == name) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < DEMOD_REGISTRY_LEN; i++) {
+        if (0 == strcmp(_demod_registry[i]->name, name)) {
+            ops = _demod_registry[i];
+            break;
+        }
+    }
+
+done:
+    return ops;
+}
+
+aresult_t demod_new(struct demod_base **pdemod, const struct demod_ops *ops, const struct demod_params *params)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != pdemod);
+    TSL_ASSERT_ARG(NULL != ops);
+    TSL_ASSERT_ARG(NULL != params);
+
+    *pdemod = NULL;
+
+    if (FAILED(ret = ops->init(pdemod, params))) {
+        goto done;
+    }
+
+    (*pdemod)->ops = ops;
+
+done:
+    return ret;
+}
+
+aresult_t demod_delete(struct demod_base **pdemod)
+{
+    TSL_ASSERT_ARG(NULL != pdemod);
+    TSL_ASSERT_ARG(NULL != *pdemod);
+
+    return (*pdemod)->ops->cleanup(pdemod);
+}
+
+size_t demod_output_sample_bytes(enum demod_output_type type)
+{
+    size_t nr_bytes = 0;
+
+    switch (type) {
+    case DEMOD_OUTPUT_REAL_INT_16:
+        nr_bytes = sizeof(int16_t);
+        break;
+    case DEMOD_OUTPUT_COMPLEX_INT_16:
+        nr_bytes = 2 * sizeof(int16_t);
+        break;
+    case DEMOD_OUTPUT_COMPLEX_INT_8:
+        nr_bytes = 2 * sizeof(int8_t);
+        break;
+    }
+
+    return nr_bytes;
+}
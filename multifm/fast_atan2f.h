@@ -1,4 +0,0 @@
-#pragma once
-
-float fast_atan2f(float y, float x);
-
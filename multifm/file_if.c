@@ -4,11 +4,13 @@
 
 #include <config/engine.h>
 
+#include <filter/convert.h>
 #include <filter/sample_buf.h>
 
 #include <tsl/assert.h>
 #include <tsl/diag.h>
 #include <tsl/errors.h>
+#include <tsl/safe_alloc.h>
 
 #include <unistd.h>
 #include <fcntl.h>
@@ -43,114 +45,44 @@ done:
     return ret;
 }
 
+/**
+ * Read a buffer's worth of samples. Samples the filters take as they are are read straight into
+ * the sample buffer; anything else is read into the raw buffer and converted.
+ */
 static
-aresult_t _file_read_cs16(struct file_worker_thread *rx, struct sample_buf *sbuf)
-{
-    aresult_t ret = A_OK;
-
-    size_t nr_read = 0;
-
-    TSL_ASSERT_ARG(NULL != rx);
-    TSL_ASSERT_ARG(NULL != sbuf);
-
-    if (FAILED(ret = __file_read_bytes(rx, sbuf->data_buf, SAMPLES_PER_BUF * 2 * sizeof(int16_t), &nr_read))) {
-        goto done;
-    }
-
-    sbuf->nr_samples = nr_read/(2 * sizeof(int16_t));
-
-done:
-    return ret;
-}
-
-static
-aresult_t _file_read_cs8(struct file_worker_thread *rx, struct sample_buf *sbuf)
+aresult_t _file_read(struct file_worker_thread *thr, struct sample_buf *sbuf)
 {
     aresult_t ret = A_OK;
 
     size_t nr_read = 0,
-           rem = 0;
+           sample_bytes = 0;
+    void *tgt_buf = NULL;
 
-    int8_t *in_buf = NULL;
-    int16_t *out_buf = NULL;
-
-    TSL_ASSERT_ARG(NULL != rx);
+    TSL_ASSERT_ARG(NULL != thr);
     TSL_ASSERT_ARG(NULL != sbuf);
 
-    /* Read into bounce buffer */
-    if (FAILED(ret = __file_read_bytes(rx, rx->bounce_buf, rx->bounce_buf_bytes, &nr_read))) {
+    sample_bytes = convert_format_bytes(thr->sample_format);
+    tgt_buf = NULL != thr->raw_buf ? thr->raw_buf : sbuf->data_buf;
+
+    if (FAILED(ret = __file_read_bytes(thr, tgt_buf, SAMPLES_PER_BUF * sample_bytes, &nr_read))) {
         DIAG("Failed to read from file, aborting.");
         goto done;
     }
 
-    TSL_BUG_ON(nr_read > rx->bounce_buf_bytes);
-
-    in_buf = rx->bounce_buf;
-    out_buf = (int16_t *)sbuf->data_buf;
-
-    /* Convert to s16 just through a cast */
-    for (size_t i = 0; i < nr_read; i += 4) {
-        out_buf[i] = in_buf[i];
-        out_buf[i + 1] = in_buf[i + 1];
-        out_buf[i + 2] = in_buf[i + 2];
-        out_buf[i + 3] = in_buf[i + 3];
-    }
-
-    rem = nr_read % 4;
-
-    for (size_t i = 0; i < rem; i++) {
-        out_buf[nr_read - rem + i] = in_buf[nr_read - rem + i];
-    }
-
     DIAG("Read %zu bytes from input file", nr_read);
 
-    /* Ensure we mark the buffer only for the number of samples actually available */
-    sbuf->nr_samples = nr_read/2;
-
-done:
-    return ret;
-}
-
-static
-aresult_t _file_read_cu8(struct file_worker_thread *rx, struct sample_buf *sbuf)
-{
-    aresult_t ret = A_OK;
-
-    size_t nr_read = 0,
-           rem = 0;
-
-    int8_t *in_buf = NULL;
-    int16_t *out_buf = NULL;
-
-    TSL_ASSERT_ARG(NULL != rx);
-    TSL_ASSERT_ARG(NULL != sbuf);
-
-    /* Read into bounce buffer */
-    if (FAILED(ret = __file_read_bytes(rx, rx->bounce_buf, rx->bounce_buf_bytes, &nr_read))) {
+    if (nr_read < sample_bytes) {
+        FL_MSG(SEV_INFO, "END-OF-FILE", "Reached the end of the input file.");
+        ret = A_E_DONE;
         goto done;
     }
 
-    TSL_BUG_ON(nr_read > rx->bounce_buf_bytes);
-
-    in_buf = rx->bounce_buf;
-    out_buf = (int16_t *)sbuf->data_buf;
-
-    /* Convert to s16 just through a cast, then subtracting 127 (assumes input is [0, 255]) */
-    for (size_t i = 0; i < nr_read; i += 4) {
-        out_buf[i + 0] = (int16_t)in_buf[i + 0] - 127;
-        out_buf[i + 1] = (int16_t)in_buf[i + 1] - 127;
-        out_buf[i + 2] = (int16_t)in_buf[i + 2] - 127;
-        out_buf[i + 3] = (int16_t)in_buf[i + 3] - 127;
-    }
-
-    rem = nr_read % 4;
-
-    for (size_t i = 0; i < rem; i++) {
-        out_buf[nr_read - rem + i] = in_buf[nr_read - rem + i];
-    }
-
     /* Ensure we mark the buffer only for the number of samples actually available */
-    sbuf->nr_samples = nr_read/2;
+    if (FAILED(ret = receiver_sample_buf_fill(&thr->rcvr, sbuf, thr->sample_format, tgt_buf,
+                    nr_read / sample_bytes)))
+    {
+        goto done;
+    }
 
 done:
     return ret;
@@ -179,8 +111,7 @@ aresult_t _file_worker_thread_work(struct receiver *rx)
             continue;
         }
 
-        TSL_BUG_ON(NULL == thr->read_call);
-        if (FAILED(ret = thr->read_call(thr, sbuf))) {
+        if (FAILED(ret = _file_read(thr, sbuf))) {
             /* Chances are we ran out of samples to process */
             goto done;
         }
@@ -219,8 +150,8 @@ aresult_t _file_worker_thread_cleanup(struct receiver *rx)
         fwt->fd = -1;
     }
 
-    if (NULL != fwt->bounce_buf) {
-        TFREE(fwt->bounce_buf);
+    if (NULL != fwt->raw_buf) {
+        TFREE(fwt->raw_buf);
     }
 
     return ret;
@@ -235,7 +166,7 @@ aresult_t file_worker_thread_new(struct receiver **pthr, struct config *cfg)
     const char *filename = NULL,
                *format = NULL;
     struct config devcfg = CONFIG_INIT_EMPTY;
-    enum file_worker_sample_format sample_format = FILE_WORKER_SAMPLE_FORMAT_UNKNOWN;
+    enum convert_format sample_format = CONVERT_FORMAT_CS16;
 
     TSL_ASSERT_ARG(NULL != pthr);
     TSL_ASSERT_ARG(NULL != cfg);
@@ -255,16 +186,9 @@ aresult_t file_worker_thread_new(struct receiver **pthr, struct config *cfg)
     }
 
     /* Validate that the format is supported */
-    if (!strncmp(format, "cs16", 4)) {
-        sample_format = FILE_WORKER_SAMPLE_FORMAT_S16;
-    } else if (!strncmp(format, "cs8", 3)) {
-        sample_format = FILE_WORKER_SAMPLE_FORMAT_S8;
-    } else if (!strncmp(format, "cu8", 3)) {
-        sample_format = FILE_WORKER_SAMPLE_FORMAT_U8;
-    } else {
+    if (FAILED(ret = convert_format_parse(format, &sample_format))) {
         FL_MSG(SEV_FATAL, "UNSUPPORTED-FILE-FORMAT", "File format [%s] is not supported, aborting.",
                 format);
-        ret = A_E_INVAL;
         goto done;
     }
 
@@ -287,28 +211,13 @@ aresult_t file_worker_thread_new(struct receiver **pthr, struct config *cfg)
     thr->fd = fd;
     thr->sample_format = sample_format;
 
-    if (sample_format == FILE_WORKER_SAMPLE_FORMAT_S8 || sample_format == FILE_WORKER_SAMPLE_FORMAT_U8) {
-        DIAG("Creating bounce buffer, input format requires conversion.");
-        switch (sample_format) {
-        case FILE_WORKER_SAMPLE_FORMAT_S8:
-            thr->read_call = _file_read_cs8;
-            break;
-        case FILE_WORKER_SAMPLE_FORMAT_U8:
-            thr->read_call = _file_read_cu8;
-            break;
-        default:
-            PANIC("Sample format is corrupted, aborting.");
-        }
-
-        if (FAILED(ret = TACALLOC(&thr->bounce_buf, SAMPLES_PER_BUF, 2 * sizeof(int8_t), SYS_CACHE_LINE_LENGTH))) {
+    /* Formats the filters can't take as they are are read into a buffer of their own and converted */
+    if (CONVERT_FORMAT_CS12 == sample_format || CONVERT_FORMAT_CF32 == sample_format) {
+        if (FAILED(ret = TACALLOC((void **)&thr->raw_buf, SAMPLES_PER_BUF, convert_format_bytes(sample_format),
+                        SYS_CACHE_LINE_LENGTH)))
+        {
             goto done;
         }
-
-        thr->bounce_buf_bytes = SAMPLES_PER_BUF * 2 * sizeof(int8_t);
-    } else if (sample_format == FILE_WORKER_SAMPLE_FORMAT_S16) {
-        thr->read_call = _file_read_cs16;
-    } else {
-        FL_MSG(SEV_FATAL, "UNSUPPORTED-SAMPLE-FORMAT", "Sample format [%s] is not supported, aborting.", format);
     }
 
     /* Initialize the receiver subsystem */
@@ -320,6 +229,9 @@ aresult_t file_worker_thread_new(struct receiver **pthr, struct config *cfg)
 done:
     if (FAILED(ret)) {
         if (NULL != thr) {
+            if (NULL != thr->raw_buf) {
+                TFREE(thr->raw_buf);
+            }
             TFREE(thr);
             thr = NULL;
         }
@@ -1,46 +1,55 @@
 #include <multifm/fm_demod.h>
 #include <multifm/demod_base.h>
-#include <multifm/fast_atan2f.h>
 
 #include <filter/filter.h>
+#include <filter/fm_disc.h>
+#include <filter/kernels.h>
 
 #include <tsl/errors.h>
 #include <tsl/assert.h>
 #include <tsl/diag.h>
 #include <tsl/safe_alloc.h>
 
-#include <math.h>
+#include <stdbool.h>
 
 struct multifm_fm_demod {
     struct demod_base demod;
-    int32_t last_fm_re;
-    int32_t last_fm_im;
+    int16_t last_fm[2];
+    float last_fm_f32[2];
+    bool integer_only;
 };
 
-aresult_t multifm_fm_demod_init(struct demod_base **pdemod)
+aresult_t multifm_fm_demod_init(struct demod_base **pdemod, const struct demod_params *params)
 {
     aresult_t ret = A_OK;
 
     struct multifm_fm_demod *demod = NULL;
 
     TSL_ASSERT_ARG(NULL != pdemod);
+    TSL_ASSERT_ARG(NULL != params);
     *pdemod = NULL;
 
+    if (FAILED(ret = filter_kernels_init())) {
+        goto done;
+    }
+
     TSL_BUG_IF_FAILED(TZAALLOC(demod, SYS_CACHE_LINE_LENGTH));
 
+    demod->demod.output_type = DEMOD_OUTPUT_REAL_INT_16;
+    demod->integer_only = params->integer_discriminator;
+
     *pdemod = &demod->demod;
 
+done:
     return ret;
 }
 
-aresult_t multifm_fm_demod_process(struct demod_base *demod, int16_t *in_samples, size_t nr_in_samples,
-        int16_t *out_samples, size_t *pnr_out_samples, size_t *pnr_out_bytes)
+aresult_t multifm_fm_demod_process(struct demod_base *demod, const int16_t *in_samples, size_t nr_in_samples,
+        void *out_samples, size_t *pnr_out_samples, size_t *pnr_out_bytes)
 {
     aresult_t ret = A_OK;
 
     struct multifm_fm_demod *dfm = NULL;
-    static const float to_q15 = (float)(1 << Q_15_SHIFT);
-    size_t nr_out_samples = 0;
 
     TSL_ASSERT_ARG(NULL != demod);
     TSL_ASSERT_ARG(NULL != in_samples);
@@ -50,36 +59,38 @@ aresult_t multifm_fm_demod_process(struct demod_base *demod, int16_t *in_samples
 
     dfm = BL_CONTAINER_OF(demod, struct multifm_fm_demod, demod);
 
-    for (size_t i = 0; i < nr_in_samples; i++) {
-        /* Get the complex conjugate of the prior sample, negating the phase term */
-        int32_t b_re =  dfm->last_fm_re,
-                b_im = -dfm->last_fm_im,
-                a_re =  in_samples[2 * i    ],
-                a_im =  in_samples[2 * i + 1];
-        int32_t s_re = 0,
-                s_im = 0;
+    /* The phase difference between each sample and the one before it, as Q.15 PCM */
+    if (true == dfm->integer_only) {
+        fm_disc_q15_cordic(in_samples, nr_in_samples, dfm->last_fm, out_samples);
+    } else {
+        fm_disc_q15(in_samples, nr_in_samples, dfm->last_fm, out_samples);
+    }
 
-        /* Calculate the phase difference */
-        s_re = a_re * b_re - a_im * b_im;
-        s_im = a_re * b_im + a_im * b_re;
+    *pnr_out_samples = nr_in_samples;
+    *pnr_out_bytes = nr_in_samples * sizeof(int16_t);
 
-        /* Convert from cartesian coordinates to a phase angle */
-        /* TODO: This needs to be made full-integer */
-        float phi = fast_atan2f((float)s_im, (float)s_re);
+    return ret;
+}
 
-        /* Scale by pi (since atan2 returns an angle in (-pi,pi]), convert back to Q.15 */
-        float phi_scaled = (phi/M_PI) * to_q15;
-        out_samples[nr_out_samples] = (int16_t)phi_scaled;
+aresult_t multifm_fm_demod_process_f32(struct demod_base *demod, const float *in_samples, size_t nr_in_samples,
+        void *out_samples, size_t *pnr_out_samples, size_t *pnr_out_bytes)
+{
+    aresult_t ret = A_OK;
 
-        nr_out_samples++;
+    struct multifm_fm_demod *dfm = NULL;
 
-        /* Store the last sample processed */
-        dfm->last_fm_re = a_re;
-        dfm->last_fm_im = a_im;
-    }
+    TSL_ASSERT_ARG(NULL != demod);
+    TSL_ASSERT_ARG(NULL != in_samples);
+    TSL_ASSERT_ARG(0 != nr_in_samples);
+    TSL_ASSERT_ARG(NULL != out_samples);
+    TSL_ASSERT_ARG(NULL != pnr_out_samples);
 
-    *pnr_out_samples = nr_out_samples;
-    *pnr_out_bytes = nr_out_samples * sizeof(int16_t);
+    dfm = BL_CONTAINER_OF(demod, struct multifm_fm_demod, demod);
+
+    fm_disc_f32(in_samples, nr_in_samples, dfm->last_fm_f32, out_samples);
+
+    *pnr_out_samples = nr_in_samples;
+    *pnr_out_bytes = nr_in_samples * sizeof(int16_t);
 
     return ret;
 }
@@ -102,3 +113,11 @@ aresult_t multifm_fm_demod_cleanup(struct demod_base **pdemod)
     return ret;
 }
 
+
+const struct demod_ops multifm_fm_demod_ops = {
+    .name = "fm",
+    .init = multifm_fm_demod_init,
+    .process = multifm_fm_demod_process,
+    .process_f32 = multifm_fm_demod_process_f32,
+    .cleanup = multifm_fm_demod_cleanup,
+};
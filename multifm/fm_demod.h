@@ -1,35 +1,52 @@
 #pragma once
 
-#include <tsl/result.h>
+#include <multifm/demod_base.h>
 
-struct demod_base;
+#include <tsl/result.h>
 
 /**
  * FM Demodulator
  *
  * This phase discriminator FM demodulator will convert an input complex FM signal to
  * a real-valued PCM stream of samples. The FM demodulator infrastructure takes complex
- * 16-bit integer pairs as inputs, and outputs a single PCM integer value.
+ * 16-bit integer pairs as inputs, and outputs a single PCM integer value. The discriminator
+ * itself is one of the batch kernels in `filter/fm_disc.h`.
  */
 
 /**
  * Initialize a new FM demodulator
  *
  * \param pdemod The demodulator state, returned by reference.
+ * \param params The demodulator parameters. If `integer_discriminator` is set, Q.15 samples are
+ *               discriminated with the fixed-point CORDIC, rather than the polynomial arctangent
+ *               over floats.
  *
  * \return A_OK on success, an error code otherwise
  */
-aresult_t multifm_fm_demod_init(struct demod_base **pdemod);
+aresult_t multifm_fm_demod_init(struct demod_base **pdemod, const struct demod_params *params);
 
 /**
  * Given the demodulator state, process the specified sample buffers, and write the output samples
  * out to the real-valued PCM buffer.
  */
-aresult_t multifm_fm_demod_process(struct demod_base *demod, int16_t *in_samples, size_t nr_in_samples,
-        int16_t *out_samples, size_t *pnr_out_samples, size_t *pnr_out_bytes);
+aresult_t multifm_fm_demod_process(struct demod_base *demod, const int16_t *in_samples, size_t nr_in_samples,
+        void *out_samples, size_t *pnr_out_samples, size_t *pnr_out_bytes);
+
+/**
+ * The same as `multifm_fm_demod_process`, for float samples with full scale at +/-1.0, such as
+ * the output of a `struct direct_fir_f32`. The phase difference is worked out in float, so
+ * there's nothing to convert before the arctangent, and the integer-only option doesn't apply.
+ * A demodulator must only ever be given one kind of sample.
+ */
+aresult_t multifm_fm_demod_process_f32(struct demod_base *demod, const float *in_samples, size_t nr_in_samples,
+        void *out_samples, size_t *pnr_out_samples, size_t *pnr_out_bytes);
 
 /**
  * Cleanup the resources used by the FM demodulator
  */
 aresult_t multifm_fm_demod_cleanup(struct demod_base **pdemod);
 
+/**
+ * The FM demodulator's operations, registered as "fm"
+ */
+extern const struct demod_ops multifm_fm_demod_ops;
@@ -0,0 +1,151 @@
+#include <multifm/iq_demod.h>
+#include <multifm/demod_base.h>
+
+#include <filter/filter.h>
+
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+#include <tsl/safe_alloc.h>
+
+#include <string.h>
+
+/**
+ * How far a Q.15 sample is shifted down to get an 8-bit sample, so Q.15 full scale lands on
+ * 8-bit full scale
+ */
+#define IQ_DEMOD_8BIT_SHIFT             (Q_15_SHIFT - 7)
+
+struct multifm_iq_demod {
+    struct demod_base demod;
+};
+
+aresult_t multifm_iq_demod_init(struct demod_base **pdemod, const struct demod_params *params)
+{
+    aresult_t ret = A_OK;
+
+    struct multifm_iq_demod *demod = NULL;
+
+    TSL_ASSERT_ARG(NULL != pdemod);
+    TSL_ASSERT_ARG(NULL != params);
+    TSL_ASSERT_ARG(8 == params->iq_output_bits || 16 == params->iq_output_bits);
+    *pdemod = NULL;
+
+    TSL_BUG_IF_FAILED(TZAALLOC(demod, SYS_CACHE_LINE_LENGTH));
+
+    demod->demod.output_type = 8 == params->iq_output_bits ? DEMOD_OUTPUT_COMPLEX_INT_8 :
+        DEMOD_OUTPUT_COMPLEX_INT_16;
+
+    *pdemod = &demod->demod;
+
+    return ret;
+}
+
+/**
+ * Round a Q.15 sample to 8 bits, saturating
+ */
+static inline
+int8_t _iq_demod_to_s8(int32_t sample)
+{
+    int32_t s = (sample + (1 << (IQ_DEMOD_8BIT_SHIFT - 1))) >> IQ_DEMOD_8BIT_SHIFT;
+
+    return s > INT8_MAX ? INT8_MAX : (s < INT8_MIN ? INT8_MIN : s);
+}
+
+/**
+ * Round a float sample to Q.15, saturating
+ */
+static inline
+int32_t _iq_demod_to_q15(float sample)
+{
+    static const float to_q15 = (float)(1 << Q_15_SHIFT);
+    float s = sample * to_q15;
+
+    s = s > (float)INT16_MAX ? (float)INT16_MAX : (s < (float)INT16_MIN ? (float)INT16_MIN : s);
+
+    return (int32_t)(s < 0.0f ? s - 0.5f : s + 0.5f);
+}
+
+aresult_t multifm_iq_demod_process(struct demod_base *demod, const int16_t *in_samples, size_t nr_in_samples,
+        void *out, size_t *pnr_out_samples, size_t *pnr_out_bytes)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != demod);
+    TSL_ASSERT_ARG(NULL != in_samples);
+    TSL_ASSERT_ARG(0 != nr_in_samples);
+    TSL_ASSERT_ARG(NULL != out);
+    TSL_ASSERT_ARG(NULL != pnr_out_samples);
+
+    if (DEMOD_OUTPUT_COMPLEX_INT_8 == demod->output_type) {
+        int8_t *out_samples = out;
+
+        for (size_t i = 0; i < 2 * nr_in_samples; i++) {
+            out_samples[i] = _iq_demod_to_s8(in_samples[i]);
+        }
+    } else {
+        memcpy(out, in_samples, 2 * nr_in_samples * sizeof(int16_t));
+    }
+
+    *pnr_out_samples = nr_in_samples;
+    *pnr_out_bytes = nr_in_samples * demod_output_sample_bytes(demod->output_type);
+
+    return ret;
+}
+
+aresult_t multifm_iq_demod_process_f32(struct demod_base *demod, const float *in_samples, size_t nr_in_samples,
+        void *out, size_t *pnr_out_samples, size_t *pnr_out_bytes)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != demod);
+    TSL_ASSERT_ARG(NULL != in_samples);
+    TSL_ASSERT_ARG(0 != nr_in_samples);
+    TSL_ASSERT_ARG(NULL != out);
+    TSL_ASSERT_ARG(NULL != pnr_out_samples);
+
+    if (DEMOD_OUTPUT_COMPLEX_INT_8 == demod->output_type) {
+        int8_t *out_samples = out;
+
+        for (size_t i = 0; i < 2 * nr_in_samples; i++) {
+            out_samples[i] = _iq_demod_to_s8(_iq_demod_to_q15(in_samples[i]));
+        }
+    } else {
+        int16_t *out_samples = out;
+
+        for (size_t i = 0; i < 2 * nr_in_samples; i++) {
+            out_samples[i] = _iq_demod_to_q15(in_samples[i]);
+        }
+    }
+
+    *pnr_out_samples = nr_in_samples;
+    *pnr_out_bytes = nr_in_samples * demod_output_sample_bytes(demod->output_type);
+
+    return ret;
+}
+
+aresult_t multifm_iq_demod_cleanup(struct demod_base **pdemod)
+{
+    aresult_t ret = A_OK;
+
+    struct multifm_iq_demod *demod = NULL;
+
+    TSL_ASSERT_ARG(NULL != pdemod);
+    TSL_ASSERT_ARG(NULL != *pdemod);
+
+    demod = BL_CONTAINER_OF(*pdemod, struct multifm_iq_demod, demod);
+
+    TFREE(demod);
+
+    *pdemod = NULL;
+
+    return ret;
+}
+
+const struct demod_ops multifm_iq_demod_ops = {
+    .name = "iq",
+    .init = multifm_iq_demod_init,
+    .process = multifm_iq_demod_process,
+    .process_f32 = multifm_iq_demod_process_f32,
+    .cleanup = multifm_iq_demod_cleanup,
+};
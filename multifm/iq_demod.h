@@ -0,0 +1,40 @@
+#pragma once
+
+#include <multifm/demod_base.h>
+
+#include <tsl/result.h>
+
+/**
+ * Raw I/Q "Demodulator"
+ *
+ * Passes the filtered, baseband complex samples straight through, for an external decoder to
+ * demodulate. The samples are written out as interleaved 16-bit Q.15 I/Q, or as 8-bit I/Q if
+ * `iq_output_bits` is 8, which halves the bandwidth going out the FIFO.
+ */
+
+/**
+ * Initialize a new raw I/Q passthrough
+ */
+aresult_t multifm_iq_demod_init(struct demod_base **pdemod, const struct demod_params *params);
+
+/**
+ * Write out interleaved Q.15 I/Q samples at the configured width
+ */
+aresult_t multifm_iq_demod_process(struct demod_base *demod, const int16_t *in_samples, size_t nr_in_samples,
+        void *out, size_t *pnr_out_samples, size_t *pnr_out_bytes);
+
+/**
+ * Write out interleaved float I/Q samples at the configured width
+ */
+aresult_t multifm_iq_demod_process_f32(struct demod_base *demod, const float *in_samples, size_t nr_in_samples,
+        void *out, size_t *pnr_out_samples, size_t *pnr_out_bytes);
+
+/**
+ * Cleanup the resources used by the raw I/Q passthrough
+ */
+aresult_t multifm_iq_demod_cleanup(struct demod_base **pdemod);
+
+/**
+ * The raw I/Q passthrough's operations, registered as "iq"
+ */
+extern const struct demod_ops multifm_iq_demod_ops;
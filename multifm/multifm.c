@@ -41,6 +41,7 @@
 #include <multifm/receiver.h>
 
 #include <filter/sample_buf.h>
+#include <filter/kernels.h>
 
 #include <config/engine.h>
 
@@ -114,6 +115,10 @@ int main(int argc, const char *argv[])
     TSL_BUG_IF_FAILED(app_init("multifm", cfg));
     TSL_BUG_IF_FAILED(app_sigint_catch(NULL));
 
+    TSL_BUG_IF_FAILED(filter_kernels_init());
+    MFM_MSG(SEV_INFO, "VERSION", "multifm %s, using %s DSP kernels", _VC_VERSION,
+            filter_isa_name(filter_kernels->isa));
+
     /* Figure out what kind of device we should initialize */
     if (FAILED(config_get(cfg, &device, "device"))) {
         MFM_MSG(SEV_FATAL, "MALFORMED-CONFIG", "Configuration is missing 'device' stanza. Aborting.");
@@ -0,0 +1,446 @@
+/*
+ *  pfb.c - Polyphase filter bank channelizer stage for multifm
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <multifm/pfb.h>
+#include <multifm/sample_buf_pool.h>
+#include <multifm/demod.h>
+#include <multifm/multifm.h>
+
+#include <filter/filter.h>
+#include <filter/pfb_channelizer.h>
+#include <filter/sample_buf.h>
+
+#include <tsl/work_queue.h>
+#include <tsl/worker_thread.h>
+#include <tsl/list.h>
+#include <tsl/safe_alloc.h>
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * A single filter bank bin, and the demodulators that consume it
+ */
+struct pfb_bin {
+    /**
+     * List of demodulator threads attached to this bin
+     */
+    struct list_entry demods;
+
+    /**
+     * Number of demodulator threads attached to this bin
+     */
+    size_t nr_demods;
+
+    /**
+     * The sample buffer currently being filled for this bin
+     */
+    struct sample_buf *buf;
+};
+
+/**
+ * PFB channelizer stage thread context
+ */
+struct pfb_thread {
+    /**
+     * Queue of wideband sample buffers to be channelized
+     */
+    struct work_queue wq CAL_CACHE_ALIGNED;
+
+    /**
+     * Mutex for the work queue. Always must be held while manipulating it.
+     */
+    pthread_mutex_t wq_mtx;
+
+    /**
+     * Condition variable signalled when a new sample buffer is ready
+     */
+    pthread_cond_t wq_cv;
+
+    /**
+     * Channelizer worker thread state
+     */
+    struct worker_thread wthr;
+
+    /**
+     * The polyphase filter bank
+     */
+    struct pfb_channelizer *chan;
+
+    /**
+     * Pool of per-bin output sample buffers
+     */
+    struct sample_buf_pool *out_pool;
+
+    /**
+     * Maximum number of samples in a per-bin output buffer
+     */
+    size_t max_out_samples;
+
+    /**
+     * The number of bins in the filter bank
+     */
+    size_t nr_bins;
+
+    /**
+     * The state of each bin
+     */
+    struct pfb_bin *bins;
+
+    /**
+     * Output sample pointers handed to the channelizer, NULL for bins nobody listens to
+     */
+    int16_t **bin_out;
+
+    /**
+     * Number of times an output sample buffer could not be allocated
+     */
+    size_t nr_alloc_fails;
+
+    /**
+     * Total number of wideband samples channelized
+     */
+    size_t total_nr_samples;
+
+    /**
+     * Whether the worker thread was started
+     */
+    bool started;
+};
+
+static
+aresult_t _pfb_thread_process(struct pfb_thread *pfb, struct sample_buf *sbuf)
+{
+    aresult_t ret = A_OK;
+
+    size_t nr_out = 0;
+    uint64_t start_time_ns = sbuf->start_time_ns;
+
+    /* Grab an output buffer for every bin that has a listener */
+    for (size_t i = 0; i < pfb->nr_bins; i++) {
+        struct pfb_bin *bin = &pfb->bins[i];
+
+        bin->buf = NULL;
+        pfb->bin_out[i] = NULL;
+
+        if (0 == bin->nr_demods) {
+            continue;
+        }
+
+        if (FAILED(sample_buf_pool_alloc(pfb->out_pool, &bin->buf))) {
+            if (0 == pfb->nr_alloc_fails) {
+                MFM_MSG(SEV_WARNING, "NO-PFB-BUFFER", "Out of channelizer output buffers, dropping samples for bin %zu.", i);
+            }
+            pfb->nr_alloc_fails++;
+            bin->buf = NULL;
+            continue;
+        }
+
+        bin->buf->sample_type = COMPLEX_INT_16;
+        bin->buf->start_time_ns = start_time_ns;
+        pfb->bin_out[i] = (int16_t *)bin->buf->data_buf;
+    }
+
+    /* The filter bank state must always advance, even if some bins are being dropped */
+    TSL_BUG_IF_FAILED(pfb_channelizer_process_sample_buf(pfb->chan, sbuf, pfb->bin_out, pfb->max_out_samples,
+                &nr_out));
+
+    pfb->total_nr_samples += sbuf->nr_samples;
+
+    TSL_BUG_IF_FAILED(sample_buf_decref(sbuf));
+
+    /* Hand the channelized samples off to the demodulators */
+    for (size_t i = 0; i < pfb->nr_bins; i++) {
+        struct pfb_bin *bin = &pfb->bins[i];
+        struct demod_thread *dthr = NULL;
+
+        if (NULL == bin->buf) {
+            continue;
+        }
+
+        if (0 == nr_out) {
+            atomic_store(&bin->buf->refcount, 1);
+            TSL_BUG_IF_FAILED(sample_buf_decref(bin->buf));
+            bin->buf = NULL;
+            continue;
+        }
+
+        bin->buf->nr_samples = nr_out;
+        atomic_store(&bin->buf->refcount, bin->nr_demods);
+
+        list_for_each_type(dthr, &bin->demods, dt_node) {
+            TSL_BUG_IF_FAILED(demod_thread_deliver(dthr, bin->buf));
+        }
+
+        bin->buf = NULL;
+    }
+
+    return ret;
+}
+
+static
+aresult_t _pfb_thread_work(struct worker_thread *wthr)
+{
+    aresult_t ret = A_OK;
+
+    struct pfb_thread *pfb = BL_CONTAINER_OF(wthr, struct pfb_thread, wthr);
+
+    pthread_mutex_lock(&pfb->wq_mtx);
+
+    while (worker_thread_is_running(wthr)) {
+        struct sample_buf *buf = NULL;
+        TSL_BUG_IF_FAILED(work_queue_pop(&pfb->wq, (void **)&buf));
+
+        if (NULL != buf) {
+            pthread_mutex_unlock(&pfb->wq_mtx);
+
+            TSL_BUG_IF_FAILED(_pfb_thread_process(pfb, buf));
+
+            pthread_mutex_lock(&pfb->wq_mtx);
+        } else {
+            /* Wait until the acquisition thread wakes us up */
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += 1;
+            pthread_cond_timedwait(&pfb->wq_cv, &pfb->wq_mtx, &ts);
+        }
+    }
+
+    pthread_mutex_unlock(&pfb->wq_mtx);
+
+    DIAG("PFB channelized %zu samples before termination.", pfb->total_nr_samples);
+
+    return ret;
+}
+
+aresult_t pfb_thread_new(struct pfb_thread **ppfb, size_t nr_bins, unsigned decimation,
+        const double *proto_taps, size_t nr_proto_taps, size_t samples_per_buf, size_t nr_bufs)
+{
+    aresult_t ret = A_OK;
+
+    struct pfb_thread *pfb = NULL;
+    int16_t *proto_coeffs = NULL;
+
+    TSL_ASSERT_ARG(NULL != ppfb);
+    TSL_ASSERT_ARG(0 != nr_bins);
+    TSL_ASSERT_ARG(NULL != proto_taps);
+    TSL_ASSERT_ARG(0 != nr_proto_taps);
+    TSL_ASSERT_ARG(0 != samples_per_buf);
+    TSL_ASSERT_ARG(0 != nr_bufs);
+
+    *ppfb = NULL;
+
+    if (FAILED(ret = TZAALLOC(pfb, SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    if (FAILED(ret = work_queue_new(&pfb->wq, 128))) {
+        goto done;
+    }
+
+    if (0 != pthread_mutex_init(&pfb->wq_mtx, NULL)) {
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (0 != pthread_cond_init(&pfb->wq_cv, NULL)) {
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (FAILED(ret = TCALLOC((void **)&proto_coeffs, nr_proto_taps, sizeof(int16_t)))) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < nr_proto_taps; i++) {
+        proto_coeffs[i] = (int16_t)(proto_taps[i] * (double)(1 << Q_15_SHIFT));
+    }
+
+    if (FAILED(ret = pfb_channelizer_new(&pfb->chan, nr_bins, decimation, proto_coeffs, nr_proto_taps))) {
+        MFM_MSG(SEV_ERROR, "BAD-PFB-PARAMS", "Failed to create a %zu bin filter bank with decimation %u.",
+                nr_bins, decimation);
+        goto done;
+    }
+
+    pfb->nr_bins = nr_bins;
+    pfb->max_out_samples = pfb_channelizer_max_out_samples(pfb->chan, samples_per_buf);
+
+    if (FAILED(ret = sample_buf_pool_new(&pfb->out_pool, pfb->max_out_samples * 2 * sizeof(int16_t),
+                    nr_bufs)))
+    {
+        goto done;
+    }
+
+    if (FAILED(ret = TCALLOC((void **)&pfb->bins, nr_bins, sizeof(struct pfb_bin)))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TCALLOC((void **)&pfb->bin_out, nr_bins, sizeof(int16_t *)))) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < nr_bins; i++) {
+        list_init(&pfb->bins[i].demods);
+    }
+
+    MFM_MSG(SEV_INFO, "PFB-CHANNELIZER", "Polyphase filter bank: %zu bins, decimation %u, %zu prototype taps",
+            nr_bins, decimation, nr_proto_taps);
+
+    *ppfb = pfb;
+
+done:
+    if (NULL != proto_coeffs) {
+        TFREE(proto_coeffs);
+    }
+
+    if (FAILED(ret)) {
+        if (NULL != pfb) {
+            pfb_thread_delete(&pfb);
+        }
+    }
+
+    return ret;
+}
+
+aresult_t pfb_thread_find_bin(struct pfb_thread *pfb, uint32_t sample_rate, int32_t offset_hz,
+        unsigned *pbin, int32_t *presidual_hz)
+{
+    TSL_ASSERT_ARG(NULL != pfb);
+
+    return pfb_channelizer_find_bin(pfb->chan, sample_rate, offset_hz, pbin, presidual_hz);
+}
+
+aresult_t pfb_thread_add_demod(struct pfb_thread *pfb, unsigned bin, struct demod_thread *dthr)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != pfb);
+    TSL_ASSERT_ARG(bin < pfb->nr_bins);
+    TSL_ASSERT_ARG(NULL != dthr);
+    TSL_ASSERT_ARG(false == pfb->started);
+
+    list_append(&pfb->bins[bin].demods, &dthr->dt_node);
+    pfb->bins[bin].nr_demods++;
+
+    return ret;
+}
+
+aresult_t pfb_thread_start(struct pfb_thread *pfb)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != pfb);
+    TSL_ASSERT_ARG(false == pfb->started);
+
+    if (FAILED(ret = worker_thread_new(&pfb->wthr, _pfb_thread_work, WORKER_THREAD_CPU_MASK_ANY))) {
+        MFM_MSG(SEV_ERROR, "PFB-THREAD-START-FAIL", "Failed to start channelizer thread, aborting.");
+        goto done;
+    }
+
+    pfb->started = true;
+
+done:
+    return ret;
+}
+
+aresult_t pfb_thread_deliver(struct pfb_thread *pfb, struct sample_buf *buf)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != pfb);
+    TSL_ASSERT_ARG_DEBUG(NULL != buf);
+
+    pthread_mutex_lock(&pfb->wq_mtx);
+    TSL_BUG_IF_FAILED(work_queue_push(&pfb->wq, buf));
+    pthread_mutex_unlock(&pfb->wq_mtx);
+
+    pthread_cond_signal(&pfb->wq_cv);
+
+    return ret;
+}
+
+aresult_t pfb_thread_delete(struct pfb_thread **ppfb)
+{
+    aresult_t ret = A_OK;
+
+    struct pfb_thread *pfb = NULL;
+    struct sample_buf *buf = NULL;
+
+    TSL_ASSERT_PTR_BY_REF(ppfb);
+
+    pfb = *ppfb;
+
+    if (true == pfb->started) {
+        TSL_BUG_IF_FAILED(worker_thread_request_shutdown(&pfb->wthr));
+        TSL_BUG_IF_FAILED(worker_thread_delete(&pfb->wthr));
+        pfb->started = false;
+    }
+
+    /* Release any wideband buffers that were never channelized */
+    do {
+        buf = NULL;
+        TSL_BUG_IF_FAILED(work_queue_pop(&pfb->wq, (void **)&buf));
+        if (NULL != buf) {
+            TSL_BUG_IF_FAILED(sample_buf_decref(buf));
+        }
+    } while (NULL != buf);
+
+    /* Demodulators hold references to our output buffers, so they must go first */
+    if (NULL != pfb->bins) {
+        for (size_t i = 0; i < pfb->nr_bins; i++) {
+            struct demod_thread *cur = NULL,
+                                *tmp = NULL;
+
+            list_for_each_type_safe(cur, tmp, &pfb->bins[i].demods, dt_node) {
+                list_del(&cur->dt_node);
+                TSL_BUG_IF_FAILED(demod_thread_delete(&cur));
+            }
+        }
+
+        TFREE(pfb->bins);
+    }
+
+    if (NULL != pfb->bin_out) {
+        TFREE(pfb->bin_out);
+    }
+
+    if (NULL != pfb->out_pool) {
+        TSL_BUG_IF_FAILED(sample_buf_pool_delete(&pfb->out_pool));
+    }
+
+    if (NULL != pfb->chan) {
+        TSL_BUG_IF_FAILED(pfb_channelizer_delete(&pfb->chan));
+    }
+
+    TSL_BUG_IF_FAILED(work_queue_release(&pfb->wq));
+
+    TFREE(pfb);
+    *ppfb = NULL;
+
+    return ret;
+}
+
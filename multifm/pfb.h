@@ -0,0 +1,80 @@
+#pragma once
+
+#include <tsl/result.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct pfb_thread;
+struct demod_thread;
+struct sample_buf;
+
+/**
+ * Create a new polyphase filter bank channelizer stage. The stage splits each wideband sample
+ * buffer into nr_bins channels, and hands the channels that have demodulators attached to them
+ * off to those demodulator threads.
+ *
+ * \param ppfb The new PFB stage, returned by reference.
+ * \param nr_bins The number of filter bank bins.
+ * \param decimation The decimation per bin. Must be nr_bins or nr_bins/2.
+ * \param proto_taps The prototype low-pass filter taps, designed at the wideband sample rate.
+ * \param nr_proto_taps The number of prototype filter taps.
+ * \param samples_per_buf The maximum number of samples in an input sample buffer.
+ * \param nr_bufs The number of output sample buffers to allocate.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t pfb_thread_new(struct pfb_thread **ppfb, size_t nr_bins, unsigned decimation,
+        const double *proto_taps, size_t nr_proto_taps, size_t samples_per_buf, size_t nr_bufs);
+
+/**
+ * Find the bin a channel lives in, and its offset from the center of the bin.
+ *
+ * \param pfb The PFB stage
+ * \param sample_rate The wideband sample rate, in Hz
+ * \param offset_hz The offset of the channel from the wideband center frequency
+ * \param pbin The bin, returned by reference
+ * \param presidual_hz The channel offset from the bin center, returned by reference
+ *
+ * \return A_OK on success, A_E_INVAL if the channel is outside the filter bank's span.
+ */
+aresult_t pfb_thread_find_bin(struct pfb_thread *pfb, uint32_t sample_rate, int32_t offset_hz,
+        unsigned *pbin, int32_t *presidual_hz);
+
+/**
+ * Attach a demodulator thread to a bin. The PFB stage takes ownership of the demodulator
+ * thread, and will delete it when the stage is deleted. Must be called before `pfb_thread_start`.
+ *
+ * \param pfb The PFB stage
+ * \param bin The bin the demodulator consumes
+ * \param dthr The demodulator thread
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t pfb_thread_add_demod(struct pfb_thread *pfb, unsigned bin, struct demod_thread *dthr);
+
+/**
+ * Start the PFB stage worker thread.
+ */
+aresult_t pfb_thread_start(struct pfb_thread *pfb);
+
+/**
+ * Deliver a wideband sample buffer to the PFB stage. The stage consumes one reference on the
+ * buffer.
+ *
+ * \param pfb The PFB stage
+ * \param buf The sample buffer
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t pfb_thread_deliver(struct pfb_thread *pfb, struct sample_buf *buf);
+
+/**
+ * Stop the PFB stage, and delete it along with all attached demodulator threads.
+ *
+ * \param ppfb The PFB stage, passed by reference. Set to NULL on success.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t pfb_thread_delete(struct pfb_thread **ppfb);
+
@@ -0,0 +1,271 @@
+/*
+ *  post_demod.c - Processing stages that run on demodulated samples before they are written out
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <multifm/post_demod.h>
+
+#include <filter/polyphase_fir.h>
+#include <filter/dc_blocker.h>
+#include <filter/deemphasis.h>
+#include <filter/filter.h>
+
+#include <tsl/basic.h>
+#include <tsl/safe_alloc.h>
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+
+#include <math.h>
+
+/**
+ * Set up a resampling stage, converting its taps to Q.15.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+static
+aresult_t _post_demod_resample_init(struct post_demod_stage *stage, const struct post_demod_stage_cfg *cfg)
+{
+    aresult_t ret = A_OK;
+
+    int16_t *taps = NULL;
+
+    TSL_ASSERT_ARG(NULL != cfg->taps);
+    TSL_ASSERT_ARG(0 != cfg->nr_taps);
+
+    if (FAILED(ret = TCALLOC((void **)&taps, cfg->nr_taps, sizeof(int16_t)))) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < cfg->nr_taps; i++) {
+        taps[i] = (int16_t)lrint(cfg->taps[i] * (double)(1 << Q_15_SHIFT));
+    }
+
+    ret = polyphase_fir_new(&stage->resampler, cfg->nr_taps, taps, cfg->interpolate, cfg->decimate);
+
+done:
+    if (NULL != taps) {
+        TFREE(taps);
+    }
+
+    return ret;
+}
+
+/**
+ * The most samples a resampler can put out in one go, if it is given at most nr_in_samples
+ * samples at a time. Samples left over in its history from the previous call can add up to a
+ * filter's worth of inputs.
+ */
+static
+size_t _post_demod_resample_max_out(const struct post_demod_stage_cfg *cfg, size_t nr_in_samples)
+{
+    return ((nr_in_samples + cfg->nr_taps) * cfg->interpolate + cfg->decimate - 1) / cfg->decimate + 1;
+}
+
+aresult_t post_demod_new(struct post_demod **ppd, const struct post_demod_cfg *cfg, size_t max_in_samples,
+        double sample_rate)
+{
+    aresult_t ret = A_OK;
+
+    struct post_demod *pd = NULL;
+    size_t nr_samples = max_in_samples;
+
+    TSL_ASSERT_ARG(NULL != ppd);
+    TSL_ASSERT_ARG(NULL != cfg);
+    TSL_ASSERT_ARG(cfg->nr_stages <= POST_DEMOD_MAX_STAGES);
+    TSL_ASSERT_ARG(0 != max_in_samples);
+    TSL_ASSERT_ARG(0.0 < sample_rate);
+
+    *ppd = NULL;
+
+    if (FAILED(ret = TZAALLOC(pd, SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < cfg->nr_stages; i++) {
+        const struct post_demod_stage_cfg *stage_cfg = &cfg->stages[i];
+        struct post_demod_stage *stage = &pd->stages[i];
+
+        stage->type = stage_cfg->type;
+
+        switch (stage_cfg->type) {
+        case POST_DEMOD_STAGE_RESAMPLE:
+            if (FAILED(ret = _post_demod_resample_init(stage, stage_cfg))) {
+                goto done;
+            }
+
+            nr_samples = _post_demod_resample_max_out(stage_cfg, nr_samples);
+            pd->resample_buf_len = BL_MAX2(pd->resample_buf_len, nr_samples);
+            sample_rate = sample_rate * (double)stage_cfg->interpolate / (double)stage_cfg->decimate;
+            break;
+        case POST_DEMOD_STAGE_DC_BLOCK:
+            if (FAILED(ret = dc_blocker_init(&stage->dc, stage_cfg->pole))) {
+                goto done;
+            }
+            break;
+        case POST_DEMOD_STAGE_DEEMPHASIS:
+            if (FAILED(ret = deemphasis_init(&stage->deemph, stage_cfg->tau, sample_rate))) {
+                goto done;
+            }
+            break;
+        case POST_DEMOD_STAGE_INVERT:
+            break;
+        case POST_DEMOD_STAGE_GAIN:
+            stage->gain = (int32_t)lrint(stage_cfg->gain * (double)(1 << Q_15_SHIFT));
+            break;
+        default:
+            ret = A_E_INVAL;
+            goto done;
+        }
+
+        /* Count the stage as soon as it holds anything that needs cleaning up */
+        pd->nr_stages = i + 1;
+    }
+
+    if (0 != pd->resample_buf_len) {
+        if (FAILED(ret = TACALLOC((void **)&pd->resample_buf, pd->resample_buf_len, sizeof(int16_t),
+                        SYS_CACHE_LINE_LENGTH)))
+        {
+            goto done;
+        }
+    }
+
+    *ppd = pd;
+
+done:
+    if (FAILED(ret)) {
+        if (NULL != pd) {
+            post_demod_delete(&pd);
+        }
+    }
+
+    return ret;
+}
+
+aresult_t post_demod_delete(struct post_demod **ppd)
+{
+    aresult_t ret = A_OK;
+
+    struct post_demod *pd = NULL;
+
+    TSL_ASSERT_PTR_BY_REF(ppd);
+
+    pd = *ppd;
+
+    for (size_t i = 0; i < pd->nr_stages; i++) {
+        struct post_demod_stage *stage = &pd->stages[i];
+
+        if (POST_DEMOD_STAGE_RESAMPLE == stage->type && NULL != stage->resampler) {
+            TSL_BUG_IF_FAILED(polyphase_fir_delete(&stage->resampler));
+        }
+    }
+
+    if (NULL != pd->resample_buf) {
+        TFREE(pd->resample_buf);
+    }
+
+    TFREE(pd);
+    *ppd = NULL;
+
+    return ret;
+}
+
+/**
+ * Flip the sign of each sample. -32768 has no positive counterpart, so it saturates.
+ */
+static
+void _post_demod_invert(int16_t *samples, size_t nr_samples)
+{
+    for (size_t i = 0; i < nr_samples; i++) {
+        int32_t v = -(int32_t)samples[i];
+        samples[i] = v > INT16_MAX ? INT16_MAX : v;
+    }
+}
+
+/**
+ * Scale each sample by a Q.15 gain, rounding and saturating.
+ */
+static
+void _post_demod_gain(int16_t *samples, size_t nr_samples, int32_t gain)
+{
+    for (size_t i = 0; i < nr_samples; i++) {
+        int64_t v = ((int64_t)samples[i] * gain + (1 << (Q_15_SHIFT - 1))) >> Q_15_SHIFT;
+        samples[i] = v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+    }
+}
+
+aresult_t post_demod_process(struct post_demod *pd, int16_t *samples, size_t nr_samples,
+        const int16_t **pout, size_t *pnr_out)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != pd);
+    TSL_ASSERT_ARG(NULL != samples);
+    TSL_ASSERT_ARG(NULL != pout);
+    TSL_ASSERT_ARG(NULL != pnr_out);
+
+    for (size_t i = 0; i < pd->nr_stages && 0 != nr_samples; i++) {
+        struct post_demod_stage *stage = &pd->stages[i];
+
+        switch (stage->type) {
+        case POST_DEMOD_STAGE_RESAMPLE:
+            if (FAILED(ret = polyphase_fir_push_samples(stage->resampler, samples, nr_samples))) {
+                goto done;
+            }
+
+            if (FAILED(ret = polyphase_fir_process(stage->resampler, pd->resample_buf, pd->resample_buf_len,
+                            &nr_samples)))
+            {
+                goto done;
+            }
+
+            samples = pd->resample_buf;
+            break;
+        case POST_DEMOD_STAGE_DC_BLOCK:
+            TSL_BUG_IF_FAILED(dc_blocker_apply(&stage->dc, samples, nr_samples));
+            break;
+        case POST_DEMOD_STAGE_DEEMPHASIS:
+            TSL_BUG_IF_FAILED(deemphasis_apply(&stage->deemph, samples, nr_samples));
+            break;
+        case POST_DEMOD_STAGE_INVERT:
+            _post_demod_invert(samples, nr_samples);
+            break;
+        case POST_DEMOD_STAGE_GAIN:
+            _post_demod_gain(samples, nr_samples, stage->gain);
+            break;
+        }
+    }
+
+    *pout = samples;
+    *pnr_out = nr_samples;
+
+done:
+    return ret;
+}
+
+double post_demod_output_rate(const struct post_demod_cfg *cfg, double sample_rate)
+{
+    for (size_t i = 0; i < cfg->nr_stages; i++) {
+        if (POST_DEMOD_STAGE_RESAMPLE == cfg->stages[i].type) {
+            sample_rate = sample_rate * (double)cfg->stages[i].interpolate / (double)cfg->stages[i].decimate;
+        }
+    }
+
+    return sample_rate;
+}
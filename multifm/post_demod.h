@@ -0,0 +1,209 @@
+#pragma once
+
+#include <filter/dc_blocker.h>
+#include <filter/deemphasis.h>
+
+#include <tsl/result.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The most stages a channel's post-demodulation chain can have
+ */
+#define POST_DEMOD_MAX_STAGES           8
+
+struct polyphase_fir;
+
+/**
+ * The kinds of stage that can follow a demodulator. Every stage works on real 16-bit PCM.
+ */
+enum post_demod_stage_type {
+    /**
+     * Rational resampling, with a polyphase FIR
+     */
+    POST_DEMOD_STAGE_RESAMPLE = 0,
+
+    /**
+     * A DC blocker
+     */
+    POST_DEMOD_STAGE_DC_BLOCK = 1,
+
+    /**
+     * A single-pole de-emphasis filter
+     */
+    POST_DEMOD_STAGE_DEEMPHASIS = 2,
+
+    /**
+     * Flip the sign of every sample
+     */
+    POST_DEMOD_STAGE_INVERT = 3,
+
+    /**
+     * Scale every sample, saturating
+     */
+    POST_DEMOD_STAGE_GAIN = 4,
+};
+
+/**
+ * Configuration for a single post-demodulation stage. Only the fields for the stage's type are
+ * looked at.
+ */
+struct post_demod_stage_cfg {
+    /**
+     * The type of stage
+     */
+    enum post_demod_stage_type type;
+
+    /**
+     * Resample: the interpolation and decimation factors
+     */
+    unsigned interpolate;
+    unsigned decimate;
+
+    /**
+     * Resample: the real low-pass filter taps, designed for the interpolated rate
+     */
+    const double *taps;
+
+    /**
+     * Resample: the number of filter taps
+     */
+    size_t nr_taps;
+
+    /**
+     * DC block: the location of the integrator's pole
+     */
+    double pole;
+
+    /**
+     * De-emphasis: the time constant, in seconds
+     */
+    double tau;
+
+    /**
+     * Gain: the gain, in linear units
+     */
+    double gain;
+};
+
+/**
+ * Configuration for a post-demodulation chain
+ */
+struct post_demod_cfg {
+    /**
+     * The stages, in the order they are applied
+     */
+    struct post_demod_stage_cfg stages[POST_DEMOD_MAX_STAGES];
+
+    /**
+     * The number of stages. 0 if the channel writes out its demodulated samples as they are.
+     */
+    size_t nr_stages;
+};
+
+/**
+ * The state of a single post-demodulation stage
+ */
+struct post_demod_stage {
+    /**
+     * The type of stage
+     */
+    enum post_demod_stage_type type;
+
+    union {
+        /**
+         * Resample: the polyphase resampler
+         */
+        struct polyphase_fir *resampler;
+
+        /**
+         * DC block: the DC blocker
+         */
+        struct dc_blocker dc;
+
+        /**
+         * De-emphasis: the de-emphasis filter
+         */
+        struct deemphasis deemph;
+
+        /**
+         * Gain: the gain, in Q.15. Wider than a sample, so gains above 2 can be represented.
+         */
+        int32_t gain;
+    };
+};
+
+/**
+ * A chain of stages that demodulated PCM samples run through before they are written out, so
+ * a channel can put out samples at the rate, and in the shape, its decoder wants.
+ */
+struct post_demod {
+    /**
+     * The stages, in the order they are applied
+     */
+    struct post_demod_stage stages[POST_DEMOD_MAX_STAGES];
+
+    /**
+     * The number of stages
+     */
+    size_t nr_stages;
+
+    /**
+     * The output of the resamplers. The resamplers copy their input into their own history, so
+     * every resampler can write over the samples the previous one left here.
+     */
+    int16_t *resample_buf;
+
+    /**
+     * The number of samples resample_buf holds
+     */
+    size_t resample_buf_len;
+};
+
+/**
+ * Create a post-demodulation chain.
+ *
+ * \param ppd The new chain, returned by reference
+ * \param cfg The stages in the chain
+ * \param max_in_samples The most samples that will be passed to `post_demod_process` at once
+ * \param sample_rate The sample rate of the demodulated samples, in Hz
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t post_demod_new(struct post_demod **ppd, const struct post_demod_cfg *cfg, size_t max_in_samples,
+        double sample_rate);
+
+/**
+ * Release a post-demodulation chain.
+ *
+ * \param ppd The chain, passed by reference. Set to NULL on success.
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t post_demod_delete(struct post_demod **ppd);
+
+/**
+ * Run a block of demodulated samples through the chain. Stages that don't change the number of
+ * samples work in place, so the input samples are overwritten.
+ *
+ * \param pd The chain
+ * \param samples The demodulated samples
+ * \param nr_samples The number of samples, at most the max_in_samples the chain was created with
+ * \param pout The output of the chain, returned by reference. Valid until the next call.
+ * \param pnr_out The number of output samples, returned by reference
+ *
+ * \return A_OK on success, an error code otherwise
+ */
+aresult_t post_demod_process(struct post_demod *pd, int16_t *samples, size_t nr_samples,
+        const int16_t **pout, size_t *pnr_out);
+
+/**
+ * Work out the sample rate at the end of a post-demodulation chain.
+ *
+ * \param cfg The stages in the chain
+ * \param sample_rate The sample rate of the demodulated samples, in Hz
+ *
+ * \return The sample rate of the chain's output, in Hz
+ */
+double post_demod_output_rate(const struct post_demod_cfg *cfg, double sample_rate);
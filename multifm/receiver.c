@@ -1,7 +1,14 @@
 #include <multifm/receiver.h>
 #include <multifm/demod.h>
+#include <multifm/decoder.h>
+#include <multifm/demod_pool.h>
+#include <multifm/broadcast_ring.h>
+#include <multifm/sample_buf_pool.h>
 #include <multifm/multifm.h>
+#include <multifm/pfb.h>
+#include <multifm/subband.h>
 
+#include <filter/convert.h>
 #include <filter/sample_buf.h>
 
 #include <config/engine.h>
@@ -11,87 +18,901 @@
 #include <tsl/assert.h>
 #include <tsl/list.h>
 #include <tsl/worker_thread.h>
-#include <tsl/frame_alloc.h>
+#include <tsl/safe_alloc.h>
 
+#include <inttypes.h>
 #include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
 
 /**
- * Free a live sample buffer.
+ * A channel to be demodulated, gathered up before being assigned to a demodulator thread
+ */
+struct receiver_channel {
+    /**
+     * The demodulator configuration for the channel
+     */
+    struct demod_channel_cfg cfg;
+
+    /**
+     * The filter bank bin or sub-band the channel is found in, if applicable
+     */
+    unsigned bin;
+};
+
+static
+int _receiver_channel_bin_compare(const void *a, const void *b)
+{
+    const struct receiver_channel *ch_a = a,
+                                  *ch_b = b;
+
+    return (ch_a->bin > ch_b->bin) - (ch_a->bin < ch_b->bin);
+}
+
+static
+int _receiver_channel_offset_compare(const void *a, const void *b)
+{
+    const struct receiver_channel *ch_a = a,
+                                  *ch_b = b;
+
+    return (ch_a->cfg.offset_hz > ch_b->cfg.offset_hz) - (ch_a->cfg.offset_hz < ch_b->cfg.offset_hz);
+}
+
+/**
+ * Allocate a sample buffer
+ */
+aresult_t receiver_sample_buf_alloc(struct receiver *rx, struct sample_buf **pbuf)
+{
+    aresult_t ret = A_OK;
+
+    struct sample_buf *sbuf = NULL;
+
+    TSL_ASSERT_ARG(NULL != rx);
+    TSL_ASSERT_ARG(NULL != pbuf);
+
+    *pbuf = NULL;
+
+    /* Allocate an output buffer */
+    if (FAILED(ret = sample_buf_pool_alloc(rx->samp_pool, &sbuf))) {
+        if (0 == rx->nr_samp_buf_alloc_fails) {
+            MFM_MSG(SEV_INFO, "NO-SAMPLE-BUFFER", "There are no available sample buffers, dropping received samples.");
+        }
+        rx->nr_samp_buf_alloc_fails++;
+        goto done;
+    }
+
+    /* Receivers that hand over 8-bit samples say so */
+    sbuf->sample_type = COMPLEX_INT_16;
+
+    *pbuf = sbuf;
+
+done:
+    return ret;
+}
+
+/**
+ * Fill a sample buffer, converting the samples if the filters can't take them as they are
+ */
+aresult_t receiver_sample_buf_fill(struct receiver *rx, struct sample_buf *buf, enum convert_format format,
+        const void *samples, size_t nr_samples)
+{
+    aresult_t ret = A_OK;
+
+    struct convert_stats *stats = NULL;
+    bool as_is = false;
+
+    TSL_ASSERT_ARG(NULL != rx);
+    TSL_ASSERT_ARG(NULL != buf);
+    TSL_ASSERT_ARG(NULL != samples);
+
+    /* 8-bit and 16-bit samples are filtered as they are, and so are floats, if the filters are float */
+    as_is = CONVERT_FORMAT_CU8 == format || CONVERT_FORMAT_CS8 == format || CONVERT_FORMAT_CS16 == format ||
+        (CONVERT_FORMAT_CF32 == format && true == rx->pass_f32);
+
+    TSL_ASSERT_ARG(nr_samples * convert_format_bytes(true == as_is ? format : CONVERT_FORMAT_CS16) <=
+            buf->sample_buf_bytes);
+
+    if (0 != rx->input_stats_interval) {
+        stats = &rx->input_stats;
+    }
+
+    if (true == as_is) {
+        if (samples != buf->data_buf) {
+            memcpy(buf->data_buf, samples, nr_samples * convert_format_bytes(format));
+        }
+
+        if (NULL != stats && FAILED(ret = convert_stats_update(format, buf->data_buf, nr_samples, stats))) {
+            goto done;
+        }
+
+        buf->sample_type = CONVERT_FORMAT_CU8 == format ? COMPLEX_UINT_8 :
+                           CONVERT_FORMAT_CS8 == format ? COMPLEX_INT_8 :
+                           CONVERT_FORMAT_CF32 == format ? COMPLEX_FLOAT_32 : COMPLEX_INT_16;
+    } else {
+        TSL_ASSERT_ARG(samples != buf->data_buf);
+
+        if (FAILED(ret = convert_to_q15(format, samples, nr_samples, (int16_t *)buf->data_buf, stats))) {
+            goto done;
+        }
+
+        buf->sample_type = COMPLEX_INT_16;
+    }
+
+    buf->nr_samples = nr_samples;
+
+done:
+    return ret;
+}
+
+/**
+ * Report the input statistics, once enough samples have been seen, and start over.
+ */
+static
+void _receiver_input_stats_report(struct receiver *rx)
+{
+    double dc_i = 0.0,
+           dc_q = 0.0,
+           power_dbfs = 0.0;
+
+    if (0 == rx->input_stats_interval || rx->input_stats.nr_samples < rx->input_stats_interval) {
+        goto done;
+    }
+
+    convert_stats_summary(&rx->input_stats, &dc_i, &dc_q, &power_dbfs);
+
+    MFM_MSG(SEV_INFO, "INPUT-LEVEL", "Input power %.1f dBFS, DC offset %+.4f%+.4fj, %" PRIu64 " of %" PRIu64
+            " samples clipped", power_dbfs, dc_i, dc_q, rx->input_stats.nr_clipped, 2 * rx->input_stats.nr_samples);
+
+    memset(&rx->input_stats, 0, sizeof(rx->input_stats));
+
+done:
+    return;
+}
+
+/**
+ * Deliver a sample buffer to any waiting consumers
+ */
+aresult_t receiver_sample_buf_deliver(struct receiver *rx, struct sample_buf *buf)
+{
+    aresult_t ret = A_OK;
+
+    struct demod_thread *dthr = NULL;
+
+    TSL_BUG_ON(0 == buf->nr_samples);
+
+    _receiver_input_stats_report(rx);
+
+    /* The filter bank is the only consumer of the wideband samples, if present */
+    if (NULL != rx->pfb) {
+        atomic_store(&buf->refcount, 1);
+        TSL_BUG_IF_FAILED(pfb_thread_deliver(rx->pfb, buf));
+        goto done;
+    }
+
+    /* Likewise, the sub-band stages are the only consumers if we're channelizing by sub-band */
+    if (0 != rx->nr_subbands) {
+        atomic_store(&buf->refcount, rx->nr_subbands);
+        for (size_t i = 0; i < rx->nr_subbands; i++) {
+            TSL_BUG_IF_FAILED(subband_thread_deliver(rx->subbands[i], buf));
+        }
+        goto done;
+    }
+
+    atomic_store(&buf->refcount, rx->nr_demod_threads);
+
+    /* Publishing to the ring costs the same no matter how many demodulators there are */
+    if (NULL != rx->ring) {
+        if (FAILED(broadcast_ring_publish(rx->ring, buf))) {
+            if (0 == rx->nr_ring_overruns) {
+                MFM_MSG(SEV_WARNING, "RING-OVERRUN", "Demodulators are a full ring behind, dropping received samples.");
+            }
+            rx->nr_ring_overruns++;
+            atomic_store(&buf->refcount, 1);
+            TSL_BUG_IF_FAILED(sample_buf_decref(buf));
+        }
+        goto done;
+    }
+
+    /* Make it available to each demodulator/processing thread */
+    list_for_each_type(dthr, &rx->demod_threads, dt_node) {
+        TSL_BUG_IF_FAILED(demod_thread_deliver(dthr, buf));
+    }
+
+done:
+
+    return ret;
+}
+
+/**
+ * Read the optional decimation chain that runs ahead of each channel FIR.
+ *
+ * \param cfg The receiver configuration
+ * \param decimation_factor The decimation left for the channel filters to do
+ * \param front_end The front end configuration, filled in if a chain was configured
+ * \param factors Storage for the stage factors, DECIMATION_CHAIN_MAX_STAGES long
+ * \param penabled Whether or not a chain was configured, returned by reference
  *
- * \param buf The buffer to free
- * 
  * \return A_OK on success, an error code otherwise.
  */
 static
-aresult_t _sample_buf_release(struct sample_buf *buf)
+aresult_t _receiver_front_end_init(struct config *cfg, int decimation_factor, struct demod_front_end_cfg *front_end,
+        unsigned *factors, bool *penabled)
+{
+    aresult_t ret = A_OK;
+
+    double *stages = NULL;
+    size_t nr_stages = 0;
+    const char *type_name = NULL;
+    unsigned chain_factor = 1;
+
+    *penabled = false;
+
+    if (FAILED(config_get_float_array(cfg, &stages, &nr_stages, "decimationChain"))) {
+        /* No chain, the channel FIR does all the work */
+        goto done;
+    }
+
+    if (0 == nr_stages || DECIMATION_CHAIN_MAX_STAGES < nr_stages) {
+        MFM_MSG(SEV_ERROR, "BAD-DECIMATION-CHAIN", "Decimation chain must have between 1 and %d stages.",
+                DECIMATION_CHAIN_MAX_STAGES);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (FAILED(config_get_string(cfg, &type_name, "decimationFrontEnd")) || 0 == strcmp(type_name, "halfband")) {
+        front_end->type = DECIMATION_CHAIN_HALFBAND;
+    } else if (0 == strcmp(type_name, "cic")) {
+        front_end->type = DECIMATION_CHAIN_CIC;
+    } else {
+        MFM_MSG(SEV_ERROR, "BAD-DECIMATION-FRONT-END", "Unknown decimation front end '%s', must be 'halfband' or 'cic'.",
+                type_name);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    for (size_t i = 0; i < nr_stages; i++) {
+        if (1.0 > stages[i] || (DECIMATION_CHAIN_HALFBAND == front_end->type && 2.0 != stages[i])) {
+            MFM_MSG(SEV_ERROR, "BAD-DECIMATION-CHAIN", "Decimation chain stage %zu has a bad factor (%f). Halfband stages must decimate by 2.",
+                    i, stages[i]);
+            ret = A_E_INVAL;
+            goto done;
+        }
+
+        factors[i] = (unsigned)stages[i];
+        chain_factor *= factors[i];
+    }
+
+    if (0 != decimation_factor % chain_factor) {
+        MFM_MSG(SEV_ERROR, "BAD-DECIMATION-CHAIN", "Decimation chain factor %u must divide the channel decimation factor %d.",
+                chain_factor, decimation_factor);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    front_end->factors = factors;
+    front_end->nr_factors = nr_stages;
+    *penabled = true;
+
+    MFM_MSG(SEV_INFO, "DECIMATION-CHAIN", "Decimating by %u with a %s chain, then by %d in the channel filter. The "
+            "channel filter taps must be designed for the reduced rate.", chain_factor,
+            DECIMATION_CHAIN_CIC == front_end->type ? "CIC" : "halfband", decimation_factor/(int)chain_factor);
+
+done:
+    if (NULL != stages) {
+        TFREE(stages);
+    }
+
+    return ret;
+}
+
+/**
+ * Set up the polyphase filter bank stage, if the configuration asks for one.
+ *
+ * \param rx The receiver
+ * \param cfg The receiver configuration
+ * \param samples_per_buf The number of samples in each wideband sample buffer
+ * \param nr_samp_bufs The number of wideband sample buffers
+ * \param sample_rate The wideband sample rate
+ * \param decimation_factor The overall decimation factor, from the wideband rate to the FM rate
+ * \param lpf_nr_taps The number of taps in the per-channel low pass filter
+ * \param pbin_decimation The decimation done by the filter bank, returned by reference. Set to 1
+ *                        if there is no filter bank.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+static
+aresult_t _receiver_pfb_init(struct receiver *rx, struct config *cfg, size_t samples_per_buf,
+        int nr_samp_bufs, int sample_rate, int decimation_factor, size_t lpf_nr_taps,
+        unsigned *pbin_decimation)
+{
+    aresult_t ret = A_OK;
+
+    const char *channelizer = NULL;
+    struct config pfb_cfg;
+    int nr_bins = 0;
+    bool oversampled = false;
+    unsigned bin_decimation = 1;
+    double *proto_taps = NULL;
+    size_t nr_proto_taps = 0;
+
+    *pbin_decimation = 1;
+
+    if (FAILED(config_get_string(cfg, &channelizer, "channelizer")) || 0 == strcmp(channelizer, "fir")) {
+        /* Classic per-channel band-pass FIR */
+        goto done;
+    }
+
+    if (0 == strcmp(channelizer, "subband")) {
+        /* Sub-bands are set up once the channels are known, see _receiver_subband_init */
+        goto done;
+    }
+
+    if (0 != strcmp(channelizer, "pfb")) {
+        MFM_MSG(SEV_ERROR, "BAD-CHANNELIZER", "Unknown channelizer '%s', must be one of 'fir', 'pfb' or 'subband'.",
+                channelizer);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (FAILED(ret = config_get(cfg, &pfb_cfg, "pfb"))) {
+        MFM_MSG(SEV_ERROR, "MISSING-PFB", "The 'pfb' channelizer needs a 'pfb' configuration section.");
+        goto done;
+    }
+
+    if (FAILED(ret = config_get_integer(&pfb_cfg, &nr_bins, "nrBins")) || 1 >= nr_bins) {
+        MFM_MSG(SEV_ERROR, "BAD-PFB-BINS", "Need to specify a filter bank bin count greater than 1 as 'nrBins'.");
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (FAILED(config_get_boolean(&pfb_cfg, &oversampled, "oversampled"))) {
+        oversampled = false;
+    }
+
+    if (true == oversampled && 0 != nr_bins % 2) {
+        MFM_MSG(SEV_ERROR, "BAD-PFB-BINS", "An oversampled filter bank needs an even number of bins, %d is odd.", nr_bins);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    bin_decimation = true == oversampled ? nr_bins/2 : nr_bins;
+
+    if (0 != decimation_factor % bin_decimation || 0 != sample_rate % bin_decimation) {
+        MFM_MSG(SEV_ERROR, "BAD-PFB-DECIMATION", "The decimation factor (%d) and sample rate (%d) must both be multiples "
+                "of the filter bank decimation (%u).", decimation_factor, sample_rate, bin_decimation);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (samples_per_buf/bin_decimation < lpf_nr_taps) {
+        MFM_MSG(SEV_ERROR, "PFB-BUF-TOO-SMALL", "Each filter bank output buffer would hold %zu samples, but the "
+                "channel filter has %zu taps.", samples_per_buf/bin_decimation, lpf_nr_taps);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (FAILED(ret = config_get_float_array(&pfb_cfg, &proto_taps, &nr_proto_taps, "protoTaps"))) {
+        MFM_MSG(SEV_ERROR, "BAD-PFB-TAPS", "Need to provide the filter bank prototype filter as 'protoTaps'.");
+        goto done;
+    }
+
+    if (FAILED(ret = pfb_thread_new(&rx->pfb, nr_bins, bin_decimation, proto_taps, nr_proto_taps,
+                    samples_per_buf, nr_samp_bufs * nr_bins)))
+    {
+        goto done;
+    }
+
+    MFM_MSG(SEV_INFO, "PFB-CHANNELIZER", "Channelizing with a %d bin filter bank, bins are %d Hz wide at %d samples/sec",
+            nr_bins, sample_rate/nr_bins, sample_rate/(int)bin_decimation);
+
+    *pbin_decimation = bin_decimation;
+
+done:
+    if (NULL != proto_taps) {
+        TFREE(proto_taps);
+    }
+
+    return ret;
+}
+
+/**
+ * Read the sub-band channelizer parameters, if the configuration asks for sub-bands.
+ *
+ * \param cfg The receiver configuration
+ * \param samples_per_buf The number of samples in each wideband sample buffer
+ * \param sample_rate The wideband sample rate
+ * \param decimation_factor The overall decimation factor, from the wideband rate to the FM rate
+ * \param lpf_nr_taps The number of taps in the per-channel low pass filter
+ * \param psub_decimation The decimation done by the sub-band stages, returned by reference. Set to
+ *                        1 if sub-bands are not being used.
+ * \param pmax_span_hz The widest span of channel centers a single sub-band may cover, returned by
+ *                     reference.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+static
+aresult_t _receiver_subband_init(struct config *cfg, size_t samples_per_buf, int sample_rate,
+        int decimation_factor, size_t lpf_nr_taps, unsigned *psub_decimation, int *pmax_span_hz)
+{
+    aresult_t ret = A_OK;
+
+    const char *channelizer = NULL;
+    struct config sub_cfg;
+    int sub_decimation = 0,
+        max_span_hz = 0,
+        sub_rate = 0,
+        chan_half_bw = 0;
+
+    *psub_decimation = 1;
+    *pmax_span_hz = 0;
+
+    if (FAILED(config_get_string(cfg, &channelizer, "channelizer")) || 0 != strcmp(channelizer, "subband")) {
+        goto done;
+    }
+
+    if (FAILED(ret = config_get(cfg, &sub_cfg, "subband"))) {
+        MFM_MSG(SEV_ERROR, "MISSING-SUBBAND", "The 'subband' channelizer needs a 'subband' configuration section.");
+        goto done;
+    }
+
+    if (FAILED(ret = config_get_integer(&sub_cfg, &sub_decimation, "decimation")) || 1 >= sub_decimation) {
+        MFM_MSG(SEV_ERROR, "BAD-SUBBAND-DECIMATION", "Need to specify a sub-band decimation greater than 1 as 'decimation'.");
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (0 != decimation_factor % sub_decimation || 0 != sample_rate % sub_decimation) {
+        MFM_MSG(SEV_ERROR, "BAD-SUBBAND-DECIMATION", "The decimation factor (%d) and sample rate (%d) must both be "
+                "multiples of the sub-band decimation (%d).", decimation_factor, sample_rate, sub_decimation);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (samples_per_buf/sub_decimation < lpf_nr_taps) {
+        MFM_MSG(SEV_ERROR, "SUBBAND-BUF-TOO-SMALL", "Each sub-band output buffer would hold %zu samples, but the "
+                "channel filter has %zu taps.", samples_per_buf/sub_decimation, lpf_nr_taps);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    sub_rate = sample_rate/sub_decimation;
+    chan_half_bw = sample_rate/decimation_factor/2;
+
+    /* By default, leave a fifth of the sub-band rate as the transition band of the sub-band filter */
+    if (FAILED(config_get_integer(&sub_cfg, &max_span_hz, "maxSpanHz"))) {
+        max_span_hz = 2 * (sub_rate * 2/5 - chan_half_bw);
+    }
+
+    if (0 > max_span_hz || max_span_hz/2 + chan_half_bw >= sub_rate/2) {
+        MFM_MSG(SEV_ERROR, "BAD-SUBBAND-SPAN", "A sub-band spanning %d Hz of channels doesn't fit at %d samples/sec.",
+                max_span_hz, sub_rate);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    MFM_MSG(SEV_INFO, "SUBBAND-CHANNELIZER", "Channelizing with sub-bands at %d samples/sec, each spanning at most %d Hz "
+            "of channels", sub_rate, max_span_hz);
+
+    *psub_decimation = sub_decimation;
+    *pmax_span_hz = max_span_hz;
+
+done:
+    return ret;
+}
+
+/**
+ * Gather the channels into clusters, and create a sub-band stage for each cluster. Each channel's
+ * offset is rewritten relative to the center of its sub-band, and its bin is set to the index of
+ * its sub-band.
+ *
+ * \param rx The receiver
+ * \param rx_channels The channels. These are sorted by offset.
+ * \param nr_channels The number of channels
+ * \param samples_per_buf The number of samples in each wideband sample buffer
+ * \param nr_samp_bufs The number of wideband sample buffers
+ * \param sample_rate The wideband sample rate
+ * \param decimation_factor The overall decimation factor, from the wideband rate to the FM rate
+ * \param sub_decimation The decimation done by each sub-band stage
+ * \param max_span_hz The widest span of channel centers a single sub-band may cover
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+static
+aresult_t _receiver_subband_cluster(struct receiver *rx, struct receiver_channel *rx_channels, size_t nr_channels,
+        size_t samples_per_buf, int nr_samp_bufs, int sample_rate, int decimation_factor, unsigned sub_decimation,
+        int max_span_hz)
+{
+    aresult_t ret = A_OK;
+
+    int chan_half_bw = sample_rate/decimation_factor/2;
+
+    TSL_ASSERT_ARG(NULL != rx->subbands);
+
+    qsort(rx_channels, nr_channels, sizeof(struct receiver_channel), _receiver_channel_offset_compare);
+
+    for (size_t i = 0; i < nr_channels; ) {
+        size_t first = i;
+        int32_t lo = rx_channels[i].cfg.offset_hz,
+                hi = lo,
+                center = 0;
+
+        /* Greedily grow the cluster until it would be too wide */
+        while (i < nr_channels && rx_channels[i].cfg.offset_hz - lo <= max_span_hz) {
+            hi = rx_channels[i++].cfg.offset_hz;
+        }
+
+        center = lo + (hi - lo)/2;
+
+        if (FAILED(ret = subband_thread_new(&rx->subbands[rx->nr_subbands], sample_rate, center, sub_decimation,
+                        (hi - lo)/2 + chan_half_bw, samples_per_buf, nr_samp_bufs)))
+        {
+            goto done;
+        }
+
+        for (size_t j = first; j < i; j++) {
+            rx_channels[j].cfg.offset_hz -= center;
+            rx_channels[j].bin = rx->nr_subbands;
+        }
+
+        DIAG("Sub-band %zu: %zu channels around %d Hz", rx->nr_subbands, i - first, center);
+
+        rx->nr_subbands++;
+    }
+
+    MFM_MSG(SEV_INFO, "SUBBANDS", "Clustered %zu channels into %zu sub-bands", nr_channels, rx->nr_subbands);
+
+done:
+    return ret;
+}
+
+/**
+ * Read the demodulator for a channel, and its parameters, from the channel's configuration.
+ */
+static
+aresult_t _receiver_channel_demod_init(struct config *channel, bool integer_discriminator,
+        struct demod_channel_cfg *chan_cfg)
+{
+    aresult_t ret = A_OK;
+
+    const char *demod_name = NULL;
+    int iq_output_bits = 0;
+    double costas_f_shift = 0.0,
+           costas_alpha = 0.0,
+           costas_beta = 0.0,
+           costas_e_max = 0.0;
+    struct demod_params *params = &chan_cfg->demod_params;
+
+    memset(params, 0, sizeof(*params));
+
+    if (FAILED(config_get_string(channel, &demod_name, "demod"))) {
+        demod_name = "fm";
+    }
+
+    if (NULL == (chan_cfg->demod = demod_find(demod_name))) {
+        MFM_MSG(SEV_ERROR, "BAD-DEMOD", "Unknown demodulator '%s', must be one of 'fm', 'am', 'costas' or 'iq'.",
+                demod_name);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    params->integer_discriminator = integer_discriminator;
+
+    /* Raw I/Q can be narrowed to 8 bits, for decoders that don't need more */
+    if (FAILED(config_get_integer(channel, &iq_output_bits, "iqOutputBits"))) {
+        iq_output_bits = 16;
+    }
+
+    if (8 != iq_output_bits && 16 != iq_output_bits) {
+        MFM_MSG(SEV_ERROR, "BAD-IQ-OUTPUT-BITS", "I/Q output must be 8 or 16 bits wide, not %d.", iq_output_bits);
+        ret = A_E_INVAL;
+        goto done;
+    }
+    params->iq_output_bits = (unsigned)iq_output_bits;
+
+    /* The Costas loop's carrier offset is in cycles per channel sample */
+    if (FAILED(config_get_float(channel, &costas_f_shift, "costasFreqShift"))) {
+        costas_f_shift = 0.0;
+    }
+
+    if (FAILED(config_get_float(channel, &costas_alpha, "costasAlpha"))) {
+        costas_alpha = RECEIVER_COSTAS_ALPHA_DEFAULT;
+    }
+
+    if (FAILED(config_get_float(channel, &costas_beta, "costasBeta"))) {
+        costas_beta = RECEIVER_COSTAS_BETA_DEFAULT;
+    }
+
+    if (FAILED(config_get_float(channel, &costas_e_max, "costasErrorMax"))) {
+        costas_e_max = RECEIVER_COSTAS_ERROR_MAX_DEFAULT;
+    }
+
+    if (0.0 >= costas_e_max || 1.0 < costas_e_max) {
+        MFM_MSG(SEV_ERROR, "BAD-COSTAS-ERROR-MAX", "The Costas loop's largest error must be in (0, 1], not %f.",
+                costas_e_max);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    params->costas_f_shift = (float)costas_f_shift;
+    params->costas_alpha = (float)costas_alpha;
+    params->costas_beta = (float)costas_beta;
+    params->costas_e_max = (int16_t)(costas_e_max * (double)(1 << Q_15_SHIFT));
+
+done:
+    return ret;
+}
+
+/**
+ * Read a single post-demodulation stage from its configuration.
+ */
+static
+aresult_t _receiver_post_demod_stage_init(struct config *stage, struct post_demod_stage_cfg *stage_cfg)
+{
+    aresult_t ret = A_OK;
+
+    const char *stage_name = NULL;
+    int interpolate = 0,
+        decimate = 0;
+    double tau_us = 0.0;
+    double *taps = NULL;
+    size_t nr_taps = 0;
+
+    memset(stage_cfg, 0, sizeof(*stage_cfg));
+
+    if (FAILED(ret = config_get_string(stage, &stage_name, "stage"))) {
+        MFM_MSG(SEV_ERROR, "MISSING-POST-DEMOD-STAGE", "Each post-demodulation stage needs a 'stage' type.");
+        goto done;
+    }
+
+    if (0 == strcmp(stage_name, "resample")) {
+        stage_cfg->type = POST_DEMOD_STAGE_RESAMPLE;
+
+        if (FAILED(config_get_integer(stage, &interpolate, "interpolate"))) {
+            interpolate = 1;
+        }
+
+        if (FAILED(config_get_integer(stage, &decimate, "decimate"))) {
+            decimate = 1;
+        }
+
+        if (0 >= interpolate || 0 >= decimate) {
+            MFM_MSG(SEV_ERROR, "BAD-RESAMPLE-FACTORS", "Resampling factors must be positive, got %d/%d.",
+                    interpolate, decimate);
+            ret = A_E_INVAL;
+            goto done;
+        }
+
+        if (FAILED(ret = config_get_float_array(stage, &taps, &nr_taps, "lpfCoeffs"))) {
+            MFM_MSG(SEV_ERROR, "BAD-RESAMPLE-FILTER", "Need to provide the resampling filter as 'lpfCoeffs'.");
+            goto done;
+        }
+
+        if (0 == nr_taps) {
+            MFM_MSG(SEV_ERROR, "BAD-RESAMPLE-FILTER", "The resampling filter needs at least one tap.");
+            TFREE(taps);
+            ret = A_E_INVAL;
+            goto done;
+        }
+
+        stage_cfg->interpolate = (unsigned)interpolate;
+        stage_cfg->decimate = (unsigned)decimate;
+        stage_cfg->taps = taps;
+        stage_cfg->nr_taps = nr_taps;
+    } else if (0 == strcmp(stage_name, "dcBlock")) {
+        stage_cfg->type = POST_DEMOD_STAGE_DC_BLOCK;
+
+        if (FAILED(config_get_float(stage, &stage_cfg->pole, "pole"))) {
+            stage_cfg->pole = RECEIVER_POST_DEMOD_DC_POLE_DEFAULT;
+        }
+
+        if (0.0 >= stage_cfg->pole || 1.0 <= stage_cfg->pole) {
+            MFM_MSG(SEV_ERROR, "BAD-DC-BLOCK-POLE", "The DC blocker's pole must be in (0, 1), not %f.",
+                    stage_cfg->pole);
+            ret = A_E_INVAL;
+            goto done;
+        }
+    } else if (0 == strcmp(stage_name, "deemphasis")) {
+        stage_cfg->type = POST_DEMOD_STAGE_DEEMPHASIS;
+
+        if (FAILED(config_get_float(stage, &tau_us, "tauUs"))) {
+            tau_us = RECEIVER_POST_DEMOD_TAU_US_DEFAULT;
+        }
+
+        if (0.0 >= tau_us) {
+            MFM_MSG(SEV_ERROR, "BAD-DEEMPHASIS-TAU", "The de-emphasis time constant must be positive, not %f us.",
+                    tau_us);
+            ret = A_E_INVAL;
+            goto done;
+        }
+
+        stage_cfg->tau = tau_us * 1e-6;
+    } else if (0 == strcmp(stage_name, "invert")) {
+        stage_cfg->type = POST_DEMOD_STAGE_INVERT;
+    } else if (0 == strcmp(stage_name, "gain")) {
+        stage_cfg->type = POST_DEMOD_STAGE_GAIN;
+
+        if (FAILED(ret = config_get_float(stage, &stage_cfg->gain, "gain"))) {
+            MFM_MSG(SEV_ERROR, "MISSING-GAIN", "A gain stage needs a linear 'gain'.");
+            goto done;
+        }
+    } else {
+        MFM_MSG(SEV_ERROR, "BAD-POST-DEMOD-STAGE", "Unknown post-demodulation stage '%s', must be one of "
+                "'resample', 'dcBlock', 'deemphasis', 'invert' or 'gain'.", stage_name);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+done:
+    return ret;
+}
+
+/**
+ * Release anything held by the post-demodulation stages read from a channel's configuration.
+ */
+static
+void _receiver_post_demod_cleanup(struct post_demod_cfg *post_cfg)
+{
+    for (size_t i = 0; i < post_cfg->nr_stages; i++) {
+        if (NULL != post_cfg->stages[i].taps) {
+            TFREE(post_cfg->stages[i].taps);
+        }
+    }
+
+    post_cfg->nr_stages = 0;
+}
+
+/**
+ * Read the chain of stages a channel's demodulated samples go through, if the channel has one.
+ */
+static
+aresult_t _receiver_channel_post_demod_init(struct config *channel, struct post_demod_cfg *post_cfg)
 {
     aresult_t ret = A_OK;
 
-    struct frame_alloc *fa = NULL;
+    struct config stages,
+                  stage;
+    size_t arr_ctr = 0;
 
-    TSL_ASSERT_ARG(NULL != buf);
-    TSL_BUG_ON(atomic_load(&buf->refcount) != 0);
+    memset(post_cfg, 0, sizeof(*post_cfg));
+
+    if (FAILED(config_get(channel, &stages, "postDemod"))) {
+        /* The demodulated samples are written out as they are */
+        goto done;
+    }
+
+    CONFIG_ARRAY_FOR_EACH(stage, &stages, ret, arr_ctr) {
+        if (POST_DEMOD_MAX_STAGES <= arr_ctr) {
+            MFM_MSG(SEV_ERROR, "TOO-MANY-POST-DEMOD-STAGES", "A channel can have at most %d post-demodulation stages.",
+                    POST_DEMOD_MAX_STAGES);
+            ret = A_E_INVAL;
+            goto done;
+        }
+
+        if (FAILED(ret = _receiver_post_demod_stage_init(&stage, &post_cfg->stages[arr_ctr]))) {
+            goto done;
+        }
+
+        post_cfg->nr_stages = arr_ctr + 1;
+    }
 
-    fa = buf->priv;
+    if (FAILED(ret)) {
+        MFM_MSG(SEV_ERROR, "BAD-POST-DEMOD", "Error reading array of post-demodulation stages, aborting.");
+        goto done;
+    }
 
-    TSL_BUG_IF_FAILED(frame_free(fa, (void **)&buf));
+done:
+    if (FAILED(ret)) {
+        _receiver_post_demod_cleanup(post_cfg);
+    }
 
     return ret;
 }
 
 /**
- * Allocate a sample buffer
+ * Read the protocol decoder a channel's PCM is fed to, if the channel has one.
+ *
+ * \param channel The channel's configuration
+ * \param pcm_rate The rate of the PCM the channel puts out, after any post-demodulation stages
+ * \param chan_cfg The channel's demodulator configuration, to fill in the decoder for
+ *
+ * \return A_OK on success, an error code otherwise.
  */
-aresult_t receiver_sample_buf_alloc(struct receiver *rx, struct sample_buf **pbuf)
+static
+aresult_t _receiver_channel_decoder_init(struct config *channel, double pcm_rate, struct demod_channel_cfg *chan_cfg)
 {
     aresult_t ret = A_OK;
 
-    struct sample_buf *sbuf = NULL;
+    struct config decoder;
+    const char *protocol_name = NULL;
+    const struct decoder_protocol *protocol = NULL;
 
-    TSL_ASSERT_ARG(NULL != rx);
-    TSL_ASSERT_ARG(NULL != pbuf);
+    chan_cfg->decoder = NULL;
 
-    *pbuf = NULL;
+    if (FAILED(config_get(channel, &decoder, "decoder"))) {
+        /* The PCM only goes out to the FIFO */
+        goto done;
+    }
 
-    /* Allocate an output buffer */
-    if (FAILED(ret = frame_alloc(rx->samp_alloc, (void **)&sbuf))) {
-        if (0 == rx->nr_samp_buf_alloc_fails) {
-            MFM_MSG(SEV_INFO, "NO-SAMPLE-BUFFER", "There are no available sample buffers, dropping received samples.");
-        }
-        rx->nr_samp_buf_alloc_fails++;
+    if (FAILED(ret = config_get_string(&decoder, &protocol_name, "protocol"))) {
+        MFM_MSG(SEV_ERROR, "MISSING-DECODER-PROTOCOL", "A decoder needs a 'protocol' to decode.");
+        goto done;
+    }
+
+    if (NULL == (protocol = decoder_find(protocol_name))) {
+        MFM_MSG(SEV_ERROR, "BAD-DECODER-PROTOCOL", "Unknown protocol '%s', must be one of 'flex', 'pocsag' or 'ais'.",
+                protocol_name);
+        ret = A_E_INVAL;
         goto done;
     }
 
-    /* Initialize the state for the sample buffer */
-    sbuf->release = _sample_buf_release;
-    sbuf->priv = rx->samp_alloc;
+    /* The decoders only work at their own rate; postDemod stages can resample to it */
+    if (fabs(pcm_rate - (double)protocol->sample_rate) > 0.005 * (double)protocol->sample_rate) {
+        MFM_MSG(SEV_WARNING, "DECODER-RATE-MISMATCH", "The '%s' decoder expects PCM at %u Hz, but the channel puts "
+                "out %f Hz. Add a 'resample' stage to 'postDemod'.", protocol->name, protocol->sample_rate, pcm_rate);
+    }
 
-    *pbuf = sbuf;
+    chan_cfg->decoder = protocol;
 
 done:
     return ret;
 }
 
 /**
- * Deliver a sample buffer to any waiting consumers
+ * Set up the demodulator worker pool, if the configuration asks for one.
+ *
+ * \param rx The receiver
+ * \param cfg The receiver configuration
+ *
+ * \return A_OK on success, an error code otherwise.
  */
-aresult_t receiver_sample_buf_deliver(struct receiver *rx, struct sample_buf *buf)
+static
+aresult_t _receiver_pool_init(struct receiver *rx, struct config *cfg)
 {
     aresult_t ret = A_OK;
 
-    struct demod_thread *dthr = NULL;
+    struct config pool_cfg;
+    int nr_workers = 0;
+    double *cores = NULL;
+    size_t nr_cores = 0;
+    int core_ids[DEMOD_POOL_MAX_WORKERS];
 
-    TSL_BUG_ON(0 == buf->nr_samples);
+    if (FAILED(config_get(cfg, &pool_cfg, "demodPool"))) {
+        /* Every demodulator gets its own thread */
+        goto done;
+    }
 
-    atomic_store(&buf->refcount, rx->nr_demod_threads);
+    if (FAILED(ret = config_get_integer(&pool_cfg, &nr_workers, "nrWorkers")) || 0 >= nr_workers ||
+            DEMOD_POOL_MAX_WORKERS < nr_workers)
+    {
+        MFM_MSG(SEV_ERROR, "BAD-POOL-WORKERS", "Need to specify between 1 and %d pool workers as 'nrWorkers'.",
+                DEMOD_POOL_MAX_WORKERS);
+        ret = A_E_INVAL;
+        goto done;
+    }
 
-    /* Make it available to each demodulator/processing thread */
-    list_for_each_type(dthr, &rx->demod_threads, dt_node) {
-        pthread_mutex_lock(&dthr->wq_mtx);
-        TSL_BUG_IF_FAILED(work_queue_push(&dthr->wq, buf));
-        pthread_mutex_unlock(&dthr->wq_mtx);
-        /* Signal there is data ready, if the thread is waiting on the condvar */
-        pthread_cond_signal(&dthr->wq_cv);
+    if (!FAILED(config_get_float_array(&pool_cfg, &cores, &nr_cores, "cores"))) {
+        if ((size_t)nr_workers != nr_cores) {
+            MFM_MSG(SEV_ERROR, "BAD-POOL-CORES", "Need exactly one core per pool worker, got %zu cores for %d workers.",
+                    nr_cores, nr_workers);
+            ret = A_E_INVAL;
+            goto done;
+        }
+
+        for (size_t i = 0; i < nr_cores; i++) {
+            core_ids[i] = (int)cores[i];
+        }
+    }
+
+    if (FAILED(ret = demod_pool_new(&rx->pool, nr_workers, NULL != cores ? core_ids : NULL))) {
+        goto done;
+    }
+
+    MFM_MSG(SEV_INFO, "DEMOD-POOL", "Demodulating with a pool of %d workers%s", nr_workers,
+            NULL != cores ? ", pinned to cores" : "");
+
+done:
+    if (NULL != cores) {
+        TFREE(cores);
     }
 
     return ret;
@@ -107,9 +928,26 @@ aresult_t receiver_init(struct receiver *rx, struct config *cfg,
            *resample_filter_taps CAL_CLEANUP(free_double_array) = NULL;
 
     size_t lpf_nr_taps = 0,
-           arr_ctr = 0;
-    int decimation_factor = 0,
+           arr_ctr = 0,
+           nr_channels = 0;
+    unsigned bin_decimation = 1;
+    int subband_max_span_hz = 0;
+    struct receiver_channel *rx_channels = NULL;
+    struct demod_channel_cfg *group = NULL;
+    const char *fir_strategy_name = NULL,
+               *numeric_format_name = NULL,
+               *decoder_output = NULL;
+    enum direct_fir_strategy fir_strategy = DIRECT_FIR_STRATEGY_AUTO;
+    enum demod_numeric_format numeric_format = DEMOD_NUMERIC_FORMAT_Q15;
+    struct demod_front_end_cfg front_end;
+    unsigned front_end_factors[DECIMATION_CHAIN_MAX_STAGES];
+    bool use_front_end = false,
+         integer_discriminator = false;
+    int channels_per_thread = 1,
+        fft_threshold = RECEIVER_FFT_FIR_THRESHOLD_DEFAULT,
+        decimation_factor = 0,
         nr_samp_bufs = 0,
+        input_stats_secs = 0,
         sample_rate = 0,
         center_freq = 0;
     int16_t *resample_int_filter_taps CAL_CLEANUP(free_i16_array) = NULL;
@@ -117,8 +955,6 @@ aresult_t receiver_init(struct receiver *rx, struct config *cfg,
     struct config channels,
                   channel;
 
-    struct frame_alloc *sample_buf_alloc = NULL;
-
     TSL_ASSERT_ARG(NULL != rx);
     TSL_ASSERT_ARG(NULL != cfg);
     TSL_ASSERT_ARG(NULL != rx_func);
@@ -126,7 +962,15 @@ aresult_t receiver_init(struct receiver *rx, struct config *cfg,
     TSL_ASSERT_ARG(0 != samples_per_buf);
 
     rx->muted = true;
-    rx->samp_alloc = sample_buf_alloc;
+    rx->samp_pool = NULL;
+    rx->pfb = NULL;
+    rx->subbands = NULL;
+    rx->nr_subbands = 0;
+    rx->pool = NULL;
+    rx->ring = NULL;
+    rx->nr_ring_overruns = 0;
+    rx->input_stats_interval = 0;
+    rx->pass_f32 = false;
     rx->cleanup_func = cleanup_func;
     rx->thread_func = rx_func;
 
@@ -148,12 +992,55 @@ aresult_t receiver_init(struct receiver *rx, struct config *cfg,
     MFM_MSG(SEV_INFO, "SAMPLE-RATE", "Sample rate is set to %u Hz", sample_rate);
     MFM_MSG(SEV_INFO, "CENTER-FREQ", "Center Frequency is %u Hz", center_freq);
 
+    /* Optionally report the input level, DC offset and clipping every so often */
+    memset(&rx->input_stats, 0, sizeof(rx->input_stats));
+    if (!FAILED(config_get_integer(cfg, &input_stats_secs, "inputStatsSecs")) && 0 < input_stats_secs) {
+        rx->input_stats_interval = (uint64_t)input_stats_secs * (uint64_t)sample_rate;
+        MFM_MSG(SEV_INFO, "INPUT-STATS", "Reporting input statistics every %d seconds", input_stats_secs);
+    }
+
+    /* Channels can be filtered and demodulated in float, rather than Q.15 */
+    if (FAILED(config_get_string(cfg, &numeric_format_name, "numericFormat")) || 0 == strcmp(numeric_format_name, "q15")) {
+        numeric_format = DEMOD_NUMERIC_FORMAT_Q15;
+    } else if (0 == strcmp(numeric_format_name, "f32")) {
+        numeric_format = DEMOD_NUMERIC_FORMAT_F32;
+        MFM_MSG(SEV_INFO, "NUMERIC-FORMAT", "Filtering and demodulating channels in float");
+    } else {
+        MFM_MSG(SEV_ERROR, "BAD-NUMERIC-FORMAT", "Unknown numeric format '%s', must be one of 'q15' or 'f32'.",
+                numeric_format_name);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    /* Messages from channels with a decoder can go to a file, rather than stdout */
+    if (!FAILED(config_get_string(cfg, &decoder_output, "decoderOutput"))) {
+        if (FAILED(ret = decoder_sink_open(decoder_output))) {
+            goto done;
+        }
+
+        MFM_MSG(SEV_INFO, "DECODER-OUTPUT", "Decoded messages are going to '%s'", decoder_output);
+    }
+
+    /* The FM discriminator can be kept entirely in fixed point */
+    if (FAILED(config_get_boolean(cfg, &integer_discriminator, "integerDiscriminator"))) {
+        integer_discriminator = false;
+    }
+
+    if (true == integer_discriminator) {
+        if (DEMOD_NUMERIC_FORMAT_F32 == numeric_format) {
+            MFM_MSG(SEV_WARNING, "FLOAT-INTEGER-DISCRIMINATOR", "Float channels are always discriminated in float.");
+            integer_discriminator = false;
+        } else {
+            MFM_MSG(SEV_INFO, "INTEGER-DISCRIMINATOR", "Using the fixed-point FM discriminator");
+        }
+    }
+
     /*
-     * Create the memory frame allocator for sample buffers
+     * Create the pool of sample buffers. Buffers released by the demodulators go straight back
+     * to the pool, without contending with the acquisition thread for an allocator lock.
      */
-    TSL_BUG_IF_FAILED(frame_alloc_new(&rx->samp_alloc,
-                sizeof(struct sample_buf) +
-                    samples_per_buf * sizeof(int16_t) * 2,
+    TSL_BUG_IF_FAILED(sample_buf_pool_new(&rx->samp_pool, samples_per_buf * 2 *
+                (DEMOD_NUMERIC_FORMAT_F32 == numeric_format ? sizeof(float) : sizeof(int16_t)),
                 nr_samp_bufs));
 
     /* Grab the decimation factor and other parameters first, just to validate them. */
@@ -185,6 +1072,26 @@ aresult_t receiver_init(struct receiver *rx, struct config *cfg,
 
     list_init(&rx->demod_threads);
 
+    /* Set up the filter bank, if we're using one. Channel filters then run at the bin rate. */
+    if (FAILED(ret = _receiver_pfb_init(rx, cfg, samples_per_buf, nr_samp_bufs, sample_rate,
+                    decimation_factor, lpf_nr_taps, &bin_decimation)))
+    {
+        goto done;
+    }
+
+    /* Or, run the channel filters at the sub-band rate, if we're clustering channels into sub-bands */
+    if (NULL == rx->pfb && FAILED(ret = _receiver_subband_init(cfg, samples_per_buf, sample_rate, decimation_factor,
+                    lpf_nr_taps, &bin_decimation, &subband_max_span_hz)))
+    {
+        goto done;
+    }
+
+    if (FAILED(ret = _receiver_front_end_init(cfg, decimation_factor/(int)bin_decimation, &front_end,
+                    front_end_factors, &use_front_end)))
+    {
+        goto done;
+    }
+
     /* Create the demodulator threads, walking the list of channels to be processed. */
     if (FAILED(ret = config_get(cfg, &channels, "channels"))) {
         MFM_MSG(SEV_ERROR, "MISSING-CHANNELS", "Need to specify at least one channel to demodulate.");
@@ -192,17 +1099,40 @@ aresult_t receiver_init(struct receiver *rx, struct config *cfg,
         goto done;
     }
 
+    /* Count the channels, so we can gather them up before assigning them to threads */
+    CONFIG_ARRAY_FOR_EACH(channel, &channels, ret, nr_channels) {
+    }
+
+    if (0 == nr_channels) {
+        MFM_MSG(SEV_ERROR, "MISSING-CHANNELS", "Need to specify at least one channel to demodulate.");
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (FAILED(ret = TCALLOC((void **)&rx_channels, nr_channels, sizeof(struct receiver_channel)))) {
+        goto done;
+    }
+
     CONFIG_ARRAY_FOR_EACH(channel, &channels, ret, arr_ctr) {
+        struct receiver_channel *rx_chan = &rx_channels[arr_ctr];
         const char *fifo_name = NULL,
+                   *ring_name = NULL,
                    *signal_debug = NULL;
         int nb_center_freq = -1;
-        struct demod_thread *dmt = NULL;
+        int32_t offset_hz = 0;
+        unsigned bin = 0;
         double channel_gain = 1.0,
                channel_gain_db = 0.0;
 
-        if (FAILED(ret = config_get_string(&channel, &fifo_name, "outFifo"))) {
-            MFM_MSG(SEV_ERROR, "MISSING-FIFO-ID", "Missing output FIFO filename, aborting.");
-            goto done;
+        TSL_BUG_ON(arr_ctr >= nr_channels);
+
+        /* A channel can write to a FIFO, a shared memory ring, both, or neither if it has a decoder */
+        if (FAILED(config_get_string(&channel, &fifo_name, "outFifo"))) {
+            fifo_name = NULL;
+        }
+
+        if (FAILED(config_get_string(&channel, &ring_name, "outRing"))) {
+            ring_name = NULL;
         }
 
         if (FAILED(ret = config_get_integer(&channel, &nb_center_freq, "chanCenterFreq"))) {
@@ -215,36 +1145,232 @@ aresult_t receiver_init(struct receiver *rx, struct config *cfg,
                     nb_center_freq, signal_debug);
         }
 
+        if (FAILED(ret = _receiver_channel_demod_init(&channel, integer_discriminator, &rx_chan->cfg))) {
+            goto done;
+        }
+
+        if (FAILED(ret = _receiver_channel_post_demod_init(&channel, &rx_chan->cfg.post_demod))) {
+            goto done;
+        }
+
+        if (FAILED(ret = _receiver_channel_decoder_init(&channel,
+                        post_demod_output_rate(&rx_chan->cfg.post_demod, (double)sample_rate / (double)decimation_factor),
+                        &rx_chan->cfg)))
+        {
+            goto done;
+        }
+
+        if (NULL == fifo_name && NULL == ring_name && NULL == rx_chan->cfg.decoder) {
+            MFM_MSG(SEV_ERROR, "MISSING-FIFO-ID", "Missing output FIFO filename or ring name, aborting.");
+            ret = A_E_INVAL;
+            goto done;
+        }
+
         if (!FAILED(ret = config_get_float(&channel, &channel_gain_db, "dBGain"))) {
             /* Convert the gain to linear units */
             channel_gain = pow(10.0, channel_gain_db/10.0);
             DIAG("Setting input channel gain to: %f (%f dB)", channel_gain, channel_gain_db);
         }
 
-        DIAG("Center Frequency: %d Hz FIFO: %s", nb_center_freq, fifo_name);
+        DIAG("Center Frequency: %d Hz FIFO: %s", nb_center_freq, NULL != fifo_name ? fifo_name : "(none)");
+
+        offset_hz = (int32_t)nb_center_freq - center_freq;
+
+        /* With a filter bank, the demodulator only has to correct for the residual offset from the bin center */
+        if (NULL != rx->pfb) {
+            if (FAILED(ret = pfb_thread_find_bin(rx->pfb, sample_rate, offset_hz, &bin, &offset_hz))) {
+                MFM_MSG(SEV_ERROR, "CHANNEL-OUT-OF-RANGE", "Channel at %d Hz is outside of the filter bank.",
+                        nb_center_freq);
+                goto done;
+            }
+
+            DIAG("Channel at %d Hz is in bin %u, residual offset %d Hz", nb_center_freq, bin, offset_hz);
+        }
+
+        rx_chan->cfg.offset_hz = offset_hz;
+        rx_chan->cfg.out_fifo = fifo_name;
+        rx_chan->cfg.out_ring = ring_name;
+        rx_chan->cfg.freq_hz = (uint32_t)nb_center_freq;
+        rx_chan->cfg.fir_debug_output = signal_debug;
+        rx_chan->cfg.gain = channel_gain;
+        rx_chan->bin = bin;
+
+        if (0 != rx_chan->cfg.post_demod.nr_stages) {
+            MFM_MSG(SEV_INFO, "POST-DEMOD", "Channel at %d Hz has %zu post-demodulation stages, putting out %f Hz",
+                    nb_center_freq, rx_chan->cfg.post_demod.nr_stages,
+                    post_demod_output_rate(&rx_chan->cfg.post_demod, (double)sample_rate / (double)decimation_factor));
+        }
+
+        MFM_MSG(SEV_INFO, "CHANNEL", "[%zu]: %4.5f MHz %s Gain: %f dB -> [%s]%s%s%s%s%s%s",
+                arr_ctr + 1, (double)nb_center_freq/1e6, rx_chan->cfg.demod->name, channel_gain_db,
+                (NULL != fifo_name ? fifo_name : "no FIFO"),
+                (NULL != ring_name ? " RING: " : ""),
+                (NULL != ring_name ? ring_name : ""),
+                (NULL != rx_chan->cfg.decoder ? " DECODER: " : ""),
+                (NULL != rx_chan->cfg.decoder ? rx_chan->cfg.decoder->name : ""),
+                (NULL != signal_debug ? " DEBUG: " : ""),
+                (NULL != signal_debug ? signal_debug : ""));
+    }
+    if (FAILED(ret)) {
+        MFM_MSG(SEV_ERROR, "CHANNEL-SETUP-FAILURE", "Error reading array of channels, aborting.");
+        goto done;
+    }
+
+    if (NULL == rx->pfb && 1 < bin_decimation) {
+        if (FAILED(ret = TCALLOC((void **)&rx->subbands, nr_channels, sizeof(struct subband_thread *)))) {
+            goto done;
+        }
+
+        if (FAILED(ret = _receiver_subband_cluster(rx, rx_channels, nr_channels, samples_per_buf, nr_samp_bufs,
+                        sample_rate, decimation_factor, bin_decimation, subband_max_span_hz)))
+        {
+            goto done;
+        }
+    }
+
+    if (FAILED(config_get_integer(cfg, &channels_per_thread, "channelsPerThread"))) {
+        channels_per_thread = 1;
+    }
+
+    if (0 >= channels_per_thread || DEMOD_THREAD_MAX_CHANNELS < channels_per_thread) {
+        MFM_MSG(SEV_ERROR, "BAD-CHANNELS-PER-THREAD", "Channels per thread must be between 1 and %d, got %d.",
+                DEMOD_THREAD_MAX_CHANNELS, channels_per_thread);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (true == use_front_end && 1 != channels_per_thread) {
+        MFM_MSG(SEV_WARNING, "FRONT-END-NOT-BATCHED", "Decimation chains can't be batched, using one channel per thread.");
+        channels_per_thread = 1;
+    }
+
+    if (DEMOD_NUMERIC_FORMAT_F32 == numeric_format) {
+        if (true == use_front_end) {
+            MFM_MSG(SEV_ERROR, "FLOAT-FRONT-END", "Decimation chains can't be used with float filtering.");
+            ret = A_E_INVAL;
+            goto done;
+        }
+
+        if (1 != channels_per_thread) {
+            MFM_MSG(SEV_WARNING, "FLOAT-NOT-BATCHED", "Float filters can't be batched, using one channel per thread.");
+            channels_per_thread = 1;
+        }
+
+        /* Float samples from the device can go straight to the float filters */
+        rx->pass_f32 = NULL == rx->pfb && 0 == rx->nr_subbands;
+    }
+
+    if (FAILED(config_get_string(cfg, &fir_strategy_name, "firStrategy")) || 0 == strcmp(fir_strategy_name, "auto")) {
+        fir_strategy = DIRECT_FIR_STRATEGY_AUTO;
+    } else if (0 == strcmp(fir_strategy_name, "complex")) {
+        fir_strategy = DIRECT_FIR_STRATEGY_COMPLEX;
+    } else if (0 == strcmp(fir_strategy_name, "mix")) {
+        fir_strategy = DIRECT_FIR_STRATEGY_MIX;
+    } else if (0 == strcmp(fir_strategy_name, "fft")) {
+        fir_strategy = DIRECT_FIR_STRATEGY_FFT;
+    } else {
+        MFM_MSG(SEV_ERROR, "BAD-FIR-STRATEGY", "Unknown FIR strategy '%s', must be one of 'auto', 'complex', 'mix' or 'fft'.",
+                fir_strategy_name);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    /* Long channel filters are cheaper in the frequency domain; 0 turns this off */
+    if (FAILED(config_get_integer(cfg, &fft_threshold, "fftFirThreshold"))) {
+        fft_threshold = RECEIVER_FFT_FIR_THRESHOLD_DEFAULT;
+    }
+
+    if (0 > fft_threshold) {
+        MFM_MSG(SEV_ERROR, "BAD-FFT-FIR-THRESHOLD", "The FFT FIR threshold must be a number of taps, or 0 to disable, got %d.",
+                fft_threshold);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (FAILED(ret = _receiver_pool_init(rx, cfg))) {
+        goto done;
+    }
+
+    /* Demodulators with their own threads that are fed straight from the receiver share a ring */
+    if (NULL == rx->pfb && 0 == rx->nr_subbands && NULL == rx->pool) {
+        size_t nr_slots = 1;
+
+        /* There can never be more buffers in flight than the allocator holds */
+        while (nr_slots < (size_t)nr_samp_bufs) {
+            nr_slots <<= 1;
+        }
+
+        if (FAILED(ret = broadcast_ring_new(&rx->ring, nr_slots))) {
+            goto done;
+        }
+    }
+
+    /* Channels that share an input can share a thread, and a batched FIR */
+    if (NULL != rx->pfb || 0 != rx->nr_subbands) {
+        qsort(rx_channels, nr_channels, sizeof(struct receiver_channel), _receiver_channel_bin_compare);
+    }
+
+    /* Each channel's config carries its whole post-demodulation chain, too big for the stack */
+    if (FAILED(ret = TCALLOC((void **)&group, DEMOD_THREAD_MAX_CHANNELS, sizeof(struct demod_channel_cfg)))) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < nr_channels; ) {
+        size_t nr_group = 0;
+        unsigned bin = rx_channels[i].bin;
+        struct demod_thread *dmt = NULL;
+
+        while (i < nr_channels && nr_group < (size_t)channels_per_thread && bin == rx_channels[i].bin) {
+            group[nr_group++] = rx_channels[i++].cfg;
+        }
 
         /* Create demodulator thread object */
-        if (FAILED(ret = demod_thread_new(&dmt, -1, (int32_t)nb_center_freq - center_freq,
-                        sample_rate, fifo_name, decimation_factor, lpf_taps, lpf_nr_taps,
-                        signal_debug,
-                        channel_gain)))
+        if (FAILED(ret = demod_thread_new(&dmt, -1, sample_rate/bin_decimation, decimation_factor/bin_decimation,
+                        lpf_taps, lpf_nr_taps, group, nr_group, fir_strategy, (size_t)fft_threshold,
+                        true == use_front_end ? &front_end : NULL, numeric_format, rx->pool)))
         {
             MFM_MSG(SEV_ERROR, "FAILED-DEMOD-THREAD", "Failed to create demodulator thread, aborting.");
             goto done;
         }
 
         list_init(&dmt->dt_node);
-        list_append(&rx->demod_threads, &dmt->dt_node);
+
+        if (NULL != rx->pfb) {
+            TSL_BUG_IF_FAILED(pfb_thread_add_demod(rx->pfb, bin, dmt));
+        } else if (0 != rx->nr_subbands) {
+            TSL_BUG_IF_FAILED(subband_thread_add_demod(rx->subbands[bin], dmt));
+        } else {
+            list_append(&rx->demod_threads, &dmt->dt_node);
+
+            if (NULL != rx->ring) {
+                if (FAILED(ret = demod_thread_attach_ring(dmt, rx->ring))) {
+                    goto done;
+                }
+            }
+        }
+
         rx->nr_demod_threads++;
+    }
 
-        MFM_MSG(SEV_INFO, "CHANNEL", "[%zu]: %4.5f MHz Gain: %f dB -> [%s]%s%s",
-                rx->nr_demod_threads, (double)nb_center_freq/1e6, channel_gain_db, fifo_name,
-                (NULL != signal_debug ? " DEBUG: " : ""),
-                (NULL != signal_debug ? signal_debug : ""));
+    MFM_MSG(SEV_INFO, "DEMOD-THREADS", "Demodulating %zu channels with %zu threads", nr_channels, rx->nr_demod_threads);
+
+    /* The pool has to be running before anything upstream can deliver samples */
+    if (NULL != rx->pool) {
+        if (FAILED(ret = demod_pool_start(rx->pool))) {
+            goto done;
+        }
     }
-    if (FAILED(ret)) {
-        MFM_MSG(SEV_ERROR, "CHANNEL-SETUP-FAILURE", "Error reading array of channels, aborting.");
-        goto done;
+
+    if (NULL != rx->pfb) {
+        if (FAILED(ret = pfb_thread_start(rx->pfb))) {
+            goto done;
+        }
+    }
+
+    for (size_t i = 0; i < rx->nr_subbands; i++) {
+        if (FAILED(ret = subband_thread_start(rx->subbands[i]))) {
+            goto done;
+        }
     }
 
 done:
@@ -252,6 +1378,18 @@ done:
         TFREE(lpf_taps);
     }
 
+    if (NULL != group) {
+        TFREE(group);
+    }
+
+    if (NULL != rx_channels) {
+        for (size_t i = 0; i < nr_channels; i++) {
+            _receiver_post_demod_cleanup(&rx_channels[i].cfg.post_demod);
+        }
+
+        TFREE(rx_channels);
+    }
+
     return ret;
 }
 
@@ -300,12 +1438,50 @@ aresult_t receiver_cleanup(struct receiver **prx)
     TSL_BUG_IF_FAILED(worker_thread_request_shutdown(&rx->wthr));
     TSL_BUG_IF_FAILED(worker_thread_delete(&rx->wthr));
 
+    /* Pooled demodulators can't be deleted while a pool worker might be running them */
+    if (NULL != rx->pool) {
+        TSL_BUG_IF_FAILED(demod_pool_stop(rx->pool));
+    }
+
+    /* The filter bank owns its demodulator threads */
+    if (NULL != rx->pfb) {
+        TSL_BUG_IF_FAILED(pfb_thread_delete(&rx->pfb));
+    }
+
+    /* As do the sub-band stages */
+    if (NULL != rx->subbands) {
+        for (size_t i = 0; i < rx->nr_subbands; i++) {
+            TSL_BUG_IF_FAILED(subband_thread_delete(&rx->subbands[i]));
+        }
+
+        TFREE(rx->subbands);
+        rx->nr_subbands = 0;
+    }
+
+    /* Kick the demodulators out of the ring, so they notice they're being shut down */
+    if (NULL != rx->ring) {
+        broadcast_ring_wake_all(rx->ring);
+    }
+
     list_for_each_type_safe(cur, tmp, &rx->demod_threads, dt_node) {
         list_del(&cur->dt_node);
         TSL_BUG_IF_FAILED(demod_thread_delete(&cur));
     }
 
-    TSL_BUG_IF_FAILED(frame_alloc_delete(&rx->samp_alloc));
+    if (NULL != rx->pool) {
+        TSL_BUG_IF_FAILED(demod_pool_delete(&rx->pool));
+    }
+
+    if (NULL != rx->ring) {
+        TSL_BUG_IF_FAILED(broadcast_ring_delete(&rx->ring));
+    }
+
+    if (NULL != rx->samp_pool) {
+        TSL_BUG_IF_FAILED(sample_buf_pool_delete(&rx->samp_pool));
+    }
+
+    /* Every decoder is gone, so nothing else can write to the decoder output */
+    decoder_sink_close();
 
     return ret;
 }
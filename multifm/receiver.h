@@ -1,17 +1,44 @@
 #pragma once
 
+#include <filter/convert.h>
+
 #include <tsl/result.h>
 #include <tsl/worker_thread.h>
 #include <tsl/list.h>
 
-struct frame_alloc;
+struct sample_buf_pool;
 struct receiver;
 struct config;
 struct sample_buf;
+struct pfb_thread;
+struct subband_thread;
+struct demod_pool;
+struct broadcast_ring;
 
 typedef aresult_t (*receiver_cleanup_func_t)(struct receiver *rx);
 typedef aresult_t (*receiver_rx_thread_func_t)(struct receiver *rx);
 
+/**
+ * Channel filters with at least this many taps may use fast convolution, unless configured
+ * otherwise with fftFirThreshold.
+ */
+#define RECEIVER_FFT_FIR_THRESHOLD_DEFAULT      256
+
+/**
+ * Default Costas loop gains, for a loop bandwidth of about 1% of the channel sample rate with a
+ * damping factor of 0.707. The loop acts on errors up to full scale.
+ */
+#define RECEIVER_COSTAS_ALPHA_DEFAULT           0.0141
+#define RECEIVER_COSTAS_BETA_DEFAULT            0.0001
+#define RECEIVER_COSTAS_ERROR_MAX_DEFAULT       1.0
+
+/**
+ * Default post-demodulation DC blocker pole, and de-emphasis time constant (in microseconds,
+ * as used for broadcast FM in the Americas)
+ */
+#define RECEIVER_POST_DEMOD_DC_POLE_DEFAULT     0.9999
+#define RECEIVER_POST_DEMOD_TAU_US_DEFAULT      75.0
+
 /**
  * Structure representing the generic state for a receiver. Usually embedded in a specialized
  * receiver structure.
@@ -32,15 +59,67 @@ struct receiver {
      */
     size_t nr_demod_threads;
 
+    /**
+     * The polyphase filter bank stage, if the receiver is channelizing with a filter bank.
+     * When set, the demodulator threads hang off of the filter bank, rather than this receiver.
+     */
+    struct pfb_thread *pfb;
+
+    /**
+     * The sub-band stages, one per cluster of channels, if the receiver is channelizing with
+     * sub-bands. When set, the demodulator threads hang off of the sub-band stages.
+     */
+    struct subband_thread **subbands;
+
+    /**
+     * The number of sub-band stages
+     */
+    size_t nr_subbands;
+
+    /**
+     * The pool of workers the demodulators run in, if the demodulators don't each get their own
+     * thread
+     */
+    struct demod_pool *pool;
+
+    /**
+     * Broadcast ring the demodulator threads take wideband sample buffers from, if they are fed
+     * directly by this receiver
+     */
+    struct broadcast_ring *ring;
+
+    /**
+     * Number of sample buffers dropped because the broadcast ring was full
+     */
+    size_t nr_ring_overruns;
+
     /**
      * Number of failed sample buffer allocations
      */
     size_t nr_samp_buf_alloc_fails;
 
     /**
-     * Frame allocator of sample buffers
+     * Statistics on the samples coming from the device, gathered while they are converted
+     */
+    struct convert_stats input_stats;
+
+    /**
+     * The number of samples between reports of the input statistics, or 0 if the statistics
+     * aren't being gathered. Set with inputStatsSecs.
+     */
+    uint64_t input_stats_interval;
+
+    /**
+     * Whether float samples from the device are handed to the demodulators as they are, as
+     * COMPLEX_FLOAT_32, rather than converted to Q.15. Only set when the demodulators filter in
+     * float, and are fed straight from the receiver.
+     */
+    bool pass_f32;
+
+    /**
+     * Pool of wideband sample buffers. Only the receiver thread allocates from it.
      */
-    struct frame_alloc *samp_alloc;
+    struct sample_buf_pool *samp_pool;
 
     /**
      * The worker thread for this receiver. Mandatory, each receiver must live in
@@ -99,6 +178,24 @@ aresult_t receiver_cleanup(struct receiver **prx);
  */
 aresult_t receiver_sample_buf_alloc(struct receiver *rx, struct sample_buf **pbuf);
 
+/**
+ * Fill a sample buffer with samples in the device's own format. 8-bit and 16-bit samples are
+ * handed to the filters as they are, as are float samples if the filters are float (see
+ * pass_f32); anything else is converted to Q.15. The input statistics, if enabled, are gathered
+ * at the same time.
+ *
+ * \param rx The receiver state
+ * \param buf The sample buffer to fill. Sets the sample type and number of samples.
+ * \param format The format of the samples
+ * \param samples The samples. Can be buf->data_buf itself if the samples are 8-bit or 16-bit,
+ *                in which case they aren't copied.
+ * \param nr_samples The number of complex samples
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t receiver_sample_buf_fill(struct receiver *rx, struct sample_buf *buf, enum convert_format format,
+        const void *samples, size_t nr_samples);
+
 /**
  * Unmute/Mute the receiver
  */
@@ -23,6 +23,7 @@
 #include <multifm/rtl_sdr_if.h>
 #include <multifm/multifm.h>
 
+#include <filter/convert.h>
 #include <filter/sample_buf.h>
 
 #include <config/engine.h>
@@ -36,13 +37,8 @@
 #include <unistd.h>
 #include <string.h>
 
-#ifdef _USE_ARM_NEON
-#include <arm_neon.h>
-#endif
-
 #include <rtl-sdr.h>
 
-#define RTL_SDR_CONVERSION_SHIFT        7
 #define RTL_SDR_DEFAULT_NR_SAMPLES      (16 * 32 * 512/2)
 
 static
@@ -89,7 +85,6 @@ void __rtl_sdr_worker_read_async_cb(unsigned char *buf, uint32_t len, void *ctx)
 {
     struct rtl_sdr_thread *thr = ctx;
     struct sample_buf *sbuf = NULL;
-    int16_t *sbuf_ptr = NULL;
 
     if (true == thr->rx.muted) {
         DIAG("Worker is muted.");
@@ -107,48 +102,8 @@ void __rtl_sdr_worker_read_async_cb(unsigned char *buf, uint32_t len, void *ctx)
         goto done;
     }
 
-    sbuf_ptr = (int16_t *)sbuf->data_buf;
-
-    /* Up-convert the u8 samples to Q.15, subtract 127 from the unsigned sample to get actual power */
-#ifdef _USE_ARM_NEON
-    int16x8_t samples,
-              sub_const  = { 127, 127, 127, 127, 127, 127, 127, 127 };
-    uint8x8_t raw_samples;
-    for (size_t i = 0; i < len/8; i++) {
-        size_t offs = i * 8;
-
-        __builtin_prefetch(buf + offs);
-
-        /* Load as unsigned 8b */
-        raw_samples = vld1_u8(buf + offs);
-
-        /* Convert to s16 - we can get away with the reinterpret because all values are [0, 255] */
-        samples = vreinterpretq_s16_u16(vmovl_u8(raw_samples));
-
-        /* subtract 127 */
-        samples = vsubq_s16(samples, sub_const);
-
-        /* Shift left by 7 */
-        samples = vqshlq_n_s16(samples, RTL_SDR_CONVERSION_SHIFT);
-
-        /* Store in the output buffer at the appropriate location */
-        vst1q_s16(sbuf_ptr + offs, samples);
-    }
-
-    /* If there's a remainder because the sample count is not divisible by 8, process the remainder */
-    size_t buf_offs = len & ~(8 - 1);
-
-    for (size_t i = 0; i < len % 8; i++) {
-        sbuf_ptr[i + buf_offs] = ((int16_t)buf[i + buf_offs] - 127) << RTL_SDR_CONVERSION_SHIFT;
-    }
-
-#else /* Works for any architecture */
-    for (size_t i = 0; i < len; i++) {
-        sbuf_ptr[i] = ((int16_t)buf[i] - 127) << RTL_SDR_CONVERSION_SHIFT;
-    }
-#endif
-
-    sbuf->nr_samples = len / 2;
+    /* The filters take the unsigned 8-bit samples as they are */
+    TSL_BUG_IF_FAILED(receiver_sample_buf_fill(&thr->rx, sbuf, CONVERT_FORMAT_CU8, buf, len / 2));
 
     TSL_BUG_IF_FAILED(receiver_sample_buf_deliver(&thr->rx, sbuf));
 
@@ -0,0 +1,236 @@
+/*
+ *  sample_buf_pool.c - Lock-free sample buffer recycling
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <multifm/sample_buf_pool.h>
+
+#include <filter/sample_buf.h>
+
+#include <tsl/frame_alloc.h>
+#include <tsl/safe_alloc.h>
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+#include <tsl/cal.h>
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/**
+ * Link that sits in front of every sample buffer in the pool, so a free buffer can be put on a
+ * list without touching the buffer itself. Sized to keep the sample buffer 16-byte aligned.
+ */
+struct sample_buf_pool_node {
+    struct sample_buf_pool_node *next CAL_ALIGN(16);
+};
+
+struct sample_buf_pool {
+    /**
+     * Buffers released by any thread, pushed here without a lock. Only ever drained in one go by
+     * the allocating thread, so there is no ABA problem.
+     */
+    struct sample_buf_pool_node *_Atomic returned CAL_CACHE_ALIGNED;
+
+    /**
+     * Free buffers only the allocating thread touches
+     */
+    struct sample_buf_pool_node *cache CAL_CACHE_ALIGNED;
+
+    /**
+     * The frame allocator backing the buffers
+     */
+    struct frame_alloc *alloc;
+
+    /**
+     * The size of the sample data in each buffer, in bytes
+     */
+    size_t buf_bytes;
+
+    /**
+     * The number of buffers in the pool
+     */
+    size_t nr_bufs;
+};
+
+static inline
+struct sample_buf *_sample_buf_pool_node_to_buf(struct sample_buf_pool_node *node)
+{
+    return (struct sample_buf *)((uint8_t *)node + sizeof(struct sample_buf_pool_node));
+}
+
+static inline
+struct sample_buf_pool_node *_sample_buf_pool_buf_to_node(struct sample_buf *buf)
+{
+    return (struct sample_buf_pool_node *)((uint8_t *)buf - sizeof(struct sample_buf_pool_node));
+}
+
+static
+aresult_t _sample_buf_pool_release(struct sample_buf *buf)
+{
+    aresult_t ret = A_OK;
+
+    struct sample_buf_pool *pool = NULL;
+    struct sample_buf_pool_node *node = NULL,
+                                *head = NULL;
+
+    TSL_ASSERT_ARG(NULL != buf);
+    TSL_BUG_ON(atomic_load(&buf->refcount) != 0);
+
+    pool = buf->priv;
+    node = _sample_buf_pool_buf_to_node(buf);
+
+    head = atomic_load_explicit(&pool->returned, memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->returned, &head, node,
+                memory_order_release, memory_order_relaxed));
+
+    return ret;
+}
+
+aresult_t sample_buf_pool_new(struct sample_buf_pool **ppool, size_t buf_bytes, size_t nr_bufs)
+{
+    aresult_t ret = A_OK;
+
+    struct sample_buf_pool *pool = NULL;
+
+    TSL_ASSERT_ARG(NULL != ppool);
+    TSL_ASSERT_ARG(0 != buf_bytes);
+    TSL_ASSERT_ARG(0 != nr_bufs);
+
+    *ppool = NULL;
+
+    if (FAILED(ret = TZAALLOC(pool, SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    pool->buf_bytes = buf_bytes;
+    pool->nr_bufs = nr_bufs;
+
+    if (FAILED(ret = frame_alloc_new(&pool->alloc,
+                    sizeof(struct sample_buf_pool_node) + sizeof(struct sample_buf) + buf_bytes,
+                    nr_bufs)))
+    {
+        goto done;
+    }
+
+    /* Take every frame up front, so the allocator is never touched again until teardown */
+    for (size_t i = 0; i < nr_bufs; i++) {
+        struct sample_buf_pool_node *node = NULL;
+
+        if (FAILED(ret = frame_alloc(pool->alloc, (void **)&node))) {
+            goto done;
+        }
+
+        node->next = pool->cache;
+        pool->cache = node;
+    }
+
+    *ppool = pool;
+
+done:
+    if (FAILED(ret)) {
+        if (NULL != pool) {
+            sample_buf_pool_delete(&pool);
+        }
+    }
+
+    return ret;
+}
+
+aresult_t sample_buf_pool_alloc(struct sample_buf_pool *pool, struct sample_buf **pbuf)
+{
+    aresult_t ret = A_OK;
+
+    struct sample_buf_pool_node *node = NULL;
+    struct sample_buf *buf = NULL;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != pool);
+    TSL_ASSERT_ARG_DEBUG(NULL != pbuf);
+
+    *pbuf = NULL;
+
+    /* Refill the cache with everything that has been released since we last looked */
+    if (NULL == pool->cache) {
+        pool->cache = atomic_exchange_explicit(&pool->returned, NULL, memory_order_acquire);
+    }
+
+    if (NULL == (node = pool->cache)) {
+        ret = A_E_NOMEM;
+        goto done;
+    }
+
+    pool->cache = node->next;
+
+    buf = _sample_buf_pool_node_to_buf(node);
+    buf->release = _sample_buf_pool_release;
+    buf->priv = pool;
+    buf->sample_buf_bytes = pool->buf_bytes;
+
+    *pbuf = buf;
+
+done:
+    return ret;
+}
+
+aresult_t sample_buf_pool_delete(struct sample_buf_pool **ppool)
+{
+    aresult_t ret = A_OK;
+
+    struct sample_buf_pool *pool = NULL;
+    struct sample_buf_pool_node *node = NULL;
+    size_t nr_freed = 0;
+
+    TSL_ASSERT_PTR_BY_REF(ppool);
+
+    pool = *ppool;
+
+    if (NULL != pool->alloc) {
+        node = pool->cache;
+        while (NULL != node) {
+            struct sample_buf_pool_node *next = node->next;
+            TSL_BUG_IF_FAILED(frame_free(pool->alloc, (void **)&node));
+            node = next;
+            nr_freed++;
+        }
+
+        node = atomic_exchange(&pool->returned, NULL);
+        while (NULL != node) {
+            struct sample_buf_pool_node *next = node->next;
+            TSL_BUG_IF_FAILED(frame_free(pool->alloc, (void **)&node));
+            node = next;
+            nr_freed++;
+        }
+
+        if (nr_freed != pool->nr_bufs) {
+            DIAG("Warning: %zu of %zu sample buffers were never returned to the pool.",
+                    pool->nr_bufs - nr_freed, pool->nr_bufs);
+        }
+
+        TSL_BUG_IF_FAILED(frame_alloc_delete(&pool->alloc));
+    }
+
+    TFREE(pool);
+    *ppool = NULL;
+
+    return ret;
+}
+
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <tsl/result.h>
+
+#include <stddef.h>
+
+struct sample_buf_pool;
+struct sample_buf;
+
+/**
+ * Create a pool of sample buffers. All the buffers are allocated up front. Buffers are handed
+ * out by a single allocating thread, from a cache only that thread touches. Buffers released
+ * from any other thread go on a lock-free return stack, which the allocating thread drains into
+ * its cache when the cache runs dry. Neither side ever takes a lock.
+ *
+ * \param ppool The new pool, returned by reference
+ * \param buf_bytes The size of the sample data in each buffer, in bytes
+ * \param nr_bufs The number of buffers in the pool
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t sample_buf_pool_new(struct sample_buf_pool **ppool, size_t buf_bytes, size_t nr_bufs);
+
+/**
+ * Get a sample buffer from the pool. Must only be called from the pool's allocating thread. The
+ * buffer's release function and private state are set up so that dropping the last reference
+ * returns it to the pool.
+ *
+ * \param pool The pool
+ * \param pbuf The buffer, returned by reference
+ *
+ * \return A_OK on success, A_E_NOMEM if every buffer is in use, an error code otherwise.
+ */
+aresult_t sample_buf_pool_alloc(struct sample_buf_pool *pool, struct sample_buf **pbuf);
+
+/**
+ * Delete the pool. Every buffer must have been returned to the pool.
+ *
+ * \param ppool The pool, passed by reference. Set to NULL on success.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t sample_buf_pool_delete(struct sample_buf_pool **ppool);
+
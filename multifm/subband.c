@@ -0,0 +1,477 @@
+/*
+ *  subband.c - Shared shift-and-decimate sub-band stage for clusters of channels
+ *
+ *  Copyright (c)2017 Phil Vachon <phil@security-embedded.com>
+ *
+ *  This file is a part of The Standard Library (TSL)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <multifm/subband.h>
+#include <multifm/sample_buf_pool.h>
+#include <multifm/demod.h>
+#include <multifm/multifm.h>
+
+#include <filter/filter.h>
+#include <filter/direct_fir.h>
+#include <filter/sample_buf.h>
+
+#include <tsl/work_queue.h>
+#include <tsl/worker_thread.h>
+#include <tsl/list.h>
+#include <tsl/safe_alloc.h>
+#include <tsl/errors.h>
+#include <tsl/assert.h>
+#include <tsl/diag.h>
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * The longest sub-band filter we're willing to design
+ */
+#define SUBBAND_MAX_TAPS            1023
+
+/**
+ * The shortest sub-band filter we'll design, even for very wide transition bands
+ */
+#define SUBBAND_MIN_TAPS            15
+
+/**
+ * Sub-band stage thread context
+ */
+struct subband_thread {
+    /**
+     * Queue of wideband sample buffers to be filtered
+     */
+    struct work_queue wq CAL_CACHE_ALIGNED;
+
+    /**
+     * Mutex for the work queue. Always must be held while manipulating it.
+     */
+    pthread_mutex_t wq_mtx;
+
+    /**
+     * Condition variable signalled when a new sample buffer is ready
+     */
+    pthread_cond_t wq_cv;
+
+    /**
+     * Sub-band worker thread state
+     */
+    struct worker_thread wthr;
+
+    /**
+     * The shift-and-decimate filter
+     */
+    struct direct_fir fir;
+
+    /**
+     * Pool of sub-band output sample buffers
+     */
+    struct sample_buf_pool *out_pool;
+
+    /**
+     * Maximum number of samples in a sub-band output buffer
+     */
+    size_t max_out_samples;
+
+    /**
+     * Scratch output, used to keep the filter moving when no output buffer is available
+     */
+    int16_t *scratch;
+
+    /**
+     * List of demodulator threads attached to this sub-band
+     */
+    struct list_entry demods;
+
+    /**
+     * Number of demodulator threads attached to this sub-band
+     */
+    size_t nr_demods;
+
+    /**
+     * Offset of the sub-band center from the wideband center, in Hz
+     */
+    int32_t center_hz;
+
+    /**
+     * Number of times an output sample buffer could not be allocated
+     */
+    size_t nr_alloc_fails;
+
+    /**
+     * Total number of wideband samples filtered
+     */
+    size_t total_nr_samples;
+
+    /**
+     * Whether the worker thread was started
+     */
+    bool started;
+};
+
+/**
+ * Design a Blackman-windowed low pass for the sub-band, long enough that nothing that aliases
+ * into the passband after decimation gets through.
+ */
+static
+aresult_t _subband_design_filter(uint32_t sample_rate, unsigned decimation, uint32_t pass_hz,
+        int16_t **pcoeffs, size_t *pnr_coeffs)
+{
+    aresult_t ret = A_OK;
+
+    double *taps = NULL;
+    int16_t *coeffs = NULL;
+    double stop_hz = (double)sample_rate/(double)decimation - (double)pass_hz,
+           cutoff = ((double)pass_hz + stop_hz)/2.0/(double)sample_rate,
+           sum = 0.0;
+    size_t nr_taps = 0;
+
+    if (stop_hz <= (double)pass_hz) {
+        MFM_MSG(SEV_ERROR, "SUBBAND-TOO-WIDE", "Sub-band passband of %u Hz doesn't fit at %u samples/sec",
+                pass_hz, sample_rate/decimation);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    /* A Blackman window needs about 5.5/(transition width) taps */
+    nr_taps = (size_t)ceil(5.5 * (double)sample_rate/(stop_hz - (double)pass_hz)) | 1;
+    nr_taps = BL_MAX2(nr_taps, SUBBAND_MIN_TAPS);
+
+    if (SUBBAND_MAX_TAPS < nr_taps) {
+        MFM_MSG(SEV_ERROR, "SUBBAND-FILTER-TOO-LONG", "Sub-band filter would need %zu taps, increase the sub-band rate.",
+                nr_taps);
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (FAILED(ret = TCALLOC((void **)&taps, nr_taps, sizeof(double)))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TCALLOC((void **)&coeffs, nr_taps, sizeof(int16_t)))) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < nr_taps; i++) {
+        double t = (double)i - (double)(nr_taps - 1)/2.0,
+               sinc = (0.0 == t) ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * t)/(M_PI * t),
+               win = 0.42 - 0.5 * cos(2.0 * M_PI * i/(nr_taps - 1)) + 0.08 * cos(4.0 * M_PI * i/(nr_taps - 1));
+        taps[i] = sinc * win;
+        sum += taps[i];
+    }
+
+    /* Unity gain at DC */
+    for (size_t i = 0; i < nr_taps; i++) {
+        coeffs[i] = (int16_t)lrint(taps[i]/sum * (double)(1 << Q_15_SHIFT));
+    }
+
+    *pcoeffs = coeffs;
+    *pnr_coeffs = nr_taps;
+    coeffs = NULL;
+
+done:
+    if (NULL != taps) {
+        TFREE(taps);
+    }
+
+    if (NULL != coeffs) {
+        TFREE(coeffs);
+    }
+
+    return ret;
+}
+
+/**
+ * Hand a block of sub-band samples off to the demodulators
+ */
+static
+void _subband_thread_emit(struct subband_thread *sbt, struct sample_buf *buf, size_t nr_out)
+{
+    struct demod_thread *dthr = NULL;
+
+    if (0 == nr_out) {
+        atomic_store(&buf->refcount, 1);
+        TSL_BUG_IF_FAILED(sample_buf_decref(buf));
+        return;
+    }
+
+    buf->nr_samples = nr_out;
+    atomic_store(&buf->refcount, sbt->nr_demods);
+
+    list_for_each_type(dthr, &sbt->demods, dt_node) {
+        TSL_BUG_IF_FAILED(demod_thread_deliver(dthr, buf));
+    }
+}
+
+static
+aresult_t _subband_thread_process(struct subband_thread *sbt, struct sample_buf *sbuf)
+{
+    aresult_t ret = A_OK;
+
+    size_t nr_out = 0;
+    uint64_t start_time_ns = sbuf->start_time_ns;
+
+    sbt->total_nr_samples += sbuf->nr_samples;
+
+    /* The mixing FIR consumes the wideband buffer right away */
+    TSL_BUG_IF_FAILED(direct_fir_push_sample_buf(&sbt->fir, sbuf));
+
+    do {
+        struct sample_buf *buf = NULL;
+
+        if (FAILED(sample_buf_pool_alloc(sbt->out_pool, &buf))) {
+            if (0 == sbt->nr_alloc_fails) {
+                MFM_MSG(SEV_WARNING, "NO-SUBBAND-BUFFER", "Out of sub-band output buffers, dropping samples for "
+                        "sub-band at %d Hz.", sbt->center_hz);
+            }
+            sbt->nr_alloc_fails++;
+
+            /* The filter state must always advance, even if the samples are being dropped */
+            TSL_BUG_IF_FAILED(direct_fir_process(&sbt->fir, sbt->scratch, sbt->max_out_samples, &nr_out));
+            continue;
+        }
+
+        buf->sample_type = COMPLEX_INT_16;
+        buf->start_time_ns = start_time_ns;
+
+        TSL_BUG_IF_FAILED(direct_fir_process(&sbt->fir, (int16_t *)buf->data_buf, sbt->max_out_samples, &nr_out));
+
+        _subband_thread_emit(sbt, buf, nr_out);
+    } while (nr_out == sbt->max_out_samples);
+
+    return ret;
+}
+
+static
+aresult_t _subband_thread_work(struct worker_thread *wthr)
+{
+    aresult_t ret = A_OK;
+
+    struct subband_thread *sbt = BL_CONTAINER_OF(wthr, struct subband_thread, wthr);
+
+    pthread_mutex_lock(&sbt->wq_mtx);
+
+    while (worker_thread_is_running(wthr)) {
+        struct sample_buf *buf = NULL;
+        TSL_BUG_IF_FAILED(work_queue_pop(&sbt->wq, (void **)&buf));
+
+        if (NULL != buf) {
+            pthread_mutex_unlock(&sbt->wq_mtx);
+
+            TSL_BUG_IF_FAILED(_subband_thread_process(sbt, buf));
+
+            pthread_mutex_lock(&sbt->wq_mtx);
+        } else {
+            /* Wait until the acquisition thread wakes us up */
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += 1;
+            pthread_cond_timedwait(&sbt->wq_cv, &sbt->wq_mtx, &ts);
+        }
+    }
+
+    pthread_mutex_unlock(&sbt->wq_mtx);
+
+    DIAG("Sub-band at %d Hz filtered %zu samples before termination.", sbt->center_hz, sbt->total_nr_samples);
+
+    return ret;
+}
+
+aresult_t subband_thread_new(struct subband_thread **psbt, uint32_t sample_rate, int32_t center_hz,
+        unsigned decimation, uint32_t pass_hz, size_t samples_per_buf, size_t nr_bufs)
+{
+    aresult_t ret = A_OK;
+
+    struct subband_thread *sbt = NULL;
+    int16_t *coeffs = NULL;
+    size_t nr_coeffs = 0;
+
+    TSL_ASSERT_ARG(NULL != psbt);
+    TSL_ASSERT_ARG(0 != sample_rate);
+    TSL_ASSERT_ARG(0 != decimation);
+    TSL_ASSERT_ARG(0 != samples_per_buf);
+    TSL_ASSERT_ARG(0 != nr_bufs);
+
+    *psbt = NULL;
+
+    if (FAILED(ret = _subband_design_filter(sample_rate, decimation, pass_hz, &coeffs, &nr_coeffs))) {
+        goto done;
+    }
+
+    if (FAILED(ret = TZAALLOC(sbt, SYS_CACHE_LINE_LENGTH))) {
+        goto done;
+    }
+
+    list_init(&sbt->demods);
+    sbt->center_hz = center_hz;
+
+    if (FAILED(ret = work_queue_new(&sbt->wq, 128))) {
+        goto done;
+    }
+
+    if (0 != pthread_mutex_init(&sbt->wq_mtx, NULL)) {
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (0 != pthread_cond_init(&sbt->wq_cv, NULL)) {
+        ret = A_E_INVAL;
+        goto done;
+    }
+
+    if (FAILED(ret = direct_fir_init_mix(&sbt->fir, nr_coeffs, coeffs, decimation, sample_rate, center_hz))) {
+        goto done;
+    }
+
+    sbt->max_out_samples = samples_per_buf/decimation + 1;
+
+    if (FAILED(ret = TACALLOC((void **)&sbt->scratch, sbt->max_out_samples, 2 * sizeof(int16_t),
+                    SYS_CACHE_LINE_LENGTH)))
+    {
+        goto done;
+    }
+
+    if (FAILED(ret = sample_buf_pool_new(&sbt->out_pool, sbt->max_out_samples * 2 * sizeof(int16_t),
+                    nr_bufs)))
+    {
+        goto done;
+    }
+
+    MFM_MSG(SEV_INFO, "SUBBAND", "Sub-band at %d Hz: +/- %u Hz passband, decimation %u, %zu taps",
+            center_hz, pass_hz, decimation, nr_coeffs);
+
+    *psbt = sbt;
+
+done:
+    if (NULL != coeffs) {
+        TFREE(coeffs);
+    }
+
+    if (FAILED(ret)) {
+        if (NULL != sbt) {
+            subband_thread_delete(&sbt);
+        }
+    }
+
+    return ret;
+}
+
+aresult_t subband_thread_add_demod(struct subband_thread *sbt, struct demod_thread *dthr)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != sbt);
+    TSL_ASSERT_ARG(NULL != dthr);
+    TSL_ASSERT_ARG(false == sbt->started);
+
+    list_append(&sbt->demods, &dthr->dt_node);
+    sbt->nr_demods++;
+
+    return ret;
+}
+
+aresult_t subband_thread_start(struct subband_thread *sbt)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG(NULL != sbt);
+    TSL_ASSERT_ARG(false == sbt->started);
+
+    if (FAILED(ret = worker_thread_new(&sbt->wthr, _subband_thread_work, WORKER_THREAD_CPU_MASK_ANY))) {
+        MFM_MSG(SEV_ERROR, "SUBBAND-THREAD-START-FAIL", "Failed to start sub-band thread, aborting.");
+        goto done;
+    }
+
+    sbt->started = true;
+
+done:
+    return ret;
+}
+
+aresult_t subband_thread_deliver(struct subband_thread *sbt, struct sample_buf *buf)
+{
+    aresult_t ret = A_OK;
+
+    TSL_ASSERT_ARG_DEBUG(NULL != sbt);
+    TSL_ASSERT_ARG_DEBUG(NULL != buf);
+
+    pthread_mutex_lock(&sbt->wq_mtx);
+    TSL_BUG_IF_FAILED(work_queue_push(&sbt->wq, buf));
+    pthread_mutex_unlock(&sbt->wq_mtx);
+
+    pthread_cond_signal(&sbt->wq_cv);
+
+    return ret;
+}
+
+aresult_t subband_thread_delete(struct subband_thread **psbt)
+{
+    aresult_t ret = A_OK;
+
+    struct subband_thread *sbt = NULL;
+    struct sample_buf *buf = NULL;
+    struct demod_thread *cur = NULL,
+                        *tmp = NULL;
+
+    TSL_ASSERT_PTR_BY_REF(psbt);
+
+    sbt = *psbt;
+
+    if (true == sbt->started) {
+        TSL_BUG_IF_FAILED(worker_thread_request_shutdown(&sbt->wthr));
+        TSL_BUG_IF_FAILED(worker_thread_delete(&sbt->wthr));
+        sbt->started = false;
+    }
+
+    /* Release any wideband buffers that were never filtered */
+    do {
+        buf = NULL;
+        TSL_BUG_IF_FAILED(work_queue_pop(&sbt->wq, (void **)&buf));
+        if (NULL != buf) {
+            TSL_BUG_IF_FAILED(sample_buf_decref(buf));
+        }
+    } while (NULL != buf);
+
+    /* Demodulators hold references to our output buffers, so they must go first */
+    list_for_each_type_safe(cur, tmp, &sbt->demods, dt_node) {
+        list_del(&cur->dt_node);
+        TSL_BUG_IF_FAILED(demod_thread_delete(&cur));
+    }
+
+    direct_fir_cleanup(&sbt->fir);
+
+    if (NULL != sbt->scratch) {
+        TFREE(sbt->scratch);
+    }
+
+    if (NULL != sbt->out_pool) {
+        TSL_BUG_IF_FAILED(sample_buf_pool_delete(&sbt->out_pool));
+    }
+
+    TSL_BUG_IF_FAILED(work_queue_release(&sbt->wq));
+
+    TFREE(sbt);
+    *psbt = NULL;
+
+    return ret;
+}
+
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <tsl/result.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct subband_thread;
+struct demod_thread;
+struct sample_buf;
+
+/**
+ * Create a new sub-band stage. The stage shifts a cluster of channels down to baseband, low-pass
+ * filters and decimates the wideband stream, then hands the narrower sub-band stream to the
+ * demodulator threads for the channels in the cluster.
+ *
+ * \param psbt The new sub-band stage, returned by reference.
+ * \param sample_rate The wideband sample rate, in Hz.
+ * \param center_hz The offset of the center of the cluster from the wideband center frequency.
+ * \param decimation The decimation factor from the wideband rate to the sub-band rate.
+ * \param pass_hz The one-sided bandwidth of the sub-band that must be passed without aliasing.
+ * \param samples_per_buf The maximum number of samples in an input sample buffer.
+ * \param nr_bufs The number of output sample buffers to allocate.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t subband_thread_new(struct subband_thread **psbt, uint32_t sample_rate, int32_t center_hz,
+        unsigned decimation, uint32_t pass_hz, size_t samples_per_buf, size_t nr_bufs);
+
+/**
+ * Attach a demodulator thread to the sub-band stage. The stage takes ownership of the
+ * demodulator thread, and will delete it when the stage is deleted. Must be called before
+ * `subband_thread_start`.
+ *
+ * \param sbt The sub-band stage
+ * \param dthr The demodulator thread
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t subband_thread_add_demod(struct subband_thread *sbt, struct demod_thread *dthr);
+
+/**
+ * Start the sub-band stage worker thread.
+ */
+aresult_t subband_thread_start(struct subband_thread *sbt);
+
+/**
+ * Deliver a wideband sample buffer to the sub-band stage. The stage consumes one reference on
+ * the buffer.
+ *
+ * \param sbt The sub-band stage
+ * \param buf The sample buffer
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t subband_thread_deliver(struct subband_thread *sbt, struct sample_buf *buf);
+
+/**
+ * Stop the sub-band stage, and delete it along with all attached demodulator threads.
+ *
+ * \param psbt The sub-band stage, passed by reference. Set to NULL on success.
+ *
+ * \return A_OK on success, an error code otherwise.
+ */
+aresult_t subband_thread_delete(struct subband_thread **psbt);
+
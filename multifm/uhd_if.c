@@ -2,6 +2,7 @@
 #include <multifm/uhd_if_priv.h>
 #include <multifm/receiver.h>
 
+#include <filter/convert.h>
 #include <filter/sample_buf.h>
 
 #include <config/engine.h>
@@ -80,6 +81,9 @@ aresult_t _uhd_rx_worker_thread(struct receiver *rx)
             buf->nr_samples += nr_samps;
 
             if (buf->nr_samples == MAX_BUF_SAMPS) {
+                /* The samples were received in place, as sc16, so this only gathers statistics */
+                TSL_BUG_IF_FAILED(receiver_sample_buf_fill(rx, buf, CONVERT_FORMAT_CS16, buf->data_buf,
+                            buf->nr_samples));
                 TSL_BUG_IF_FAILED(receiver_sample_buf_deliver(rx, buf));
                 buf = NULL;
             }
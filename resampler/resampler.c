@@ -25,6 +25,7 @@
 #include <filter/sample_buf.h>
 #include <filter/complex.h>
 #include <filter/dc_blocker.h>
+#include <filter/shm_ring.h>
 
 #include <app/app.h>
 
@@ -39,9 +40,15 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
+#include <inttypes.h>
 
 #define RES_MSG(sev, sys, msg, ...) MESSAGE("RESAMPLER", sev, sys, msg, ##__VA_ARGS__)
 
+/**
+ * How long to wait for a block from the input ring before checking if we should stop
+ */
+#define RING_WAIT_NS                100000000ull
+
 static
 unsigned interpolate = 1;
 
@@ -54,6 +61,9 @@ unsigned input_sample_rate = 0;
 static
 int in_fifo = -1;
 
+static
+struct shm_ring_consumer *in_ring = NULL;
+
 static
 int out_fifo = -1;
 
@@ -72,9 +82,10 @@ bool dc_blocker = false;
 static
 void _usage(const char *appname)
 {
-    RES_MSG(SEV_INFO, "USAGE", "%s -I [interpolate] -D [decimate] -F [filter file] -S [sample rate] [-b] [in_fifo] [out_fifo]",
+    RES_MSG(SEV_INFO, "USAGE", "%s -I [interpolate] -D [decimate] -F [filter file] -S [sample rate] [-b] [-r in_ring | in_fifo] [out_fifo]",
             appname);
     RES_MSG(SEV_INFO, "USAGE", "        -b      Enable DC blocking filter");
+    RES_MSG(SEV_INFO, "USAGE", "        -r      Read from a multifm output ring");
     exit(EXIT_SUCCESS);
 }
 
@@ -82,11 +93,13 @@ static
 void _set_options(int argc, char * const argv[])
 {
     int arg = -1;
-    const char *filter_file = NULL;
+    const char *filter_file = NULL,
+               *in_ring_name = NULL,
+               *out_fifo_name = NULL;
     struct config *cfg CAL_CLEANUP(config_delete) = NULL;
     double *filter_coeffs_f = NULL;
 
-    while ((arg = getopt(argc, argv, "I:D:S:F:bh")) != -1) {
+    while ((arg = getopt(argc, argv, "I:D:S:F:r:bh")) != -1) {
         switch (arg) {
         case 'I':
             interpolate = strtoll(optarg, NULL, 0);
@@ -104,17 +117,23 @@ void _set_options(int argc, char * const argv[])
             dc_blocker = true;
             RES_MSG(SEV_INFO, "DC-BLOCKER-ENABLED", "Enabling DC Blocking Filter.");
             break;
+        case 'r':
+            in_ring_name = optarg;
+            break;
         case 'h':
             _usage(argv[0]);
             break;
         }
     }
 
-    if (optind > argc) {
+    /* With an input ring, the only file is the output FIFO */
+    if (optind + (NULL == in_ring_name ? 1 : 0) >= argc) {
         RES_MSG(SEV_FATAL, "MISSING-SRC-DEST", "Missing source/destination file");
         exit(EXIT_FAILURE);
     }
 
+    out_fifo_name = argv[optind + (NULL == in_ring_name ? 1 : 0)];
+
     if (0 == decimate) {
         RES_MSG(SEV_FATAL, "BAD-DECIMATION", "Decimation factor must be a non-zero integer.");
         exit(EXIT_FAILURE);
@@ -150,12 +169,28 @@ void _set_options(int argc, char * const argv[])
         filter_coeffs[i] = (int16_t)(filter_coeffs_f[i] * q15);
     }
 
-    if (0 > (out_fifo = open(argv[optind + 1], O_WRONLY))) {
-        RES_MSG(SEV_INFO, "BAD-OUTPUT", "Bad output - cannot open %s", argv[optind + 1]);
+    if (0 > (out_fifo = open(out_fifo_name, O_WRONLY))) {
+        RES_MSG(SEV_INFO, "BAD-OUTPUT", "Bad output - cannot open %s", out_fifo_name);
         exit(EXIT_FAILURE);
     }
 
-    if (0 > (in_fifo = open(argv[optind], O_RDONLY))) {
+    if (NULL != in_ring_name) {
+        if (FAILED(shm_ring_consumer_new(&in_ring, in_ring_name))) {
+            RES_MSG(SEV_FATAL, "BAD-INPUT-RING", "Bad input - cannot attach to ring '%s', is multifm running?",
+                    in_ring_name);
+            exit(EXIT_FAILURE);
+        }
+
+        if (SHM_RING_SAMPLE_REAL_INT_16 != shm_ring_consumer_sample_type(in_ring)) {
+            RES_MSG(SEV_FATAL, "BAD-INPUT-RING", "Ring '%s' doesn't carry PCM samples.", in_ring_name);
+            exit(EXIT_FAILURE);
+        }
+
+        if (0 != input_sample_rate && input_sample_rate != shm_ring_consumer_sample_rate(in_ring)) {
+            RES_MSG(SEV_WARNING, "RING-RATE-MISMATCH", "Ring '%s' carries samples at %u Hz, not %u Hz.",
+                    in_ring_name, shm_ring_consumer_sample_rate(in_ring), input_sample_rate);
+        }
+    } else if (0 > (in_fifo = open(argv[optind], O_RDONLY))) {
         RES_MSG(SEV_INFO, "BAD-INPUT", "Bad input - cannot open %s", argv[optind]);
         exit(EXIT_FAILURE);
     }
@@ -262,6 +297,79 @@ done:
     return ret;
 }
 
+/**
+ * Read blocks of samples from the input ring, in place, and resample them out to the output
+ * FIFO.
+ */
+static
+aresult_t process_ring_fir(void)
+{
+    int ret = A_OK;
+
+    struct dc_blocker blck;
+
+    TSL_BUG_IF_FAILED(dc_blocker_init(&blck, 0.9999));
+
+    do {
+        const int16_t *samples = NULL;
+        size_t nr_bytes = 0,
+               new_samples = 0;
+        uint64_t nr_dropped = 0;
+
+        if (FAILED(ret = shm_ring_consumer_next(in_ring, (const void **)&samples, &nr_bytes, &nr_dropped,
+                        RING_WAIT_NS)))
+        {
+            if (A_E_DONE == ret) {
+                RES_MSG(SEV_INFO, "RING-CLOSED", "The input ring was closed by multifm.");
+                ret = A_OK;
+            }
+            goto done;
+        }
+
+        if (NULL == samples) {
+            continue;
+        }
+
+        if (0 != nr_dropped) {
+            RES_MSG(SEV_WARNING, "RING-OVERRUN", "Fell behind the input ring, lost %"PRIu64" blocks of samples.",
+                    nr_dropped);
+        }
+
+        /* The filter copies the samples into its history, so the block can be handed back right away */
+        TSL_BUG_IF_FAILED(polyphase_fir_push_samples(pfir, samples, nr_bytes / sizeof(int16_t)));
+
+        if (FAILED(shm_ring_consumer_release(in_ring))) {
+            RES_MSG(SEV_WARNING, "RING-OVERRUN", "Input ring block was written over while it was being read.");
+        }
+
+        /* Filter the samples until the filter runs dry */
+        for (;;) {
+            TSL_BUG_IF_FAILED(polyphase_fir_process(pfir, output_buf, NR_SAMPLES, &new_samples));
+
+            if (0 == new_samples) {
+                break;
+            }
+
+            /* Apply DC blocker, if asked */
+            if (true == dc_blocker) {
+                TSL_BUG_IF_FAILED(dc_blocker_apply(&blck, output_buf, new_samples));
+            }
+
+            /* Write them out */
+            if (0 > write(out_fifo, output_buf, new_samples * sizeof(int16_t))) {
+                int errnum = errno;
+                ret = A_E_INVAL;
+                RES_MSG(SEV_FATAL, "WRITE-FIFO-FAIL", "Failed to write to output fifo: %s (%d)",
+                        strerror(errnum), errnum);
+                goto done;
+            }
+        }
+    } while (app_running());
+
+done:
+    return ret;
+}
+
 int main(int argc, char * const argv[])
 {
     int ret = EXIT_FAILURE;
@@ -274,7 +382,7 @@ int main(int argc, char * const argv[])
 
     RES_MSG(SEV_INFO, "STARTING", "Starting polyphase resampler");
 
-    if (FAILED(process_fir())) {
+    if (FAILED(NULL != in_ring ? process_ring_fir() : process_fir())) {
         RES_MSG(SEV_FATAL, "FIR-FAILED", "Failed during filtering.");
         goto done;
     }
@@ -283,6 +391,11 @@ int main(int argc, char * const argv[])
 
 done:
     polyphase_fir_delete(&pfir);
+
+    if (NULL != in_ring) {
+        shm_ring_consumer_delete(&in_ring);
+    }
+
     return ret;
 }
 
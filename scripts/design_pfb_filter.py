@@ -0,0 +1,56 @@
+#!/usr/bin/env python
+from gnuradio import filter
+
+import json
+import sys
+
+def design_filter(nr_bins, oversampled):
+    """
+    Design the prototype low pass filter for a polyphase filter bank channelizer.
+    Args:
+        nr_bins: number of bins in the filter bank (integer > 1)
+        oversampled: whether the bank is 2x oversampled (decimates by nr_bins/2) (bool)
+    Returns:
+        : sequence of numbers
+    """
+
+    if nr_bins < 2:
+        raise ValueError('Invalid bin count, must be at least 2.')
+
+    if oversampled and 0 != nr_bins % 2:
+        raise ValueError('An oversampled filter bank needs an even number of bins.')
+
+    beta = 7.0
+    bin_width = 1.0/float(nr_bins)
+
+    if oversampled:
+        # Pass the entire bin, so a channel that straddles two bins is still intact in
+        # one of them. Stop before the band folds over at the bin sample rate.
+        cutoff = bin_width
+        trans_width = bin_width/2.0
+    else:
+        cutoff = bin_width/2.0
+        trans_width = bin_width/4.0
+
+    taps = filter.firdes.low_pass(1.0,                               # gain
+                                  1.0,                               # Fs
+                                  cutoff,                            # cut-off
+                                  trans_width,                       # transition width
+                                  filter.firdes.WIN_KAISER,
+                                  beta)                              # beta
+
+    return taps
+
+def main(argv):
+    if len(argv) < 3:
+        print('Usage: {} [number of bins] [oversampled (0 or 1)]'.format(argv[0]))
+        print('  Design a prototype filter for the multifm polyphase filter bank channelizer')
+        sys.exit(-1)
+
+    nr_bins = int(argv[1])
+    oversampled = 0 != int(argv[2])
+
+    print(json.dumps({'pfb': {'nrBins': nr_bins, 'oversampled': oversampled, 'protoTaps': list(design_filter(nr_bins, oversampled))}}))
+
+if __name__ == '__main__':
+    main(sys.argv)